@@ -73,7 +73,7 @@ struct aw_s {
 	/* alignment name in gam format */
 	char *aln_name_prefix;
 	uint32_t aln_name_len;
-	uint32_t pad2;
+	uint32_t flags;				/* aw_aln_flags of the current read */
 	int64_t aln_cnt;
 };
 
@@ -261,6 +261,11 @@ void sam_print_option_tags(
 {
 	/* print alignment score */
 	zfprintf(aw->fp, "RG:Z:%d", SAM_DEFAULT_READGROUP);
+
+	/* truncated by the per-read work limits */
+	if((aw->flags & AW_TRUNCATED) != 0) {
+		zfprintf(aw->fp, "\tZT:i:1");
+	}
 	return;
 }
 
@@ -765,7 +770,13 @@ void gpa_write_segment(
 
 	/* optional fields */
 	/* mapping quality */
-	zfprintf(aw->fp, "MQ:i:%d\n", 255);
+	zfprintf(aw->fp, "MQ:i:%d", 255);
+
+	/* truncated by the per-read work limits */
+	if((aw->flags & AW_TRUNCATED) != 0) {
+		zfprintf(aw->fp, "\tZT:i:1");
+	}
+	zfputc(aw->fp, '\n');
 	return;
 }
 
@@ -812,8 +823,10 @@ void aw_append_alignment(
 	gref_idx_t const *ref,
 	gref_acv_t const *query,
 	struct gaba_alignment_s const *const *aln,
-	uint64_t cnt)
+	uint64_t cnt,
+	uint32_t flags)
 {
+	aw->flags = flags;
 	for(uint64_t i = 0; i < cnt; i++) {
 		debug("append i(%lld), ref(%p), query(%p), aln[i](%p)", i, ref, query, aln[i]);
 		aw->conf.body(aw, ref, query, aln[i], i == 0);
@@ -827,8 +840,10 @@ void aw_append_alignment(
 void aw_append_unmapped(
 	aw_t *aw,
 	gref_idx_t const *ref,
-	gref_acv_t const *query)
+	gref_acv_t const *query,
+	uint32_t flags)
 {
+	aw->flags = flags;
 	aw->conf.unmapped(aw, ref, query);
 	return;
 }
@@ -901,14 +916,24 @@ aw_t *aw_init(
 	if(params->format != 0) {
 		aw->conf = conf[params->format];
 	} else {
+		/* compressed output (e.g. "out.sam.zst") is detected by the extension before the suffix */
+		static char const *const zext[] = { ".gz", ".bz2", ".zst", ".xz" };
+		uint64_t path_len = strlen(path);
+		for(uint64_t i = 0; i < sizeof(zext) / sizeof(char const *); i++) {
+			if(path_len > strlen(zext[i]) && strcmp(path + path_len - strlen(zext[i]), zext[i]) == 0) {
+				path_len -= strlen(zext[i]);
+				break;
+			}
+		}
+
 		for(uint64_t i = 0; i < sizeof(conf) / sizeof(struct aw_conf_s); i++) {
 			/* skip if extension string is not provided */
 			if(conf[i].ext == NULL) { continue; }
 
 			/* if path string is shorter than extension string */
-			if(strlen(path) < strlen(conf[i].ext)) { continue; }
+			if(path_len < strlen(conf[i].ext)) { continue; }
 
-			if(strncmp(path + strlen(path) - strlen(conf[i].ext), conf[i].ext, strlen(conf[i].ext)) == 0) {
+			if(strncmp(path + path_len - strlen(conf[i].ext), conf[i].ext, strlen(conf[i].ext)) == 0) {
 				debug("format detected %s", conf[i].ext);
 
 				aw->conf = conf[i];
@@ -1251,7 +1276,7 @@ unittest()
 
 	char const *path = "./test.sam";
 	aw_t *aw = aw_init(path, c->idx, NULL);
-	aw_append_alignment(aw, c->idx, c->idx, (gaba_alignment_t const *const *)c->res, c->cnt);
+	aw_append_alignment(aw, c->idx, c->idx, (gaba_alignment_t const *const *)c->res, c->cnt, 0);
 	aw_clean(aw);
 
 	char const *sam =
@@ -1288,7 +1313,7 @@ unittest()
 
 	char const *path = "./test.sam";
 	aw_t *aw = aw_init(path, c->idx, AW_PARAMS(.clip = 'H'));
-	aw_append_alignment(aw, c->idx, c->idx, (gaba_alignment_t const *const *)c->res, c->cnt);
+	aw_append_alignment(aw, c->idx, c->idx, (gaba_alignment_t const *const *)c->res, c->cnt, 0);
 	aw_clean(aw);
 
 	char const *sam =
@@ -1363,7 +1388,7 @@ unittest()
 
 	char const *path = "./test.gpa";
 	aw_t *aw = aw_init(path, c->idx, NULL);
-	aw_append_alignment(aw, c->idx, c->idx, (gaba_alignment_t const *const *)c->res, c->cnt);
+	aw_append_alignment(aw, c->idx, c->idx, (gaba_alignment_t const *const *)c->res, c->cnt, 0);
 	aw_clean(aw);
 
 	char const *gpa =
@@ -1396,7 +1421,7 @@ unittest()
 
 	char const *path = "./test.gpa";
 	aw_t *aw = aw_init(path, c->idx, AW_PARAMS( .name_prefix = "aln" ));
-	aw_append_alignment(aw, c->idx, c->idx, (gaba_alignment_t const *const *)c->res, c->cnt);
+	aw_append_alignment(aw, c->idx, c->idx, (gaba_alignment_t const *const *)c->res, c->cnt, 0);
 	aw_clean(aw);
 
 	char const *gpa =
@@ -1422,6 +1447,56 @@ unittest()
 	remove(path);
 }
 
+/* truncated reads are marked with ZT:i:1 in sam and gpa */
+unittest()
+{
+	omajinai();
+
+	char const *path[2] = { "./test.sam", "./test.gpa" };
+	for(uint64_t i = 0; i < 2; i++) {
+		aw_t *aw = aw_init(path[i], c->idx, NULL);
+		aw_append_alignment(aw, c->idx, c->idx, (gaba_alignment_t const *const *)c->res, 1, 0);
+		aw_append_alignment(aw, c->idx, c->idx, (gaba_alignment_t const *const *)c->res, 1, AW_TRUNCATED);
+		aw_clean(aw);
+	}
+
+	char const *sam =
+		"@HD\tVN:1.0\tSO:unsorted\n"
+		"@SQ\tSN:sec0\tLN:4\n"
+		"@SQ\tSN:sec1\tLN:4\n"
+		"@SQ\tSN:sec2\tLN:8\n"
+		"@RG\tID:1\n"
+		"sec0\t0\tsec0\t1\t255\t4M\tsec1\t0\t0\tGGRA\t*\tRG:Z:1\n"
+		"sec1\t0\tsec1\t1\t255\t4M\tsec2\t0\t0\tMGGG\t*\tRG:Z:1\n"
+		"sec2\t0\tsec2\t1\t255\t8M\t*\t0\t0\tACVVGTGT\t*\tRG:Z:1\n"
+		"sec0\t0\tsec0\t1\t255\t4M\tsec1\t0\t0\tGGRA\t*\tRG:Z:1\tZT:i:1\n"
+		"sec1\t0\tsec1\t1\t255\t4M\tsec2\t0\t0\tMGGG\t*\tRG:Z:1\tZT:i:1\n"
+		"sec2\t0\tsec2\t1\t255\t8M\t*\t0\t0\tACVVGTGT\t*\tRG:Z:1\tZT:i:1\n";
+	char const *gpa =
+		"H\tVN:Z:0.1\n"
+		"A\t0\tsec0\t0\t4\t+\tsec0\t0\t4\t+\t4M\t*\t1\tMQ:i:255\n"
+		"A\t1\tsec1\t0\t4\t+\tsec1\t0\t4\t+\t4M\t0\t2\tMQ:i:255\n"
+		"A\t2\tsec2\t0\t8\t+\tsec2\t0\t8\t+\t8M\t1\t*\tMQ:i:255\n"
+		"A\t3\tsec0\t0\t4\t+\tsec0\t0\t4\t+\t4M\t*\t4\tMQ:i:255\tZT:i:1\n"
+		"A\t4\tsec1\t0\t4\t+\tsec1\t0\t4\t+\t4M\t3\t5\tMQ:i:255\tZT:i:1\n"
+		"A\t5\tsec2\t0\t8\t+\tsec2\t0\t8\t+\t8M\t4\t*\tMQ:i:255\tZT:i:1\n";
+	char const *expected[2] = { sam, gpa };
+
+	for(uint64_t i = 0; i < 2; i++) {
+		char *rbuf = (char *)malloc(1024);
+
+		zf_t *fp = zfopen(path[i], "r");
+		uint64_t size = zfread(fp, rbuf, 1024);
+
+		assert(size == strlen(expected[i]), "size(%lld, %lld)", size, strlen(expected[i]));
+		assert(memcmp(rbuf, expected[i], MIN2(size, strlen(expected[i]))) == 0, "%s%s", dump(rbuf, size), dump(expected[i], strlen(expected[i])));
+
+		zfclose(fp);
+		free(rbuf);
+		remove(path[i]);
+	}
+}
+
 /**
  * end of aw.c
  */
@@ -37,6 +37,14 @@ enum aw_sam_flags {
 	SAM_SUPPLEMENTARY		= 0x0800
 };
 
+/**
+ * @enum aw_aln_flags
+ */
+enum aw_aln_flags {
+	/** flags of a read, given to aw_append_alignment and aw_append_unmapped */
+	AW_TRUNCATED			= 0x0001	/* alignment of the read was truncated (ZT:i:1 in sam and gpa) */
+};
+
 /**
  * @struct aw_params_s
  */
@@ -80,7 +88,8 @@ void aw_append_alignment(
 	gref_idx_t const *ref,
 	gref_acv_t const *query,
 	struct gaba_alignment_s const *const *aln,
-	uint64_t cnt);
+	uint64_t cnt,
+	uint32_t flags);
 
 /**
  * @fn aw_append_unmapped
@@ -88,7 +97,8 @@ void aw_append_alignment(
 void aw_append_unmapped(
 	aw_t *aw,
 	gref_idx_t const *ref,
-	gref_acv_t const *query);
+	gref_acv_t const *query,
+	uint32_t flags);
 
 
 #endif /* _SAM_H_INCLUDED */
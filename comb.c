@@ -37,6 +37,14 @@
 #define COMB_VERSION_STRING			"0.0.1"
 #endif
 
+/* memory budget (see comb_align_calc_mem) */
+#define COMB_MB						( 1024 * 1024 )
+#define COMB_DP_MEM_SIZE			( 256 * COMB_MB )	/* initial DP stack of each thread (gaba default) */
+#define COMB_DP_MIN_MEM_SIZE		( 4 * COMB_MB )
+#define COMB_READ_MEM_SIZE			( 4 * COMB_MB )		/* each read in flight (sr pool object) */
+#define COMB_OUT_MEM_SIZE			( 4 * COMB_MB )		/* output stream buffers */
+#define COMB_MIN_READS_PER_THREAD	( 4 )
+
 
 /* alignment core functions */
 /**
@@ -74,8 +82,22 @@ struct comb_align_params_s {
 
 	/* filtering parameters */
 	int64_t kmer_cnt_thresh;
+	int64_t rep_rescue_cnt;
 	int64_t overlap_thresh;
 	int64_t gapless_thresh;
+	int64_t two_hit_window;
+	int64_t chain_window;
+
+	/* per-read work limits */
+	int64_t max_seeds;
+	int64_t max_fronts;
+	int64_t max_cells;
+	int64_t max_msec;
+
+	/* beam pruning */
+	int64_t beam_width;
+	int64_t beam_window;
+	int64_t beam_margin;
 
 	/* scoring parameters */
 	int64_t xdrop;
@@ -98,6 +120,9 @@ struct comb_align_worker_args_s {
 	sr_t *ref;
 	sr_t *query;
 	aw_t *aw;
+
+	/* pieces of a split query waiting for the rest (used in drain) */
+	lmm_kvec_t(struct comb_align_worker_item_s *) pending;
 };
 
 /**
@@ -143,6 +168,7 @@ struct comb_align_worker_args_s **comb_align_worker_init(
 			.query = query,
 			.aw = aw
 		};
+		lmm_kv_init(NULL, base[i].pending);
 	}
 	memset(&base[num_worker], 0, sizeof(struct comb_align_worker_args_s));
 	return(w);
@@ -158,6 +184,7 @@ void comb_align_worker_clean(
 	if(w == NULL) { return; }
 
 	for(struct comb_align_worker_args_s **p = w; (*p)->params != NULL; p++) {
+		lmm_kv_destroy(NULL, (*p)->pending);
 		ggsea_ctx_clean((*p)->ctx);
 		sr_gref_free((*p)->r);
 		memset(*p, 0, sizeof(struct comb_align_worker_args_s));
@@ -217,6 +244,17 @@ void *comb_align_worker(
 	return((void *)i);
 }
 
+/**
+ * @fn comb_align_aw_flags
+ * @brief translate ggsea result flags to aw flags
+ */
+static _force_inline
+uint32_t comb_align_aw_flags(
+	struct ggsea_result_s const *res)
+{
+	return(((res->flags & GGSEA_TRUNCATED) != 0) ? AW_TRUNCATED : 0);
+}
+
 /**
  * @fn comb_align_drain
  */
@@ -228,21 +266,58 @@ void comb_align_drain(
 	struct comb_align_worker_args_s *a = (struct comb_align_worker_args_s *)arg;
 	struct comb_align_worker_item_s *i = (struct comb_align_worker_item_s *)item;
 
+	/* pieces of a split query are held until all of them arrive */
+	int64_t part_cnt = i->q->part_cnt;
+	struct comb_align_worker_item_s *parts[part_cnt];
+	parts[0] = i;
+	if(part_cnt > 1) {
+		lmm_kv_push(NULL, a->pending, i);
+
+		int64_t cnt = 0;
+		for(int64_t j = 0; j < lmm_kv_size(a->pending); j++) {
+			cnt += lmm_kv_at(a->pending, j)->q->gref == i->q->gref;
+		}
+		if(cnt < part_cnt) { return; }
+
+		/* collect pieces in order and remove them from the pending array */
+		int64_t k = 0;
+		for(int64_t j = 0; j < lmm_kv_size(a->pending); j++) {
+			struct comb_align_worker_item_s *p = lmm_kv_at(a->pending, j);
+			if(p->q->gref != i->q->gref) {
+				lmm_kv_at(a->pending, k++) = p;
+			} else {
+				parts[p->q->part_idx] = p;
+			}
+		}
+		lmm_kv_size(a->pending) = k;
+
+		/* merge results */
+		struct ggsea_result_s *res[part_cnt];
+		for(int64_t j = 0; j < part_cnt; j++) {
+			res[j] = parts[j]->res;
+			parts[j]->res = NULL;
+		}
+		parts[0]->res = ggsea_merge_results(res, part_cnt, NULL);
+	}
+
 	/* append to result queue */
-	if(i->res->cnt == 0 && a->params->include_unmapped != 0) {
-		aw_append_unmapped(a->aw, i->res->ref, i->res->query);
+	struct ggsea_result_s *res = parts[0]->res;
+	if(res->cnt == 0 && a->params->include_unmapped != 0) {
+		aw_append_unmapped(a->aw, res->ref, res->query, comb_align_aw_flags(res));
 	} else {
-		aw_append_alignment(a->aw, i->res->ref, i->res->query, i->res->aln, i->res->cnt);
+		aw_append_alignment(a->aw, res->ref, res->query, res->aln, res->cnt, comb_align_aw_flags(res));
 	}
 
 	/* cleanup */
-	ggsea_aln_free(i->res);
-
-	/* lmm must be freed before gref_free */
-	debug("worker destroyed, ptr(%p)", i);
-	struct sr_gref_s *q = i->q;
-	lmm_free(i->lmm, (void *)i);
-	sr_gref_free(q);
+	ggsea_aln_free(res);
+
+	for(int64_t j = 0; j < part_cnt; j++) {
+		/* lmm must be freed before gref_free */
+		debug("worker destroyed, ptr(%p)", parts[j]);
+		struct sr_gref_s *q = parts[j]->q;
+		lmm_free(parts[j]->lmm, (void *)parts[j]);
+		sr_gref_free(q);
+	}
 	return;
 }
 
@@ -261,10 +336,14 @@ void comb_align_print_option_summary(
 	#define _p(...)		p += sprintf(p, __VA_ARGS__);
 	_p("%s align ", params->command_base);
 	_p("-t%" PRId64 " ", params->num_threads);
+	_p("-M%" PRId64 " ", params->mem_size);
 	_p("-k%" PRId64 " ", params->k);
 	_p("-r%" PRId64 " ", params->kmer_cnt_thresh);
+	_p("-R%" PRId64 " ", params->rep_rescue_cnt);
 	_p("-d%" PRId64 " ", params->overlap_thresh);
 	_p("-f%" PRId64 " ", params->gapless_thresh);
+	_p("-w%" PRId64 " ", params->two_hit_window);
+	_p("-L%" PRId64 " ", params->chain_window);
 	_p("-a%d ", params->m);
 	_p("-b%d ", params->x);
 	_p("-p%d ", params->gi);
@@ -272,6 +351,17 @@ void comb_align_print_option_summary(
 	_p("-x%" PRId64 " ", params->xdrop);
 	_p("-m%" PRId64 " ", params->score_thresh);
 	_p("-c%c", params->clip);
+	if((params->beam_width | params->beam_margin) != 0) {
+		_p(" --beam=%" PRId64, params->beam_width);
+		_p(" --beam-window=%" PRId64, params->beam_window);
+		_p(" --beam-margin=%" PRId64, params->beam_margin);
+	}
+	if((params->max_seeds | params->max_fronts | params->max_cells | params->max_msec) != 0) {
+		_p(" --max-seeds=%" PRId64, params->max_seeds);
+		_p(" --max-fronts=%" PRId64, params->max_fronts);
+		_p(" --max-cells=%" PRId64, params->max_cells);
+		_p(" --max-time=%" PRId64, params->max_msec);
+	}
 	#undef _p
 
 	params->message_printer(params->message_context, "%s\n", s);
@@ -279,6 +369,120 @@ void comb_align_print_option_summary(
 	return;
 }
 
+/**
+ * @struct comb_align_mem_s
+ * @brief split of the memory budget (-M)
+ */
+struct comb_align_mem_s {
+	int64_t index_size;
+	int64_t dp_size;			/* initial DP stack of each thread */
+	int64_t read_size;			/* each read in flight */
+	int64_t out_size;
+	int64_t pool_size;			/* number of reads in flight */
+};
+
+/**
+ * @fn comb_align_read_cnt
+ * @brief reads held at once for pool_size reads in flight, including the ones parsed ahead in sr
+ */
+static _force_inline
+int64_t comb_align_read_cnt(
+	struct comb_align_params_s const *params,
+	int64_t pool_size)
+{
+	return(pool_size + ((params->num_threads > 0) ? MAX2(params->num_threads, SR_READ_AHEAD(pool_size)) : 0));
+}
+
+/**
+ * @fn comb_align_calc_mem
+ * @brief split -M into the index, DP stacks, reads in flight, and output buffers. the index
+ * is fixed once built; the rest is divided among threads, half for the DP stack and half for
+ * the reads. reads in flight are reduced first, down to COMB_MIN_READS_PER_THREAD. a quarter
+ * more reads than the ones in flight are parsed ahead (SR_READ_AHEAD).
+ */
+static _force_inline
+struct comb_align_mem_s comb_align_calc_mem(
+	struct comb_align_params_s const *params,
+	int64_t index_size)
+{
+	int64_t num_worker = MAX2(1, params->num_threads);
+	struct comb_align_mem_s m = {
+		.index_size = index_size,
+		.dp_size = COMB_DP_MEM_SIZE,
+		.read_size = COMB_READ_MEM_SIZE,
+		.out_size = COMB_OUT_MEM_SIZE,
+		.pool_size = params->pool_size
+	};
+	if(params->mem_size <= 0) {
+		return(m);					/* unlimited */
+	}
+
+	int64_t share = MAX2(0, params->mem_size - index_size - m.out_size) / num_worker;
+	int64_t reads = MIN2(params->pool_size / num_worker, (share - m.dp_size) / m.read_size * 4 / 5);
+	if(reads < COMB_MIN_READS_PER_THREAD) {
+		/* DP stacks are shrunk too (they grow on demand) */
+		m.dp_size = MIN2(COMB_DP_MEM_SIZE, MAX2(COMB_DP_MIN_MEM_SIZE, share / 2 & ~(COMB_MB - 1)));
+		reads = (share - m.dp_size) / m.read_size * 4 / 5;
+	}
+	m.pool_size = num_worker * MAX2(COMB_MIN_READS_PER_THREAD, reads);
+	m.pool_size = MIN2(m.pool_size, params->pool_size);
+	return(m);
+}
+
+/**
+ * @fn comb_align_print_mem
+ */
+static _force_inline
+void comb_align_print_mem(
+	struct comb_align_params_s const *params,
+	struct comb_align_mem_s const *m)
+{
+	int64_t num_worker = MAX2(1, params->num_threads);
+	int64_t read_cnt = comb_align_read_cnt(params, m->pool_size);
+	int64_t total = m->index_size + m->out_size + num_worker * m->dp_size + read_cnt * m->read_size;
+
+	params->message_printer(params->message_context,
+		"Memory budget: %" PRId64 "MB (index %" PRId64 "MB, DP stack %" PRId64 "MB x %" PRId64 " threads, "
+		"%" PRId64 " reads in flight and parsed ahead x %" PRId64 "MB, output %" PRId64 "MB).\n",
+		total / COMB_MB, m->index_size / COMB_MB, m->dp_size / COMB_MB, num_worker,
+		read_cnt, m->read_size / COMB_MB, m->out_size / COMB_MB);
+	if(params->mem_size > 0 && total > params->mem_size) {
+		params->message_printer(params->message_context,
+			"[WARNING] Memory budget exceeds -M%" PRId64 "%s.\n", params->mem_size,
+			(m->index_size > params->mem_size) ? ", the index does not fit (build it with `comb index -M')" : "");
+	}
+	return;
+}
+
+/**
+ * @fn comb_align_init_ref
+ * @brief open reference. `<ref_name>.gref' built by `comb index' is used if exists
+ * and compatible, falls back to parsing the sequence file otherwise.
+ */
+static _force_inline
+sr_t *comb_align_init_ref(
+	struct comb_align_params_s const *params)
+{
+	sr_params_t const *p = SR_PARAMS(
+		.format = params->ref_format,
+		.k = params->k,
+		.seq_direction = SR_FW_ONLY,
+		.num_threads = params->num_threads
+	);
+
+	if(!sr_is_index_path(params->ref_name)) {
+		char *path = (char *)malloc(strlen(params->ref_name) + strlen(SR_INDEX_SUFFIX) + 1);
+		strcpy(path, params->ref_name);
+		strcat(path, SR_INDEX_SUFFIX);
+
+		FILE *fp = fopen(path, "rb");
+		sr_t *ref = (fp != NULL) ? (fclose(fp), sr_init(path, p)) : NULL;
+		free(path);
+		if(ref != NULL) { return(ref); }
+	}
+	return(sr_init(params->ref_name, p));
+}
+
 /**
  * @fn comb_align
  */
@@ -309,6 +513,18 @@ int comb_align(
 		comb_align_print_option_summary(params);
 	}
 
+	/* build reference sequence index (or load prebuilt one) */
+	ref = comb_align_init_ref(params);
+	comb_align_error(ref != NULL, "Failed to open reference file `%s'.\n", params->ref_name);
+	struct sr_gref_s *r = sr_get_index(ref);
+	comb_align_error(r != NULL, "Failed to build reference index.\n");
+
+	/* split the rest of the memory budget */
+	struct comb_align_mem_s mem = comb_align_calc_mem(params, gref_get_index_size(r->gref));
+	if(params->message_level != 0) {
+		comb_align_print_mem(params, &mem);
+	}
+
 	/* build ggsea configuration object */
 	debug("build conf");
 	conf = ggsea_conf_init(GGSEA_PARAMS(
@@ -316,34 +532,36 @@ int comb_align(
 		.score_matrix = GABA_SCORE_SIMPLE(params->m, params->x, params->gi, params->ge),
 		.k = params->k,
 		.kmer_cnt_thresh = params->kmer_cnt_thresh,
+		.rep_rescue_cnt = params->rep_rescue_cnt,
 		.overlap_thresh = params->overlap_thresh,
 		.gapless_thresh = params->gapless_thresh,
-		.score_thresh = params->score_thresh));
+		.two_hit_window = params->two_hit_window,
+		.chain_window = params->chain_window,
+		.score_thresh = params->score_thresh,
+		.stack_size = mem.dp_size,
+		.beam_width = params->beam_width,
+		.beam_window = params->beam_window,
+		.beam_margin = params->beam_margin,
+		.max_seeds = params->max_seeds,
+		.max_fronts = params->max_fronts,
+		.max_cells = params->max_cells,
+		.max_usec = params->max_msec * 1000));
 	comb_align_error(conf != NULL, "Failed to create alignment configuration. Check scoring parameters are small enough to be handled in gaba library.\n");
 
-	/* build reference sequence index */
-	ref = sr_init(params->ref_name,
-		SR_PARAMS(
-			.format = params->ref_format,
-			.k = params->k,
-			.seq_direction = SR_FW_ONLY,
-			.num_threads = params->num_threads
-		));
-	comb_align_error(ref != NULL, "Failed to open reference file `%s'.\n", params->ref_name);
-
 	/* build read pool */
 	query = sr_init(params->query_name,
 		SR_PARAMS(
 			.format = params->query_format,
 			.k = params->k,
 			.seq_direction = SR_FW_ONLY,
-			.pool_size = params->pool_size,
+			.pool_size = mem.pool_size,
+			.read_mem_size = mem.read_size,
+			.num_threads = params->num_threads,
+			.graph_split_cnt = 4 * MAX2(1, params->num_threads)
 		));
 	comb_align_error(query != NULL, "Failed to open query file `%s'.\n", params->query_name);
 
 	/* build alignment writer */
-	struct sr_gref_s *r = sr_get_index(ref);
-	comb_align_error(r != NULL, "Failed to build reference index.\n");
 	aw = aw_init(params->out_name, r->gref,
 		AW_PARAMS(
 			.format = params->out_format,
@@ -355,13 +573,13 @@ int comb_align(
 	sr_gref_free(r);
 	comb_align_error(aw != NULL, "Failed to open output file `%s'.\n", params->out_name);
 
-	/* initialize parallel task dispatcher */
+	/* initialize parallel task dispatcher (reads are bounded by the queue until the drain writes them) */
 	w = comb_align_worker_init(params, conf, ref, query, aw);
-	pt = ptask_init(comb_align_worker, (void **)w, params->num_threads, params->pool_size);
+	pt = ptask_init(comb_align_worker, (void **)w, params->num_threads, mem.pool_size);
 	comb_align_error(w != NULL && pt != NULL, "Failed to initialize parallel worker threads.\n");
 
 	/* run tasks */
-	ptask_stream(pt, comb_align_source, (void *)*w, comb_align_drain, (void *)*w, params->pool_size / 4);
+	ptask_stream(pt, comb_align_source, (void *)*w, comb_align_drain, (void *)*w, mem.pool_size / 4);
 
 	/* destroy objects */
 	ret = 0;
@@ -400,7 +618,7 @@ void comb_align_clean(
 
 
 
-/* index core functions (not yet implemented) */
+/* index core functions */
 /**
  * @struct comb_index_params_s
  */
@@ -442,6 +660,7 @@ void comb_index_print_option_summary(
 	#define _p(...)		p += sprintf(p, __VA_ARGS__);
 	_p("%s index ", params->command_base);
 	_p("-t%" PRId64 " ", params->num_threads);
+	_p("-M%" PRId64 " ", params->mem_size);
 	_p("-k%" PRId64 " ", params->k);
 	#undef _p
 
@@ -457,10 +676,51 @@ static
 int comb_index(
 	struct comb_index_params_s const *params)
 {
+	int ret = 1;
+
+	sr_t *ref = NULL;
+	char *path = NULL;
+
+	#define comb_index_error(expr, ...) { \
+		if(!(expr)) { \
+			if(params->message_level != 0) { \
+				params->message_printer(params->message_context, "[ERROR] " __VA_ARGS__); \
+			} \
+			goto _comb_index_error_handler; \
+		} \
+	}
+
+	/* print option summary */
 	if(params->message_level != 0) {
 		comb_index_print_option_summary(params);
 	}
-	return(1);
+
+	/* build reference sequence index (the same params as comb_align) */
+	ref = sr_init(params->ref_name,
+		SR_PARAMS(
+			.k = params->k,
+			.seq_direction = SR_FW_ONLY,
+			.num_threads = params->num_threads
+		));
+	comb_index_error(ref != NULL, "Failed to open reference file `%s'.\n", params->ref_name);
+
+	/* build and dump (kmers are sorted out of core if the build exceeds mem_size) */
+	path = (char *)malloc(strlen(params->prefix) + strlen(SR_INDEX_SUFFIX) + 1);
+	strcpy(path, params->prefix);
+	strcat(path, SR_INDEX_SUFFIX);
+	comb_index_error(sr_dump_index(ref, path, params->mem_size) == 0,
+		"Failed to build and dump index to `%s'.\n", path);
+
+	if(params->message_level != 0) {
+		params->message_printer(params->message_context, "Index dumped to `%s'.\n", path);
+	}
+
+	/* destroy objects */
+	ret = 0;
+_comb_index_error_handler:;
+	free(path); path = NULL;
+	sr_clean(ref); ref = NULL;
+	return(ret);
 }
 
 /**
@@ -478,6 +738,7 @@ void comb_index_clean(
 	free(params->command_base); params->command_base = NULL;
 	free(params->program_name); params->program_name = NULL;
 	free(params->ref_name); params->ref_name = NULL;
+	free(params->prefix); params->prefix = NULL;
 	free(params);
 	return;
 }
@@ -630,7 +891,7 @@ int64_t comb_atoi_dec(
 	if(isdigit(val[len - 1])) {
 		return(strtoll(val, NULL, 10));
 	}
-	do {
+	while(len > 1) {
 		switch(val[len - 1]) {
 			case 'i': base = 1024; len--; continue;
 			case 'T': mul *= base;
@@ -642,9 +903,9 @@ int64_t comb_atoi_dec(
 				char tmp[len];
 				memcpy(tmp, val, len - 1);
 				tmp[len - 1] = '\0';
-				return(strtoll(tmp, NULL, 10));
+				return(mul * strtoll(tmp, NULL, 10));
 		}
-	} while(0);
+	}
 	return(0);
 }
 static _force_inline
@@ -749,15 +1010,23 @@ char const *const comb_align_help_message =
 	"\n"
 	"  Options and defaults\n"
 	"    Global option\n"
-	"      -t<int>  [0]  Number of threads.\n"
+	"      -t<int>  [0]  Number of threads (0: all the cores available to the process).\n"
+	"      -M<int>  [free mem] Memory budget, shared by the index, DP stacks, and reads\n"
+	"                    in flight (fewer reads are kept in flight if tight).\n"
 	"\n"
 	"    Seeding option\n"
 	"      -k<int>  [14] k-mer length in indexing and matching.\n"
 	"\n"
 	"    Filtering options\n"
 	"      -r<int>  [30] Repetitive k-mer filter threshold.\n"
+	"      -R<int>  [0]  Max seeds of repetitive k-mers extended for reads without\n"
+	"                    alignment, less repetitive ones first (0: disabled).\n"
 	"      -d<int>  [3]  Overlap filter threshold.\n"
 	"      -f<int>  [10] Gapless alignment filter threshold.\n"
+	"      -w<int>  [0]  Two-hit filter window, extends seeds only on diagonals with two\n"
+	"                    non-overlapping hits within the window (0: disabled).\n"
+	"      -L<int>  [0]  Chaining filter window (long reads), extends seeds only on\n"
+	"                    co-linear chains with gaps up to the window (0: disabled).\n"
 	"\n"
 	"    Extension options\n"
 	"      -a<int>  [1]  Match award (in positive integer)\n"
@@ -765,11 +1034,23 @@ char const *const comb_align_help_message =
 	"      -p<int>  [1]  Gap-open penalty (pos. int. or 0 (=linear-gap penalty))\n"
 	"      -q<int>  [1]  Gap-extension penalty (positive integer)\n"
 	"      -x<int>  [60] X-drop threshold\n"
+	"      --beam=<int>         [0] Max live fronts within the beam window on graph\n"
+	"                               branches (0: exact).\n"
+	"      --beam-window=<int>  [0] P-coordinate range from the head of the DP queue\n"
+	"                               the beam applies to (0: the whole queue).\n"
+	"      --beam-margin=<int>  [0] Drop fronts whose score trails the best one by\n"
+	"                               more than the margin (0: exact).\n"
 	"\n"
 	"    Reporting options\n"
 	"      -m<int>  [10] Minimum score for reporting.\n"
 	"      -c<char> [S]  Clip operation in CIGAR string. (H (hard) or S (soft))\n"
 	"\n"
+	"    Per-read work limits (truncated reads are tagged ZT:i:1, 0: unlimited)\n"
+	"      --max-seeds=<int>   [0] Seeds extended.\n"
+	"      --max-fronts=<int>  [0] Fronts pushed to the DP queue.\n"
+	"      --max-cells=<int>   [0] DP cells filled.\n"
+	"      --max-time=<int>    [0] Wall time in milliseconds.\n"
+	"\n"
 	"    Miscellaneous options\n"
 	"      -h       Print help (this) message.\n"
 	"      -v       Print version information.\n"
@@ -817,6 +1098,31 @@ int64_t comb_init_align_default_score_thresh(
 	return(100 * params->m);
 }
 
+/* default thread and pool sizes */
+/**
+ * @fn comb_init_default_num_threads
+ * @brief cores available to the process if not specified (or 0); single thread mode on a single core
+ */
+static _force_inline
+int64_t comb_init_default_num_threads(
+	int64_t num_threads)
+{
+	if(num_threads > 0) { return(num_threads); }
+	int64_t cores = ptask_get_num_cores();
+	return((cores > 1) ? cores : 0);
+}
+
+/**
+ * @fn comb_init_align_default_pool_size
+ * @brief keep 64 reads in flight per thread (the bulk size is pool_size / 4)
+ */
+static _force_inline
+int64_t comb_init_align_default_pool_size(
+	struct comb_align_params_s const *params)
+{
+	return(MAX2(params->pool_size, 64 * params->num_threads));
+}
+
 /**
  * @fn comb_init_align
  */
@@ -826,6 +1132,13 @@ int64_t comb_init_align_default_score_thresh(
 #define ID_OUT_FORMAT			( ID_BASE + 3 )
 #define ID_INCLUDE_UNMAPPED		( ID_BASE + 4 )
 #define ID_OMIT_UNMAPPED		( ID_BASE + 5 )
+#define ID_MAX_SEEDS			( ID_BASE + 6 )
+#define ID_MAX_FRONTS			( ID_BASE + 7 )
+#define ID_MAX_CELLS			( ID_BASE + 8 )
+#define ID_MAX_TIME				( ID_BASE + 9 )
+#define ID_BEAM_WIDTH			( ID_BASE + 10 )
+#define ID_BEAM_MARGIN			( ID_BASE + 11 )
+#define ID_BEAM_WINDOW			( ID_BASE + 12 )
 static
 struct comb_align_params_s *comb_init_align(
 	char const *base,
@@ -884,8 +1197,11 @@ struct comb_align_params_s *comb_init_align(
 
 		/* filtering params */
 		{ "repcnt", required_argument, NULL, 'r' },
+		{ "rescue", required_argument, NULL, 'R' },
 		{ "depth", required_argument, NULL, 'd' },
 		{ "popcnt", required_argument, NULL, 'f' },
+		{ "two-hit", required_argument, NULL, 'w' },
+		{ "chain", required_argument, NULL, 'L' },
 
 		/* scoring params */
 		{ "match", required_argument, NULL, 'a' },
@@ -894,6 +1210,15 @@ struct comb_align_params_s *comb_init_align(
 		{ "gap-extend", required_argument, NULL, 'q' },
 		{ "xdrop", required_argument, NULL, 'x' },
 		{ "clip-penalty", required_argument, NULL, 'C' },
+		{ "beam", required_argument, NULL, ID_BEAM_WIDTH },
+		{ "beam-margin", required_argument, NULL, ID_BEAM_MARGIN },
+		{ "beam-window", required_argument, NULL, ID_BEAM_WINDOW },
+
+		/* per-read work limits */
+		{ "max-seeds", required_argument, NULL, ID_MAX_SEEDS },
+		{ "max-fronts", required_argument, NULL, ID_MAX_FRONTS },
+		{ "max-cells", required_argument, NULL, ID_MAX_CELLS },
+		{ "max-time", required_argument, NULL, ID_MAX_TIME },
 
 		/* reporting params */
 		{ "min", required_argument, NULL, 'm' },
@@ -924,15 +1249,25 @@ struct comb_align_params_s *comb_init_align(
 			/* params */
 			case 'k': params->k = comb_atoi(optarg); break;
 			case 'r': params->kmer_cnt_thresh = comb_atoi(optarg); break;
+			case 'R': params->rep_rescue_cnt = comb_atoi(optarg); break;
 			case 'd': params->overlap_thresh = comb_atoi(optarg); break;
 			case 'f': params->gapless_thresh = comb_atoi(optarg); break;
+			case 'w': params->two_hit_window = comb_atoi(optarg); break;
+			case 'L': params->chain_window = comb_atoi(optarg); break;
 			case 'a': params->m = comb_atoi(optarg); break;
 			case 'b': params->x = comb_atoi(optarg); break;
 			case 'p': params->gi = comb_atoi(optarg); break;
 			case 'q': params->ge = comb_atoi(optarg); break;
 			case 'x': params->xdrop = comb_atoi(optarg); break;
+			case ID_BEAM_WIDTH: params->beam_width = comb_atoi(optarg); break;
+			case ID_BEAM_MARGIN: params->beam_margin = comb_atoi(optarg); break;
+			case ID_BEAM_WINDOW: params->beam_window = comb_atoi(optarg); break;
 			case 'm': params->score_thresh = comb_atoi(optarg); break;
 			case 'c': params->clip = optarg[0]; break;
+			case ID_MAX_SEEDS: params->max_seeds = comb_atoi(optarg); break;
+			case ID_MAX_FRONTS: params->max_fronts = comb_atoi(optarg); break;
+			case ID_MAX_CELLS: params->max_cells = comb_atoi(optarg); break;
+			case ID_MAX_TIME: params->max_msec = comb_atoi(optarg); break;
 			case ID_INCLUDE_UNMAPPED: params->include_unmapped = 1; break;
 			case ID_OMIT_UNMAPPED: params->include_unmapped = 0; break;
 			
@@ -942,6 +1277,8 @@ struct comb_align_params_s *comb_init_align(
 	}
 
 	/* restore default params */
+	params->num_threads = comb_init_default_num_threads(params->num_threads);
+	params->pool_size = comb_init_align_default_pool_size(params);
 	if(params->gapless_thresh == 0) {
 		params->gapless_thresh = comb_init_align_default_gapless_thresh(params);
 	}
@@ -993,6 +1330,23 @@ static
 char const *const comb_index_help_message =
 	"\n"
 	"    comb aligner (%s) index subcommand\n"
+	"\n"
+	"  Build k-mer index of the reference and dump it to <prefix>.gref. The index\n"
+	"is memory-mapped on `comb align <prefix>.gref ...' (or `comb align <reference>\n"
+	"...' if <reference>.gref exists), skipping parsing and index construction.\n"
+	"\n"
+	"  Usage\n"
+	"\n"
+	"    $ comb index [options] <reference>\n"
+	"\n"
+	"  Options and defaults\n"
+	"      -t<int>  [0]  Number of threads (0: all the cores available to the process).\n"
+	"      -M<int>  [free mem] Memory limit of index construction (k-mers are sorted\n"
+	"                    out of core in $TMPDIR if exceeded).\n"
+	"      -p<str>  [<reference>] Prefix of the index file.\n"
+	"      -k<int>  [14] k-mer length (must be the same as that in `comb align').\n"
+	"      -h       Print help (this) message.\n"
+	"      -v       Print version information.\n"
 	"\n";
 
 /**
@@ -1061,7 +1415,7 @@ struct comb_index_params_s *comb_init_index(
 			case 'v': comb_print_version(); goto _comb_init_index_error_handler;
 			case 'V': params->message_level = 3; break;
 			case 't': params->num_threads = comb_atoi(optarg); break;
-			case 'M': params->mem_size = mem_estimate_free_size(); break;
+			case 'M': params->mem_size = comb_atoi(optarg); break;
 			case 'p': params->prefix = strdup(optarg); break;
 
 			/* params */
@@ -1085,6 +1439,9 @@ struct comb_index_params_s *comb_init_index(
 		params->prefix = strdup(params->ref_name);
 	}
 
+	/* restore default params */
+	params->num_threads = comb_init_default_num_threads(params->num_threads);
+
 	free(opts_short);
 	return(params);
 
@@ -1232,6 +1589,9 @@ struct comb_index_params_s *comb_init_bwa_index(
 		params->prefix = strdup(params->ref_name);
 	}
 
+	/* restore default params */
+	params->num_threads = comb_init_default_num_threads(params->num_threads);
+
 	free(opts_short);
 	return(params);
 
@@ -1371,6 +1731,8 @@ struct comb_align_params_s *comb_init_bwa_mem(
 	}
 
 	/* restore default params */
+	params->num_threads = comb_init_default_num_threads(params->num_threads);
+	params->pool_size = comb_init_align_default_pool_size(params);
 	params->gapless_thresh = comb_init_align_default_gapless_thresh(params);
 
 	/* positional arguments */
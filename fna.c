@@ -17,10 +17,14 @@
  * List of APIs:
  *   Basic readers:
  *     fna_t *fna_init(char const *path, fna_params_t *params);
+ *     fna_t *fna_init_mem(void const *ptr, uint64_t len, fna_params_t *params);
  *     fna_seq_t *fna_read(fna_t const *fna, fna_seq_t *seq);
  *     void fna_seq_free(fna_seq_t *seq);
  *     void fna_close(fna_t *fna);
  *
+ *   Block reader (for parsing on multiple threads):
+ *     uint8_t *fna_read_block(fna_t *fna, uint64_t size, uint64_t *len);
+ *
  *   Sequence duplicators:
  *     fna_seq_t *fna_duplicate(fna_seq_t const *seq);
  *     fna_seq_t *fna_revcomp(fna_seq_t const *seq);
@@ -46,6 +50,7 @@
 #include <string.h>
 #include "zf.h"
 #include "lmm.h"
+#include "arch/arch.h"
 #include "log.h"
 #include "sassert.h"
 #include "fna.h"
@@ -86,6 +91,10 @@ struct fna_context_s {
 	uint16_t seq_head_margin;	/** margin at the head of seq buffer */
 	uint16_t seq_tail_margin;	/** margin at the tail of seq buffer */
 
+	/* bytes read beyond the last block boundary (fna_read_block) */
+	uint8_t *carry;
+	uint64_t carry_len;
+
 	/* file format specific parser */
 	struct fna_seq_intl_s *(*read)(struct fna_context_s *fna);
 
@@ -143,15 +152,13 @@ static struct fna_read_ret_s fna_read_seq_4bit(struct fna_context_s *fna, lmm_kv
 static struct fna_read_ret_s fna_read_seq_4bitpacked(struct fna_context_s *fna, lmm_kvec_uint8_t *v, uint8_t const *delim_table, int64_t lim);
 
 /**
- * @fn fna_init
- *
- * @brief create a sequence reader context
- *
- * @param[in] path : a path to a file to open.
+ * @fn fna_init_intl
  *
- * @return a pointer to the context
+ * @brief create a sequence reader context on an opened stream (the stream is closed on error)
  */
-fna_t *fna_init(
+static
+fna_t *fna_init_intl(
+	zf_t *fp,
 	char const *path,
 	fna_params_t const *params)
 {
@@ -219,16 +226,19 @@ fna_t *fna_init(
 		.seq_tail_margin = 0
 	};
 
-	if(path == NULL) { return NULL; }
+	if(fp == NULL) { return NULL; }
 	if(params == NULL) { params = &default_params; }
 
 	/* global context is malloc'd with global malloc */
 	if((fna = (struct fna_context_s *)malloc(sizeof(struct fna_context_s))) == NULL) {
+		zfclose(fp);
 		goto _fna_init_error_handler;
 	}
 	fna->lmm = params->lmm;
 	fna->path = NULL;
-	fna->fp = NULL;
+	fna->fp = fp;
+	fna->carry = NULL;
+	fna->carry_len = 0;
 
 	/* copy params */
 	fna->seq_encode = params->seq_encode;	/** encode sequence to 2-bit if encode == FNA_2BITPACKED */
@@ -242,10 +252,6 @@ fna_t *fna_init(
 	/* restore defaults */
 	if(fna->seq_encode == 0) { fna->seq_encode = FNA_ASCII; }
 
-	/* open file */
-	fna->fp = zfopen(path, "r");
-	if(fna->fp == NULL) { goto _fna_init_error_handler; }
-
 	/**
 	 * if fna->file_format is not specified...
 	 * 1. determine file format from the path extension
@@ -313,6 +319,36 @@ _fna_init_error_handler:
 	return(NULL);
 }
 
+/**
+ * @fn fna_init
+ *
+ * @brief create a sequence reader context
+ *
+ * @param[in] path : a path to a file to open.
+ *
+ * @return a pointer to the context
+ */
+fna_t *fna_init(
+	char const *path,
+	fna_params_t const *params)
+{
+	if(path == NULL) { return NULL; }
+	return(fna_init_intl(zfopen(path, "r"), path, params));
+}
+
+/**
+ * @fn fna_init_mem
+ *
+ * @brief create a sequence reader context on [ptr, ptr + len), e.g. a block returned by fna_read_block
+ */
+fna_t *fna_init_mem(
+	void const *ptr,
+	uint64_t len,
+	fna_params_t const *params)
+{
+	return(fna_init_intl(zfopen_mem(ptr, len), "-", params));
+}
+
 /**
  * @fn fna_close
  *
@@ -325,6 +361,7 @@ void fna_close(fna_t *ctx)
 	if(fna != NULL) {
 		zfclose(fna->fp); fna->fp = NULL;
 		free(fna->path); fna->path = NULL;
+		free(fna->carry); fna->carry = NULL;
 		free(fna); fna = NULL;
 	}
 	return;
@@ -556,6 +593,125 @@ struct fna_read_ret_s fna_read_skip(
 	});
 }
 
+/**
+ * @val fna_encode_2bit_table
+ * @brief mapping IUPAC amb. to 2bit encoding, indexed by the lower 5 bits of the character
+ */
+#define _b(x)	( (x) & 0x1f )
+enum fna_2bit_bases {
+	A2 = 0x00, C2 = 0x01, G2 = 0x02, T2 = 0x03
+};
+static
+uint8_t const fna_encode_2bit_table[32] = {
+	[_b('A')] = A2,
+	[_b('C')] = C2,
+	[_b('G')] = G2,
+	[_b('T')] = T2,
+	[_b('U')] = T2,
+	[_b('N')] = A2,		/* treat 'N' as 'A' */
+	[_b('_')] = 0		/* sentinel */
+};
+#undef _b
+
+/**
+ * @val fna_encode_4bit_table
+ * @brief mapping IUPAC amb. to 4bit encoding, indexed by the lower 5 bits of the character
+ */
+#define _b(x)	( (x) & 0x1f )
+enum fna_4bit_bases {
+	A4 = 0x01, C4 = 0x02, G4 = 0x04, T4 = 0x08
+};
+static
+uint8_t const fna_encode_4bit_table[32] = {
+	[_b('A')] = A4,
+	[_b('C')] = C4,
+	[_b('G')] = G4,
+	[_b('T')] = T4,
+	[_b('U')] = T4,
+	[_b('R')] = A4 | G4,
+	[_b('Y')] = C4 | T4,
+	[_b('S')] = G4 | C4,
+	[_b('W')] = A4 | T4,
+	[_b('K')] = G4 | T4,
+	[_b('M')] = A4 | C4,
+	[_b('B')] = C4 | G4 | T4,
+	[_b('D')] = A4 | G4 | T4,
+	[_b('H')] = A4 | C4 | T4,
+	[_b('V')] = A4 | C4 | G4,
+	[_b('N')] = 0,		/* treat 'N' as a gap */
+	[_b('_')] = 0		/* sentinel */
+};
+#undef _b
+
+/**
+ * @fn fna_seq_delim_char
+ * @brief terminator of the sequence delimiter tables, which consist of non-printable
+ * (skipped) characters, one terminator and 0xff (EOF). -1 for the other tables.
+ */
+static _force_inline
+int fna_seq_delim_char(
+	uint8_t const *delim_table)
+{
+	if(delim_table == delim_fasta_seq) { return('>'); }
+	if(delim_table == delim_fastq_seq) { return('+'); }
+	if(delim_table == delim_fastq_qual) { return(0xff); }
+	return(-1);
+}
+
+/**
+ * @fn fna_read_seq_bulk
+ * @brief read a run of bases directly from the zf buffer, 32 characters at a time, until
+ * a non-printable character, the terminator, or lim. characters are translated with conv
+ * (indexed by the lower 5 bits, as fna_encode_2bit and fna_encode_4bit) if conv is not NULL.
+ * returns the number of bases pushed; the rest are left to the scalar loop of the caller.
+ */
+static _force_inline
+int64_t fna_read_seq_bulk(
+	struct fna_context_s *fna,
+	lmm_kvec_uint8_t *v,
+	int term,
+	uint8_t const *conv,
+	int64_t lim)
+{
+	size_t avail;
+	uint8_t const *p = zfbuf(fna->fp, &avail);
+	if(avail < 32) { return(0); }
+
+	/* classification and conversion constants */
+	v32i8_t const neg = _set_v32i8(-1), sp = _set_v32i8(' '), tv = _set_v32i8(term), eof = _set_v32i8(-1);
+	v32i8_t const lmask = _set_v32i8(0x1f), hbit = _set_v32i8(0x10);
+	v32i8_t const tlo = _from_v16i8_v32i8(_loadu_v16i8(conv != NULL ? conv : fna_encode_4bit_table));
+	v32i8_t const thi = _from_v16i8_v32i8(_loadu_v16i8(conv != NULL ? conv + 16 : fna_encode_4bit_table + 16));
+
+	int64_t len = 0, i = 0;
+	while(i + 32 <= (int64_t)avail && len < lim) {
+		lmm_kv_reserve(fna->lmm, *v, lmm_kv_size(*v) + 32);
+		v32i8_t x = _loadu_v32i8(&p[i]);
+
+		/* non-printable (0x00 - 0x1f), terminator, or 0xff */
+		v32i8_t const special = _or_v32i8(
+			_and_v32i8(_gt_v32i8(x, neg), _gt_v32i8(sp, x)),
+			_or_v32i8(_eq_v32i8(x, tv), _eq_v32i8(x, eof)));
+		uint64_t n = tzcnt(((v32i8_masku_t){ .mask = _mask_v32i8(special) }).all | (1ULL<<32));
+		n = (n < (uint64_t)(lim - len)) ? n : (uint64_t)(lim - len);
+
+		/* translate with two 16-entry shuffles, selected by bit 4 */
+		if(conv != NULL) {
+			v32i8_t const idx = _and_v32i8(x, lmask);
+			v32i8_t const sel = _eq_v32i8(_and_v32i8(idx, hbit), hbit);
+			x = _or_v32i8(
+				_andn_v32i8(sel, _shuf_v32i8(tlo, idx)),
+				_and_v32i8(sel, _shuf_v32i8(thi, idx)));
+		}
+		_storeu_v32i8(lmm_kv_ptr(*v) + lmm_kv_size(*v), x);
+		lmm_kv_size(*v) += n;
+		len += n; i += n;
+		if(n < 32) { break; }
+	}
+	zfadvance(fna->fp, i);
+	return(len);
+}
+
 /**
  * @fn fna_read_seq_ascii
  * @brief read seq until delim, with conv table
@@ -569,7 +725,11 @@ struct fna_read_ret_s fna_read_seq_ascii(
 {
 	int c = 0;
 	int64_t len = 0;
+	int const term = fna_seq_delim_char(delim_table);
 	while(len < lim) {
+		/* copy runs of bases at once, then check the delimiter */
+		if(term >= 0 && (len += fna_read_seq_bulk(fna, v, term, NULL, lim - len)) >= lim) { break; }
+
 		uint8_t type = delim_table[(uint8_t)(c = zfgetc(fna->fp))];
 		if(type & DELIM_TERM) { break; }
 		if(type != 0) { continue; }
@@ -595,24 +755,7 @@ uint8_t fna_encode_2bit(
 	int c)
 {
 	/* convert to upper case and subtract offset by 0x40 */
-	#define _b(x)	( (x) & 0x1f )
-
-	/* conversion tables */
-	enum bases {
-		A = 0x00, C = 0x01, G = 0x02, T = 0x03
-	};
-	static uint8_t const table[] = {
-		[_b('A')] = A,
-		[_b('C')] = C,
-		[_b('G')] = G,
-		[_b('T')] = T,
-		[_b('U')] = T,
-		[_b('N')] = A,		/* treat 'N' as 'A' */
-		[_b('_')] = 0		/* sentinel */
-	};
-	return(table[_b((uint8_t)c)]);
-
-	#undef _b
+	return(fna_encode_2bit_table[(uint8_t)c & 0x1f]);
 }
 
 /**
@@ -628,7 +771,11 @@ struct fna_read_ret_s fna_read_seq_2bit(
 {
 	int c = 0;
 	int64_t len = 0;
+	int const term = fna_seq_delim_char(delim_table);
 	while(len < lim) {
+		/* encode runs of bases at once, then check the delimiter */
+		if(term >= 0 && (len += fna_read_seq_bulk(fna, v, term, fna_encode_2bit_table, lim - len)) >= lim) { break; }
+
 		c = zfgetc(fna->fp);
 		uint8_t type = delim_table[(uint8_t)c];
 		if(type & DELIM_TERM) { break; }
@@ -702,34 +849,7 @@ uint8_t fna_encode_4bit(
 	int c)
 {
 	/* convert to upper case and subtract offset by 0x40 */
-	#define _b(x)	( (x) & 0x1f )
-
-	/* conversion tables */
-	enum bases {
-		A = 0x01, C = 0x02, G = 0x04, T = 0x08
-	};
-	static uint8_t const table[] = {
-		[_b('A')] = A,
-		[_b('C')] = C,
-		[_b('G')] = G,
-		[_b('T')] = T,
-		[_b('U')] = T,
-		[_b('R')] = A | G,
-		[_b('Y')] = C | T,
-		[_b('S')] = G | C,
-		[_b('W')] = A | T,
-		[_b('K')] = G | T,
-		[_b('M')] = A | C,
-		[_b('B')] = C | G | T,
-		[_b('D')] = A | G | T,
-		[_b('H')] = A | C | T,
-		[_b('V')] = A | C | G,
-		[_b('N')] = 0,		/* treat 'N' as a gap */
-		[_b('_')] = 0		/* sentinel */
-	};
-	return(table[_b((uint8_t)c)]);
-
-	#undef _b
+	return(fna_encode_4bit_table[(uint8_t)c & 0x1f]);
 }
 
 /**
@@ -745,7 +865,11 @@ struct fna_read_ret_s fna_read_seq_4bit(
 {
 	int c = 0;
 	int64_t len = 0;
+	int const term = fna_seq_delim_char(delim_table);
 	while(len < lim) {
+		/* encode runs of bases at once, then check the delimiter */
+		if(term >= 0 && (len += fna_read_seq_bulk(fna, v, term, fna_encode_4bit_table, lim - len)) >= lim) { break; }
+
 		c = zfgetc(fna->fp);
 		uint8_t type = delim_table[(uint8_t)c];
 		if(type & DELIM_TERM) { break; }
@@ -1364,6 +1488,136 @@ fna_seq_t *fna_read(fna_t *ctx)
 	return((fna_seq_t *)fna->read(fna));
 }
 
+/**
+ * @fn fna_find_block_boundary
+ *
+ * @brief (internal) find the head of the last record in p[0..len) that can be cut there.
+ * p begins just after the marker of a record. FASTQ records are followed from the head as
+ * fna_read_fastq does (the sequence until '+', then as many quality characters), so that
+ * records of any number of lines are cut right. returns 0 if not found.
+ */
+static
+uint64_t fna_find_block_boundary(
+	struct fna_context_s *fna,
+	uint8_t const *p,
+	uint64_t len)
+{
+	if(fna->file_format == FNA_GFA) {
+		/* GFA: head of the line after the last '\n' */
+		for(uint64_t i = len; i-- > 0;) {
+			if(p[i] == '\n') { return(i + 1); }
+		}
+		return(0);
+	}
+
+	if(fna->file_format == FNA_FASTA) {
+		for(uint64_t i = len; i-- > 1;) {
+			if(p[i] == '>' && p[i - 1] == '\n') { return(i); }
+		}
+		return(0);
+	}
+
+	/* fastq: a quality line may start with '@', so the qualities are counted instead */
+	uint64_t i = 0, b = 0;
+	while(1) {
+		/* header */
+		while(i < len && p[i] != '\r' && p[i] != '\n') { i++; }
+
+		/* sequence until '+', skipping non-printable characters */
+		uint64_t seq_len = 0;
+		while(i < len && p[i] != '+') { seq_len += p[i++] >= ' '; }
+
+		/* separator line, then as many quality characters as the sequence */
+		while(i < len && p[i] != '\r' && p[i] != '\n') { i++; }
+		uint64_t qual_len = 0;
+		while(i < len && qual_len < seq_len) { qual_len += p[i++] >= ' '; }
+
+		/* the next record begins at '@' */
+		while(i < len && p[i] != '@') { i++; }
+		if(i >= len) { return(b); }
+		b = i++;
+	}
+	return(0);
+}
+
+/**
+ * @fn fna_read_block
+ *
+ * @brief read raw text of complete records, at least size bytes unless the stream ends.
+ * the block begins with the record marker ('>' or '@'), or with a header line for GFA, so
+ * that it can be parsed with fna_init_mem, e.g. on another thread. FASTA, FASTQ and GFA only,
+ * must not be mixed with fna_read on the same context.
+ *
+ * @return malloc'd block (freed by the caller) and its length in *len, NULL at the end
+ */
+uint8_t *fna_read_block(
+	fna_t *ctx,
+	uint64_t size,
+	uint64_t *len)
+{
+	static char const *const head_table[] = {
+		[FNA_FASTA] = ">",
+		[FNA_FASTQ] = "@",
+		[FNA_GFA] = "H\tVN:Z:1.0\n"
+	};
+
+	struct fna_context_s *fna = (struct fna_context_s *)ctx;
+	*len = 0;
+	if(fna == NULL || fna->file_format >= sizeof(head_table) / sizeof(char const *) || head_table[fna->file_format] == NULL) {
+		return(NULL);
+	}
+
+	/**
+	 * the stream is at the head of a record, just after its marker (FASTA and FASTQ; the
+	 * marker is consumed at the boundary) or at the head of a line (GFA). bytes read ahead
+	 * are in carry.
+	 */
+	uint64_t const head_len = strlen(head_table[fna->file_format]);
+	uint64_t const skip = (fna->file_format == FNA_GFA) ? 0 : 1;
+	uint64_t cap = size + fna->carry_len + head_len, used = head_len;
+	uint8_t *p = (uint8_t *)malloc(cap);
+	if(p == NULL) { return(NULL); }
+	memcpy(p, head_table[fna->file_format], head_len);
+	if(fna->carry_len > 0) {
+		memcpy(&p[used], fna->carry, fna->carry_len);
+		used += fna->carry_len;
+	}
+	free(fna->carry); fna->carry = NULL; fna->carry_len = 0;
+
+	while(1) {
+		uint64_t req = cap - used;
+		uint64_t r = (req > 0) ? zfread(fna->fp, &p[used], req) : 0;
+		used += r;
+		if(r < req) { break; }		/* reached the end, all the rest is in the block */
+
+		/* cut at the last record boundary */
+		uint64_t b = fna_find_block_boundary(fna, &p[head_len], used - head_len);
+		if(b != 0) {
+			fna->carry_len = used - (head_len + b + skip);
+			if(fna->carry_len > 0) {
+				fna->carry = (uint8_t *)malloc(fna->carry_len);
+				memcpy(fna->carry, &p[head_len + b + skip], fna->carry_len);
+			}
+			used = head_len + b;
+			break;
+		}
+
+		/* a record is longer than the block, extend */
+		cap *= 2;
+		uint8_t *q = (uint8_t *)realloc(p, cap);
+		if(q == NULL) { free(p); return(NULL); }
+		p = q;
+	}
+
+	if(used <= head_len) {
+		free(p);
+		fna->status = FNA_EOF;
+		return(NULL);
+	}
+	*len = used;
+	return(p);
+}
+
 /**
  * @fn fna_seq_free
  *
@@ -2183,6 +2437,229 @@ unittest()
 	remove(filename);
 }
 
+/**
+ * long sequences (bulk path) in FASTA and FASTQ
+ */
+unittest()
+{
+	char const *fasta_filename = "test_fna_bulk.fa";
+	char const *bases = "ACGTacgtNnRYSWKMBDHVUu";
+
+	/* 200 bases in lines of 70 columns, followed by a sequence on a single line */
+	char content[1024], *p = content;
+	char expected[256];
+	for(int64_t i = 0; i < 200; i++) { expected[i] = bases[(i * 7) % strlen(bases)]; }
+	p += sprintf(p, ">test0\n");
+	for(int64_t i = 0; i < 200; i++) {
+		*p++ = expected[i];
+		if((i % 70) == 69) { *p++ = '\n'; }
+	}
+	p += sprintf(p, "\n>test1\n");
+	for(int64_t i = 0; i < 100; i++) { *p++ = expected[i]; }
+	p += sprintf(p, "\n");
+	assert(fdump(fasta_filename, content));
+
+	fna_t *fna = fna_init(fasta_filename, FNA_PARAMS( .seq_encode = FNA_4BIT ));
+	assert(fna != NULL, "fna(%p)", fna);
+
+	fna_seq_t *seq = fna_read(fna);
+	assert(seq->s.segment.seq.len == 200, "len(%lld)", seq->s.segment.seq.len);
+	int64_t match = 0;
+	for(int64_t i = 0; i < 200; i++) {
+		match += seq->s.segment.seq.ptr[i] == fna_encode_4bit(expected[i]);
+	}
+	assert(match == 200, "match(%lld)", match);
+	fna_seq_free(seq);
+
+	seq = fna_read(fna);
+	assert(strcmp(seq->s.segment.name.ptr, "test1") == 0, "name(%s)", seq->s.segment.name.ptr);
+	assert(seq->s.segment.seq.len == 100, "len(%lld)", seq->s.segment.seq.len);
+	match = 0;
+	for(int64_t i = 0; i < 100; i++) {
+		match += seq->s.segment.seq.ptr[i] == fna_encode_4bit(expected[i]);
+	}
+	assert(match == 100, "match(%lld)", match);
+	fna_seq_free(seq);
+
+	fna_close(fna);
+	remove(fasta_filename);
+
+	/* FASTQ, qualities containing '+' and '@' */
+	char const *fastq_filename = "test_fna_bulk.fq";
+	p = content;
+	p += sprintf(p, "@test0\n");
+	for(int64_t i = 0; i < 100; i++) { *p++ = expected[i]; }
+	p += sprintf(p, "\n+\n");
+	for(int64_t i = 0; i < 100; i++) { *p++ = "+@I#"[i % 4]; }
+	p += sprintf(p, "\n");
+	assert(fdump(fastq_filename, content));
+
+	fna = fna_init(fastq_filename, FNA_PARAMS( .seq_encode = FNA_ASCII ));
+	seq = fna_read(fna);
+	assert(seq != NULL, "seq(%p)", seq);
+	assert(seq->s.segment.seq.len == 100, "len(%lld)", seq->s.segment.seq.len);
+	assert(strncmp((char const *)seq->s.segment.seq.ptr, expected, 100) == 0, "seq(%s)", seq->s.segment.seq.ptr);
+	assert(seq->s.segment.qual.len == 100, "len(%lld)", seq->s.segment.qual.len);
+	assert(seq->s.segment.qual.ptr[0] == '+' && seq->s.segment.qual.ptr[99] == '#', "qual(%s)", seq->s.segment.qual.ptr);
+	fna_seq_free(seq);
+
+	fna_close(fna);
+	remove(fastq_filename);
+}
+
+/**
+ * block reader: records cut into blocks are parsed into the same sequence
+ */
+unittest()
+{
+	char const *fastq_filename = "test_fna_block.fq";
+	char content[8192], *p = content;
+	for(int64_t i = 0; i < 64; i++) {
+		/* qualities starting with '@' look like headers */
+		p += sprintf(p, "@r%lld\n%.*s\n+\n@%.*s\n", (long long)i,
+			(int)(i % 17 + 1), "ACGTACGTACGTACGTACGT",
+			(int)(i % 17), "IIIIIIIIIIIIIIIIIIII");
+	}
+	assert(fdump(fastq_filename, content));
+
+	fna_t *fna = fna_init(fastq_filename, FNA_PARAMS( .seq_encode = FNA_ASCII ));
+	assert(fna != NULL, "fna(%p)", fna);
+
+	int64_t cnt = 0, blocks = 0;
+	uint64_t len;
+	uint8_t *block;
+	while((block = fna_read_block(fna, 100, &len)) != NULL) {
+		assert(block[0] == '@', "block(%c)", block[0]);
+		fna_t *b = fna_init_mem(block, len, FNA_PARAMS( .seq_encode = FNA_ASCII ));
+		assert(b != NULL, "b(%p)", b);
+
+		fna_seq_t *seq;
+		while((seq = fna_read(b)) != NULL) {
+			char name[32];
+			sprintf(name, "r%lld", (long long)cnt);
+			assert(strcmp(seq->s.segment.name.ptr, name) == 0, "name(%s, %s)", seq->s.segment.name.ptr, name);
+			assert(seq->s.segment.seq.len == cnt % 17 + 1, "len(%lld)", seq->s.segment.seq.len);
+			assert(seq->s.segment.qual.len == cnt % 17 + 1, "len(%lld)", seq->s.segment.qual.len);
+			fna_seq_free(seq);
+			cnt++;
+		}
+		fna_close(b);
+		free(block);
+		blocks++;
+	}
+	assert(cnt == 64, "cnt(%lld)", cnt);
+	assert(blocks > 1, "blocks(%lld)", blocks);
+
+	fna_close(fna);
+	remove(fastq_filename);
+}
+
+/**
+ * block reader on multi-line FASTQ: sequence and quality lines are wrapped, and wrapped
+ * quality lines may start with '@' or '+'
+ */
+unittest()
+{
+	char const *fastq_filename = "test_fna_block_ml.fq";
+	char content[16384], *p = content;
+	for(int64_t i = 0; i < 64; i++) {
+		/* "@IIII", "IIIII", "+IIII" looks like a header, a sequence, and a separator */
+		int64_t len = i % 17 + 11;
+		char const *qual[3] = { "@IIII", "IIIII", "+IIII" };
+		p += sprintf(p, "@r%lld\n", (long long)i);
+		for(int64_t j = 0; j < len; j += 5) {
+			p += sprintf(p, "%.*s\n", (int)(len - j < 5 ? len - j : 5), "ACGTA");
+		}
+		p += sprintf(p, "+\n");
+		for(int64_t j = 0; j < len; j += 5) {
+			p += sprintf(p, "%.*s\n", (int)(len - j < 5 ? len - j : 5), qual[(j / 5) % 3]);
+		}
+	}
+	assert(fdump(fastq_filename, content));
+
+	fna_t *fna = fna_init(fastq_filename, FNA_PARAMS( .seq_encode = FNA_ASCII ));
+	assert(fna != NULL, "fna(%p)", fna);
+
+	int64_t cnt = 0, blocks = 0;
+	uint64_t len;
+	uint8_t *block;
+	while((block = fna_read_block(fna, 100, &len)) != NULL) {
+		assert(block[0] == '@', "block(%c)", block[0]);
+		fna_t *b = fna_init_mem(block, len, FNA_PARAMS( .seq_encode = FNA_ASCII ));
+		assert(b != NULL, "b(%p)", b);
+
+		fna_seq_t *seq;
+		while((seq = fna_read(b)) != NULL) {
+			char name[32];
+			sprintf(name, "r%lld", (long long)cnt);
+			assert(strcmp(seq->s.segment.name.ptr, name) == 0, "name(%s, %s)", seq->s.segment.name.ptr, name);
+			assert(seq->s.segment.seq.len == cnt % 17 + 11, "len(%lld)", seq->s.segment.seq.len);
+			assert(seq->s.segment.qual.len == cnt % 17 + 11, "len(%lld)", seq->s.segment.qual.len);
+			fna_seq_free(seq);
+			cnt++;
+		}
+		fna_close(b);
+		free(block);
+		blocks++;
+	}
+	assert(cnt == 64, "cnt(%lld)", cnt);
+	assert(blocks > 1, "blocks(%lld)", blocks);
+
+	fna_close(fna);
+	remove(fastq_filename);
+}
+
+/* block reader on GFA: each block gets a header line */
+unittest()
+{
+	char const *gfa_filename = "test_fna_block.gfa";
+	char content[8192], *p = content;
+	p += sprintf(p, "H\tVN:Z:1.0\n");
+	for(int64_t i = 0; i < 64; i++) {
+		/* links refer to segments appearing later */
+		p += sprintf(p, "L\ts%lld\t+\ts%lld\t-\t0M\n", (long long)i, (long long)(i + 1));
+		p += sprintf(p, "S\ts%lld\t%.*s\n", (long long)i, (int)(i % 17 + 1), "ACGTACGTACGTACGTACGT");
+	}
+	assert(fdump(gfa_filename, content));
+
+	fna_t *fna = fna_init(gfa_filename, FNA_PARAMS( .seq_encode = FNA_ASCII ));
+	assert(fna != NULL, "fna(%p)", fna);
+
+	int64_t cnt = 0, blocks = 0;
+	uint64_t len;
+	uint8_t *block;
+	while((block = fna_read_block(fna, 100, &len)) != NULL) {
+		assert(block[0] == 'H', "block(%c)", block[0]);
+		fna_t *b = fna_init_mem(block, len, FNA_PARAMS( .seq_encode = FNA_ASCII ));
+		assert(b != NULL, "b(%p)", b);
+		assert(b->file_format == FNA_GFA, "format(%d)", b->file_format);
+
+		fna_seq_t *seq;
+		while((seq = fna_read(b)) != NULL) {
+			char name[32];
+			sprintf(name, "s%lld", (long long)(cnt / 2));
+			if((cnt & 0x01) == 0) {
+				assert(seq->type == FNA_LINK, "type(%d)", seq->type);
+				assert(strcmp(seq->s.link.src.ptr, name) == 0, "name(%s, %s)", seq->s.link.src.ptr, name);
+			} else {
+				assert(seq->type == FNA_SEGMENT, "type(%d)", seq->type);
+				assert(strcmp(seq->s.segment.name.ptr, name) == 0, "name(%s, %s)", seq->s.segment.name.ptr, name);
+				assert(seq->s.segment.seq.len == (cnt / 2) % 17 + 1, "len(%lld)", seq->s.segment.seq.len);
+			}
+			fna_seq_free(seq);
+			cnt++;
+		}
+		fna_close(b);
+		free(block);
+		blocks++;
+	}
+	assert(cnt == 128, "cnt(%lld)", cnt);
+	assert(blocks > 1, "blocks(%lld)", blocks);
+
+	fna_close(fna);
+	remove(gfa_filename);
+}
+
 #if 0
 /**
  * sequence handling
@@ -208,6 +208,13 @@ typedef struct fna_seq_s fna_seq_t;
  */
 fna_t *fna_init(char const *path, fna_params_t const *params);
 
+/**
+ * @fn fna_init_mem
+ *
+ * @brief create a sequence reader context on memory [ptr, ptr + len) (not copied)
+ */
+fna_t *fna_init_mem(void const *ptr, uint64_t len, fna_params_t const *params);
+
 /**
  * @fn fna_close
  *
@@ -215,6 +222,14 @@ fna_t *fna_init(char const *path, fna_params_t const *params);
  */
 void fna_close(fna_t *fna);
 
+/**
+ * @fn fna_read_block
+ *
+ * @brief read raw text of complete records (at least size bytes unless EOF), to be parsed
+ * with fna_init_mem. FASTA, FASTQ and GFA only. returns a malloc'd block, NULL at the end.
+ */
+uint8_t *fna_read_block(fna_t *fna, uint64_t size, uint64_t *len);
+
 /**
  * @fn fna_set_lmm
  *
@@ -85,6 +85,7 @@
 #define MIN_BULK_BLOCKS				( 32 )
 #define MEM_ALIGN_SIZE				( 32 )		/* 32byte aligned for AVX2 environments */
 #define MEM_INIT_SIZE				( (uint64_t)256 * 1024 * 1024 )
+#define MEM_MIN_SIZE				( (uint64_t)1024 * 1024 )
 #define MEM_MARGIN_SIZE				( 2048 )
 #define PSUM_BASE					( 1 )
 
@@ -112,7 +113,7 @@ _static_assert(sizeof(void *) == 8);
 
 /** check size of structs declared in gaba.h */
 _static_assert(sizeof(struct gaba_score_s) == 20);
-_static_assert(sizeof(struct gaba_params_s) == 16);
+_static_assert(sizeof(struct gaba_params_s) == 24);
 _static_assert(sizeof(struct gaba_section_s) == 16);
 _static_assert(sizeof(struct gaba_fill_s) == 64);
 _static_assert(sizeof(struct gaba_path_section_s) == 32);
@@ -235,6 +236,7 @@ _static_assert(sizeof(struct gaba_block_s) == 704);
 #endif
 _static_assert(sizeof(struct gaba_phantom_block_s) == 192);
 #define _last_block(x)				( (struct gaba_block_s *)(x) - 1 )
+#define _last_phantom_block(x)		( (struct gaba_phantom_block_s *)(x) - 1 )
 
 /**
  * @struct gaba_joint_tail_s
@@ -268,8 +270,33 @@ _static_assert(offsetof(struct gaba_joint_tail_s, max) == offsetof(struct gaba_f
 #define _tail(x)				( (struct gaba_joint_tail_s *)(x) )
 #define _fill(x)				( (struct gaba_fill_s *)(x) )
 
+/**
+ * @enum _MERGE_STATE
+ * @brief dp states whose source is recorded for each lane of a merged tail.
+ * u and l are the upper and left neighbors of the lane on the previous anti-diagonal,
+ * reached by the diagonal step of the forward and reverse trace, respectively.
+ */
+enum _MERGE_STATE {
+	MERGE_S = 0,
+	MERGE_U = 1,
+	MERGE_L = 2,
+	MERGE_E = 3,				/* affine only */
+	MERGE_F = 4,				/* affine only */
+	MERGE_STATES = 5
+};
+#if MODEL == LINEAR
+#  define MERGE_STATE_CNT		( 3 )
+#else
+#  define MERGE_STATE_CNT		( 5 )
+#endif
+#define MERGE_MAX_CNT			( 255 )
+
 /**
  * @struct gaba_merge_tail_s
+ *
+ * @brief (internal) tail created by gaba_dp_merge, placed right after a phantom block
+ * holding the lane-wise max of the sources. the trace jumps to the source of the state
+ * on the lane when it reaches the tail.
  */
 struct gaba_merge_tail_s {
 	/* coordinates */
@@ -285,15 +312,22 @@ struct gaba_merge_tail_s {
 	uint32_t rem_len;			/** (4) */
 
 	/* section info */
-	struct gaba_joint_tail_s const *tail;/** (8) */
+	struct gaba_joint_tail_s const *tail;/** (8) source chosen by the last trace */
 	uint32_t apos, bpos;		/** (8) pos */
 	uint32_t alen, blen;		/** (8) len */
 	uint32_t aid, bid;			/** (8) id */
 
 	/* tail array */
-	uint8_t tail_idx[2][BW];	/** (64) array of index of joint_tail */
+	uint8_t tail_idx[MERGE_STATES][BW];	/** (160) index of the source for each state and lane */
+	uint64_t cnt;				/** (8) */
+	struct gaba_merge_src_s {
+		struct gaba_joint_tail_s const *tail;
+		int64_t qofs;			/** lane offset of the source band */
+	} src[];
 };
-_static_assert(sizeof(struct gaba_merge_tail_s) == 128);
+_static_assert(offsetof(struct gaba_merge_tail_s, tail) == offsetof(struct gaba_joint_tail_s, tail));
+_static_assert(offsetof(struct gaba_merge_tail_s, tail_idx) == sizeof(struct gaba_joint_tail_s));
+_static_assert(sizeof(struct gaba_merge_tail_s) == 232);
 
 /**
  * @struct gaba_path_intl_s
@@ -365,7 +399,8 @@ struct gaba_writer_work_s {
 	uint32_t aid, bid;					/** (8) */
 	int32_t asum, bsum;					/** (8) sum length from current tail to base of each section */
 	int32_t asidx, bsidx;				/** (8) base indices of the current trace */
-	uint64_t _pad1;						/** (8) */
+	uint32_t brk;						/** (4) loop where the last fragment stopped */
+	uint32_t _pad1;						/** (4) */
 	/** 64, 128 */
 
 	/** 64byte aligned */
@@ -498,12 +533,24 @@ _static_assert(sizeof(struct gaba_context_s) == 704);
 enum _STATE {
 	CONT 	= 0,
 	UPDATE  = 0x0100,
-	TERM 	= 0x0200
+	TERM 	= 0x0200,
+	MERGE	= 0x0400		/* internal, the tail is a gaba_merge_tail_s */
 };
 _static_assert((int32_t)CONT == (int32_t)GABA_STATUS_CONT);
 _static_assert((int32_t)UPDATE == (int32_t)GABA_STATUS_UPDATE);
 _static_assert((int32_t)TERM == (int32_t)GABA_STATUS_TERM);
 
+/**
+ * @enum _TRACE_BREAK
+ * @brief loop the trace stopped in at the end of a section, the next fragment resumes there
+ */
+enum _TRACE_BREAK {
+	TRACE_BREAK_NONE = 0,		/* leaf, enters the first gap loop */
+	TRACE_BREAK_D = 1,
+	TRACE_BREAK_H = 2,
+	TRACE_BREAK_V = 3
+};
+
 
 /**
  * coordinate conversion macros
@@ -1983,6 +2030,258 @@ struct gaba_fill_s *suffix(gaba_dp_fill)(
 }
 
 
+/* merge functions */
+/**
+ * @fn merge_test_band
+ * @brief returns nonzero if the band of y can be aligned to that of x: the same section pair
+ * and the same anti-diagonal with overlapping lanes. lane q of x is lane q + *qofs of y.
+ */
+static _force_inline
+int64_t merge_test_band(
+	struct gaba_joint_tail_s const *x,
+	struct gaba_joint_tail_s const *y,
+	int64_t *qofs)
+{
+	/* sections; psum may differ between the paths reaching the same cell */
+	if(x->psum < 0 || y->psum < 0) {
+		return(0);
+	}
+	if(x->aid != y->aid || x->bid != y->bid || x->alen != y->alen || x->blen != y->blen) {
+		return(0);
+	}
+	if(((x->stat ^ y->stat) & (GABA_STATUS_UPDATE_A | GABA_STATUS_UPDATE_B)) != 0) {
+		return(0);
+	}
+
+	/* anti-diagonal; lane q is on (alen - aridx - q, blen - bridx - (BW - 1) + q) */
+	struct gaba_phantom_block_s const *xb = _last_phantom_block(x), *yb = _last_phantom_block(y);
+	if(xb->md != yb->md || xb->aridx + xb->bridx != yb->aridx + yb->bridx) {
+		return(0);
+	}
+	*qofs = (int64_t)xb->aridx - (int64_t)yb->aridx;
+	return(*qofs > -BW && *qofs < BW);
+}
+
+/**
+ * @fn merge_test_inside
+ * @brief returns nonzero if all the cells of the band are inside the current section pair;
+ * the trace never leaves the section pair before reaching the tail in that case.
+ */
+static _force_inline
+int64_t merge_test_inside(
+	struct gaba_joint_tail_s const *x)
+{
+	struct gaba_phantom_block_s const *xb = _last_phantom_block(x);
+	return((int64_t)x->alen - xb->aridx >= BW && (int64_t)x->blen - xb->bridx >= BW);
+}
+
+/**
+ * @struct merge_lane_s
+ * @brief absolute scores (up to a constant for each state) of a lane
+ */
+struct merge_lane_s {
+	int64_t v[MERGE_STATES];
+	int64_t max;
+};
+
+/**
+ * @fn merge_load_lane
+ * @brief decode the scores of lane q + qofs of the tail, returns zero if out of the band
+ */
+static _force_inline
+int64_t merge_load_lane(
+	struct gaba_joint_tail_s const *tail,
+	int64_t qofs,
+	int64_t q,
+	struct merge_lane_s *l)
+{
+	int64_t r = q + qofs;
+	if((uint64_t)r >= BW) {
+		return(0);
+	}
+
+	struct gaba_phantom_block_s const *blk = _last_phantom_block(tail);
+	int64_t base = blk->offset + blk->md->delta[r];
+	int64_t s = base + blk->sd.delta[r];
+	l->v[MERGE_S] = s;
+	l->max = base + blk->sd.max[r];
+
+	#if MODEL == LINEAR
+		/* dh: dH - gh, dv: dV - gv */
+		l->v[MERGE_L] = s - (int8_t)blk->diff.dh[r];
+		l->v[MERGE_U] = s - (int8_t)blk->diff.dv[r];
+	#else
+		/* dh and dv in the higher 5bits, de (E - S_up) and df (F - S_left) in the lower 3bits */
+		l->v[MERGE_L] = s - (blk->diff.dh[r]>>3);
+		l->v[MERGE_U] = s - (blk->diff.dv[r]>>3);
+		l->v[MERGE_E] = l->v[MERGE_U] + (blk->diff.dh[r] & 0x07);
+		l->v[MERGE_F] = l->v[MERGE_L] + (blk->diff.dv[r] & 0x07);
+	#endif
+	return(1);
+}
+
+/**
+ * @fn merge_store_lane
+ * @brief encode lane q onto the phantom block, returns zero if the diffs overflow
+ */
+static _force_inline
+int64_t merge_store_lane(
+	struct gaba_phantom_block_s *blk,
+	int64_t q,
+	struct merge_lane_s const *l)
+{
+	int64_t base = blk->offset + blk->md->delta[q];
+	int64_t delta = l->v[MERGE_S] - base, max = l->max - base;
+	int64_t dh = l->v[MERGE_S] - l->v[MERGE_L], dv = l->v[MERGE_S] - l->v[MERGE_U];
+	if(delta < INT8_MIN || delta > INT8_MAX || max < INT8_MIN || max > INT8_MAX) {
+		return(0);
+	}
+	blk->sd.delta[q] = delta;
+	blk->sd.max[q] = max;
+
+	#if MODEL == LINEAR
+		if(dh < INT8_MIN || dh > INT8_MAX || dv < INT8_MIN || dv > INT8_MAX) {
+			return(0);
+		}
+		blk->diff.dh[q] = (int8_t)dh;
+		blk->diff.dv[q] = (int8_t)dv;
+	#else
+		int64_t de = l->v[MERGE_E] - l->v[MERGE_U], df = l->v[MERGE_F] - l->v[MERGE_L];
+		if((uint64_t)dh > 0x1f || (uint64_t)dv > 0x1f || (uint64_t)de > 0x07 || (uint64_t)df > 0x07) {
+			return(0);
+		}
+		blk->diff.dh[q] = (dh<<3) | de;
+		blk->diff.dv[q] = (dv<<3) | df;
+	#endif
+	return(1);
+}
+
+/**
+ * @fn gaba_dp_merge
+ *
+ * @brief merge API, returns a fill to be extended in place of all the fills in fill_list,
+ * or NULL if the fills cannot be merged. the bands are aligned on the anti-diagonal and
+ * the lane-wise max of every dp state is taken; the dp is max-plus linear in the initial
+ * vector, so extending the merged one is equivalent to extending all of them. a fill
+ * dominating the others in all the states is returned as is. otherwise a merged tail is
+ * created, which requires the bands to be inside the last section pair, and the trace
+ * jumps to the source of the state on the lane when it reaches the tail.
+ */
+struct gaba_fill_s *suffix(gaba_dp_merge)(
+	struct gaba_dp_context_s *this,
+	struct gaba_fill_s const *const *fill_list,
+	uint64_t fill_cnt)
+{
+	if(fill_cnt == 0 || fill_cnt > MERGE_MAX_CNT) { return(NULL); }
+
+	/* the band of the one with the largest max is kept */
+	uint64_t x = 0;
+	for(uint64_t i = 1; i < fill_cnt; i++) {
+		x = (fill_list[i]->max > fill_list[x]->max) ? i : x;
+	}
+	struct gaba_joint_tail_s const *xt = _tail(fill_list[x]);
+	struct gaba_phantom_block_s const *xb = _last_phantom_block(xt);
+
+	/* align bands */
+	int64_t qofs[fill_cnt];
+	int64_t aligned = 1, inside = 1, same_char = 1;
+	for(uint64_t i = 0; i < fill_cnt; i++) {
+		struct gaba_joint_tail_s const *tail = _tail(fill_list[i]);
+		if(merge_test_band(xt, tail, &qofs[i]) == 0) {
+			return(NULL);
+		}
+		aligned &= qofs[i] == 0;
+		inside &= merge_test_inside(tail);
+		same_char &= memcmp(&xb->ch, &_last_phantom_block(tail)->ch, sizeof(struct gaba_char_vec_s)) == 0;
+	}
+
+	/* lane-wise max */
+	struct merge_lane_s lane[BW];
+	uint8_t tail_idx[MERGE_STATES][BW];
+	int64_t dominant = aligned;
+	for(int64_t q = 0; q < BW; q++) {
+		merge_load_lane(xt, 0, q, &lane[q]);
+		for(int64_t k = 0; k < MERGE_STATES; k++) {
+			tail_idx[k][q] = x;
+		}
+
+		for(uint64_t i = 0; i < fill_cnt; i++) {
+			struct merge_lane_s l;
+			if(i == x || merge_load_lane(_tail(fill_list[i]), qofs[i], q, &l) == 0) {
+				continue;
+			}
+			for(int64_t k = 0; k < MERGE_STATE_CNT; k++) {
+				if(l.v[k] <= lane[q].v[k]) { continue; }
+				lane[q].v[k] = l.v[k];
+				tail_idx[k][q] = i;
+				dominant = 0;
+			}
+			lane[q].max = MAX2(lane[q].max, l.max);
+		}
+	}
+	if(dominant && same_char) {
+		debug("merged, cnt(%llu), max(%p)", fill_cnt, xt);
+		return(_fill(xt));
+	}
+	if(inside == 0) {
+		return(NULL);
+	}
+
+	/* build phantom block, offset is adjusted to the center lane */
+	struct gaba_phantom_block_s blk = *xb;
+	blk.offset = lane[BW/2].v[MERGE_S] - xb->md->delta[BW/2];
+	int64_t max = INT64_MIN;
+	for(int64_t q = 0; q < BW; q++) {
+		if(merge_store_lane(&blk, q, &lane[q]) == 0) {
+			return(NULL);
+		}
+		max = MAX2(max, lane[q].max);
+	}
+
+	/* the accumulator follows the difference of the both ends */
+	struct merge_lane_s head, tail;
+	merge_load_lane(xt, 0, 0, &head);
+	merge_load_lane(xt, 0, BW - 1, &tail);
+	blk.dir.dynamic.acc += (lane[0].v[MERGE_S] - head.v[MERGE_S]) - (lane[BW - 1].v[MERGE_S] - tail.v[MERGE_S]);
+
+	/* malloc phantom block and tail on the stack */
+	struct gaba_phantom_block_s *pblk = (struct gaba_phantom_block_s *)gaba_dp_malloc(this,
+		sizeof(struct gaba_phantom_block_s)
+		+ sizeof(struct gaba_merge_tail_s)
+		+ sizeof(struct gaba_merge_src_s) * fill_cnt);
+	if(pblk == NULL) {
+		return(NULL);
+	}
+	*pblk = blk;
+
+	struct gaba_merge_tail_s *mt = (struct gaba_merge_tail_s *)(pblk + 1);
+	int64_t psum = 0;
+	uint32_t ssum = 0;
+	for(uint64_t i = 0; i < fill_cnt; i++) {
+		psum = MAX2(psum, _tail(fill_list[i])->psum);
+		ssum = MAX2(ssum, _tail(fill_list[i])->ssum);
+		mt->src[i] = (struct gaba_merge_src_s){
+			.tail = _tail(fill_list[i]),
+			.qofs = qofs[i]
+		};
+	}
+	mt->psum = psum;		/* the longest path bounds the trace buffer */
+	mt->p = xt->p;
+	mt->ssum = ssum;
+	mt->max = max;
+	mt->stat = (xt->stat & ~TERM) | MERGE;
+	mt->rem_len = 0;
+	mt->tail = xt;
+	_store_v2i32(&mt->apos, _load_v2i32(&xt->apos));
+	_store_v2i32(&mt->alen, _load_v2i32(&xt->alen));
+	_store_v2i32(&mt->aid, _load_v2i32(&xt->aid));
+	memcpy(mt->tail_idx, tail_idx, sizeof(tail_idx));
+	mt->cnt = fill_cnt;
+
+	debug("merged, cnt(%llu), merged(%p), max(%lld)", fill_cnt, mt, mt->max);
+	return(_fill(mt));
+}
+
 /* trace leaf search functions */
 /**
  * @struct gaba_leaf_s
@@ -2250,6 +2549,21 @@ void leaf_search(
 	return;
 }
 
+/**
+ * @fn trace_prev_tail
+ * @brief returns the previous tail on the chain. a merged tail stands for its sources
+ * on the same section pair, so it is skipped together with the source the trace took.
+ */
+static _force_inline
+struct gaba_joint_tail_s const *trace_prev_tail(
+	struct gaba_joint_tail_s const *tail)
+{
+	while(_unlikely((tail->stat & MERGE) != 0)) {
+		tail = tail->tail;
+	}
+	return(tail->tail);
+}
+
 /**
  * @fn gaba_dp_search_max
  */
@@ -2265,11 +2579,11 @@ struct gaba_pos_pair_s suffix(gaba_dp_search_max)(
 	int32_t aidx = alen - leaf.aridx, bidx = blen - leaf.bridx;
 
 	while(aidx <= 0) {
-		for(atail = atail->tail; (atail->stat & GABA_STATUS_UPDATE_A) == 0; atail = atail->tail) {}
+		for(atail = trace_prev_tail(atail); (atail->stat & GABA_STATUS_UPDATE_A) == 0; atail = trace_prev_tail(atail)) {}
 		aidx += (alen = atail->alen);
 	}
 	while(bidx <= 0) {
-		for(btail = btail->tail; (btail->stat & GABA_STATUS_UPDATE_B) == 0; btail = btail->tail) {}
+		for(btail = trace_prev_tail(btail); (btail->stat & GABA_STATUS_UPDATE_B) == 0; btail = trace_prev_tail(btail)) {}
 		bidx += (blen = btail->blen);
 	}
 	return((struct gaba_pos_pair_s){
@@ -2290,18 +2604,21 @@ void trace_load_section_a(
 
 	/* load tail pointer (must be inited with leaf tail) */
 	struct gaba_joint_tail_s const *tail = this->w.l.atail;
-	int32_t len = tail->alen;
-	int32_t sum = len;
-	int32_t idx = this->w.l.aidx + len;
+	int32_t len = this->w.l.alen;
+	int32_t sum = this->w.l.asum;
+	int32_t idx = this->w.l.aidx;
 
+	/* the section of the leaf tail comes first; the current one is exhausted afterward */
+	if(len == 0) {
+		len = tail->alen; sum = len; idx += len;
+	}
 	while(idx <= 0) {
-		for(tail = tail->tail; (tail->stat & GABA_STATUS_UPDATE_A) == 0; tail = tail->tail) {}
+		for(tail = trace_prev_tail(tail); (tail->stat & GABA_STATUS_UPDATE_A) == 0; tail = trace_prev_tail(tail)) {}
 		len = tail->alen; sum += len; idx += len;
 	}
 
 	/* reload finished, store section info */
-	// this->w.l.atail = tail->tail;
-	this->w.l.atail = tail;		/* fixme: is this correct?? */
+	this->w.l.atail = tail;
 	this->w.l.alen = len;
 	this->w.l.aid = tail->aid;
 	this->w.l.asum = sum;
@@ -2318,18 +2635,21 @@ void trace_load_section_b(
 
 	/* load tail pointer (must be inited with leaf tail) */
 	struct gaba_joint_tail_s const *tail = this->w.l.btail;
-	int32_t len = tail->blen;
-	int32_t sum = len;
-	int32_t idx = this->w.l.bidx + len;
+	int32_t len = this->w.l.blen;
+	int32_t sum = this->w.l.bsum;
+	int32_t idx = this->w.l.bidx;
 
+	/* the section of the leaf tail comes first; the current one is exhausted afterward */
+	if(len == 0) {
+		len = tail->blen; sum = len; idx += len;
+	}
 	while(idx <= 0) {
-		for(tail = tail->tail; (tail->stat & GABA_STATUS_UPDATE_B) == 0; tail = tail->tail) {}
+		for(tail = trace_prev_tail(tail); (tail->stat & GABA_STATUS_UPDATE_B) == 0; tail = trace_prev_tail(tail)) {}
 		len = tail->blen; sum += len; idx += len;
 	}
 
 	/* reload finished, store section info */
-	// this->w.l.btail = tail->tail;
-	this->w.l.btail = tail;		/* fixme: is this correct?? */
+	this->w.l.btail = tail;
 	this->w.l.blen = len;
 	this->w.l.bid = tail->bid;
 	this->w.l.bsum = sum;
@@ -2408,7 +2728,7 @@ void trace_load_section_b(
 /**
  * @macro _trace_reload_tail
  */
-#define _trace_reload_tail(t) { \
+#define _trace_reload_tail(t, _state) { \
 	debug("tail(%p), next tail(%p), p(%d), psum(%lld), ssum(%d)", \
 		(t)->w.l.tail, (t)->w.l.tail->tail, (t)->w.l.tail->tail->p, \
 		(t)->w.l.tail->tail->psum, (t)->w.l.tail->tail->ssum); \
@@ -2417,8 +2737,17 @@ void trace_load_section_b(
 	/* load section lengths */ \
 	struct gaba_joint_tail_s const *tail = (t)->w.l.tail; \
 	v2i32_t len = _load_v2i32(&tail->alen); \
-	/* reload tail */ \
-	tail = (t)->w.l.tail = tail->tail; \
+	/* reload tail, jump to the source of the state on the lane if merged */ \
+	tail = tail->tail; \
+	while(_unlikely((tail->stat & MERGE) != 0)) { \
+		struct gaba_merge_tail_s *_mt = (struct gaba_merge_tail_s *)tail; \
+		struct gaba_merge_src_s const *_src = &_mt->src[_mt->tail_idx[(_state)][q]]; \
+		debug("merged tail(%p), state(%d), q(%lld), src(%p), qofs(%lld)", _mt, (_state), q, _src->tail, _src->qofs); \
+		q += _src->qofs; \
+		(t)->w.l.psum += _src->tail->psum - _mt->psum; \
+		tail = _mt->tail = _src->tail;	/* section loaders follow the chosen one */ \
+	} \
+	(t)->w.l.tail = tail; \
 	blk = _last_block(tail) + 1; \
 	p = ((t)->w.l.p = tail->p) - 1; \
 	debug("updated psum(%lld), w.l.p(%d), p(%lld)", (t)->w.l.psum, (t)->w.l.p, p); \
@@ -2502,7 +2831,7 @@ void trace_load_section_b(
 /**
  * @macro _trace_forward_*_load
  */
-#define _trace_forward_head_load(t, _jump_to) { \
+#define _trace_forward_head_load(t, _jump_to, _state) { \
 	if(ptr == blk->mask - 1) { \
 		_trace_forward_cap_update_path(); \
 		_trace_reload_ptr(BLK - 1); \
@@ -2512,7 +2841,7 @@ void trace_load_section_b(
 	} \
 	_trace_load_mask(); \
 }
-#define _trace_forward_bulk_load(t, _jump_to) { \
+#define _trace_forward_bulk_load(t, _jump_to, _state) { \
 	if(ptr == blk->mask - 1) { \
 		_trace_forward_bulk_update_path(); \
 		_trace_reload_ptr(BLK - 1); \
@@ -2525,7 +2854,7 @@ void trace_load_section_b(
 	} \
 	_trace_load_mask(); \
 }
-#define _trace_forward_tail_load(t, _jump_to) { \
+#define _trace_forward_tail_load(t, _jump_to, _state) { \
 	if(ptr == blk->mask - 1) { \
 		debug("load block, blk(%p), next_blk(%p), p(%lld)", \
 			blk, blk-1, p); \
@@ -2536,7 +2865,7 @@ void trace_load_section_b(
 			if((t)->w.l.psum < (t)->w.l.p - p) { \
 				goto _trace_forward_index_break; \
 			} \
-			_trace_reload_tail(t); \
+			_trace_reload_tail(t, _state); \
 			debug("jump to %s", #_jump_to); \
 			goto _jump_to; \
 		} \
@@ -2549,7 +2878,7 @@ void trace_load_section_b(
 /**
  * @macro _trace_reverse_*_load
  */
-#define _trace_reverse_head_load(t, _jump_to) { \
+#define _trace_reverse_head_load(t, _jump_to, _state) { \
 	if(ptr == blk->mask - 1) { \
 		_trace_reverse_cap_update_path(); \
 		_trace_reload_ptr(BLK - 1); \
@@ -2559,7 +2888,7 @@ void trace_load_section_b(
 	} \
 	_trace_load_mask(); \
 }
-#define _trace_reverse_bulk_load(t, _jump_to) { \
+#define _trace_reverse_bulk_load(t, _jump_to, _state) { \
 	if(ptr == blk->mask - 1) { \
 		_trace_reverse_bulk_update_path(); \
 		_trace_reload_ptr(BLK - 1); \
@@ -2572,7 +2901,7 @@ void trace_load_section_b(
 	} \
 	_trace_load_mask(); \
 }
-#define _trace_reverse_tail_load(t, _jump_to) { \
+#define _trace_reverse_tail_load(t, _jump_to, _state) { \
 	if(ptr == blk->mask - 1) { \
 		debug("load block, blk(%p), next_blk(%p), p(%lld)", \
 			blk, blk-1, p); \
@@ -2583,7 +2912,7 @@ void trace_load_section_b(
 			if((t)->w.l.psum < (t)->w.l.p - p) { \
 				goto _trace_reverse_index_break; \
 			} \
-			_trace_reload_tail(t); \
+			_trace_reload_tail(t, _state); \
 			debug("jump to %s", #_jump_to); \
 			goto _jump_to; \
 		} \
@@ -2652,6 +2981,20 @@ void trace_load_section_b(
 #define _trace_test_gap_v()				( (mask_f>>q) & 0x01 )
 #endif
 
+/**
+ * @macro _trace_h_state, _trace_v_state
+ * @brief state of the gap loops, used to resolve merged tails
+ */
+#if MODEL == LINEAR
+#define _trace_h_state					( MERGE_S )
+#define _trace_v_state					( MERGE_S )
+#else /* MODEL == AFFINE */
+#define _trace_h_state					( MERGE_E )
+#define _trace_v_state					( MERGE_F )
+#endif
+#define _trace_h_break					( TRACE_BREAK_H )
+#define _trace_v_break					( TRACE_BREAK_V )
+
 /**
  * @macro _trace_*_*_update_path_q
  */
@@ -2718,13 +3061,15 @@ void trace_forward_body(
 				goto _trace_forward_##_type##_d_head; \
 			} \
 			if(_trace_##_type##_##_label##_test_index()) { \
+				_trace_forward_cap_update_path(); \
+				(t)->w.l.brk = _trace_##_label##_break; \
 				goto _trace_forward_index_break; \
 			} \
 			debug("go %s (%s), dir(%llx), mask_h(%x), mask_v(%x), p(%lld), q(%lld), ptr(%p), path_array(%llx)", \
 				#_label, #_type, ((uint64_t)dir.dynamic.array), mask_h, mask_v, p, q, ptr, path_array); \
 			_trace_##_type##_##_label##_update_index(); \
 			_trace_forward_##_label##_update_path_q(); \
-			_trace_forward_##_type##_load(t, _trace_forward_##_next##_##_label##_head); \
+			_trace_forward_##_type##_load(t, _trace_forward_##_next##_##_label##_head, _trace_##_label##_state); \
 		} \
 	}
 
@@ -2736,17 +3081,18 @@ void trace_forward_body(
 			} \
 			if(_trace_##_type##_d_test_index()) { \
 				_trace_forward_cap_update_path(); \
+				(t)->w.l.brk = TRACE_BREAK_D; \
 				goto _trace_forward_index_break; \
 			} \
 			debug("go d (%s), dir(%llx), mask_h(%x), mask_v(%x), p(%lld), q(%lld), ptr(%p), path_array(%llx)", \
 				#_type, ((uint64_t)dir.dynamic.array), mask_h, mask_v, p, q, ptr, path_array); \
 			_trace_##_type##_h_update_index(); \
 			_trace_forward_h_update_path_q(); \
-			_trace_forward_##_type##_load(t, _trace_forward_##_next##_d_mid); \
+			_trace_forward_##_type##_load(t, _trace_forward_##_next##_d_mid, MERGE_U); \
 		_trace_forward_##_type##_d_mid: \
 			_trace_##_type##_v_update_index(); \
 			_trace_forward_v_update_path_q(); \
-			_trace_forward_##_type##_load(t, _trace_forward_##_next##_d_tail); \
+			_trace_forward_##_type##_load(t, _trace_forward_##_next##_d_tail, MERGE_S); \
 		_trace_forward_##_type##_d_tail: \
 			if(_trace_test_diag_v() != 0) { \
 				goto _trace_forward_##_type##_v_head; \
@@ -2756,6 +3102,13 @@ void trace_forward_body(
 
 	_trace_forward_load_context(this);
 
+	/* resume the loop where the last fragment stopped, the v loop comes first at the leaf */
+	switch(this->w.l.brk) {
+		case TRACE_BREAK_D: goto _trace_forward_loop_d_head;
+		case TRACE_BREAK_H: goto _trace_forward_loop_h_head;
+		default: break;
+	}
+
 	/* v loop */
 	_trace_forward_loop_v_head: {
 		if(p < 3 * BLK) {
@@ -2767,6 +3120,13 @@ void trace_forward_body(
 	}
 
 	/* d dispatchers */
+	_trace_forward_loop_d_head: {
+		if(p < 3 * BLK) {
+			goto _trace_forward_tail_d_head;
+		} else {
+			goto _trace_forward_head_d_head;
+		}
+	}
 	_trace_forward_loop_d_mid: {
 		if(p < 3 * BLK) {
 			goto _trace_forward_tail_d_mid;
@@ -2816,13 +3176,15 @@ void trace_reverse_body(
 				goto _trace_reverse_##_type##_d_head; \
 			} \
 			if(_trace_##_type##_##_label##_test_index()) { \
+				_trace_reverse_cap_update_path(); \
+				(t)->w.l.brk = _trace_##_label##_break; \
 				goto _trace_reverse_index_break; \
 			} \
 			debug("go %s (%s), dir(%llx), mask_h(%x), mask_v(%x), p(%lld), q(%lld), ptr(%p), path_array(%llx)", \
 				#_label, #_type, ((uint64_t)dir.dynamic.array), mask_h, mask_v, p, q, ptr, path_array); \
 			_trace_##_type##_##_label##_update_index(); \
 			_trace_reverse_##_label##_update_path_q(); \
-			_trace_reverse_##_type##_load(t, _trace_reverse_##_next##_##_label##_head); \
+			_trace_reverse_##_type##_load(t, _trace_reverse_##_next##_##_label##_head, _trace_##_label##_state); \
 		} \
 	}
 
@@ -2834,17 +3196,18 @@ void trace_reverse_body(
 			} \
 			if(_trace_##_type##_d_test_index()) { \
 				_trace_reverse_cap_update_path(); \
+				(t)->w.l.brk = TRACE_BREAK_D; \
 				goto _trace_reverse_index_break; \
 			} \
 			debug("go d (%s), dir(%llx), mask_h(%x), mask_v(%x), p(%lld), q(%lld), ptr(%p), path_array(%llx)", \
 				#_type, ((uint64_t)dir.dynamic.array), mask_h, mask_v, p, q, ptr, path_array); \
 			_trace_##_type##_v_update_index(); \
 			_trace_reverse_v_update_path_q(); \
-			_trace_reverse_##_type##_load(t, _trace_reverse_##_next##_d_mid); \
+			_trace_reverse_##_type##_load(t, _trace_reverse_##_next##_d_mid, MERGE_L); \
 		_trace_reverse_##_type##_d_mid: \
 			_trace_##_type##_h_update_index(); \
 			_trace_reverse_h_update_path_q(); \
-			_trace_reverse_##_type##_load(t, _trace_reverse_##_next##_d_tail); \
+			_trace_reverse_##_type##_load(t, _trace_reverse_##_next##_d_tail, MERGE_S); \
 		_trace_reverse_##_type##_d_tail: \
 			if(_trace_test_diag_h() != 0) { \
 				goto _trace_reverse_##_type##_h_head; \
@@ -2854,6 +3217,13 @@ void trace_reverse_body(
 
 	_trace_reverse_load_context(this);
 
+	/* resume the loop where the last fragment stopped, the h loop comes first at the leaf */
+	switch(this->w.l.brk) {
+		case TRACE_BREAK_D: goto _trace_reverse_loop_d_head;
+		case TRACE_BREAK_V: goto _trace_reverse_loop_v_head;
+		default: break;
+	}
+
 	/* h loop */
 	_trace_reverse_loop_h_head: {
 		if(p < 3 * BLK) {
@@ -2865,6 +3235,13 @@ void trace_reverse_body(
 	}
 
 	/* d dispatchers */
+	_trace_reverse_loop_d_head: {
+		if(p < 3 * BLK) {
+			goto _trace_reverse_tail_d_head;
+		} else {
+			goto _trace_reverse_head_d_head;
+		}
+	}
 	_trace_reverse_loop_d_mid: {
 		if(p < 3 * BLK) {
 			goto _trace_reverse_tail_d_mid;
@@ -3054,6 +3431,7 @@ void trace_init_work(
 
 	this->w.l.psum = tail->psum - tail->p + leaf->p;
 	this->w.l.pspos = 0;
+	this->w.l.brk = TRACE_BREAK_NONE;
 
 	/* save section info */
 	this->w.l.sec = *sec;
@@ -3902,6 +4280,8 @@ void gaba_init_restore_default_params(
 	restore(filter_thresh,		0);
 	restore(xdrop, 				100);
 	restore(score_matrix, 		default_score_matrix);
+	restore(stack_size,			MEM_INIT_SIZE);
+	params->stack_size = MAX2(params->stack_size, MEM_MIN_SIZE);
 	return;
 }
 
@@ -4247,8 +4627,8 @@ gaba_t *suffix(gaba_init)(
 	*ctx = (struct gaba_context_s) {
 		/* template */
 		.k = (struct gaba_dp_context_s) {
-			/* memory management */
-			.mem = { 0 },
+			/* memory management (size of the initial stack is kept in the template) */
+			.mem = { .size = params_intl.stack_size },
 			.curr_mem = NULL,
 			.stack_top = NULL,						/* stored on init */
 			.stack_end = NULL,						/* stored on init */
@@ -4334,8 +4714,9 @@ struct gaba_dp_context_s *suffix(gaba_dp_init)(
 	uint8_t const *blim)
 {
 	/* malloc stack memory */
+	uint64_t const stack_size = ctx->k.mem.size;
 	struct gaba_dp_context_s *this = (struct gaba_dp_context_s *)gaba_aligned_malloc(
-		MEM_INIT_SIZE, MEM_ALIGN_SIZE);
+		stack_size, MEM_ALIGN_SIZE);
 	if(this == NULL) {
 		debug("failed to malloc memory");
 		return(NULL);
@@ -4343,7 +4724,7 @@ struct gaba_dp_context_s *suffix(gaba_dp_init)(
 
 	/* init stack pointers */
 	this->stack_top = (uint8_t *)(this + 1);
-	this->stack_end = (uint8_t *)this + MEM_INIT_SIZE - MEM_MARGIN_SIZE;
+	this->stack_end = (uint8_t *)this + stack_size - MEM_MARGIN_SIZE;
 
 	/* init seq lims */
 	this->w.r.alim = alim;
@@ -4360,7 +4741,7 @@ struct gaba_dp_context_s *suffix(gaba_dp_init)(
 	this->mem = (struct gaba_mem_block_s){
 		.next = NULL,
 		.prev = NULL,
-		.size = MEM_INIT_SIZE
+		.size = stack_size
 	};
 	return(this);
 }
@@ -4994,6 +5375,99 @@ unittest(with_seq_pair("A", "A"))
 	gaba_dp_clean(d);
 }
 
+/* merge */
+unittest(with_seq_pair("A", "A"))
+{
+	omajinai();
+
+	struct gaba_fill_s *f = gaba_dp_fill_root(d, &s->afsec, 0, &s->bfsec, 0);
+	f = gaba_dp_fill(d, f, &s->afsec, &s->bfsec);
+
+	/* two fronts converging on the same section pair */
+	struct gaba_fill_s *f1 = gaba_dp_fill(d, f, &s->aftail, &s->bftail);
+	struct gaba_fill_s *f2 = gaba_dp_fill(d, f, &s->aftail, &s->bftail);
+	assert(check_tail(f1, 4, 13, 13, 3), print_tail(f1));
+	assert(check_tail(f2, 4, 13, 13, 3), print_tail(f2));
+
+	struct gaba_fill_s const *list[3] = { f1, f2, f };
+	assert(gaba_dp_merge(d, list, 0) == NULL);
+	assert(gaba_dp_merge(d, list, 1) == f1);
+	assert(gaba_dp_merge(d, list, 2) == f1);
+
+	/* different p-coordinates */
+	assert(gaba_dp_merge(d, list, 3) == NULL);
+	assert(gaba_dp_merge(d, &list[1], 2) == NULL);
+
+	/* extension of the merged one */
+	struct gaba_fill_s *m = gaba_dp_fill(d, gaba_dp_merge(d, list, 2), &s->aftail, &s->bftail);
+	#if MODEL == LINEAR
+		assert(check_tail(m, 4, 40, 53, 4), print_tail(m));
+	#else
+		assert(check_tail(m, 4, 31, 44, 4), print_tail(m));
+	#endif
+
+	gaba_dp_clean(d);
+}
+
+/* two paths reconverging on a shared section with different scores */
+#define UNITTEST_MERGE_P	"GGCGATCATCCCGGCACGTCAATCTCTCGCTCTATTTATG"
+#define UNITTEST_MERGE_X	"GGCGATCATCCCGGCACGTCAATCTCTCGCTCTATTATGT"
+#define UNITTEST_MERGE_Y	"GGCGATCATCCCGGCACGTCAATCTCTCGCTCTATTTAGA"
+#define UNITTEST_MERGE_S	"TGCTGAACCTGAACCTCAGCCGTGTTGGACGTAA"
+#define UNITTEST_MERGE_T	"GGAGAGGGGGATGCTAGAGGTCCCTCGGAGGGCGACAGTG"
+unittest(with_seq_pair(
+	UNITTEST_MERGE_X UNITTEST_MERGE_Y UNITTEST_MERGE_S UNITTEST_MERGE_T,
+	UNITTEST_MERGE_P UNITTEST_MERGE_S UNITTEST_MERGE_T))
+{
+	omajinai();
+
+	/* X and Y are the two branches, S the shared section, T the tail */
+	uint64_t const xlen = strlen(UNITTEST_MERGE_X), ylen = strlen(UNITTEST_MERGE_Y), slen = strlen(UNITTEST_MERGE_S);
+	struct gaba_section_s const xsec = gaba_build_section(10, s->a, xlen);
+	struct gaba_section_s const ysec = gaba_build_section(12, s->a + xlen, ylen);
+	struct gaba_section_s const ssec = gaba_build_section(14, s->a + xlen + ylen, slen);
+	struct gaba_section_s const tsec = gaba_build_section(16, s->a + xlen + ylen + slen, strlen(UNITTEST_MERGE_T));
+
+	struct gaba_fill_s *fx = gaba_dp_fill_root(d, &xsec, 0, &s->bfsec, 0);
+	struct gaba_fill_s *fy = gaba_dp_fill_root(d, &ysec, 0, &s->bfsec, 0);
+	fx = gaba_dp_fill(d, fx, &ssec, &s->bfsec);
+	fy = gaba_dp_fill(d, fy, &ssec, &s->bfsec);
+
+	/* neither dominates the other, a merged tail is built */
+	struct gaba_fill_s const *list[2] = { fx, fy };
+	struct gaba_fill_s *m = gaba_dp_merge(d, list, 2);
+	assert(m != NULL && m != fx && m != fy, "m(%p), fx(%p), fy(%p)", m, fx, fy);
+	assert(m->max == 106, "%lld", m->max);
+	assert(_tail(m)->p == _tail(fy)->p && m->psum == fy->psum, print_tail(_tail(m)));
+
+	/* extend the three down to the tails */
+	struct gaba_fill_s *e[3] = { m, fx, fy };
+	for(int64_t i = 0; i < 3; i++) {
+		e[i] = gaba_dp_fill(d, e[i], &tsec, &s->bfsec);
+		struct gaba_section_s const *as = (e[i]->status & GABA_STATUS_UPDATE_A) ? &s->aftail : &tsec;
+		struct gaba_section_s const *bs = (e[i]->status & GABA_STATUS_UPDATE_B) ? &s->bftail : &s->bfsec;
+		e[i] = gaba_dp_fill(d, e[i], as, bs);
+	}
+	assert(e[0]->max == MAX2(e[1]->max, e[2]->max), "%lld, %lld, %lld", e[0]->max, e[1]->max, e[2]->max);
+
+	/* the trace through the merged tail recovers the path of the winning branch */
+	struct gaba_alignment_s const *r = gaba_dp_trace(d, e[0], NULL, NULL);
+	assert(r->score == e[2]->max, "%lld, %lld", r->score, e[2]->max);
+	assert(r->slen == 3, "%u", r->slen);
+	assert(check_cigar(r, "114M"), print_path(r));
+	assert(check_section(r->sec[0], ysec, 0, 40, s->bfsec, 0, 40, 0, 80), print_section(r->sec[0]));
+	assert(check_section(r->sec[1], ssec, 0, 34, s->bfsec, 40, 34, 80, 68), print_section(r->sec[1]));
+	assert(check_section(r->sec[2], tsec, 0, 40, s->bfsec, 74, 40, 148, 80), print_section(r->sec[2]));
+
+	/* the losing branch alone still traces back through its own sections */
+	r = gaba_dp_trace(d, e[1], NULL, NULL);
+	assert(r->score == e[1]->max && r->score < e[2]->max, "%lld, %lld", r->score, e[2]->max);
+	assert(check_cigar(r, "36M1I4M1D73M"), print_path(r));
+	assert(check_section(r->sec[0], xsec, 0, 40, s->bfsec, 0, 40, 0, 80), print_section(r->sec[0]));
+
+	gaba_dp_clean(d);
+}
+
 /* with longer sequences */
 unittest(with_seq_pair("ACGTACGTACGT", "ACGTACGTACGT"))
 {
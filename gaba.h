@@ -83,6 +83,9 @@ struct gaba_params_s {
 	/** score parameters */
 	int16_t xdrop;
 	gaba_score_t const *score_matrix;
+
+	/** memory options */
+	uint64_t stack_size;		/** initial size of the DP stack (grows on demand), 256MB if zero */
 };
 typedef struct gaba_params_s gaba_params_t;
 
@@ -306,11 +309,14 @@ gaba_fill_t *gaba_dp_fill(
 
 /**
  * @fn gaba_dp_merge
+ * @brief merge fills converging at the same p-coordinate on the same section pair.
+ * returns the fill to be extended in place of all the fills in the list, or NULL if
+ * they cannot be merged (the fills must be extended separately in that case).
  */
 gaba_fill_t *gaba_dp_merge(
 	gaba_dp_t *dp,
-	gaba_fill_t const *sec_list,
-	uint64_t sec_list_len);
+	gaba_fill_t const *const *fill_list,
+	uint64_t fill_cnt);
 
 /**
  * @fn gaba_dp_search_max
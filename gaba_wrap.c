@@ -31,9 +31,7 @@
  * @brief a set of pointers to GABA API
  */
 struct gaba_api_s {
-	/* configuration init / destroy */
-	gaba_t *(*init)(
-		gaba_params_t const *params);
+	/* configuration destroy */
 	void (*clean)(
 		gaba_t *ctx);
 
@@ -49,6 +47,10 @@ struct gaba_api_s {
 		gaba_fill_t const *prev_sec,
 		gaba_section_t const *a,
 		gaba_section_t const *b);
+	gaba_fill_t *(*dp_merge)(
+		gaba_dp_t *this,
+		gaba_fill_t const *const *fill_list,
+		uint64_t fill_cnt);
 	gaba_pos_pair_t (*dp_search_max)(
 		gaba_dp_t *this,
 		gaba_fill_t const *sec);
@@ -97,8 +99,8 @@ gaba_fill_t *gaba_dp_fill_linear(
 	gaba_section_t const *b);
 gaba_fill_t *gaba_dp_merge_linear(
 	gaba_dp_t *this,
-	gaba_fill_t const *sec_list,
-	uint64_t sec_list_len);
+	gaba_fill_t const *const *fill_list,
+	uint64_t fill_cnt);
 gaba_pos_pair_t gaba_dp_search_max_linear(
 	gaba_dp_t *this,
 	gaba_fill_t const *sec);
@@ -173,8 +175,8 @@ gaba_fill_t *gaba_dp_fill_affine(
 	gaba_section_t const *b);
 gaba_fill_t *gaba_dp_merge_affine(
 	gaba_dp_t *this,
-	gaba_fill_t const *sec_list,
-	uint64_t sec_list_len);
+	gaba_fill_t const *const *fill_list,
+	uint64_t fill_cnt);
 gaba_pos_pair_t gaba_dp_search_max_affine(
 	gaba_dp_t *this,
 	gaba_fill_t const *sec);
@@ -217,22 +219,28 @@ int64_t gaba_dp_dump_cigar_reverse_affine(
 	uint32_t len);
 
 
-/* function table */
+/* function table, copied to the head of the contexts (the init functions are kept out of it to fit in the six slots) */
+static
+gaba_t *(*const init_table[])(
+	gaba_params_t const *params) = {
+	[LINEAR] = gaba_init_linear,
+	[AFFINE] = gaba_init_affine
+};
 static
 struct gaba_api_s const api_table[] __attribute__(( aligned(16) )) = {
 	[LINEAR] = {
-		.init = gaba_init_linear,
 		.clean = gaba_clean_linear,
 		.dp_fill_root = gaba_dp_fill_root_linear,
 		.dp_fill = gaba_dp_fill_linear,
+		.dp_merge = gaba_dp_merge_linear,
 		.dp_search_max = gaba_dp_search_max_linear,
 		.dp_trace = gaba_dp_trace_linear
 	},
 	[AFFINE] = {
-		.init = gaba_init_affine,
 		.clean = gaba_clean_affine,
 		.dp_fill_root = gaba_dp_fill_root_affine,
 		.dp_fill = gaba_dp_fill_affine,
+		.dp_merge = gaba_dp_merge_affine,
 		.dp_search_max = gaba_dp_search_max_affine,
 		.dp_trace = gaba_dp_trace_affine
 	}
@@ -283,11 +291,11 @@ gaba_t *gaba_init(
 		return(NULL);
 	}
 
-	struct gaba_api_s const *api = &api_table[gaba_init_get_index(params->score_matrix)];
-	if(api->init == NULL) {
+	int64_t idx = gaba_init_get_index(params->score_matrix);
+	if(init_table[idx] == NULL) {
 		return(NULL);
 	}
-	return((gaba_t *)gaba_set_api((void *)api->init(params), api));
+	return((gaba_t *)gaba_set_api((void *)init_table[idx](params), &api_table[idx]));
 }
 
 /**
@@ -384,11 +392,10 @@ gaba_fill_t *gaba_dp_fill(
  */
 gaba_fill_t *gaba_dp_merge(
 	gaba_dp_t *this,
-	gaba_fill_t const *sec_list,
-	uint64_t sec_list_len)
+	gaba_fill_t const *const *fill_list,
+	uint64_t fill_cnt)
 {
-	// return(_api(this)->dp_merge(this, sec_list, sec_list_len));
-	return(NULL);		/* not implemented yet */
+	return(_api(this)->dp_merge(this, fill_list, fill_cnt));
 }
 
 /**
@@ -742,6 +749,64 @@ unittest(with_seq_pair("GGAAAAAAAA", "AAAAAAAA"))
 	gaba_clean(c);	
 }
 
+/* merge dispatched to the affine implementation */
+#define UNITTEST_MERGE_P	"GGCGATCATCCCGGCACGTCAATCTCTCGCTCTATTTATG"
+#define UNITTEST_MERGE_X	"GGCGATCATCCCGGCACGTCAATCTCTCGCTCTATTATGT"
+#define UNITTEST_MERGE_Y	"GGCGATCATCCCGGCACGTCAATCTCTCGCTCTATTTAGA"
+#define UNITTEST_MERGE_S	"TGCTGAACCTGAACCTCAGCCGTGTTGGACGTAA"
+#define UNITTEST_MERGE_T	"GGAGAGGGGGATGCTAGAGGTCCCTCGGAGGGCGACAGTG"
+unittest(with_seq_pair(
+	UNITTEST_MERGE_X UNITTEST_MERGE_Y UNITTEST_MERGE_S UNITTEST_MERGE_T,
+	UNITTEST_MERGE_P UNITTEST_MERGE_S UNITTEST_MERGE_T))
+{
+	omajinai();
+
+	void const *lim = (void const *)0x800000000000;
+	gaba_t *c = gaba_init(GABA_PARAMS(
+		.xdrop = 100,
+		.score_matrix = GABA_SCORE_SIMPLE(2, 3, 5, 1)));
+	gaba_dp_t *d = gaba_dp_init(c, lim, lim);
+
+	/* two branches X and Y converging on S, followed by T */
+	uint64_t const xlen = strlen(UNITTEST_MERGE_X), ylen = strlen(UNITTEST_MERGE_Y), slen = strlen(UNITTEST_MERGE_S);
+	gaba_section_t const xsec = gaba_build_section(10, s->a, xlen);
+	gaba_section_t const ysec = gaba_build_section(12, s->a + xlen, ylen);
+	gaba_section_t const ssec = gaba_build_section(14, s->a + xlen + ylen, slen);
+	gaba_section_t const tsec = gaba_build_section(16, s->a + xlen + ylen + slen, strlen(UNITTEST_MERGE_T));
+
+	gaba_fill_t *fx = gaba_dp_fill(d, gaba_dp_fill_root(d, &xsec, 0, &s->bfsec, 0), &ssec, &s->bfsec);
+	gaba_fill_t *fy = gaba_dp_fill(d, gaba_dp_fill_root(d, &ysec, 0, &s->bfsec, 0), &ssec, &s->bfsec);
+
+	gaba_fill_t const *list[2] = { fx, fy };
+	gaba_fill_t *m = gaba_dp_merge(d, list, 2);
+	assert(m != NULL && m != fx && m != fy, "m(%p), fx(%p), fy(%p)", m, fx, fy);
+	assert(m->max == 106, "%lld", m->max);
+
+	/* extension of the merged front scores the better branch */
+	gaba_fill_t *e[3] = { m, fx, fy };
+	for(int64_t i = 0; i < 3; i++) {
+		e[i] = gaba_dp_fill(d, e[i], &tsec, &s->bfsec);
+		e[i] = gaba_dp_fill(d, e[i],
+			(e[i]->status & GABA_STATUS_UPDATE_A) ? &s->aftail : &tsec,
+			(e[i]->status & GABA_STATUS_UPDATE_B) ? &s->bftail : &s->bfsec);
+	}
+	assert(e[1]->max == 214, "%lld", e[1]->max);
+	assert(e[2]->max == 218, "%lld", e[2]->max);
+	assert(e[0]->max == 218, "%lld", e[0]->max);
+
+	/* and the trace goes back through Y */
+	gaba_alignment_t *r = gaba_dp_trace(d, e[0], NULL, NULL);
+	assert(r != NULL);
+	assert(r->score == 218, "%lld", r->score);
+	assert(r->slen == 3, "%u", r->slen);
+	assert(r->sec[0].aid == 12, "%u", r->sec[0].aid);
+	assert(r->sec[1].aid == 14, "%u", r->sec[1].aid);
+	assert(r->sec[2].aid == 16, "%u", r->sec[2].aid);
+
+	gaba_dp_clean(d);
+	gaba_clean(c);
+}
+
 #endif
 /**
  * end of gaba_wrap.c
@@ -8,12 +8,16 @@
  * @date 2016/4/12
  */
 
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE		200112L		/* clock_gettime */
+#endif
+
 #define UNITTEST_UNIQUE_ID			10
 #include "unittest.h"
 
 #include <stdint.h>
+#include <time.h>
 #include "ggsea.h"
-#include "hmap.h"
 #include "psort.h"
 #include "tree.h"
 #include "gref.h"
@@ -33,6 +37,7 @@
 #define MARGIN_SEQ_SIZE				( 64 )
 #define MARGIN_SEQ_OFFSET			( 16 )
 #define MARGIN_SEQ_LEN				( 32 )
+#define DP_BAND_WIDTH				( 32 )		/* cells filled per p-coordinate in gaba */
 
 /* max and min */
 #define MAX2(x,y) 		( (x) > (y) ? (x) : (y) )
@@ -57,8 +62,6 @@ struct ggsea_conf_s {
 	gaba_t *gaba;
 
 	/* params */
-	uint64_t init_rep_hash_size;
-	uint64_t max_rep_vec_size;		/* max kmer vector size */
 	uint64_t overlap_width;			/* overlap filter width */
 	uint64_t res_lmm_size;			/* result memory manager size */
 	struct ggsea_params_s params;
@@ -66,13 +69,15 @@ struct ggsea_conf_s {
 
 /**
  * @struct rep_seed_s
+ * @brief repetitive kmer held for the rescue pass, sorted on bytes [0, 4)
  */
 struct rep_seed_s {
-	hmap_header_t header;
-	uint64_t vec_size;
-	kvec_t(struct gref_gid_pos_s) rv;
-	kvec_t(struct gref_gid_pos_s) qv;
+	uint32_t cnt;			/* number of occurrences on the reference */
+	uint32_t pad;
+	struct gref_gid_pos_s qpos;
+	struct gref_gid_pos_s const *rarr;		/* occurrences (points into the index) */
 };
+_static_assert(sizeof(struct rep_seed_s) == 24);
 
 /**
  * @struct rtree_node_s
@@ -141,6 +146,55 @@ struct dp_front_s {
 };
 _static_assert(sizeof(struct dp_front_s) == 24);
 
+/**
+ * @struct ggsea_seed_s
+ * @brief seed held for the two-hit filter and the chaining filter
+ */
+struct ggsea_seed_s {
+	struct gref_gid_pos_s rpos;
+	struct gref_gid_pos_s qpos;
+	uint32_t hit;			/* nonzero if paired on the diagonal or chained */
+	uint32_t len;			/* bases of the exact run from the seed, the adjacent kmers are removed from the array */
+};
+_static_assert(sizeof(struct ggsea_seed_s) == 24);
+
+/**
+ * @struct ggsea_diag_s
+ * @brief (rgid, diagonal, qgid) key of a seed, sorted on bytes [4, 16)
+ */
+struct ggsea_diag_s {
+	uint32_t idx;			/* index in the seed array (not sorted) */
+	uint32_t qgid;
+	uint32_t diag;			/* rpos - qpos (biased) */
+	uint32_t rgid;
+};
+_static_assert(sizeof(struct ggsea_diag_s) == 16);
+
+/**
+ * @struct ggsea_chain_s
+ * @brief chaining score of a seed and its predecessor
+ */
+struct ggsea_chain_s {
+	uint32_t rpos;			/* start positions of the kmer in the first sections */
+	uint32_t qpos;
+	int32_t score;
+	int32_t pred;			/* index in the seed array, -1 if the head of a chain */
+};
+_static_assert(sizeof(struct ggsea_chain_s) == 16);
+
+/**
+ * @struct ggsea_work_s
+ * @brief remaining per-read work, INT64_MAX if unlimited
+ */
+struct ggsea_work_s {
+	int64_t seeds;
+	int64_t fronts;
+	int64_t cells;
+	int64_t deadline;		/* in microseconds */
+	uint32_t truncated;
+	uint32_t pad;
+};
+
 /**
  * @struct ggsea_ctx_s
  */
@@ -156,21 +210,29 @@ struct ggsea_ctx_s {
 	gref_acv_t const *q;
 
 	/* repetitive kmer container */
-	hmap_t *rep;
+	kvec_t(struct rep_seed_s) rep;
 
 	/* seed filters */
 	rbtree_t *rtree;
 	rbtree_t *qtree;
+	kvec_t(struct ggsea_seed_s) seed;		/* seeds of the current read (two-hit and chaining filters) */
+	kvec_t(uint32_t) run;					/* seed index of the runs reaching the previous kmer, for the current one appended */
+	kvec_t(struct ggsea_diag_s) diag;
+	kvec_t(struct ggsea_chain_s) chain;
 
 	/* dp context */
 	gaba_dp_t *dp;
 	kvec_t(struct dp_front_s) queue;	/* segment queue */
+	kvec_t(struct dp_front_s) front;	/* segments at the same p-coordinate (merge buffer) */
 	uint8_t *margin;
 	struct gref_section_s fw_margin, rv_margin;
 
 	/* result vector */
 	lmm_t *res_lmm;
 	kvec_t(struct gaba_alignment_s const *) aln;
+
+	/* per-read work limits */
+	struct ggsea_work_s work;
 };
 
 
@@ -223,15 +285,14 @@ ggsea_conf_t *ggsea_conf_init(
 	conf->gaba = gaba_init(GABA_PARAMS(
 		.filter_thresh = p.gapless_thresh,
 		.xdrop = p.xdrop,
-		.score_matrix = p.score_matrix));
+		.score_matrix = p.score_matrix,
+		.stack_size = p.stack_size));
 	if(conf->gaba == NULL) {
 		free(conf);
 		return(NULL);
 	}
 
 	/* store constants */
-	conf->init_rep_hash_size = 1024;
-	conf->max_rep_vec_size = 128;
 	conf->overlap_width = 48;
 	conf->res_lmm_size = 16 * 1024 * 1024;		/* 16MB */
 	conf->params = p;
@@ -248,17 +309,8 @@ void ggsea_ctx_clean(
 	ggsea_ctx_t *ctx)
 {
 	if(ctx != NULL) {
-		/* destroy repetitive kmer vectors */
-		if(ctx->rep != NULL) {
-			int64_t hcnt = hmap_get_count(ctx->rep);
-			for(int64_t i = 0; i < hcnt; i++) {
-				struct rep_seed_s *c = hmap_get_object(ctx->rep, i);
-				debug("free rv(%p), qv(%p)", kv_ptr(c->rv), kv_ptr(c->qv));
-				kv_destroy(c->rv);
-				kv_destroy(c->qv);
-			}
-		}
-		hmap_clean(ctx->rep); ctx->rep = NULL;
+		/* destroy repetitive kmer vector */
+		kv_destroy(ctx->rep);
 
 		/* destroy seed filter tree */
 		rbtree_clean(ctx->rtree); ctx->rtree = NULL;
@@ -266,6 +318,13 @@ void ggsea_ctx_clean(
 
 		/* destroy tree traversing queue */
 		kv_hq_destroy(ctx->queue);
+		kv_destroy(ctx->front);
+
+		/* two-hit and chaining filters */
+		kv_destroy(ctx->seed);
+		kv_destroy(ctx->run);
+		kv_destroy(ctx->diag);
+		kv_destroy(ctx->chain);
 
 		/* margin sequence */
 		free(ctx->margin); ctx->margin = NULL;
@@ -305,10 +364,8 @@ ggsea_ctx_t *ggsea_ctx_init(
 	ctx->q = NULL;
 
 	/* init repetitive kmer filter */
-	ctx->rep = hmap_init(
-		sizeof(struct rep_seed_s),
-		HMAP_PARAMS(.hmap_size = conf->init_rep_hash_size));
-	if(ctx->rep == NULL) {
+	kv_init(ctx->rep);
+	if(kv_ptr(ctx->rep) == NULL) {
 		goto _ggsea_ctx_init_error_handler;
 	}
 
@@ -323,6 +380,21 @@ ggsea_ctx_t *ggsea_ctx_init(
 	}
 	debug("init, hq_size(%llu)", kv_hq_size(ctx->queue));
 
+	kv_init(ctx->front);
+	if(kv_ptr(ctx->front) == NULL) {
+		goto _ggsea_ctx_init_error_handler;
+	}
+
+	/* init two-hit and chaining filters */
+	kv_init(ctx->seed);
+	kv_init(ctx->run);
+	kv_init(ctx->diag);
+	kv_init(ctx->chain);
+	if(kv_ptr(ctx->seed) == NULL || kv_ptr(ctx->run) == NULL
+	|| kv_ptr(ctx->diag) == NULL || kv_ptr(ctx->chain) == NULL) {
+		goto _ggsea_ctx_init_error_handler;
+	}
+
 	/* init margin seq */
 	uint64_t margin_size = 2 * sizeof(uint8_t) * (MARGIN_SEQ_SIZE + 32);
 	if((ctx->margin = (uint8_t *)malloc(margin_size)) == NULL) {
@@ -358,6 +430,71 @@ _ggsea_ctx_init_error_handler:;
 	return(NULL);
 }
 
+/* per-read work limits */
+/**
+ * @fn work_get_usec
+ */
+static _force_inline
+int64_t work_get_usec(
+	void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/**
+ * @fn work_flush
+ */
+static _force_inline
+void work_flush(
+	struct ggsea_ctx_s *ctx)
+{
+	#define _lim(_x)	( ((_x) == 0) ? INT64_MAX : (_x) )
+	struct ggsea_params_s const *p = &ctx->conf.params;
+	ctx->work = (struct ggsea_work_s){
+		.seeds = _lim(p->max_seeds),
+		.fronts = _lim(p->max_fronts),
+		.cells = _lim(p->max_cells),
+		.deadline = (p->max_usec == 0) ? INT64_MAX : work_get_usec() + p->max_usec,
+		.truncated = 0
+	};
+	#undef _lim
+	return;
+}
+
+/**
+ * @fn work_test
+ * @brief nonzero if any of the fill limits is reached, the read is marked truncated.
+ * the seed limit is tested in ggsea_extend_seed, not inside the extension.
+ */
+static _force_inline
+uint32_t work_test(
+	struct ggsea_ctx_s *ctx)
+{
+	struct ggsea_work_s *w = &ctx->work;
+	if(w->truncated != 0) { return(1); }
+
+	if(w->fronts <= 0 || w->cells <= 0
+	|| (w->deadline != INT64_MAX && work_get_usec() >= w->deadline)) {
+		debug("truncated, fronts(%lld), cells(%lld)", w->fronts, w->cells);
+		w->truncated = 1;
+	}
+	return(w->truncated);
+}
+
+/**
+ * @fn work_count_fill
+ */
+static _force_inline
+gaba_fill_t const *work_count_fill(
+	struct ggsea_ctx_s *ctx,
+	gaba_fill_t const *fill)
+{
+	ctx->work.cells -= (int64_t)fill->p * DP_BAND_WIDTH;
+	return(fill);
+}
+
 /**
  * @fn ggsea_flush
  */
@@ -372,16 +509,8 @@ void ggsea_flush(
 	/* set sequence info */
 	ctx->q = query;
 
-	/* flush hashmap */
-	int64_t hcnt = hmap_get_count(ctx->rep);
-	for(int64_t i = 0; i < hcnt; i++) {
-		struct rep_seed_s *c = hmap_get_object(ctx->rep, i);
-		debug("free rv(%p), qv(%p)", kv_ptr(c->rv), kv_ptr(c->qv));
-
-		kv_destroy(c->rv);
-		kv_destroy(c->qv);
-	}
-	hmap_flush(ctx->rep);
+	/* flush repetitive kmers */
+	kv_clear(ctx->rep);
 
 	/* flush tree */
 	rbtree_flush(ctx->rtree);
@@ -389,6 +518,10 @@ void ggsea_flush(
 
 	/* flush queues */
 	kv_hq_clear(ctx->queue);
+	kv_clear(ctx->seed);
+
+	/* reset work limits */
+	work_flush(ctx);
 
 	/* flush dp context for the new read */
 	debug("rlim(%p), qlim(%p)", gref_get_lim(ctx->r), gref_get_lim(ctx->q));
@@ -404,71 +537,24 @@ void ggsea_flush(
 
 
 /* repetitive kmer filters */
-/**
- * @fn rep_dedup_pos
- */
-static _force_inline
-int64_t rep_dedup_pos(
-	struct ggsea_ctx_s *ctx,
-	struct gref_gid_pos_s *ptr,
-	int64_t size)
-{
-	/* sort */
-	psort_full((void *)ptr, size, sizeof(struct gref_gid_pos_s), 0);
-
-	/* dedup */
-	uint64_t *p = (uint64_t *)ptr;
-	int64_t cnt = 0;
-	for(int64_t i = 0; i < size; i++) {
-		if(p[cnt] == p[i]) { continue; }
-		p[++cnt] = p[i];
-	}
-	return(cnt + 1);
-}
-
 /**
  * @fn rep_save_pos
+ * @brief hold a repetitive kmer for the rescue pass (nothing is done if the pass is disabled)
  */
 static _force_inline
 void rep_save_pos(
 	struct ggsea_ctx_s *ctx,
-	uint64_t kmer,
-	struct gref_gid_pos_s rpos,
+	struct gref_match_res_s m,
 	struct gref_gid_pos_s qpos)
 {
-	/* add kmer to the hashmap */
-	uint32_t id = hmap_get_id(ctx->rep,
-		(char const *)&kmer, sizeof(uint64_t));
-	struct rep_seed_s *c = hmap_get_object(ctx->rep, id);
-
-	debug("id(%u), count(%u), diff(%d)", id, hmap_get_count(ctx->rep), id - hmap_get_count(ctx->rep) + 1);
-	if(id == (hmap_get_count(ctx->rep) - 1)) {
-		c->vec_size = ctx->conf.max_rep_vec_size;
-		if(kv_ptr(c->rv) == NULL) { kv_init(c->rv); }
-		if(kv_ptr(c->qv) == NULL) { kv_init(c->qv); }
-
-		debug("malloc rv(%p), qv(%p)", kv_ptr(c->rv), kv_ptr(c->qv));
-	}
-
-	debug("save repetitive kmer(%llx), r(%u, %u), q(%u, %u), rv(%p, %llu), qv(%p, %llu)",
-		kmer, rpos.gid, rpos.pos, qpos.gid, qpos.pos,
-		kv_ptr(c->rv), kv_size(c->rv), kv_ptr(c->qv), kv_size(c->qv));
-
-	/* add rpos */
-	kv_push(c->rv, rpos);
-	if(kv_size(c->rv) > c->vec_size) {
-		kv_size(c->rv) = rep_dedup_pos(ctx, kv_ptr(c->rv), kv_size(c->rv));
-	}
-
-	kv_push(c->qv, qpos);
-	if(kv_size(c->qv) > c->vec_size) {
-		kv_size(c->qv) = rep_dedup_pos(ctx, kv_ptr(c->qv), kv_size(c->qv));
-	}
+	if(ctx->conf.params.rep_rescue_cnt == 0) { return; }
 
-	/* expand vector if spilled */
-	if(kv_size(c->rv) > c->vec_size && kv_size(c->qv) > c->vec_size) {
-		c->vec_size *= 2;
-	}
+	debug("save repetitive kmer, cnt(%lld), q(%u, %u)", m.len, qpos.gid, qpos.pos);
+	kv_push(ctx->rep, ((struct rep_seed_s){
+		.cnt = m.len,
+		.qpos = qpos,
+		.rarr = m.gid_pos_arr
+	}));
 	return;
 }
 
@@ -499,9 +585,9 @@ gaba_fill_t const *dp_extend_leaf(
 	/* fill loop */
 	trigger_mask |= GABA_STATUS_TERM;
 	while(1) {
-		fill = gaba_dp_fill(ctx->dp, fill,
+		fill = work_count_fill(ctx, gaba_dp_fill(ctx->dp, fill,
 			(struct gaba_section_s *)rsec,
-			(struct gaba_section_s *)qsec);
+			(struct gaba_section_s *)qsec));
 		debug("status(%x), max(%lld), r(%u), q(%u)",
 			fill->status, fill->max, rsec->gid, qsec->gid);
 		max = (fill->max > max->max) ? fill : max;
@@ -562,6 +648,13 @@ gaba_fill_t const *dp_extend_update_queue(
 
 	// debug("rlen(%llu), qlen(%llu)", rlink.len, qlink.len);
 
+	/* beam pruning: drop the successors if trailing the best front too far */
+	int64_t const margin = ctx->conf.params.beam_margin;
+	if(margin != 0 && fill->max + margin < max->max) {
+		debug("pruned, max(%lld), best(%lld)", fill->max, max->max);
+		return(max);
+	}
+
 	/* push section pairs */
 	for(int64_t i = 0; i < rlink.len; i++) {
 		for(int64_t j = 0; j < qlink.len; j++) {
@@ -578,9 +671,93 @@ gaba_fill_t const *dp_extend_update_queue(
 			}));
 		}
 	}
+	ctx->work.fronts -= rlink.len * qlink.len;
 	return(max);
 }
 
+/**
+ * @fn dp_extend_merge_front
+ * @brief merge seg into a front in the buffer which enters the same section pair,
+ * returns nonzero if merged.
+ */
+static _force_inline
+int64_t dp_extend_merge_front(
+	struct ggsea_ctx_s *ctx,
+	struct dp_front_s const *seg)
+{
+	for(int64_t i = 0; i < kv_size(ctx->front); i++) {
+		struct dp_front_s *f = &kv_at(ctx->front, i);
+		if(f->rgid != seg->rgid || f->qgid != seg->qgid) { continue; }
+
+		gaba_fill_t const *fill_list[2] = { f->fill, seg->fill };
+		gaba_fill_t const *merged = gaba_dp_merge(ctx->dp, fill_list, 2);
+		if(merged != NULL) {
+			debug("merged, fill(%p, %p), merged(%p)", f->fill, seg->fill, merged);
+			f->fill = merged;
+			return(1);
+		}
+	}
+	return(0);
+}
+
+/**
+ * @fn dp_extend_prune_front
+ * @brief beam pruning: keep beam_width fronts of the largest max among the ones popped at
+ * psum (in the buffer) and the queued ones within [psum, psum + beam_window), the whole queue
+ * if beam_window is zero. branches of different lengths reach the queue at different psum,
+ * so they are bounded together here. the survivors beyond psum are returned to the queue.
+ */
+static _force_inline
+void dp_extend_prune_front(
+	struct ggsea_ctx_s *ctx,
+	int64_t psum)
+{
+	int64_t const width = ctx->conf.params.beam_width;
+	if(width == 0 || kv_size(ctx->front) + kv_hq_size(ctx->queue) <= width) { return; }
+
+	/* move the queued fronts in the window to the buffer, then rebuild the heap of the rest in place */
+	int64_t const window = ctx->conf.params.beam_window;
+	int64_t const lim = (window == 0 || psum > INT64_MAX - window) ? INT64_MAX : psum + window;
+	uint64_t const qcnt = kv_size(ctx->queue);
+	kv_hq_clear(ctx->queue);
+	for(uint64_t k = 1; k < qcnt; k++) {
+		struct dp_front_s const q = kv_at(ctx->queue, k);
+		if(q.psum < lim) {
+			kv_push(ctx->front, q);
+		} else {
+			kv_hq_push(ctx->queue, q);		/* written at or before k */
+		}
+	}
+
+	/* insertion sort in descending order of max (stable), the buffer is bounded by the beam */
+	if(kv_size(ctx->front) > width) {
+		struct dp_front_s *f = kv_ptr(ctx->front);
+		for(int64_t i = 1; i < kv_size(ctx->front); i++) {
+			struct dp_front_s t = f[i];
+			int64_t j = i;
+			for(; j > 0 && f[j - 1].fill->max < t.fill->max; j--) {
+				f[j] = f[j - 1];
+			}
+			f[j] = t;
+		}
+		debug("pruned, fronts(%llu), width(%lld)", kv_size(ctx->front), width);
+		kv_size(ctx->front) = width;
+	}
+
+	/* fill the ones at psum, return the others to the queue */
+	uint64_t n = 0;
+	for(uint64_t i = 0; i < kv_size(ctx->front); i++) {
+		struct dp_front_s const t = kv_at(ctx->front, i);
+		if(t.psum == psum) {
+			kv_at(ctx->front, n++) = t;
+		} else {
+			kv_hq_push(ctx->queue, t);
+		}
+	}
+	kv_size(ctx->front) = n;
+	return;
+}
+
 /**
  * @fn dp_extend_intl
  */
@@ -599,9 +776,9 @@ gaba_fill_t const *dp_extend_intl(
 
 	/* fill the first section */
 	gaba_fill_t const *max = NULL;
-	gaba_fill_t const *fill = max = gaba_dp_fill_root(ctx->dp,
+	gaba_fill_t const *fill = max = work_count_fill(ctx, gaba_dp_fill_root(ctx->dp,
 		(struct gaba_section_s *)rsec, rpos,
-		(struct gaba_section_s *)qsec, qpos);
+		(struct gaba_section_s *)qsec, qpos));
 
 	debug("root: status(%x), max(%lld), r(%u, %u), q(%u, %u)",
 		fill->status, fill->max, rsec->gid, rpos, qsec->gid, qpos);
@@ -614,39 +791,52 @@ gaba_fill_t const *dp_extend_intl(
 	/* update first joint */
 	max = dp_extend_update_queue(ctx, fill, max, rsec, qsec);
 
-	/* loop */
-	while(kv_hq_size(ctx->queue) > 0) {
-		struct dp_front_s seg = kv_hq_pop(ctx->queue);
-		/*debug("pop queue, fill(%p), psum(%lld), r(%u), q(%u)",
-			seg.fill, seg.psum, seg.rgid, seg.qgid);*/
-
-		if(seg.fill == NULL) {
-			debug("fill == NULL (unexpected NULL pointer detected)");
-			break;
-		}
-
+	/* loop, the max so far is returned if the work limits are reached */
+	while(kv_hq_size(ctx->queue) > 0 && work_test(ctx) == 0) {
 		/**
-		 * Lazy merge detection comes here.
-		 * tails at the head of the queue is scaned and overlapping pairs are
-		 * detected in the lazy strategy. the detected pairs will be merged
-		 * by ggsea_merge_tails function.
+		 * lazy merge: all the tails at the head of the queue (with the same p-coordinate)
+		 * are popped and the ones entering the same section pair are merged if possible.
+		 * fronts converging after a bubble are merged here, so that the number of fronts
+		 * does not grow exponentially with the number of bubbles.
 		 */
+		int64_t psum = kv_hq_n(ctx->queue, 1);
+		kv_clear(ctx->front);
+		while(kv_hq_size(ctx->queue) > 0 && kv_hq_n(ctx->queue, 1) == psum) {
+			struct dp_front_s seg = kv_hq_pop(ctx->queue);
+			/*debug("pop queue, fill(%p), psum(%lld), r(%u), q(%u)",
+				seg.fill, seg.psum, seg.rgid, seg.qgid);*/
+
+			if(seg.fill == NULL) {
+				debug("fill == NULL (unexpected NULL pointer detected)");
+				kv_hq_clear(ctx->queue);
+				break;
+			}
 
-		/* extend */
-		rsec = gref_get_section(ctx->r, seg.rgid);
-		qsec = gref_get_section(ctx->q, seg.qgid);
-		gaba_fill_t *fill = gaba_dp_fill(ctx->dp, seg.fill,
-			(struct gaba_section_s const *)rsec,
-			(struct gaba_section_s const *)qsec);
-
-		/* update max */
-		// debug("check max, max(%lld), prev_max(%lld)", fill->max, max->max);
-		max = (fill->max > max->max) ? fill : max;
-
-		/* check xdrop term */
-		if((fill->status & GABA_STATUS_TERM) == 0) {
-			max = dp_extend_update_queue(ctx, fill, max, rsec, qsec);
-			// debug("queue updated, max(%lld)", max->max);
+			if(dp_extend_merge_front(ctx, &seg) == 0) {
+				kv_push(ctx->front, seg);
+			}
+		}
+		dp_extend_prune_front(ctx, psum);
+
+		for(int64_t i = 0; i < kv_size(ctx->front); i++) {
+			struct dp_front_s seg = kv_at(ctx->front, i);
+
+			/* extend */
+			rsec = gref_get_section(ctx->r, seg.rgid);
+			qsec = gref_get_section(ctx->q, seg.qgid);
+			gaba_fill_t const *fill = work_count_fill(ctx, gaba_dp_fill(ctx->dp, seg.fill,
+				(struct gaba_section_s const *)rsec,
+				(struct gaba_section_s const *)qsec));
+
+			/* update max */
+			// debug("check max, max(%lld), prev_max(%lld)", fill->max, max->max);
+			max = (fill->max > max->max) ? fill : max;
+
+			/* check xdrop term */
+			if((fill->status & GABA_STATUS_TERM) == 0) {
+				max = dp_extend_update_queue(ctx, fill, max, rsec, qsec);
+				// debug("queue updated, max(%lld)", max->max);
+			}
 		}
 	}
 
@@ -972,7 +1162,8 @@ struct ggsea_result_s *resv_pack_result(
 		.query = ctx->q,
 		.aln = aln,
 		.cnt = dedup_cnt,
-		.reserved2 = cnt
+		.reserved2 = cnt,
+		.flags = (ctx->work.truncated != 0) ? GGSEA_TRUNCATED : 0
 	};
 	debug("result, ptr(%p), aln(%p)", res, res->aln);
 	return(res);
@@ -1408,6 +1599,21 @@ struct rtree_node_pair_s {
 	struct rtree_node_s *right;
 };
 
+/**
+ * @fn overlap_filter_init
+ * @brief node pair at the head of rtree
+ */
+static _force_inline
+struct rtree_node_pair_s overlap_filter_init(
+	struct ggsea_ctx_s *ctx)
+{
+	return((struct rtree_node_pair_s){
+		.left = NULL,
+		.right = (struct rtree_node_s *)rbtree_search_key_right(
+			ctx->rtree, INT64_MIN)
+	});
+}
+
 /**
  * @fn overlap_filter_skip_nodes
  */
@@ -1939,6 +2145,46 @@ struct rtree_node_pair_s ggsea_evaluate_alignment(
 }
 
 
+/**
+ * @fn ggsea_extend_seed
+ * @brief overlap filter, extension, and postprocess of a seed. qn is refreshed if extended.
+ */
+static _force_inline
+struct rtree_node_pair_s ggsea_extend_seed(
+	struct ggsea_ctx_s *ctx,
+	struct rtree_node_pair_s r,
+	struct qtree_node_s **qn,
+	struct gref_gid_pos_s rpos,
+	struct gref_gid_pos_s qpos)
+{
+	/* nothing is extended after the work limits are reached */
+	if(work_test(ctx) != 0) { return(r); }
+
+	/* overlap filter */
+	r = overlap_filter_skip_nodes(ctx, r, rpos, qpos);
+	if(overlap_filter_test(ctx, r, rpos)) { return(r); }
+	debug("filter passed, rpos(%u)", rpos.pos);
+
+	/* the seed limit is tested here so that the last seed is extended to the end */
+	if(ctx->work.seeds <= 0) {
+		ctx->work.truncated = 1;
+		return(r);
+	}
+	ctx->work.seeds--;
+
+	/* extend */
+	struct gaba_alignment_s const *aln = dp_extend_seed(ctx, rpos, qpos);
+	if(aln == NULL) { return(r); }
+
+	/* postprocess */
+	r = ggsea_evaluate_alignment(ctx, r, rpos, qpos, aln);
+	*qn = qtree_refresh_node(ctx, qpos);
+	debug("extend finished, rpos(%u, %u), qpos(%u, %u), rn(%p), qn(%p), score(%lld)",
+		rpos.gid, rpos.pos, qpos.gid, qpos.pos,
+		r.right, *qn, (aln != NULL) ? aln->score : 0);
+	return(r);
+}
+
 /**
  * @fn ggsea_evaluate_seeds
  */
@@ -1961,11 +2207,7 @@ struct qtree_node_s *ggsea_evaluate_seeds(
 	debug("init adjacent filter, parr(%p), ptail(%p), plen(%lld)", parr, ptail, plen);
 
 	/* iterate over rtree */
-	struct rtree_node_pair_s r = {
-		.left = NULL,
-		.right = (struct rtree_node_s *)rbtree_search_key_right(
-			ctx->rtree, INT64_MIN)
-	};
+	struct rtree_node_pair_s r = overlap_filter_init(ctx);
 	debug("init rnode, rn(%p, %lld)", r.right, (r.right != NULL) ? r.right->h.key : -1);
 	for(int64_t i = 0; i < rlen; i++) {
 		struct gref_gid_pos_s rpos = rarr[i];
@@ -1976,23 +2218,308 @@ struct qtree_node_s *ggsea_evaluate_seeds(
 		parr = adjacent_filter_skip_nodes(rpos, parr, ptail);
 		if(adjacent_filter_test(rpos, parr, ptail)) { continue; }
 
-		/* next overlap filter */
-		r = overlap_filter_skip_nodes(ctx, r, rpos, qpos);
-		if(overlap_filter_test(ctx, r, rpos)) { continue; }
-		debug("filter passed, i(%lld), rpos(%u)", i, rpos.pos);
+		/* next overlap filter, then extend */
+		r = ggsea_extend_seed(ctx, r, &qn, rpos, qpos);
+	}
+	return(qn);
+}
+
+/* two-hit filter */
+/**
+ * @fn two_hit_filter_collect
+ * @brief seeds passed the adjacent filter are held until the end of the read,
+ * the adjacent ones extend the exact run of the seed they follow
+ */
+static _force_inline
+void two_hit_filter_collect(
+	struct ggsea_ctx_s *ctx,
+	struct gref_gid_pos_s const *rarr,
+	int64_t rlen,
+	struct gref_gid_pos_s const *parr,
+	int64_t plen,
+	struct gref_gid_pos_s qpos)
+{
+	/* runs of the previous kmer at the head, those of the current one follow */
+	kv_reserve(ctx->run, plen + rlen);
+	uint32_t *run = kv_ptr(ctx->run);
 
-		/* extend */
-		struct gaba_alignment_s const *aln = dp_extend_seed(ctx, rpos, qpos);
-		if(aln == NULL) { continue; }
+	struct gref_gid_pos_s const *pbase = parr, *ptail = parr + plen;
+	for(int64_t i = 0; i < rlen; i++) {
+		parr = adjacent_filter_skip_nodes(rarr[i], parr, ptail);
+		if(adjacent_filter_test(rarr[i], parr, ptail)) {
+			run[plen + i] = run[parr - pbase];
+			kv_at(ctx->seed, run[plen + i]).len++;
+			continue;
+		}
 
-		/* postprocess */
-		r = ggsea_evaluate_alignment(ctx, r, rpos, qpos, aln);
-		qn = qtree_refresh_node(ctx, qpos);
-		debug("extend finished, rpos(%u, %u), qpos(%u, %u), rn(%p), qn(%p), score(%lld)",
-			rpos.gid, rpos.pos, qpos.gid, qpos.pos,
-			r.right, qn, (aln != NULL) ? aln->score : 0);
+		run[plen + i] = kv_size(ctx->seed);
+		kv_push(ctx->seed, ((struct ggsea_seed_s){
+			.rpos = rarr[i],
+			.qpos = qpos,
+			.hit = 0,
+			.len = ctx->conf.params.k
+		}));
 	}
-	return(qn);
+	memmove(run, run + plen, sizeof(uint32_t) * rlen);
+	return;
+}
+
+/**
+ * @fn two_hit_filter_mark
+ * @brief bucket seeds by (rgid, diagonal, qgid), mark pairs of non-overlapping seeds within the window.
+ * an exact run covering two non-overlapping kmers is a pair by itself.
+ */
+static _force_inline
+int64_t two_hit_filter_mark(
+	struct ggsea_ctx_s *ctx)
+{
+	struct ggsea_seed_s *s = kv_ptr(ctx->seed);
+	int64_t const cnt = kv_size(ctx->seed);
+
+	kv_reserve(ctx->diag, cnt);
+	struct ggsea_diag_s *d = kv_ptr(ctx->diag);
+	for(int64_t i = 0; i < cnt; i++) {
+		d[i] = (struct ggsea_diag_s){
+			.idx = i,
+			.qgid = s[i].qpos.gid,
+			.diag = s[i].rpos.pos - s[i].qpos.pos,
+			.rgid = s[i].rpos.gid
+		};
+	}
+
+	/* stable, seeds in a bucket are kept in the query order */
+	psort_partial(d, cnt, sizeof(struct ggsea_diag_s), 0, 4, sizeof(struct ggsea_diag_s));
+
+	#define _key(_d)	( ((uint64_t)(_d).rgid<<32) | (_d).diag )
+	uint64_t const k = ctx->conf.params.k;
+	uint64_t const window = ctx->conf.params.two_hit_window;
+	int64_t hit_cnt = 0;
+	for(int64_t i = 0; i < cnt && k <= window; i++) {
+		if(s[i].len < 2 * k) { continue; }
+		s[i].hit = 1; hit_cnt++;
+	}
+	for(int64_t i = 0; i < cnt; i++) {
+		for(int64_t j = i + 1; j < cnt && _key(d[j]) == _key(d[i]) && d[j].qgid == d[i].qgid; j++) {
+			uint64_t dist = s[d[j].idx].qpos.pos - s[d[i].idx].qpos.pos;
+			if(dist > window) { break; }
+			if(dist < k) { continue; }		/* overlapping */
+
+			hit_cnt += (s[d[i].idx].hit == 0) + (s[d[j].idx].hit == 0);
+			s[d[i].idx].hit = s[d[j].idx].hit = 1;
+			break;
+		}
+	}
+	#undef _key
+	debug("seeds(%lld), hit(%lld)", cnt, hit_cnt);
+	return(hit_cnt);
+}
+
+/* chaining filter */
+/**
+ * @macro CHAIN_MAX_LOOKBACK
+ * @brief number of preceding seeds (in the query order) tested as the predecessor
+ */
+#define CHAIN_MAX_LOOKBACK			( 64 )
+
+/**
+ * @fn chain_filter_decode_pos
+ * @brief start position of a kmer in its first section (pos is encoded if the kmer spans sections)
+ */
+static _force_inline
+int64_t chain_filter_decode_pos(
+	int64_t pos,
+	int64_t len,
+	int64_t ofs)
+{
+	int64_t const mask = GREF_K_MAX - 1;
+	int64_t rem = pos - len + ofs;
+	return(len - ofs + (((rem < 0) ? -1 : mask) & rem));
+}
+
+/**
+ * @fn chain_filter_calc_rdist
+ * @brief distance from the seed at (jgid, jpos) to (igid, ipos) on the reference,
+ * -1 if not reachable in the same section or through a link.
+ */
+static _force_inline
+int64_t chain_filter_calc_rdist(
+	struct ggsea_ctx_s *ctx,
+	uint32_t jgid,
+	int64_t jpos,
+	uint32_t igid,
+	int64_t ipos)
+{
+	if(jgid == igid) {
+		return((ipos > jpos) ? ipos - jpos : -1);
+	}
+
+	struct gref_link_s link = gref_get_link(ctx->r, jgid);
+	for(int64_t i = 0; i < link.len; i++) {
+		if(link.gid_arr[i] != igid) { continue; }
+		return(gref_get_section(ctx->r, jgid)->len - jpos + ipos);
+	}
+	return(-1);
+}
+
+/**
+ * @fn chain_filter_mark
+ * @brief compute co-linear chains of held seeds, mark seeds on chains scored over 1.5k
+ */
+static _force_inline
+int64_t chain_filter_mark(
+	struct ggsea_ctx_s *ctx)
+{
+	struct ggsea_seed_s *s = kv_ptr(ctx->seed);
+	int64_t const cnt = kv_size(ctx->seed);
+
+	/* decode seed positions, seeds are in the query order */
+	int64_t const k = ctx->conf.params.k;
+	kv_reserve(ctx->chain, cnt);
+	struct ggsea_chain_s *c = kv_ptr(ctx->chain);
+	for(int64_t i = 0; i < cnt; i++) {
+		c[i] = (struct ggsea_chain_s){
+			.rpos = chain_filter_decode_pos(s[i].rpos.pos,
+				gref_get_section(ctx->r, s[i].rpos.gid)->len, k - 1),
+			.qpos = chain_filter_decode_pos(s[i].qpos.pos,
+				gref_get_section(ctx->q, s[i].qpos.gid)->len, k - 1),
+			.score = s[i].len,
+			.pred = -1
+		};
+	}
+
+	/* score of a seed is the sum of bases covered by the exact runs on the chain ending at it, minus a half of the gap length */
+	int64_t const window = ctx->conf.params.chain_window;
+	for(int64_t i = 0; i < cnt; i++) {
+		for(int64_t j = i - 1; j >= MAX2(0, i - CHAIN_MAX_LOOKBACK); j--) {
+			if(s[j].qpos.gid != s[i].qpos.gid) { break; }
+			int64_t qdist = (int64_t)c[i].qpos - (int64_t)c[j].qpos;
+			if(qdist > window) { break; }
+			if(qdist <= 0) { continue; }
+
+			int64_t rdist = chain_filter_calc_rdist(ctx,
+				s[j].rpos.gid, c[j].rpos, s[i].rpos.gid, c[i].rpos);
+			if(rdist <= 0 || rdist > window) { continue; }
+
+			int64_t gap = (rdist > qdist) ? rdist - qdist : qdist - rdist;
+			int64_t ovl = MAX2(0, (int64_t)s[j].len - MIN2(qdist, rdist));
+			int64_t score = c[j].score + MAX2(0, (int64_t)s[i].len - ovl) - (gap>>1);
+			if(score > c[i].score) {
+				c[i].score = score;
+				c[i].pred = j;
+			}
+		}
+	}
+
+	/* backtrace from the tail, seeds on chains already marked are not traversed twice */
+	int64_t const thresh = k + (k>>1);
+	int64_t hit_cnt = 0;
+	for(int64_t i = cnt - 1; i >= 0; i--) {
+		if(s[i].hit != 0 || c[i].score < thresh) { continue; }
+		for(int64_t j = i; j >= 0 && s[j].hit == 0; j = c[j].pred) {
+			s[j].hit = 1; hit_cnt++;
+		}
+	}
+	debug("seeds(%lld), chained(%lld)", cnt, hit_cnt);
+	return(hit_cnt);
+}
+
+/**
+ * @fn two_hit_filter_advance_qtree
+ * @brief qtree_advance over the positions without seeds up to qpos
+ */
+static _force_inline
+struct qtree_node_s *two_hit_filter_advance_qtree(
+	struct ggsea_ctx_s *ctx,
+	struct qtree_node_s *qn,
+	struct gref_gid_pos_s qpos)
+{
+	while(qn != NULL && (uint64_t)qn->h.key < _cast_u(qpos)) {
+		if(_cast_p(qn->h.key).gid != qpos.gid) {
+			/* previous sections, rtree is already flushed */
+			qn = (struct qtree_node_s *)rbtree_right(ctx->qtree, (rbtree_node_t *)qn);
+			continue;
+		}
+		qn = qtree_advance(ctx, qn, _cast_p(qn->h.key));
+	}
+	return(qtree_advance(ctx, qn, qpos));
+}
+
+/**
+ * @fn ggsea_extend_held_seeds
+ * @brief extend held seeds of the hit flag, in the query order as ggsea_evaluate_seeds does
+ * (shared by the two-hit and chaining filters and the repetitive kmer rescue)
+ */
+static _force_inline
+void ggsea_extend_held_seeds(
+	struct ggsea_ctx_s *ctx,
+	uint32_t hit)
+{
+	struct ggsea_seed_s const *s = kv_ptr(ctx->seed);
+	int64_t const cnt = kv_size(ctx->seed);
+
+	struct qtree_node_s *qn = (struct qtree_node_s *)rbtree_search_key_right(ctx->qtree, INT64_MIN);
+	uint32_t prev_gid = (uint32_t)-1;
+	for(int64_t i = 0, j = 0; i < cnt; i = j) {
+		/* seeds at the same qpos */
+		struct gref_gid_pos_s qpos = s[i].qpos;
+		int64_t hit_cnt = 0;
+		for(j = i; j < cnt && _cast_u(s[j].qpos) == _cast_u(qpos); j++) {
+			hit_cnt += s[j].hit == hit;
+		}
+		if(hit_cnt == 0) { continue; }
+
+		if(qpos.gid != prev_gid) {
+			/* entered new section, flush rtree */
+			rbtree_flush(ctx->rtree);
+			prev_gid = qpos.gid;
+		}
+		qn = two_hit_filter_advance_qtree(ctx, qn, qpos);
+
+		struct rtree_node_pair_s r = overlap_filter_init(ctx);
+		for(int64_t k = i; k < j; k++) {
+			if(s[k].hit != hit) { continue; }
+			r = ggsea_extend_seed(ctx, r, &qn, s[k].rpos, qpos);
+		}
+	}
+	return;
+}
+
+/* repetitive kmer rescue */
+/**
+ * @fn rep_rescue
+ * @brief extend occurrences of the held repetitive kmers, the least repetitive ones first,
+ * up to rep_rescue_cnt seeds in total
+ */
+static _force_inline
+void rep_rescue(
+	struct ggsea_ctx_s *ctx)
+{
+	struct rep_seed_s *c = kv_ptr(ctx->rep);
+	int64_t const cnt = kv_size(ctx->rep);
+
+	/* stable, kmers of the same count are kept in the query order */
+	psort_partial(c, cnt, sizeof(struct rep_seed_s), 0, 0, 4);
+
+	/* sample seeds, held ones of the other filters are no longer used */
+	kv_clear(ctx->seed);
+	int64_t rem = ctx->conf.params.rep_rescue_cnt;
+	for(int64_t i = 0; i < cnt && rem > 0; i++) {
+		for(int64_t j = 0; j < c[i].cnt && rem > 0; j++, rem--) {
+			kv_push(ctx->seed, ((struct ggsea_seed_s){
+				.rpos = c[i].rarr[j],
+				.qpos = c[i].qpos,
+				.hit = 1,
+				.len = ctx->conf.params.k
+			}));
+		}
+	}
+	debug("kmers(%lld), seeds(%llu)", cnt, kv_size(ctx->seed));
+
+	/* back to the query order for the overlap filter */
+	psort_partial(kv_ptr(ctx->seed), kv_size(ctx->seed), sizeof(struct ggsea_seed_s), 0,
+		offsetof(struct ggsea_seed_s, qpos), offsetof(struct ggsea_seed_s, hit));
+	ggsea_extend_held_seeds(ctx, 1);
+	return;
 }
 
 /**
@@ -2019,43 +2546,84 @@ ggsea_result_t *ggsea_align(
 	struct gref_match_res_s const init = { .gid_pos_arr = &dec, .len = 0 };
 	struct gref_match_res_s p = init;
 
-	/* iterate seeds over query sequence */
+	/* iterate seeds over query sequence, kmers are matched in a batch of GREF_MATCH_BATCH_SIZE */
 	uint32_t prev_gid = (uint32_t)-1;
-	struct gref_kmer_tuple_s t;
-	while((t = gref_iter_next(iter)).gid_pos.gid != (uint32_t)-1) {
-		if(t.gid_pos.gid != prev_gid) {
-			/* entered new section, flush rtree */
-			rbtree_flush(ctx->rtree);
+	struct gref_kmer_tuple_s tarr[GREF_MATCH_BATCH_SIZE];
+	uint64_t karr[GREF_MATCH_BATCH_SIZE];
+	struct gref_match_res_s marr[GREF_MATCH_BATCH_SIZE];
+	int64_t cnt = 0;
+	do {
+		/* fill window */
+		for(cnt = 0; cnt < GREF_MATCH_BATCH_SIZE; cnt++) {
+			if((tarr[cnt] = gref_iter_next(iter)).gid_pos.gid == (uint32_t)-1) { break; }
+			karr[cnt] = tarr[cnt].kmer;
 		}
+		gref_match_batch(ctx->r, karr, marr, cnt);
 
-		/* fetch the next intersecting region */
-		qn = qtree_advance(ctx, qn, t.gid_pos);
+		for(int64_t i = 0; i < cnt; i++) {
+			struct gref_kmer_tuple_s t = tarr[i];
+			if(t.gid_pos.gid != prev_gid) {
+				/* entered new section, flush rtree */
+				rbtree_flush(ctx->rtree);
+			}
 
-		/* match and evaluate */
-		struct gref_match_res_s m = gref_match_2bitpacked(ctx->r, t.kmer);
+			/* fetch the next intersecting region */
+			qn = qtree_advance(ctx, qn, t.gid_pos);
 
-		debug("fetched kmer iterator ptr(%p), len(%lld)", m.gid_pos_arr, m.len);
+			/* evaluate */
+			struct gref_match_res_s m = marr[i];
 
-		/* skip if no seeds found */
-		if(m.len == 0) {
-			p = init; continue;
-		}
+			debug("fetched kmer iterator ptr(%p), len(%lld)", m.gid_pos_arr, m.len);
+
+			/* skip if no seeds found */
+			if(m.len == 0) {
+				p = init; continue;
+			}
 
-		/* skip if too many seeds found (mark repetitive) */
-		if(m.len > ctx->conf.params.kmer_cnt_thresh) {
-			rep_save_pos(ctx, t.kmer, m.gid_pos_arr[0], t.gid_pos);
-			p = init; continue;
+			/* skip if too many seeds found (mark repetitive) */
+			if(m.len > ctx->conf.params.kmer_cnt_thresh) {
+				rep_save_pos(ctx, m, t.gid_pos);
+				p = init; continue;
+			}
+
+			/* evaluate (held until the end of the read under the two-hit and chaining filters) */
+			if((ctx->conf.params.two_hit_window | ctx->conf.params.chain_window) != 0) {
+				two_hit_filter_collect(ctx,
+					m.gid_pos_arr, m.len,
+					p.gid_pos_arr, p.len,
+					t.gid_pos);
+			} else {
+				qn = ggsea_evaluate_seeds(ctx, qn, t.kmer,
+					m.gid_pos_arr, m.len,
+					p.gid_pos_arr, p.len,
+					t.gid_pos);
+			}
+
+			/* save previous seeds */
+			p = m;
+			prev_gid = t.gid_pos.gid;
+
+			/* stop on reaching the work limits */
+			if(ctx->work.truncated != 0) { break; }
 		}
+	} while(cnt == GREF_MATCH_BATCH_SIZE && ctx->work.truncated == 0);
 
-		/* evaluate */
-		qn = ggsea_evaluate_seeds(ctx, qn, t.kmer,
-			m.gid_pos_arr, m.len,
-			p.gid_pos_arr, p.len,
-			t.gid_pos);
+	/* two-hit or chaining filter: marked seeds first, the others are retried only if nothing is found */
+	if((ctx->conf.params.two_hit_window | ctx->conf.params.chain_window) != 0) {
+		if(ctx->conf.params.chain_window != 0) {
+			chain_filter_mark(ctx);
+		} else {
+			two_hit_filter_mark(ctx);
+		}
+		ggsea_extend_held_seeds(ctx, 1);
+		if(lmm_kv_size(ctx->aln) == 0) {
+			ggsea_extend_held_seeds(ctx, 0);
+		}
+	}
 
-		/* save previous seeds */
-		p = m;
-		prev_gid = t.gid_pos.gid;
+	/* repetitive kmer rescue: only if nothing is found with the unique ones */
+	if(ctx->conf.params.rep_rescue_cnt != 0 && lmm_kv_size(ctx->aln) == 0 && ctx->work.truncated == 0) {
+		rep_rescue(ctx);
 	}
 
 	/* cleanup iterator */
@@ -2063,6 +2631,180 @@ ggsea_result_t *ggsea_align(
 	return((ggsea_result_t *)resv_pack_result(ctx));
 }
 
+/**
+ * @struct ggsea_shadow_s
+ * @brief a section of a reported alignment, sorted by (aid, bid, apos) to find
+ * alignments sharing a (ref, query) section range. seeds in such region are removed
+ * by the overlap filter when both are found in the same piece.
+ */
+struct ggsea_shadow_s {
+	uint32_t idx;			/* index in the section array */
+	uint32_t apos;
+	uint32_t bid;
+	uint32_t aid;
+};
+_static_assert(sizeof(struct ggsea_shadow_s) == 16);
+
+/**
+ * @fn ggsea_mark_shadowed
+ * @brief mark alignments overlapping a better one; sections are swept in the ref order
+ * and only the ones overlapping on the ref are compared.
+ */
+static
+void ggsea_mark_shadowed(
+	lmm_t *lmm,
+	struct gaba_alignment_s const **aln,
+	struct resv_score_pos_s const *karr,
+	int64_t rep_cnt,
+	uint8_t *dup)
+{
+	int64_t sec_cnt = 0;
+	for(int64_t i = 0; i < rep_cnt; i++) {
+		sec_cnt += aln[i]->slen;
+	}
+
+	/* sections with the rank (in the score order) of the alignment */
+	struct ggsea_shadow_s *sh = (struct ggsea_shadow_s *)lmm_malloc(lmm,
+		sizeof(struct ggsea_shadow_s) * (sec_cnt + 1));
+	struct gaba_path_section_s const **sec = (struct gaba_path_section_s const **)lmm_malloc(lmm,
+		sizeof(struct gaba_path_section_s const *) * (sec_cnt + 1));
+	uint32_t *rank = (uint32_t *)lmm_malloc(lmm, sizeof(uint32_t) * (sec_cnt + 1));
+
+	int64_t k = 0;
+	for(int64_t r = 0; r < rep_cnt; r++) {
+		struct gaba_alignment_s const *a = aln[karr[r].idx];
+		for(int64_t j = 0; j < a->slen; j++, k++) {
+			sec[k] = &a->sec[j];
+			rank[k] = r;
+			sh[k] = (struct ggsea_shadow_s){
+				.idx = k,
+				.apos = a->sec[j].apos,
+				.bid = a->sec[j].bid,
+				.aid = a->sec[j].aid
+			};
+		}
+	}
+	psort_partial(sh, sec_cnt, sizeof(struct ggsea_shadow_s), 0, 4, sizeof(struct ggsea_shadow_s));
+
+	/* overlapping pairs of different alignments, (better rank, worse rank) */
+	lmm_kvec_t(uint64_t) e;
+	lmm_kv_init(lmm, e);
+	for(int64_t i = 0; i < sec_cnt; i++) {
+		struct gaba_path_section_s const *x = sec[sh[i].idx];
+		for(int64_t j = i + 1; j < sec_cnt; j++) {
+			struct gaba_path_section_s const *y = sec[sh[j].idx];
+			if(y->aid != x->aid || y->bid != x->bid || y->apos >= x->apos + x->alen) { break; }
+			if(rank[sh[i].idx] == rank[sh[j].idx]) { continue; }
+			if(x->apos < y->apos + y->alen
+			&& x->bpos < y->bpos + y->blen && y->bpos < x->bpos + x->blen) {
+				uint64_t const p = rank[sh[i].idx], q = rank[sh[j].idx];
+				lmm_kv_push(lmm, e, (p < q) ? ((p<<32) | q) : ((q<<32) | p));
+			}
+		}
+	}
+
+	/* the better one wins (the first found for ties); a shadowed one does not shadow the others */
+	psort_full(lmm_kv_ptr(e), lmm_kv_size(e), sizeof(uint64_t), 0);
+	for(int64_t i = 0; i < rep_cnt; i++) {
+		dup[i] = 0;
+	}
+	for(int64_t i = 0; i < lmm_kv_size(e); i++) {
+		uint64_t const p = lmm_kv_at(e, i)>>32, q = lmm_kv_at(e, i) & 0xffffffff;
+		dup[karr[q].idx] |= (dup[karr[p].idx] == 0);
+	}
+
+	lmm_kv_destroy(lmm, e);
+	lmm_free(lmm, rank);
+	lmm_free(lmm, sec);
+	lmm_free(lmm, sh);
+	return;
+}
+
+/**
+ * @fn ggsea_merge_results
+ */
+ggsea_result_t *ggsea_merge_results(
+	ggsea_result_t **res,
+	int64_t cnt,
+	void *_lmm)
+{
+	lmm_t *lmm = (lmm_t *)_lmm;
+	if(cnt == 0) { return(NULL); }
+
+	/* gather alignments; reported ones first, then the rest (kept to be freed) */
+	int64_t total_cnt = 0, rep_cnt = 0;
+	for(int64_t i = 0; i < cnt; i++) {
+		total_cnt += res[i]->reserved2;
+		rep_cnt += res[i]->cnt;
+	}
+
+	struct gaba_alignment_s const **aln = (struct gaba_alignment_s const **)lmm_malloc(lmm,
+		sizeof(struct gaba_alignment_s const *) * (total_cnt + 1));
+	struct resv_score_pos_s *karr = (struct resv_score_pos_s *)lmm_malloc(lmm,
+		sizeof(struct resv_score_pos_s) * (rep_cnt + 1));
+	uint8_t *dup = (uint8_t *)lmm_malloc(lmm, sizeof(uint8_t) * (rep_cnt + 1));
+
+	int64_t k = 0, l = rep_cnt;
+	for(int64_t i = 0; i < cnt; i++) {
+		for(int64_t j = 0; j < res[i]->cnt; j++) {
+			aln[k++] = res[i]->aln[j];
+		}
+		for(int64_t j = res[i]->cnt; j < res[i]->reserved2; j++) {
+			aln[l++] = res[i]->aln[j];
+		}
+	}
+
+	/* sort reported ones by score to find duplicates found in multiple pieces */
+	for(int64_t i = 0; i < rep_cnt; i++) {
+		karr[i] = (struct resv_score_pos_s){
+			.score = -aln[i]->score,		/* score in descending order */
+			.pos = i,
+			.idx = i
+		};
+	}
+	psort_full(karr, rep_cnt, 16, 0);
+	ggsea_mark_shadowed(lmm, aln, karr, rep_cnt, dup);
+
+	/* pack unique ones at the head (keeping the order), duplicates follow */
+	struct gaba_alignment_s const **tmp = (struct gaba_alignment_s const **)karr;
+	int64_t uniq_cnt = 0, dup_cnt = 0;
+	for(int64_t i = 0; i < rep_cnt; i++) {
+		if(dup[i] == 0) {
+			aln[uniq_cnt++] = aln[i];
+		} else {
+			tmp[dup_cnt++] = aln[i];
+		}
+	}
+	memcpy(&aln[uniq_cnt], tmp, sizeof(struct gaba_alignment_s const *) * dup_cnt);
+
+	/* build result object, truncated if any of the pieces is */
+	uint32_t flags = 0;
+	for(int64_t i = 0; i < cnt; i++) {
+		flags |= res[i]->flags;
+	}
+	struct ggsea_result_s *m = (struct ggsea_result_s *)lmm_malloc(lmm, sizeof(struct ggsea_result_s));
+	*m = (struct ggsea_result_s){
+		.reserved1 = (void *)lmm,
+		.ref = res[0]->ref,
+		.query = res[0]->query,
+		.aln = aln,
+		.cnt = uniq_cnt,
+		.reserved2 = total_cnt,
+		.flags = flags
+	};
+
+	/* free containers (alignments are moved to the merged one) */
+	for(int64_t i = 0; i < cnt; i++) {
+		lmm_t *rlmm = (lmm_t *)res[i]->reserved1;
+		lmm_free(rlmm, (void *)res[i]->aln);
+		lmm_free(rlmm, (void *)res[i]);
+		res[i] = NULL;
+	}
+	lmm_free(lmm, karr);
+	lmm_free(lmm, dup);
+	return((ggsea_result_t *)m);
+}
+
 /**
  * @fn ggsea_aln_free
  */
@@ -2212,6 +2954,386 @@ unittest(with_default_conf(14))
 	gref_clean(query);
 }
 
+/* seed filters and beam pruning: the same fixture with the expected counts in the table */
+struct unittest_graph_s {
+	char const *seq[8];					/* segments, named sec0, sec1, ... */
+	uint32_t link[8][2];				/* links between the segments */
+	int64_t link_cnt;
+};
+struct unittest_filter_s {
+	struct unittest_graph_s const *ref;
+	char const *query;
+	int64_t two_hit_window;
+	int64_t chain_window;
+	int64_t beam_width;
+	int64_t beam_margin;
+	int64_t score;						/* best one */
+	int64_t marked;						/* held seeds of the hit flag */
+	int64_t extended;					/* seeds extended */
+	int64_t fronts;						/* fronts pushed to the queue */
+};
+
+static struct unittest_graph_s const unittest_linear_ref = {
+	.seq = { "CTCACCTCGCTCAAAAGGGCTGCCTCCGAGCGTGTGGGCGAGGACAACCGCCCCACAGTCAAGCTCGAATGGGTGCTATTGCGTAGCTAGGACCGGCACT" }
+};
+static struct unittest_graph_s const unittest_linked_ref = {
+	.seq = {
+		"CTCACCTCGCTCAAAAGGGCTGCCTCCGAGCGTGTGGGCGAGGACAACCG",
+		"CCCCACAGTCAAGCTCGAATGGGTGCTATTGCGTAGCTAGGACCGGCACT"
+	},
+	.link = { { 0, 1 } },
+	.link_cnt = 1
+};
+static struct unittest_graph_s const unittest_paralog_ref = {
+	/* a 60-base locus followed by a copy with a mismatch at every 16 bases */
+	.seq = { "CTTAAGGGTTAAGTAAGTGTGCTAAAGACAATTACATAACATACACGTCAGCACGAAACTTGTTGGCCCAGTGTGAATCGGATGCATACGCCTTTACTTGGCTAAAGACAATTACCTAACATACACGTCAGGACGAAACTTGTTGGCGCAGTGTGAATCGCTGTGTCCACCCCATCGGAC" }
+};
+static struct unittest_graph_s const unittest_decoy_ref = {
+	/* the same locus followed by a copy sharing only a 15-base run with it */
+	.seq = { "TGGCATTTTTATTACACTCAGCTAAAGACAATTACATAACATACACGTCAGCACGAAACTTGTTGGCCCAGTGTGAATCGGAAACAGAACTCGGGTAATTGCTCAAGCCAAATACCTAACATACACGTCAGGACGCAACATGTAGGCGCAGAGTGCATCGTTGACAGGTCACGCAGAGGC" }
+};
+static struct unittest_graph_s const unittest_bubble_ref = {
+	/* two bubbles, sec1 and sec5 are on the query and linked first, the tie is kept by one front */
+	.seq = {
+		"GCTAAAGACAATTACATAACATACACGTCAGCACGAAACT",
+		"TGTTGGCCCAGTGTGAATCG",
+		"CTTAAGGGTTAAGTAAGTGT",
+		"GATGCATACGCCTTTACTTGCTGTGTCCACCCCATCGGAC",
+		"TGGCATTTTTATTACACTCA",
+		"GAAACAGAACTCGGGTAATT",
+		"TTGACAGGTCACGCAGAGGCGCGCCCTCCTGAAGTGCGTG"
+	},
+	.link = { { 0, 1 }, { 0, 2 }, { 1, 3 }, { 2, 3 }, { 3, 5 }, { 3, 4 }, { 4, 6 }, { 5, 6 } },
+	.link_cnt = 8
+};
+#define UNITTEST_BUBBLE_QUERY \
+	"ATTACATAACATACACGTCAGCACGAAACTTGTTGGCCCAGTGTGAATCGGATGCATACGCCTTTACTTGCTGTGTCCACCCCATCGGACGAAACAGAACTCGGGTAATTTTGACAGGTCACGCAGAGGCGCGCCCTCCT"
+
+unittest()
+{
+	struct unittest_filter_s const t[] = {
+		/* paired seeds on a diagonal (a mismatch in the middle) */
+		{ &unittest_linear_ref, "GGCTGCCTCCGAGCGTGTGGGCGAGGTCAACCGCCCCACAGTCAAGCTCGAA", 0, 0, 0, 0, 99, 0, 1, 0 },
+		{ &unittest_linear_ref, "GGCTGCCTCCGAGCGTGTGGGCGAGGTCAACCGCCCCACAGTCAAGCTCGAA", 64, 0, 0, 0, 99, 2, 1, 0 },
+
+		/* an exact run covering two kmers */
+		{ &unittest_linear_ref, "GGGCGAGGACAACCGCCCCACAGTCAAGCT", 0, 0, 0, 0, 60, 0, 1, 0 },
+		{ &unittest_linear_ref, "GGGCGAGGACAACCGCCCCACAGTCAAGCT", 64, 0, 0, 0, 60, 1, 1, 0 },
+
+		/* the exact locus is kept along with the paired seeds on the diverged copy */
+		{ &unittest_paralog_ref, "AGACAATTACATAACATACACGTCAGCACGAAACTTGTTGGCCCAGTGTG", 0, 0, 0, 0, 100, 0, 2, 0 },
+		{ &unittest_paralog_ref, "AGACAATTACATAACATACACGTCAGCACGAAACTTGTTGGCCCAGTGTG", 64, 0, 0, 0, 100, 3, 2, 0 },
+
+		/* seeds chained over the link (a deletion before it) */
+		{ &unittest_linked_ref, "GCTGCCTCCGAGCGTGTGGGCGAGGAAACCGCCCCACAGTCAAGCTCGAATGGGTGCTATTGCGTAGCTAG", 0, 0, 0, 0, 136, 0, 1, 1 },
+		{ &unittest_linked_ref, "GCTGCCTCCGAGCGTGTGGGCGAGGAAACCGCCCCACAGTCAAGCTCGAATGGGTGCTATTGCGTAGCTAG", 0, 256, 0, 0, 136, 3, 1, 1 },
+
+		/* a single seed over a long exact run is a chain by itself */
+		{ &unittest_linked_ref, "GGGCGAGGACAACCGCCCCACAGTCAAGCT", 0, 0, 0, 0, 60, 0, 1, 1 },
+		{ &unittest_linked_ref, "GGGCGAGGACAACCGCCCCACAGTCAAGCT", 0, 256, 0, 0, 60, 2, 1, 1 },
+
+		/* the short run off the chain is not extended */
+		{ &unittest_decoy_ref, "AGACAATTACATAACATACACGTCAGCACGAAACTTGTTGGCCCAGTGTG", 0, 0, 0, 0, 100, 0, 2, 0 },
+		{ &unittest_decoy_ref, "AGACAATTACATAACATACACGTCAGCACGAAACTTGTTGGCCCAGTGTG", 0, 256, 0, 0, 100, 1, 1, 0 },
+
+		/* both branches of each bubble are pushed unless pruned; a margin wider than the xdrop is exact */
+		{ &unittest_bubble_ref, UNITTEST_BUBBLE_QUERY, 0, 0, 0, 0, 280, 0, 1, 8 },
+		{ &unittest_bubble_ref, UNITTEST_BUBBLE_QUERY, 0, 0, 0, 1000, 280, 0, 1, 8 },
+		{ &unittest_bubble_ref, UNITTEST_BUBBLE_QUERY, 0, 0, 1, 0, 280, 0, 1, 6 },
+		{ &unittest_bubble_ref, UNITTEST_BUBBLE_QUERY, 0, 0, 0, 1, 280, 0, 1, 6 }
+	};
+	char const *name[8] = { "sec0", "sec1", "sec2", "sec3", "sec4", "sec5", "sec6", "sec7" };
+
+	for(int64_t i = 0; i < sizeof(t) / sizeof(t[0]); i++) {
+		gref_pool_t *rpool = gref_init_pool(_pool(14));
+		for(int64_t j = 0; j < 8 && t[i].ref->seq[j] != NULL; j++) {
+			gref_append_segment(rpool, _str(name[j]), _seq(t[i].ref->seq[j]));
+		}
+		for(int64_t j = 0; j < t[i].ref->link_cnt; j++) {
+			gref_append_link(rpool, _str(name[t[i].ref->link[j][0]]), 0, _str(name[t[i].ref->link[j][1]]), 0);
+		}
+		gref_idx_t *ref = gref_build_index(gref_freeze_pool(rpool));
+
+		gref_pool_t *qpool = gref_init_pool(_pool(14));
+		gref_append_segment(qpool, _str("query1"), _seq(t[i].query));
+		gref_acv_t *query = gref_freeze_pool(qpool);
+
+		ggsea_conf_t *conf = ggsea_conf_init(GGSEA_PARAMS(
+			.score_matrix = GABA_SCORE_SIMPLE(2, 3, 5, 1),
+			.xdrop = 10,
+			.k = 14,
+			.two_hit_window = t[i].two_hit_window,
+			.chain_window = t[i].chain_window,
+			.beam_width = t[i].beam_width,
+			.beam_margin = t[i].beam_margin));
+		ggsea_ctx_t *sea = ggsea_ctx_init(conf, ref);
+
+		gref_iter_t *iter = gref_iter_init(query, NULL);
+		ggsea_result_t *r = ggsea_align(sea, query, iter, NULL);
+
+		/* held seeds and the work counters are kept until the next read */
+		int64_t marked = 0;
+		for(int64_t j = 0; j < kv_size(sea->seed); j++) {
+			marked += kv_at(sea->seed, j).hit != 0;
+		}
+		int64_t extended = INT64_MAX - sea->work.seeds;
+		int64_t fronts = INT64_MAX - sea->work.fronts;
+		assert(r->cnt > 0, "i(%lld)", i);
+		assert(r->aln[0]->score == t[i].score, "i(%lld), score(%lld, %lld)", i, r->aln[0]->score, t[i].score);
+		assert(marked == t[i].marked, "i(%lld), marked(%lld, %lld)", i, marked, t[i].marked);
+		assert(extended == t[i].extended, "i(%lld), extended(%lld, %lld)", i, extended, t[i].extended);
+		assert(fronts == t[i].fronts, "i(%lld), fronts(%lld, %lld)", i, fronts, t[i].fronts);
+
+		ggsea_aln_free(r);
+		gref_iter_clean(iter);
+		ggsea_ctx_clean(sea);
+		ggsea_conf_clean(conf);
+		gref_clean(query);
+		gref_clean(ref);
+	}
+}
+
+/**
+ * beam pruning on branches of different lengths: a chain of bubbles with a base inserted on
+ * one branch, so the two reach the next bubble at different p-coordinates and are not merged.
+ * with the beam, an extension pushes at most width fronts to the two links at each of the two
+ * joints of a bubble.
+ */
+unittest()
+{
+	int64_t const bcnt = 16, len = 20;
+	char const *base = "ACGT";
+	uint64_t x = 1;
+	#define _rand_base()	( base[((x = x * 6364136223846793005ULL + 1442695040888963407ULL)>>33) & 0x03] )
+
+	/* sec0, then a, a with an insertion, and a tail for each bubble */
+	char seq[1 + 3 * bcnt][2 * len + 2], name[1 + 3 * bcnt][16];
+	char query[2 * len + 2 * len * bcnt + 1], *q = query;
+	for(int64_t i = 0; i < 1 + 3 * bcnt; i++) {
+		int64_t l = (i == 0) ? 2 * len : len;
+		for(int64_t j = 0; j < l; j++) { seq[i][j] = _rand_base(); }
+		seq[i][l] = '\0';
+		sprintf(name[i], "sec%lld", (long long)i);
+	}
+	for(int64_t i = 0; i < bcnt; i++) {
+		char *b = seq[2 + 3 * i];
+		memcpy(b, seq[1 + 3 * i], len);
+		memmove(&b[len / 2 + 1], &b[len / 2], len / 2);
+		b[len / 2] = (b[len / 2 + 1] == 'A') ? 'C' : 'A';
+		b[len + 1] = '\0';
+	}
+	q += sprintf(q, "%s", seq[0]);
+	for(int64_t i = 0; i < bcnt; i++) {
+		q += sprintf(q, "%s%s", seq[1 + 3 * i], seq[3 + 3 * i]);
+	}
+	#undef _rand_base
+
+	gref_pool_t *rpool = gref_init_pool(_pool(14));
+	for(int64_t i = 0; i < 1 + 3 * bcnt; i++) {
+		gref_append_segment(rpool, _str(name[i]), _seq(seq[i]));
+	}
+	for(int64_t i = 0; i < bcnt; i++) {
+		int64_t const h = 3 * i;		/* the tail of the previous bubble (sec0 for the first) */
+		gref_append_link(rpool, _str(name[h]), 0, _str(name[h + 1]), 0);
+		gref_append_link(rpool, _str(name[h]), 0, _str(name[h + 2]), 0);
+		gref_append_link(rpool, _str(name[h + 1]), 0, _str(name[h + 3]), 0);
+		gref_append_link(rpool, _str(name[h + 2]), 0, _str(name[h + 3]), 0);
+	}
+	gref_idx_t *ref = gref_build_index(gref_freeze_pool(rpool));
+
+	gref_pool_t *qpool = gref_init_pool(_pool(14));
+	gref_append_segment(qpool, _str("query1"), _seq(query));
+	gref_acv_t *query_acv = gref_freeze_pool(qpool);
+
+	struct { int64_t width, window, fronts, bounded; } const t[] = {
+		{ 0, 0,  5556, 0 },		/* exact */
+		{ 2, 1,  4646, 0 },		/* fronts at the same p-coordinate only */
+		{ 2, 0,  596,  1 },		/* the whole queue */
+		{ 2, 64, 596,  1 },		/* wider than the inserted base */
+		{ 4, 0,  1076, 1 }
+	};
+	for(int64_t i = 0; i < sizeof(t) / sizeof(t[0]); i++) {
+		ggsea_conf_t *conf = ggsea_conf_init(GGSEA_PARAMS(
+			.score_matrix = GABA_SCORE_SIMPLE(2, 3, 5, 1),
+			.xdrop = 60,
+			.k = 14,
+			.beam_width = t[i].width,
+			.beam_window = t[i].window));
+		ggsea_ctx_t *sea = ggsea_ctx_init(conf, ref);
+
+		gref_iter_t *iter = gref_iter_init(query_acv, NULL);
+		ggsea_result_t *r = ggsea_align(sea, query_acv, iter, NULL);
+		int64_t const fronts = INT64_MAX - sea->work.fronts, extended = INT64_MAX - sea->work.seeds;
+		int64_t const bound = 2 * 2 * MAX2(t[i].width, 1) * bcnt * extended;
+		assert(r->cnt > 0, "i(%lld)", i);
+		assert(r->aln[0]->score == 2 * (int64_t)strlen(query), "i(%lld), score(%lld)", i, r->aln[0]->score);
+		assert(fronts == t[i].fronts, "i(%lld), fronts(%lld, %lld)", i, fronts, t[i].fronts);
+		assert((fronts <= bound) == t[i].bounded, "i(%lld), fronts(%lld), bound(%lld)", i, fronts, bound);
+
+		ggsea_aln_free(r);
+		gref_iter_clean(iter);
+		ggsea_ctx_clean(sea);
+		ggsea_conf_clean(conf);
+	}
+	gref_clean(query_acv);
+	gref_clean(ref);
+}
+
+/* repetitive kmer rescue */
+unittest()
+{
+	/* build reference index object, a segment duplicated */
+	char const *dup = "GGCTGCCTCCGAGCGTGTGGGCGAGGACAACCGCCCCACAGTCAAGCTCGAA";
+	gref_pool_t *rpool = gref_init_pool(_pool(14));
+	gref_append_segment(rpool, _str("ref1"), _seq(dup));
+	gref_append_segment(rpool, _str("ref2"), _seq(dup));
+	gref_idx_t *ref = gref_build_index(gref_freeze_pool(rpool));
+
+	gref_pool_t *qpool = gref_init_pool(_pool(14));
+	gref_append_segment(qpool, _str("query1"), _seq("GGCTGCCTCCGAGCGTGTGGGCGAGGACAACCG"));
+	gref_acv_t *query = gref_freeze_pool(qpool);
+
+	/* all kmers are repetitive, found only with the rescue pass */
+	for(int64_t j = 0; j < 2; j++) {
+		ggsea_conf_t *conf = ggsea_conf_init(GGSEA_PARAMS(
+			.score_matrix = GABA_SCORE_SIMPLE(2, 3, 5, 1),
+			.xdrop = 10,
+			.k = 14,
+			.kmer_cnt_thresh = 1,
+			.rep_rescue_cnt = (j == 0) ? 0 : 16));
+		ggsea_ctx_t *sea = ggsea_ctx_init(conf, ref);
+
+		gref_iter_t *iter = gref_iter_init(query, NULL);
+		ggsea_result_t *r = ggsea_align(sea, query, iter, NULL);
+		assert((r->cnt > 0) == (j == 1), "j(%lld), cnt(%u)", j, r->cnt);
+
+		ggsea_aln_free(r);
+		gref_iter_clean(iter);
+		ggsea_ctx_clean(sea);
+		ggsea_conf_clean(conf);
+	}
+	gref_clean(query);
+	gref_clean(ref);
+}
+
+/* per-read work limits */
+unittest()
+{
+	gref_pool_t *rpool = gref_init_pool(_pool(14));
+	gref_append_segment(rpool, _str("ref1"),
+		_seq("CTCACCTCGCTCAAAAGGGCTGCCTCCGAGCGTGTGGGCGAGGACAACCGCCCCACAGTCAAGCTCGAATGGGTGCTATTGCGTAGCTAGGACCGGCACT"));
+	gref_append_segment(rpool, _str("ref2"), _seq("TTGACAGGTCACGCAGAGGCGCGCCCTCCTGAAGTGCGTG"));
+	gref_idx_t *ref = gref_build_index(gref_freeze_pool(rpool));
+
+	/* one locus with a mismatch, and two loci on different segments */
+	char const *q[2] = {
+		"GGCTGCCTCCGAGCGTGTGGGCGAGGTCAACCGCCCCACAGTCAAGCTCGAA",
+		"CTCACCTCGCTCAAAAGGGCTGCCTCCGAGCGTGTTTGACAGGTCACGCAGAGGCGCGCCCTCCTGAAG"
+	};
+
+	/* unlimited, one seed, and one cell; the first row of each query is unlimited */
+	struct { int64_t q, seeds, cells; uint32_t flags; } const t[5] = {
+		{ 0, 0, 0, 0 },
+		{ 0, 1, 0, 0 },					/* exactly one seed is extended to the end */
+		{ 0, 0, 1, GGSEA_TRUNCATED },
+		{ 1, 0, 0, 0 },
+		{ 1, 1, 0, GGSEA_TRUNCATED }	/* the second locus is not extended */
+	};
+	int64_t score[5] = { 0 }, cnt[5] = { 0 };
+	for(int64_t j = 0; j < 5; j++) {
+		gref_pool_t *qpool = gref_init_pool(_pool(14));
+		gref_append_segment(qpool, _str("query1"), _seq(q[t[j].q]));
+		gref_acv_t *query = gref_freeze_pool(qpool);
+
+		ggsea_conf_t *conf = ggsea_conf_init(GGSEA_PARAMS(
+			.score_matrix = GABA_SCORE_SIMPLE(2, 3, 5, 1),
+			.xdrop = 10,
+			.k = 14,
+			.max_seeds = t[j].seeds,
+			.max_cells = t[j].cells));
+		ggsea_ctx_t *sea = ggsea_ctx_init(conf, ref);
+
+		gref_iter_t *iter = gref_iter_init(query, NULL);
+		ggsea_result_t *r = ggsea_align(sea, query, iter, NULL);
+		assert(r->flags == t[j].flags, "j(%lld), flags(%x)", j, r->flags);
+
+		/* the alignment found so far is reported, the root fill is not interrupted */
+		assert(r->cnt > 0, "j(%lld)", j);
+		cnt[j] = r->cnt;
+		score[j] = r->aln[0]->score;
+
+		/* compared to the unlimited row of the same query */
+		int64_t u = (t[j].q == 0) ? 0 : 3;
+		if(t[j].flags == 0) {
+			assert(score[j] == score[u], "j(%lld), %lld, %lld", j, score[j], score[u]);
+			assert(cnt[j] == cnt[u], "j(%lld), %lld, %lld", j, cnt[j], cnt[u]);
+		} else {
+			assert(score[j] <= score[u], "j(%lld), %lld, %lld", j, score[j], score[u]);
+			assert(cnt[j] <= cnt[u], "j(%lld), %lld, %lld", j, cnt[j], cnt[u]);
+		}
+
+		ggsea_aln_free(r);
+		gref_iter_clean(iter);
+		ggsea_ctx_clean(sea);
+		ggsea_conf_clean(conf);
+		gref_clean(query);
+	}
+	assert(cnt[3] == 2, "%lld", cnt[3]);
+	assert(cnt[4] == 1, "%lld", cnt[4]);
+	gref_clean(ref);
+}
+
+/* merge: an alignment overlapping a better one on both the ref and the query is removed */
+unittest()
+{
+	struct merge_aln_s {
+		int64_t score;
+		uint32_t piece, aid, apos, bpos;
+		int64_t dup;
+	} const t[] = {
+		{ 10, 0, 2, 100, 0,   0 },		/* best */
+		{ 8,  1, 2, 140, 40,  1 },		/* overlaps the best */
+		{ 9,  1, 4, 100, 0,   0 },		/* another ref section */
+		{ 7,  2, 2, 170, 70,  0 },		/* overlaps only the removed one */
+		{ 6,  2, 2, 100, 500, 0 },		/* another query range */
+		{ 10, 2, 2, 120, 20,  1 }		/* tie, the first one wins */
+	};
+	int64_t const n = sizeof(t) / sizeof(t[0]), pieces = 3;
+
+	struct gaba_path_section_s sec[n];
+	struct gaba_alignment_s aln[n];
+	ggsea_result_t *res[pieces];
+	for(int64_t p = 0; p < pieces; p++) {
+		struct gaba_alignment_s const **a = (struct gaba_alignment_s const **)malloc(sizeof(struct gaba_alignment_s const *) * n);
+		uint32_t cnt = 0;
+		for(int64_t i = 0; i < n; i++) {
+			if(t[i].piece != p) { continue; }
+			sec[i] = (struct gaba_path_section_s){
+				.aid = t[i].aid, .bid = 0, .apos = t[i].apos, .bpos = t[i].bpos, .alen = 50, .blen = 50
+			};
+			aln[i] = (struct gaba_alignment_s){ .score = t[i].score, .slen = 1, .sec = &sec[i] };
+			a[cnt++] = &aln[i];
+		}
+		res[p] = (ggsea_result_t *)malloc(sizeof(ggsea_result_t));
+		*res[p] = (ggsea_result_t){ .aln = a, .cnt = cnt, .reserved2 = cnt };
+	}
+
+	ggsea_result_t *m = ggsea_merge_results(res, pieces, NULL);
+	assert(m != NULL);
+	assert(m->cnt == 4, "%u", m->cnt);
+	assert(m->reserved2 == n, "%u", m->reserved2);
+
+	/* unique ones in the input order, then the removed ones */
+	int64_t u = 0, d = m->cnt, ordered = 1;
+	for(int64_t i = 0; i < n; i++) {
+		ordered &= m->aln[t[i].dup ? d++ : u++] == &aln[i];
+	}
+	assert(ordered);
+
+	free((void *)m->aln);
+	free(m);
+}
+
 /**
  * end of ggsea.c
  */
@@ -40,6 +40,7 @@ struct ggsea_params_s {
 	/* repetitive kmer filter */
 	int64_t k;
 	int64_t kmer_cnt_thresh;		/* kmer count threshold */
+	int64_t rep_rescue_cnt;			/* max seeds of repetitive kmers extended for reads without alignment (skipped if zero) */
 
 	/* overlap filter thresh */
 	int64_t overlap_thresh;			/* depth */
@@ -49,6 +50,26 @@ struct ggsea_params_s {
 
 	/* score thresh */
 	int64_t score_thresh;
+
+	/* two-hit filter window, extends only diagonals with two seeds within it (disabled if zero) */
+	int64_t two_hit_window;
+
+	/* chaining filter window, extends only seeds on co-linear chains with gaps up to it (disabled if zero) */
+	int64_t chain_window;
+
+	/* initial size of the DP stack of each context (gaba default if zero) */
+	uint64_t stack_size;
+
+	/* beam pruning of graph extension (exact if zero) */
+	int64_t beam_width;				/* max live fronts in the p-coordinate window at the head of the queue */
+	int64_t beam_window;			/* p-coordinate range the width applies to (the whole queue if zero) */
+	int64_t beam_margin;			/* fronts whose max trails the best one by more than it are dropped */
+
+	/* per-read work limits, alignment of the read is truncated on reaching any of them (unlimited if zero) */
+	int64_t max_seeds;				/* seeds extended */
+	int64_t max_fronts;				/* fronts pushed to the DP queue */
+	int64_t max_cells;				/* DP cells filled */
+	int64_t max_usec;				/* wall time in microseconds */
 };
 typedef struct ggsea_params_s ggsea_params_t;
 
@@ -58,6 +79,13 @@ typedef struct ggsea_params_s ggsea_params_t;
  */
 #define GGSEA_PARAMS(...)			( &((struct ggsea_params_s const) { __VA_ARGS__ }) )
 
+/**
+ * @enum ggsea_result_flags
+ */
+enum ggsea_result_flags {
+	GGSEA_TRUNCATED = 0x01		/* a per-read work limit was reached, aln holds the ones found so far */
+};
+
 /**
  * @struct ggsea_result_s
  */
@@ -68,6 +96,8 @@ struct ggsea_result_s {
 	struct gaba_alignment_s const *const *aln;
 	uint32_t cnt;
 	uint32_t reserved2;
+	uint32_t flags;				/* ggsea_result_flags */
+	uint32_t pad;
 };
 typedef struct ggsea_result_s ggsea_result_t;
 
@@ -113,6 +143,16 @@ ggsea_result_t *ggsea_align(
 	gref_iter_t *iter,
 	void *lmm);
 
+/**
+ * @fn ggsea_merge_results
+ * @brief merge results of the pieces of a split query into one, removing alignments
+ * found in more than one piece. partial results are consumed.
+ */
+ggsea_result_t *ggsea_merge_results(
+	ggsea_result_t **res,
+	int64_t cnt,
+	void *lmm);
+
 /**
  * @fn ggsea_aln_free
  */
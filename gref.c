@@ -17,8 +17,13 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "hmap.h"
 #include "psort.h"
+#include "ptask.h"
 #include "zf.h"
 #include "arch/arch.h"
 // #include "kvec.h"
@@ -39,10 +44,16 @@ _static_assert(K_MIN == GREF_K_MIN);
 _static_assert(K_MAX_BASE == GREF_K_MAX_BASE);
 _static_assert(K_MAX == GREF_K_MAX);
 
+/* ranges shorter than this are not split into threads on freeze and melt */
+#define GREF_FREEZE_MIN_LEN			( 256 * 1024 )
+
 
 /* inline directive */
 #define _force_inline				inline
 
+/* prefetch */
+#define _prefetch(_p)				__builtin_prefetch((void const *)(_p))
+
 /* roundup */
 #define _roundup(x, base)			( (((x) + (base) - 1) / (base)) * (base) )
 
@@ -122,6 +133,17 @@ struct gref_section_half_s {
 };
 _static_assert(sizeof(struct gref_section_half_s) == 32);
 
+/**
+ * @struct gref_kmer_bucket_s
+ * @brief hashed kmer index (GREF_KMER_IDX_HASH), idx points to the compacted kmer_idx_table
+ */
+struct gref_kmer_bucket_s {
+	uint64_t kmer;
+	int64_t idx;					/* -1 if empty */
+};
+_static_assert(sizeof(struct gref_kmer_bucket_s) == 16);
+#define _kmer_hash(_kmer)			( ((_kmer) * 0x9e3779b97f4a7c15ULL)>>17 )
+
 /**
  * @enum gref_type
  * @breif gref->type
@@ -172,6 +194,15 @@ struct gref_s {
 	int64_t kmer_table_size;
 	struct gref_gid_pos_s *kmer_table;
 
+	/* hashed kmer index (kmer_idx_table is compacted to the distinct kmers if non-NULL) */
+	struct gref_kmer_bucket_s *kmer_hash_table;
+	uint64_t kmer_hash_mask;
+	int64_t kmer_idx_table_size;
+
+	/* mapped index (arrays above point into the mapping if map_base != NULL) */
+	void *map_base;
+	uint64_t map_size;
+
 	/* sequence encoder */
 	struct gref_seq_interval_s (*append_seq)(
 		struct gref_s *gref,
@@ -307,6 +338,20 @@ struct gref_seq_interval_s gref_nocopy_seq_4bit(
 }
 
 /* init / destroy pool */
+/**
+ * @fn gref_calc_iter_init_stack_size
+ */
+static _force_inline
+int64_t gref_calc_iter_init_stack_size(
+	int64_t k)
+{
+	int64_t buf_size = 1;
+	for(int64_t i = 0; i < (k + 1) / 2; i++) {
+		buf_size *= 3;
+	}
+	return(MAX2(1024, buf_size));
+}
+
 /**
  * @fn gref_init_pool
  */
@@ -335,6 +380,8 @@ gref_pool_t *gref_init_pool(
 	if(p.k < K_MIN || p.k > K_MAX) { return(NULL); }
 	if((uint8_t)p.seq_format > GREF_4BIT) { return(NULL); }
 	if((uint8_t)p.copy_mode > GREF_NOCOPY) { return(NULL); }
+	if((uint8_t)p.kmer_idx_mode > GREF_KMER_IDX_HASH) { return(NULL); }
+	if((uint8_t)p.kmer_build_mode > GREF_KMER_BUILD_COUNT) { return(NULL); }
 	p.seq_head_margin = _roundup(p.seq_head_margin, 16);
 	p.seq_tail_margin = _roundup(p.seq_tail_margin, 16);
 
@@ -364,11 +411,7 @@ gref_pool_t *gref_init_pool(
 	pool->type = GREF_POOL;
 
 	/* calc iterator buffer size */
-	int64_t buf_size = 1;
-	for(int64_t i = 0; i < (p.k + 1) / 2; i++) {
-		buf_size *= 3;
-	}
-	pool->iter_init_stack_size = MAX2(1024, buf_size);
+	pool->iter_init_stack_size = gref_calc_iter_init_stack_size(p.k);
 
 	/* init seq vector */
 	if(p.copy_mode != GREF_NOCOPY) {
@@ -430,12 +473,21 @@ void gref_clean(
 {
 	struct gref_s *gref = (struct gref_s *)_gref;
 
+	if(gref != NULL && gref->map_base != NULL) {
+		/* arrays are not owned by the object */
+		hmap_clean(gref->hmap); gref->hmap = NULL;
+		munmap(gref->map_base, gref->map_size); gref->map_base = NULL;
+		lmm_free(gref->lmm, gref);
+		return;
+	}
+
 	if(gref != NULL) {
 		/* cleanup, cleanup... */
 		hmap_clean(gref->hmap); gref->hmap = NULL;
 		lmm_kv_destroy(gref->lmm, gref->seq);
 		lmm_kv_destroy(gref->lmm, gref->link);
 		lmm_free(gref->lmm, gref->kmer_idx_table); gref->kmer_idx_table = NULL;
+		lmm_free(gref->lmm, gref->kmer_hash_table); gref->kmer_hash_table = NULL;
 		lmm_free(gref->lmm, gref->kmer_table); gref->kmer_table = NULL;
 		lmm_free(gref->lmm, gref);
 	}
@@ -445,22 +497,37 @@ void gref_clean(
 
 /* pool modify operation */
 /**
- * @fn gref_append_segment
+ * @fn gref_get_name_id
  */
-int gref_append_segment(
+uint32_t gref_get_name_id(
 	gref_pool_t *_pool,
 	char const *name,
-	int32_t name_len,
+	int32_t name_len)
+{
+	struct gref_s *pool = (struct gref_s *)_pool;
+
+	/* gref object is mutable only when type == POOL */
+	if(pool == NULL || pool->type != GREF_POOL) { return((uint32_t)-1); }
+	uint32_t id = hmap_get_id(pool->hmap, name, name_len);
+
+	/* update sec_cnt */
+	pool->sec_cnt = MAX2(pool->sec_cnt, id + 1);
+	return(id);
+}
+
+/**
+ * @fn gref_append_segment_id
+ */
+int gref_append_segment_id(
+	gref_pool_t *_pool,
+	uint32_t id,
 	uint8_t const *seq,
 	int64_t seq_len)
 {
 	struct gref_s *pool = (struct gref_s *)_pool;
-	// debug("append segment");
 
 	/* gref object is mutable only when type == POOL */
-	if(pool == NULL || pool->type != GREF_POOL) { return(-1); }
-
-	debug("append segment, name(%s, %u), cnt(%u)", name, name_len, hmap_get_count(pool->hmap));
+	if(pool == NULL || pool->type != GREF_POOL || id >= hmap_get_count(pool->hmap)) { return(-1); }
 
 	/* add sequence at the tail of the seq buffer */
 	struct gref_seq_interval_s iv = pool->append_seq(pool, seq, seq_len);
@@ -472,13 +539,9 @@ int gref_append_segment(
 	uint64_t const max_sec_len = 0x80000000;
 	uint64_t len = MIN2(iv.tail - iv.base, max_sec_len);
 
-	uint32_t id = hmap_get_id(pool->hmap, name, name_len);
 	struct gref_section_intl_s *sec =
 		(struct gref_section_intl_s *)hmap_get_object(pool->hmap, id);
 
-	/* update sec_cnt */
-	pool->sec_cnt = MAX2(pool->sec_cnt, id + 1);
-
 	/* store section info */
 	sec->base_gid = _encode_id(id, 0);
 	sec->fw_link_idx_base = 0;
@@ -497,27 +560,40 @@ int gref_append_segment(
 }
 
 /**
- * @fn gref_append_link
+ * @fn gref_append_segment
  */
-int gref_append_link(
+int gref_append_segment(
 	gref_pool_t *_pool,
-	char const *src,
-	int32_t src_len,
+	char const *name,
+	int32_t name_len,
+	uint8_t const *seq,
+	int64_t seq_len)
+{
+	struct gref_s *pool = (struct gref_s *)_pool;
+	// debug("append segment");
+
+	/* gref object is mutable only when type == POOL */
+	if(pool == NULL || pool->type != GREF_POOL) { return(-1); }
+
+	debug("append segment, name(%s, %u), cnt(%u)", name, name_len, hmap_get_count(pool->hmap));
+	return(gref_append_segment_id(_pool, gref_get_name_id(_pool, name, name_len), seq, seq_len));
+}
+
+/**
+ * @fn gref_append_link_id
+ */
+int gref_append_link_id(
+	gref_pool_t *_pool,
+	uint32_t src_id,
 	int32_t src_ori,
-	char const *dst,
-	int32_t dst_len,
+	uint32_t dst_id,
 	int32_t dst_ori)
 {
 	struct gref_s *pool = (struct gref_s *)_pool;
-	debug("append link, src(%s, %u), dst(%s, %u), cnt(%u)", src, src_len, dst, dst_len, hmap_get_count(pool->hmap));
 
 	/* gref object is mutable only when type == POOL */
 	if(pool == NULL || pool->type != GREF_POOL) { return(-1); }
 
-	/* get ids */
-	uint32_t src_id = hmap_get_id(pool->hmap, src, src_len);
-	uint32_t dst_id = hmap_get_id(pool->hmap, dst, dst_len);
-
 	/* add forward link */
 	lmm_kv_push(pool->lmm, pool->link, ((struct gref_gid_pair_s){
 		.from = _encode_id(src_id, src_ori),
@@ -529,13 +605,34 @@ int gref_append_link(
 		.from = _encode_id(dst_id, _rev(dst_ori)),
 		.to = _encode_id(src_id, _rev(src_ori))
 	}));
-
-	/* update tail_id */
-	pool->sec_cnt = MAX3(pool->sec_cnt, src_id + 1, dst_id + 1);
 	debug("sec_cnt(%u), src_id(%u), dst_id(%u)", pool->sec_cnt, src_id, dst_id);
 	return(0);
 }
 
+/**
+ * @fn gref_append_link
+ */
+int gref_append_link(
+	gref_pool_t *_pool,
+	char const *src,
+	int32_t src_len,
+	int32_t src_ori,
+	char const *dst,
+	int32_t dst_len,
+	int32_t dst_ori)
+{
+	struct gref_s *pool = (struct gref_s *)_pool;
+	debug("append link, src(%s, %u), dst(%s, %u), cnt(%u)", src, src_len, dst, dst_len, hmap_get_count(pool->hmap));
+
+	/* gref object is mutable only when type == POOL */
+	if(pool == NULL || pool->type != GREF_POOL) { return(-1); }
+
+	/* get ids */
+	uint32_t src_id = gref_get_name_id(_pool, src, src_len);
+	uint32_t dst_id = gref_get_name_id(_pool, dst, dst_len);
+	return(gref_append_link_id(_pool, src_id, src_ori, dst_id, dst_ori));
+}
+
 /**
  * @fn gref_append_snp
  */
@@ -598,7 +695,7 @@ void gref_add_tail_section(
 	struct gref_s *pool)
 {
 	uint32_t tail_id = pool->sec_cnt;
-	if(hmap_get_count(pool->hmap) >= tail_id) {
+	if(hmap_get_count(pool->hmap) > tail_id) {
 		/* sentinel already exists */
 		return;
 	}
@@ -642,36 +739,97 @@ void gref_add_tail_section(
 }
 
 /**
- * @fn gref_build_link_idx_table
- * @brief build link_idx table. gref_add_tail_section must be called beforehand.
+ * @struct gref_freeze_part_s
+ * @brief a range of a freeze (or melt) stage, processed on a thread
+ */
+struct gref_freeze_part_s {
+	struct gref_s *pool;
+	void (*stage)(struct gref_s *pool, uint64_t from, uint64_t to);
+	uint64_t from, to;
+};
+
+/**
+ * @fn gref_freeze_dispatcher
+ */
+static
+void *gref_freeze_dispatcher(
+	void *arg,
+	void *item)
+{
+	struct gref_freeze_part_s *p = (struct gref_freeze_part_s *)item;
+	p->stage(p->pool, p->from, p->to);
+	return(NULL);
+}
+
+/**
+ * @fn gref_freeze_init_ptask
+ * @brief threads for freeze and melt, NULL in the single thread mode
  */
 static _force_inline
-int gref_build_link_idx_table(
+ptask_t *gref_freeze_init_ptask(
 	struct gref_s *pool)
 {
-	int64_t link_idx_table_size = 2 * pool->sec_cnt;
-	int64_t link_table_size = lmm_kv_size(pool->link);
-
-	/* store link table size */
-	pool->link_table_size = link_table_size;
+	/* lmm is not thread-safe but the stages do not allocate */
+	if(pool->params.num_threads <= 1) {
+		return(NULL);
+	}
+	return(ptask_init(gref_freeze_dispatcher, NULL, pool->params.num_threads, 1));
+}
 
-	/* sort by src, build src->dst mapping */
-	debug("sort src->dst mapping, size(%llu)", lmm_kv_size(pool->link));
-	if(psort_half(lmm_kv_ptr(pool->link), lmm_kv_size(pool->link),
-		sizeof(struct gref_gid_pair_s), pool->params.num_threads) != 0) {
+/**
+ * @fn gref_freeze_for
+ * @brief apply stage to [from, to), split into num_threads ranges of the same length
+ */
+static _force_inline
+void gref_freeze_for(
+	struct gref_s *pool,
+	ptask_t *pt,
+	void (*stage)(struct gref_s *pool, uint64_t from, uint64_t to),
+	uint64_t from,
+	uint64_t to)
+{
+	int64_t const num_threads = pool->params.num_threads;
+	if(pt == NULL || to - from < GREF_FREEZE_MIN_LEN) {
+		stage(pool, from, to);
+		return;
+	}
 
-		/* sort failed */
-		return(-1);
+	struct gref_freeze_part_s part[num_threads];
+	void *items[num_threads];
+	for(int64_t i = 0; i < num_threads; i++) {
+		part[i] = (struct gref_freeze_part_s){
+			.pool = pool,
+			.stage = stage,
+			.from = from + (to - from) * i / num_threads,
+			.to = from + (to - from) * (i + 1) / num_threads
+		};
+		items[i] = (void *)&part[i];
 	}
+	ptask_parallel(pt, items, NULL);
+	return;
+}
 
-	/* init index */
-	uint32_t prev_gid = 0;
+/**
+ * @fn gref_link_idx_stage
+ * @brief fill link_idx_base of the sections whose links begin in [from, to). each section
+ * is filled by exactly one index (the first link whose src is the section or beyond).
+ */
+static
+void gref_link_idx_stage(
+	struct gref_s *pool,
+	uint64_t from,
+	uint64_t to)
+{
+	int64_t link_idx_table_size = 2 * pool->sec_cnt;
+	int64_t link_table_size = pool->link_table_size;
 	struct gref_section_half_s *sec_half =
 		(struct gref_section_half_s *)hmap_get_object(pool->hmap, 0);
 
-	/* store link index */
-	sec_half[prev_gid].link_idx_base = 0;		/* head is always zero */
-	for(int64_t i = 0; i < link_table_size; i++) {
+	/* head is always zero */
+	if(from == 0) { sec_half[0].link_idx_base = 0; }
+
+	uint32_t prev_gid = (from == 0) ? 0 : lmm_kv_at(pool->link, from - 1).from;
+	for(int64_t i = from; i < to; i++) {
 		uint32_t gid = lmm_kv_at(pool->link, i).from;
 		debug("i(%lld), gid(%u), prev_gid(%u)", i, gid, prev_gid);
 
@@ -688,20 +846,72 @@ int gref_build_link_idx_table(
 	}
 
 	/* store tail */
-	for(int64_t j = prev_gid + 1; j < link_idx_table_size + 1; j++) {
-		// debug("fill gaps j(%lld)", j);
-		sec_half[j].link_idx_base = link_table_size;
+	if(to == link_table_size) {
+		for(int64_t j = prev_gid + 1; j < link_idx_table_size + 1; j++) {
+			// debug("fill gaps j(%lld)", j);
+			sec_half[j].link_idx_base = link_table_size;
+		}
+	}
+	return;
+}
+
+/**
+ * @fn gref_build_link_idx_table
+ * @brief build link_idx table. gref_add_tail_section must be called beforehand.
+ */
+static _force_inline
+int gref_build_link_idx_table(
+	struct gref_s *pool,
+	ptask_t *pt)
+{
+	int64_t link_table_size = lmm_kv_size(pool->link);
+
+	/* store link table size */
+	pool->link_table_size = link_table_size;
+
+	/* sort by src, build src->dst mapping */
+	debug("sort src->dst mapping, size(%llu)", lmm_kv_size(pool->link));
+	if(psort_half(lmm_kv_ptr(pool->link), lmm_kv_size(pool->link),
+		sizeof(struct gref_gid_pair_s), pool->params.num_threads) != 0) {
+
+		/* sort failed */
+		return(-1);
 	}
+
+	/* store link index */
+	gref_freeze_for(pool, pt, gref_link_idx_stage, 0, link_table_size);
 	return(0);
 }
 
+/**
+ * @fn gref_revcomp_stage
+ * @brief append reverse complement of the forward sequence, [from, to) of the reverse one
+ */
+static
+void gref_revcomp_stage(
+	struct gref_s *pool,
+	uint64_t from,
+	uint64_t to)
+{
+	static uint8_t const comp[16] = {
+		0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e,
+		0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f
+	};
+	uint64_t fw_tail_pos = pool->seq_len + pool->params.seq_head_margin;
+	for(uint64_t i = from; i < to; i++) {
+		lmm_kv_at(pool->seq, fw_tail_pos + i) = comp[lmm_kv_at(pool->seq, fw_tail_pos - 1 - i)];
+	}
+	return;
+}
+
 /**
  * @fn gref_*_*_modify_seq
  * @brief calculate pos and lim of reverse section, append rv seq if needed
  */
 static
 int gref_fw_copy_modify_seq(
-	struct gref_s *pool)
+	struct gref_s *pool,
+	ptask_t *pt)
 {
 	struct gref_section_intl_s *sec =
 		(struct gref_section_intl_s *)hmap_get_object(pool->hmap, 0);
@@ -723,7 +933,8 @@ int gref_fw_copy_modify_seq(
 }
 static
 int gref_fw_nocopy_modify_seq(
-	struct gref_s *pool)
+	struct gref_s *pool,
+	ptask_t *pt)
 {
 	struct gref_section_intl_s *sec =
 		(struct gref_section_intl_s *)hmap_get_object(pool->hmap, 0);
@@ -748,7 +959,8 @@ int gref_fw_nocopy_modify_seq(
 }
 static
 int gref_fr_copy_modify_seq(
-	struct gref_s *pool)
+	struct gref_s *pool,
+	ptask_t *pt)
 {
 	struct gref_section_intl_s *sec =
 		(struct gref_section_intl_s *)hmap_get_object(pool->hmap, 0);
@@ -764,14 +976,7 @@ int gref_fr_copy_modify_seq(
 	if(lmm_kv_ptr(pool->seq) == NULL) { return(-1); }
 
 	/* append revcomp seq */
-	static uint8_t const comp[16] = {
-		0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e,
-		0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f
-	};
-	uint64_t fw_tail_pos = pool->seq_len + pool->params.seq_head_margin;
-	for(uint64_t i = 0; i < pool->seq_len; i++) {
-		lmm_kv_at(pool->seq, fw_tail_pos + i) = comp[lmm_kv_at(pool->seq, fw_tail_pos - 1 - i)];
-	}
+	gref_freeze_for(pool, pt, gref_revcomp_stage, 0, pool->seq_len);
 
 	/* lim == 0x800000000000 in fw_copy mode */
 	uint8_t const *seq_base = lmm_kv_ptr(pool->seq) + pool->params.seq_head_margin;
@@ -788,7 +993,8 @@ int gref_fr_copy_modify_seq(
 }
 static
 int gref_fr_nocopy_modify_seq(
-	struct gref_s *pool)
+	struct gref_s *pool,
+	ptask_t *pt)
 {
 	struct gref_section_intl_s *sec =
 		(struct gref_section_intl_s *)hmap_get_object(pool->hmap, 0);
@@ -832,27 +1038,49 @@ int gref_flush_modified_seq(
 	uint64_t seq_base = (uint64_t)lmm_kv_ptr(acv->seq) + acv->params.seq_head_margin;
 	struct gref_section_intl_s *sec =
 		(struct gref_section_intl_s *)hmap_get_object(acv->hmap, 0);
-	for(int64_t i = 0; i < 2 * (acv->sec_cnt + 1); i++) {
+	for(int64_t i = 0; i < acv->sec_cnt; i++) {
 		sec[i].fw_sec.base -= seq_base;
 		sec[i].rv_sec.base = NULL;
 	}
 	return(0);
 }
 
+/**
+ * @fn gref_shrink_stage
+ * @brief pack [from, to) of the link table into 32bit dst array (in place)
+ */
+static
+void gref_shrink_stage(
+	struct gref_s *pool,
+	uint64_t from,
+	uint64_t to)
+{
+	uint32_t *link_table = (uint32_t *)lmm_kv_ptr(pool->link);
+	for(uint64_t i = from; i < to; i++) {
+		link_table[i] = lmm_kv_at(pool->link, i).to;
+	}
+	return;
+}
+
 /**
  * @fn gref_shrink_link_table
  * @brief shrink link table. gref_build_link_idx_table must be called beforehand.
  */
 static _force_inline
 int gref_shrink_link_table(
-	struct gref_s *pool)
+	struct gref_s *pool,
+	ptask_t *pt)
 {
-	int64_t link_table_size = pool->link_table_size;
-	uint32_t *link_table = (uint32_t *)lmm_kv_ptr(pool->link);
-
-	/* pack */
-	for(int64_t i = 0; i < link_table_size; i++) {
-		link_table[i] = lmm_kv_at(pool->link, i).to;
+	uint64_t link_table_size = pool->link_table_size;
+
+	/**
+	 * pack. [a, 2a) is read from [8a, 16a) and written to [4a, 8a) in bytes, which is the
+	 * source of [a/2, a) already packed, so each doubling range can be split into threads.
+	 */
+	uint64_t const m = GREF_FREEZE_MIN_LEN;
+	gref_shrink_stage(pool, 0, MIN2(m, link_table_size));
+	for(uint64_t a = m; a < link_table_size; a *= 2) {
+		gref_freeze_for(pool, pt, gref_shrink_stage, a, MIN2(2 * a, link_table_size));
 	}
 	lmm_kv_resize(pool->lmm, pool->link, link_table_size / 2);
 	lmm_kv_size(pool->link) = link_table_size / 2;
@@ -864,28 +1092,31 @@ int gref_shrink_link_table(
 }
 
 /**
- * @fn gref_expand_link_table
+ * @fn gref_expand_stage
+ * @brief expand [from, to) of the 32bit dst array into src-dst pairs (in place)
  */
-static _force_inline
-int gref_expand_link_table(
-	struct gref_s *acv)
+static
+void gref_expand_stage(
+	struct gref_s *acv,
+	uint64_t from,
+	uint64_t to)
 {
-	/* resize mem */
-	int64_t link_table_size = acv->link_table_size;
-	lmm_kv_resize(acv->lmm, acv->link, link_table_size);
 	uint32_t *link = (uint32_t *)lmm_kv_ptr(acv->link);
-
-	if(link == NULL) { return(-1); }
-
-	/* load section ptr */
-	int64_t sec_cnt = acv->sec_cnt;
 	struct gref_section_half_s *sec_half =
 		(struct gref_section_half_s *)hmap_get_object(acv->hmap, 0);
+	if(from == to) { return; }
+
+	/* find the last section i whose links include to - 1, i.e. base[i] <= to - 1 < base[i + 1] */
+	int64_t lo = 0, hi = 2 * acv->sec_cnt;
+	while(lo + 1 < hi) {
+		int64_t mid = (lo + hi) / 2;
+		if(sec_half[mid].link_idx_base <= to - 1) { lo = mid; } else { hi = mid; }
+	}
 
 	/* expand, iterate from tail to head */
-	for(int64_t i = 2 * sec_cnt - 1; i >= 0; i--) {
-		for(int64_t j = sec_half[i + 1].link_idx_base - 1;
-			j >= sec_half[i].link_idx_base;
+	for(int64_t i = lo; i >= 0; i--) {
+		for(int64_t j = (int64_t)MIN2(sec_half[i + 1].link_idx_base, to) - 1;
+			j >= (int64_t)MAX2(sec_half[i].link_idx_base, from);
 			j--) {
 
 			lmm_kv_at(acv->link, j) = (struct gref_gid_pair_s){
@@ -893,7 +1124,34 @@ int gref_expand_link_table(
 				.to = link[j]
 			};
 		}
+		if(sec_half[i].link_idx_base <= from) { break; }
+	}
+	return;
+}
+
+/**
+ * @fn gref_expand_link_table
+ */
+static _force_inline
+int gref_expand_link_table(
+	struct gref_s *acv,
+	ptask_t *pt)
+{
+	/* resize mem */
+	uint64_t link_table_size = acv->link_table_size;
+	lmm_kv_resize(acv->lmm, acv->link, link_table_size);
+	uint32_t *link = (uint32_t *)lmm_kv_ptr(acv->link);
+
+	if(link == NULL) { return(-1); }
+
+	/* the reverse of gref_shrink_link_table; doubling ranges from the tail */
+	uint64_t const m = GREF_FREEZE_MIN_LEN;
+	uint64_t a = m;
+	while(a < link_table_size) { a *= 2; }
+	for(a /= 2; a >= m; a /= 2) {
+		gref_freeze_for(acv, pt, gref_expand_stage, a, MIN2(2 * a, link_table_size));
 	}
+	gref_expand_stage(acv, 0, MIN2(m, link_table_size));
 	return(0);
 }
 
@@ -904,6 +1162,7 @@ gref_acv_t *gref_freeze_pool(
 	gref_pool_t *pool)
 {
 	struct gref_s *gref = (struct gref_s *)pool;
+	ptask_t *pt = NULL;
 
 	debug("gref_freeze_pool called, gref(%p)", gref);
 
@@ -914,8 +1173,11 @@ gref_acv_t *gref_freeze_pool(
 	/* push tail sentinel */
 	gref_add_tail_section(gref);
 
+	/* threads for the sequence and link table conversion */
+	pt = gref_freeze_init_ptask(gref);
+
 	/* modify seq */
-	int (*modify_seq[][3])(struct gref_s *pool) = {
+	int (*modify_seq[][3])(struct gref_s *pool, ptask_t *pt) = {
 		[GREF_FW_ONLY] = {
 			[GREF_COPY] = gref_fw_copy_modify_seq,
 			[GREF_NOCOPY] = gref_fw_nocopy_modify_seq
@@ -925,26 +1187,28 @@ gref_acv_t *gref_freeze_pool(
 			[GREF_NOCOPY] = gref_fr_nocopy_modify_seq
 		}
 	};
-	if(modify_seq[gref->params.seq_direction][gref->params.copy_mode](gref) != 0) {
+	if(modify_seq[gref->params.seq_direction][gref->params.copy_mode](gref, pt) != 0) {
 		goto _gref_freeze_pool_error_handler;
 	}
 
 	/* build link array */
-	if(gref_build_link_idx_table(gref) != 0) {
+	if(gref_build_link_idx_table(gref, pt) != 0) {
 		/* sort failed */
 		goto _gref_freeze_pool_error_handler;
 	}
 
 	/* shrink table */
-	if(gref_shrink_link_table(gref) != 0) {
+	if(gref_shrink_link_table(gref, pt) != 0) {
 		goto _gref_freeze_pool_error_handler;
 	}
+	ptask_clean(pt);
 
 	/* change type */
 	gref->type = GREF_ACV;
 	return((gref_acv_t *)gref);
 
 _gref_freeze_pool_error_handler:;
+	ptask_clean(pt);
 	gref_clean((void *)gref);
 	return(NULL);
 }
@@ -957,7 +1221,8 @@ gref_pool_t *gref_melt_archive(
 {
 	struct gref_s *gref = (struct gref_s *)acv;
 
-	if(gref == NULL || gref->type != GREF_ACV) {
+	if(gref == NULL || gref->type != GREF_ACV || gref->map_base != NULL) {
+		/* mapped object is immutable */
 		goto _gref_melt_archive_error_handler;
 	}
 
@@ -971,7 +1236,10 @@ gref_pool_t *gref_melt_archive(
 	gref->kmer_table_size = 0;
 
 	/* expand table */
-	if(gref_expand_link_table(gref) != 0) {
+	ptask_t *pt = gref_freeze_init_ptask(gref);
+	int ret = gref_expand_link_table(gref, pt);
+	ptask_clean(pt);
+	if(ret != 0) {
 		goto _gref_melt_archive_error_handler;
 	}
 
@@ -1080,9 +1348,10 @@ void gref_iter_kmer_append(
 		{ 0 },
 	};
 
-	/* update count array */
+	/* update count array (the count of the base dropping out of the window is taken before shift) */
 	uint64_t pcnt = popcnt_table[c];
-	kmer->cnt = (kmer->cnt>>2) | (pcnt<<(kmer->shift_len + 2));
+	uint64_t shrink_skip = 0x03 & kmer->cnt;
+	kmer->cnt = (kmer->cnt>>2) | (pcnt<<kmer->shift_len);
 	uint64_t lim = kmer->lim;
 
 	/* branch */
@@ -1095,9 +1364,9 @@ void gref_iter_kmer_append(
 
 	/* append to vector */
 	uint64_t *p = _kmer_arr(kmer);
-	uint64_t mask = 0x03<<kmer->shift_len;
+	uint64_t mask = 0x03ULL<<kmer->shift_len;
 	for(uint64_t j = 0; j < pcnt; j++) {
-		uint64_t b = mask & (conv<<(kmer->shift_len - shift_table[c][j]));
+		uint64_t b = mask & ((uint64_t)conv<<(kmer->shift_len - shift_table[c][j]));
 		for(uint64_t k = 0; k < lim; k++) {
 			*p = (*p>>2) | b; p++;
 			debug("%lld, %lld, %lld, %x, %x, %llx",
@@ -1109,7 +1378,6 @@ void gref_iter_kmer_append(
 	lim *= pcnt;
 
 	/* merge (shrink buffer) */
-	uint64_t shrink_skip = 0x03 & kmer->cnt;
 	if(shrink_skip > 1) {
 		// lim /= shrink_skip;
 		lim = (lim * ((shrink_skip == 2) ? 0x10000 : 0xaaab))>>17;
@@ -1381,16 +1649,20 @@ uint8_t gref_iter_fetch(
 }
 
 /**
- * @fn gref_iter_init
+ * @fn gref_iter_init_range
+ * @brief iterate over sections in [base_gid, tail_gid)
  */
-gref_iter_t *gref_iter_init(
+gref_iter_t *gref_iter_init_range(
 	gref_acv_t const *acv,
-	gref_iter_params_t const *params)
+	gref_iter_params_t const *params,
+	uint32_t base_gid,
+	uint32_t tail_gid)
 {
 	struct gref_s const *gref = (struct gref_s const *)acv;
 
 	debug("init_stack_size(%lld)", gref->iter_init_stack_size);	
 	if(gref == NULL || gref->type == GREF_POOL) { return(NULL); }
+	if(base_gid >= tail_gid) { return(NULL); }
 
 	/* restore params */
 	static struct gref_iter_params_s const default_params = {
@@ -1410,9 +1682,9 @@ gref_iter_t *gref_iter_init(
 	/* init param container */
 	memset(iter->mem_arr, 0, sizeof(void *) * GREF_ITER_INTL_MEM_ARR_LEN);
 
-	/* iterate from section 0 */
-	iter->base_gid = 0;
-	iter->tail_gid = _encode_id(acv->sec_cnt, 0);
+	/* iterate over the range */
+	iter->base_gid = base_gid;
+	iter->tail_gid = tail_gid;
 	iter->step_gid = (params->seq_direction == GREF_FW_RV) ? 1 : 2;
 	
 	/* set params */
@@ -1432,12 +1704,23 @@ gref_iter_t *gref_iter_init(
 }
 
 /**
- * @fn gref_iter_next
+ * @fn gref_iter_init
  */
-struct gref_kmer_tuple_s gref_iter_next(
-	gref_iter_t *_iter)
+gref_iter_t *gref_iter_init(
+	gref_acv_t const *acv,
+	gref_iter_params_t const *params)
 {
-	struct gref_iter_s *iter = (struct gref_iter_s *)_iter;
+	/* iterate from section 0 */
+	return(gref_iter_init_range(acv, params, 0, _encode_id(acv->sec_cnt, 0)));
+}
+
+/**
+ * @fn gref_iter_next
+ */
+struct gref_kmer_tuple_s gref_iter_next(
+	gref_iter_t *_iter)
+{
+	struct gref_iter_s *iter = (struct gref_iter_s *)_iter;
 	// struct gref_iter_stack_s *stack = iter->stack;
 	// struct gref_iter_kmer_s *kmer = stack->kmer;
 
@@ -1505,6 +1788,7 @@ void gref_iter_clean(
 /* build kmer index (acv -> idx conversion) */
 /**
  * @fn gref_build_kmer_idx_table
+ * @brief dense table, kmer_idx[kmer] holds the head of the kmer in the sorted array
  */
 static _force_inline
 int64_t *gref_build_kmer_idx_table(
@@ -1516,7 +1800,7 @@ int64_t *gref_build_kmer_idx_table(
 	lmm_kv_init(acv->lmm, kmer_idx);
 
 	/* may fail when main memory is small */
-	uint64_t kmer_idx_size = 0x01 << (2 * acv->params.k);
+	uint64_t kmer_idx_size = 0x01ULL << (2 * acv->params.k);
 	lmm_kv_reserve(acv->lmm, kmer_idx, kmer_idx_size + 1);
 	debug("ptr(%p), size(%llu)", lmm_kv_ptr(kmer_idx), kmer_idx_size);
 	if(lmm_kv_ptr(kmer_idx) == NULL) { return(NULL); }
@@ -1536,178 +1820,1662 @@ int64_t *gref_build_kmer_idx_table(
 		for(uint64_t j = prev_kmer + 1; j < kmer + 1; j++) {
 			lmm_kv_push(acv->lmm, kmer_idx, i);
 		}
-		prev_kmer = kmer;
-	}
-	for(uint64_t j = prev_kmer; j < kmer_idx_size; j++) {
-		lmm_kv_push(acv->lmm, kmer_idx, size);
+		prev_kmer = kmer;
+	}
+	for(uint64_t j = prev_kmer; j < kmer_idx_size; j++) {
+		lmm_kv_push(acv->lmm, kmer_idx, size);
+	}
+	acv->kmer_idx_table_size = lmm_kv_size(kmer_idx);
+	return(lmm_kv_ptr(kmer_idx));
+}
+
+/**
+ * @fn gref_count_distinct_kmers
+ */
+static _force_inline
+int64_t gref_count_distinct_kmers(
+	struct gref_kmer_tuple_s const *arr,
+	int64_t size)
+{
+	int64_t cnt = 0;
+	for(int64_t i = 0; i < size; i++) {
+		cnt += (i == 0 || arr[i].kmer != arr[i - 1].kmer);
+	}
+	return(cnt);
+}
+
+/**
+ * @fn gref_calc_kmer_hash_size
+ * @brief number of buckets (load factor <= 0.5)
+ */
+static _force_inline
+uint64_t gref_calc_kmer_hash_size(
+	int64_t distinct_cnt)
+{
+	uint64_t hash_size = 16;
+	while(hash_size < 2 * (uint64_t)distinct_cnt) {
+		hash_size *= 2;
+	}
+	return(hash_size);
+}
+
+/**
+ * @fn gref_select_kmer_idx_mode
+ * @brief dense table is preferred unless it is four times larger than the hashed one
+ */
+static _force_inline
+int gref_select_kmer_idx_mode(
+	int64_t k,
+	int64_t distinct_cnt)
+{
+	/* dense table of k >= 24 never fits in memory */
+	if(k >= 24) { return(GREF_KMER_IDX_HASH); }
+
+	uint64_t dense_size = sizeof(int64_t) * ((0x01ULL<<(2 * k)) + 1);
+	uint64_t hash_size = sizeof(struct gref_kmer_bucket_s) * gref_calc_kmer_hash_size(distinct_cnt)
+		+ sizeof(int64_t) * (distinct_cnt + 1);
+	return((dense_size <= 4 * hash_size) ? GREF_KMER_IDX_DENSE : GREF_KMER_IDX_HASH);
+}
+
+/**
+ * @fn gref_build_kmer_hash_table
+ * @brief compact kmer_idx table (distinct kmers + 1) and open-addressing buckets pointing to it
+ */
+static _force_inline
+int64_t *gref_build_kmer_hash_table(
+	struct gref_s *acv,
+	struct gref_kmer_tuple_s *arr,
+	int64_t size,
+	int64_t distinct_cnt)
+{
+	uint64_t hash_size = gref_calc_kmer_hash_size(distinct_cnt);
+	int64_t *kmer_idx = (int64_t *)lmm_malloc(acv->lmm, sizeof(int64_t) * (distinct_cnt + 1));
+	struct gref_kmer_bucket_s *bucket = (struct gref_kmer_bucket_s *)lmm_malloc(acv->lmm,
+		sizeof(struct gref_kmer_bucket_s) * hash_size);
+	debug("ptr(%p, %p), distinct_cnt(%lld), hash_size(%llu)", kmer_idx, bucket, distinct_cnt, hash_size);
+	if(kmer_idx == NULL || bucket == NULL) {
+		lmm_free(acv->lmm, kmer_idx);
+		lmm_free(acv->lmm, bucket);
+		return(NULL);
+	}
+	memset(bucket, 0xff, sizeof(struct gref_kmer_bucket_s) * hash_size);
+
+	uint64_t const mask = hash_size - 1;
+	int64_t idx = 0;
+	for(int64_t i = 0; i < size; i++) {
+		uint64_t kmer = arr[i].kmer;
+		if(i != 0 && arr[i - 1].kmer == kmer) { continue; }
+
+		/* linear probing */
+		uint64_t h = _kmer_hash(kmer) & mask;
+		while(bucket[h].idx >= 0) { h = (h + 1) & mask; }
+		bucket[h] = (struct gref_kmer_bucket_s){
+			.kmer = kmer,
+			.idx = idx
+		};
+		kmer_idx[idx++] = i;
+	}
+	kmer_idx[idx] = size;
+
+	acv->kmer_hash_table = bucket;
+	acv->kmer_hash_mask = mask;
+	acv->kmer_idx_table_size = distinct_cnt + 1;
+	return(kmer_idx);
+}
+
+/**
+ * @fn gref_shrink_kmer_table
+ */
+static _force_inline
+struct gref_gid_pos_s *gref_shrink_kmer_table(
+	struct gref_s *acv,
+	struct gref_kmer_tuple_s *kmer_table,
+	int64_t kmer_table_size)
+{
+	struct gref_gid_pos_s *packed_pos = (struct gref_gid_pos_s *)kmer_table;
+	
+	for(int64_t i = 0; i < kmer_table_size; i++) {
+		packed_pos[i] = kmer_table[i].gid_pos;
+	}
+
+	return(lmm_realloc(acv->lmm, kmer_table, sizeof(struct gref_gid_pos_s) * kmer_table_size));
+}
+
+/**
+ * @struct gref_kmer_enum_s
+ * @brief per-thread context of parallel kmer enumeration
+ */
+struct gref_kmer_enum_s {
+	struct gref_s const *acv;
+	uint32_t base_gid;
+	uint32_t tail_gid;
+	lmm_kvec_t(struct gref_kmer_tuple_s) v;
+	struct gref_kmer_tuple_s *dst;		/* merge destination */
+};
+
+/**
+ * @fn gref_kmer_enum_dispatcher
+ */
+static
+void *gref_kmer_enum_dispatcher(
+	void *arg,
+	void *item)
+{
+	((void (*)(struct gref_kmer_enum_s *))item)((struct gref_kmer_enum_s *)arg);
+	return(NULL);
+}
+
+/**
+ * @fn gref_kmer_enum_collect
+ * @brief enumerate kmers in [base_gid, tail_gid) into the local vector
+ */
+static
+void gref_kmer_enum_collect(
+	struct gref_kmer_enum_s *e)
+{
+	static struct gref_iter_params_s const iter_params = {
+		.step_size = 1,
+		.seq_direction = GREF_FW_RV
+	};
+
+	lmm_kv_init(e->acv->lmm, e->v);
+	struct gref_iter_s *iter = gref_iter_init_range(e->acv, &iter_params, e->base_gid, e->tail_gid);
+	if(iter == NULL) { return; }
+
+	struct gref_kmer_tuple_s t;
+	while((t = gref_iter_next(iter)).gid_pos.gid != (uint32_t)-1) {
+		lmm_kv_push(e->acv->lmm, e->v, t);
+	}
+	gref_iter_clean(iter);
+	return;
+}
+
+/**
+ * @fn gref_kmer_enum_merge
+ * @brief copy the local vector to its offset in the merged array (the leading one is extended in place)
+ */
+static
+void gref_kmer_enum_merge(
+	struct gref_kmer_enum_s *e)
+{
+	if(e->dst != lmm_kv_ptr(e->v)) {
+		memcpy(e->dst, lmm_kv_ptr(e->v), sizeof(struct gref_kmer_tuple_s) * lmm_kv_size(e->v));
+		lmm_kv_destroy(e->acv->lmm, e->v);
+	}
+	return;
+}
+
+/**
+ * @fn gref_kmer_enum_partition
+ * @brief split sections into contiguous gid ranges of approximately the same sequence length
+ */
+static _force_inline
+void gref_kmer_enum_partition(
+	struct gref_s const *acv,
+	struct gref_kmer_enum_s *e,
+	int64_t num_threads)
+{
+	struct gref_section_half_s const *hsec =
+		(struct gref_section_half_s const *)hmap_get_object(acv->hmap, 0);
+	uint32_t const tail_gid = _encode_id(acv->sec_cnt, 0);
+
+	uint64_t total_len = 0;
+	for(uint32_t gid = 0; gid < tail_gid; gid++) {
+		total_len += hsec[gid].sec.len;
+	}
+
+	uint32_t gid = 0;
+	uint64_t acc_len = 0;
+	for(int64_t i = 0; i < num_threads; i++) {
+		uint64_t lim_len = (i + 1) * total_len / num_threads;
+
+		e[i].acv = acv;
+		e[i].base_gid = gid;
+		while(gid < tail_gid && (acc_len < lim_len || i == num_threads - 1)) {
+			acc_len += hsec[gid++].sec.len;
+		}
+		e[i].tail_gid = gid;
+		e[i].dst = NULL;
+	}
+	return;
+}
+
+/**
+ * @fn gref_enumerate_kmers
+ * @brief enumerate all the kmers in the archive. sections are partitioned into num_threads
+ * ranges and the per-thread vectors are concatenated in the gid order, so the result is
+ * identical to that of the single-threaded enumeration.
+ */
+static _force_inline
+int gref_enumerate_kmers(
+	struct gref_s const *acv,
+	struct gref_kmer_tuple_s **arr,
+	uint64_t *size)
+{
+	/* lmm is not thread-safe; fall back to single thread */
+	int64_t num_threads = (acv->lmm == NULL) ? acv->params.num_threads : 1;
+	num_threads = MAX2(1, MIN2(num_threads, _encode_id(acv->sec_cnt, 0)));
+
+	struct gref_kmer_enum_s *e = (struct gref_kmer_enum_s *)malloc(
+		num_threads * (sizeof(struct gref_kmer_enum_s) + 3 * sizeof(void *)));
+	if(e == NULL) { return(-1); }
+
+	/* thread contexts and stage functions (see psort) */
+	void **pe = (void **)&e[num_threads];
+	void **collect = &pe[num_threads];
+	void **merge = &collect[num_threads];
+	for(int64_t i = 0; i < num_threads; i++) {
+		pe[i] = (void *)&e[i];
+		collect[i] = (void *)gref_kmer_enum_collect;
+		merge[i] = (void *)gref_kmer_enum_merge;
+	}
+	gref_kmer_enum_partition(acv, e, num_threads);
+
+	if(num_threads == 1) {
+		gref_kmer_enum_collect(&e[0]);
+	} else {
+		ptask_t *pt = ptask_init(gref_kmer_enum_dispatcher, pe, num_threads, 1);
+		if(pt == NULL) {
+			free(e);
+			return(-1);
+		}
+		ptask_parallel(pt, collect, NULL);
+
+		/* extend the leading vector to the total size, then copy the others in parallel */
+		uint64_t total_size = 0;
+		for(int64_t i = 0; i < num_threads; i++) {
+			total_size += lmm_kv_size(e[i].v);
+		}
+		lmm_kv_reserve(acv->lmm, e[0].v, total_size);
+		if(lmm_kv_ptr(e[0].v) == NULL) {
+			for(int64_t i = 1; i < num_threads; i++) {
+				lmm_kv_destroy(acv->lmm, e[i].v);
+			}
+			ptask_clean(pt);
+			free(e);
+			return(-1);
+		}
+
+		struct gref_kmer_tuple_s *dst = lmm_kv_ptr(e[0].v);
+		for(int64_t i = 0; i < num_threads; i++) {
+			e[i].dst = dst;
+			dst += lmm_kv_size(e[i].v);
+		}
+		ptask_parallel(pt, merge, NULL);
+		ptask_clean(pt);
+		lmm_kv_size(e[0].v) = total_size;
+	}
+
+	*arr = lmm_kv_ptr(e[0].v);
+	*size = lmm_kv_size(e[0].v);
+	free(e);
+	return(0);
+}
+
+/**
+ * @struct gref_kmer_count_s
+ * @brief per-thread context of the counting kmer table build
+ */
+struct gref_kmer_count_s {
+	struct gref_s const *acv;
+	uint32_t base_gid;
+	uint32_t tail_gid;
+	uint64_t base_kmer;
+	uint64_t tail_kmer;
+	int64_t *kmer_idx;				/* shared occurrence / offset table */
+	struct gref_gid_pos_s *dst;		/* shared final kmer table */
+};
+
+/**
+ * @fn gref_kmer_count_dispatcher
+ */
+static
+void *gref_kmer_count_dispatcher(
+	void *arg,
+	void *item)
+{
+	((void (*)(struct gref_kmer_count_s *))item)((struct gref_kmer_count_s *)arg);
+	return(NULL);
+}
+
+/**
+ * @fn gref_kmer_count_occ
+ * @brief count kmers in [base_gid, tail_gid), occurrences of kmer are accumulated at kmer_idx[kmer + 1]
+ */
+static
+void gref_kmer_count_occ(
+	struct gref_kmer_count_s *c)
+{
+	static struct gref_iter_params_s const iter_params = {
+		.step_size = 1,
+		.seq_direction = GREF_FW_RV
+	};
+
+	struct gref_iter_s *iter = gref_iter_init_range(c->acv, &iter_params, c->base_gid, c->tail_gid);
+	if(iter == NULL) { return; }
+
+	struct gref_kmer_tuple_s t;
+	while((t = gref_iter_next(iter)).gid_pos.gid != (uint32_t)-1) {
+		__atomic_fetch_add(&c->kmer_idx[t.kmer + 1], 1, __ATOMIC_RELAXED);
+	}
+	gref_iter_clean(iter);
+	return;
+}
+
+/**
+ * @fn gref_kmer_count_scatter
+ * @brief store pos of kmers in [base_gid, tail_gid) at kmer_idx[kmer], which is advanced
+ */
+static
+void gref_kmer_count_scatter(
+	struct gref_kmer_count_s *c)
+{
+	static struct gref_iter_params_s const iter_params = {
+		.step_size = 1,
+		.seq_direction = GREF_FW_RV
+	};
+
+	struct gref_iter_s *iter = gref_iter_init_range(c->acv, &iter_params, c->base_gid, c->tail_gid);
+	if(iter == NULL) { return; }
+
+	struct gref_kmer_tuple_s t;
+	while((t = gref_iter_next(iter)).gid_pos.gid != (uint32_t)-1) {
+		int64_t i = __atomic_fetch_add(&c->kmer_idx[t.kmer], 1, __ATOMIC_RELAXED);
+		c->dst[i] = t.gid_pos;
+	}
+	gref_iter_clean(iter);
+	return;
+}
+
+/**
+ * @fn gref_kmer_count_sort
+ * @brief sort pos of kmers in [base_kmer, tail_kmer) after the parallel scatter. pos are
+ * enumerated in the (gid, pos) order, which the stable radix sort of the sort build keeps.
+ */
+static
+void gref_kmer_count_sort(
+	struct gref_kmer_count_s *c)
+{
+	/* kmer_idx[kmer] points to the tail of kmer after scatter */
+	uint64_t *arr = (uint64_t *)c->dst;
+	for(uint64_t kmer = c->base_kmer; kmer < c->tail_kmer; kmer++) {
+		int64_t head = (kmer == 0) ? 0 : c->kmer_idx[kmer - 1], tail = c->kmer_idx[kmer];
+		if(tail - head > 64) {
+			psort_full(&arr[head], tail - head, sizeof(uint64_t), 0);
+			continue;
+		}
+
+		/* insertion sort */
+		for(int64_t i = head + 1; i < tail; i++) {
+			uint64_t x = arr[i];
+			int64_t j = i;
+			while(j > head && arr[j - 1] > x) { arr[j] = arr[j - 1]; j--; }
+			arr[j] = x;
+		}
+	}
+	return;
+}
+_static_assert(sizeof(struct gref_gid_pos_s) == sizeof(uint64_t));
+
+/**
+ * @fn gref_use_count_build
+ * @brief the counting build needs the dense table (4^k + 1 offsets) in addition to the kmer table
+ */
+static _force_inline
+int gref_use_count_build(
+	struct gref_s const *acv)
+{
+	/* dense table of k >= 24 never fits in memory */
+	if(acv->params.k >= 24 || acv->params.kmer_idx_mode == GREF_KMER_IDX_HASH) { return(0); }
+
+	switch(acv->params.kmer_build_mode) {
+		case GREF_KMER_BUILD_SORT: return(0);
+		case GREF_KMER_BUILD_COUNT: return(1);
+		default: break;
+	}
+	if(acv->params.kmer_idx_mode == GREF_KMER_IDX_DENSE) { return(1); }
+
+	/* approximately two kmers (forward and reverse) for each base */
+	uint64_t dense_size = sizeof(int64_t) * ((0x01ULL<<(2 * acv->params.k)) + 1);
+	uint64_t table_size = sizeof(struct gref_gid_pos_s) * 2 * acv->seq_len;
+	return(dense_size <= table_size);
+}
+
+/**
+ * @fn gref_count_build_kmer_table
+ * @brief build the dense kmer_idx table and the kmer table in two enumeration passes, without
+ * the intermediate (kmer, pos) array and the sort buffer. identical to the sort build.
+ */
+static _force_inline
+int gref_count_build_kmer_table(
+	struct gref_s *acv,
+	int64_t *distinct_cnt)
+{
+	/* lmm is not thread-safe; fall back to single thread */
+	int64_t num_threads = (acv->lmm == NULL) ? acv->params.num_threads : 1;
+	num_threads = MAX2(1, MIN2(num_threads, _encode_id(acv->sec_cnt, 0)));
+
+	uint64_t const kmer_idx_size = 0x01ULL << (2 * acv->params.k);
+	int64_t *kmer_idx = (int64_t *)lmm_malloc(acv->lmm, sizeof(int64_t) * (kmer_idx_size + 1));
+	if(kmer_idx == NULL) { return(-1); }
+	memset(kmer_idx, 0, sizeof(int64_t) * (kmer_idx_size + 1));
+
+	/* split sections as the enumeration does */
+	struct gref_kmer_enum_s e[num_threads];
+	gref_kmer_enum_partition(acv, e, num_threads);
+
+	struct gref_kmer_count_s c[num_threads];
+	void *pc[num_threads], *count[num_threads], *scatter[num_threads], *sort[num_threads];
+	for(int64_t i = 0; i < num_threads; i++) {
+		c[i] = (struct gref_kmer_count_s){
+			.acv = acv,
+			.base_gid = e[i].base_gid,
+			.tail_gid = e[i].tail_gid,
+			.base_kmer = i * kmer_idx_size / num_threads,
+			.tail_kmer = (i + 1) * kmer_idx_size / num_threads,
+			.kmer_idx = kmer_idx,
+			.dst = NULL
+		};
+		pc[i] = (void *)&c[i];
+		count[i] = (void *)gref_kmer_count_occ;
+		scatter[i] = (void *)gref_kmer_count_scatter;
+		sort[i] = (void *)gref_kmer_count_sort;
+	}
+	ptask_t *pt = (num_threads == 1) ? NULL : ptask_init(gref_kmer_count_dispatcher, pc, num_threads, 1);
+	#define _run(_stage) { \
+		if(pt == NULL) { gref_kmer_count_dispatcher(pc[0], _stage[0]); } \
+		else { ptask_parallel(pt, _stage, NULL); } \
+	}
+
+	/* first pass: count, then convert to heads */
+	_run(count);
+	int64_t cnt = 0;
+	for(uint64_t i = 0; i < kmer_idx_size; i++) {
+		cnt += kmer_idx[i + 1] != 0;
+		kmer_idx[i + 1] += kmer_idx[i];
+	}
+	*distinct_cnt = cnt;
+
+	/* second pass: scatter into the final table */
+	int64_t kmer_table_size = kmer_idx[kmer_idx_size];
+	struct gref_gid_pos_s *kmer_table = (struct gref_gid_pos_s *)lmm_malloc(acv->lmm,
+		sizeof(struct gref_gid_pos_s) * MAX2(kmer_table_size, 1));
+	if(kmer_table == NULL) {
+		ptask_clean(pt);
+		lmm_free(acv->lmm, kmer_idx);
+		return(-1);
+	}
+	for(int64_t i = 0; i < num_threads; i++) {
+		c[i].dst = kmer_table;
+	}
+	_run(scatter);
+
+	/* restore order of pos stored by the threads concurrently */
+	if(pt != NULL) { _run(sort); }
+	#undef _run
+	ptask_clean(pt);
+
+	/* kmer_idx[kmer] points to the tail of kmer; shift to the head */
+	memmove(&kmer_idx[1], &kmer_idx[0], sizeof(int64_t) * kmer_idx_size);
+	kmer_idx[0] = 0;
+
+	acv->kmer_idx_table = kmer_idx;
+	acv->kmer_idx_table_size = kmer_idx_size + 1;
+	acv->kmer_table = kmer_table;
+	acv->kmer_table_size = kmer_table_size;
+	return(0);
+}
+
+/**
+ * @fn gref_convert_kmer_hash_table
+ * @brief replace the dense kmer_idx table with the hashed one (see gref_build_kmer_hash_table)
+ */
+static _force_inline
+int gref_convert_kmer_hash_table(
+	struct gref_s *acv,
+	int64_t distinct_cnt)
+{
+	uint64_t const kmer_idx_size = acv->kmer_idx_table_size - 1;
+	int64_t const *dense = acv->kmer_idx_table;
+
+	uint64_t hash_size = gref_calc_kmer_hash_size(distinct_cnt);
+	int64_t *kmer_idx = (int64_t *)lmm_malloc(acv->lmm, sizeof(int64_t) * (distinct_cnt + 1));
+	struct gref_kmer_bucket_s *bucket = (struct gref_kmer_bucket_s *)lmm_malloc(acv->lmm,
+		sizeof(struct gref_kmer_bucket_s) * hash_size);
+	if(kmer_idx == NULL || bucket == NULL) {
+		lmm_free(acv->lmm, kmer_idx);
+		lmm_free(acv->lmm, bucket);
+		return(-1);
+	}
+	memset(bucket, 0xff, sizeof(struct gref_kmer_bucket_s) * hash_size);
+
+	/* inserted in the ascending order of kmers, as gref_build_kmer_hash_table does */
+	uint64_t const mask = hash_size - 1;
+	int64_t idx = 0;
+	for(uint64_t kmer = 0; kmer < kmer_idx_size; kmer++) {
+		if(dense[kmer] == dense[kmer + 1]) { continue; }
+
+		/* linear probing */
+		uint64_t h = _kmer_hash(kmer) & mask;
+		while(bucket[h].idx >= 0) { h = (h + 1) & mask; }
+		bucket[h] = (struct gref_kmer_bucket_s){
+			.kmer = kmer,
+			.idx = idx
+		};
+		kmer_idx[idx++] = dense[kmer];
+	}
+	kmer_idx[idx] = dense[kmer_idx_size];
+
+	lmm_free(acv->lmm, acv->kmer_idx_table);
+	acv->kmer_idx_table = kmer_idx;
+	acv->kmer_hash_table = bucket;
+	acv->kmer_hash_mask = mask;
+	acv->kmer_idx_table_size = distinct_cnt + 1;
+	return(0);
+}
+
+/**
+ * @fn gref_build_index
+ */
+gref_idx_t *gref_build_index(
+	gref_acv_t *acv)
+{
+	struct gref_s *gref = (struct gref_s *)acv;
+
+	if(gref == NULL || gref->type != GREF_ACV) {
+		goto _gref_build_index_error_handler;
+	}
+
+	/* count kmers and scatter pos into the final table */
+	if(gref_use_count_build(gref)) {
+		int64_t distinct_cnt = 0;
+		if(gref_count_build_kmer_table(gref, &distinct_cnt) != 0) {
+			debug("count build failed");
+			goto _gref_build_index_error_handler;
+		}
+		if(gref->params.kmer_idx_mode == GREF_KMER_IDX_AUTO) {
+			gref->params.kmer_idx_mode = gref_select_kmer_idx_mode(gref->params.k, distinct_cnt);
+		}
+		if(gref->params.kmer_idx_mode == GREF_KMER_IDX_HASH
+		&& gref_convert_kmer_hash_table(gref, distinct_cnt) != 0) {
+			debug("failed to build index table");
+			goto _gref_build_index_error_handler;
+		}
+		goto _gref_build_index_finish;
+	}
+
+	/* enumerate kmers and pack into vector */
+	lmm_kvec_t(struct gref_kmer_tuple_s) v;
+	if(gref_enumerate_kmers(gref, &lmm_kv_ptr(v), &lmm_kv_size(v)) != 0) {
+		debug("enumeration failed");
+		goto _gref_build_index_error_handler;
+	}
+
+	/* sort kmers */
+	if(psort_half(lmm_kv_ptr(v), lmm_kv_size(v),
+		sizeof(struct gref_kmer_tuple_s), acv->params.num_threads) != 0) {
+		lmm_kv_destroy(acv->lmm, v);
+		debug("sort failed");
+		goto _gref_build_index_error_handler;
+	}
+
+	/* build index of kmer table */
+	int64_t distinct_cnt = gref_count_distinct_kmers(lmm_kv_ptr(v), lmm_kv_size(v));
+	if(gref->params.kmer_idx_mode == GREF_KMER_IDX_AUTO) {
+		gref->params.kmer_idx_mode = gref_select_kmer_idx_mode(gref->params.k, distinct_cnt);
+	}
+	if(gref->params.kmer_idx_mode == GREF_KMER_IDX_DENSE) {
+		gref->kmer_idx_table = gref_build_kmer_idx_table(acv, lmm_kv_ptr(v), lmm_kv_size(v));
+	} else {
+		gref->kmer_idx_table = gref_build_kmer_hash_table(acv, lmm_kv_ptr(v), lmm_kv_size(v), distinct_cnt);
+	}
+	if(gref->kmer_idx_table == NULL) {
+		debug("failed to build index table");
+		goto _gref_build_index_error_handler;
+	}
+
+	/* shrink table */
+	gref->kmer_table_size = lmm_kv_size(v);
+	gref->kmer_table = gref_shrink_kmer_table(acv, lmm_kv_ptr(v), lmm_kv_size(v));
+	if(gref->kmer_table == NULL) {
+		debug("failed to shrink");
+		goto _gref_build_index_error_handler;
+	}
+
+_gref_build_index_finish:;
+	/* store misc constants for kmer matching */
+	gref->mask = 0xffffffffffffffff>>(64 - 2 * gref->params.k);
+
+	/* change state */
+	gref->type = GREF_IDX;
+	return((gref_idx_t *)gref);
+
+_gref_build_index_error_handler:;
+	gref_clean((gref_t *)gref);
+	return(NULL);
+}
+
+/**
+ * @fn gref_disable_index
+ */
+gref_acv_t *gref_disable_index(
+	gref_idx_t *idx)
+{
+	struct gref_s *gref = (struct gref_s *)idx;
+
+	if(gref == NULL || gref->type != GREF_IDX) {
+		gref_clean((gref_t *)gref);
+		return(NULL);
+	}
+
+	/* cleanup kmer_idx_table */
+	if(gref->map_base == NULL) {
+		lmm_free(idx->lmm, idx->kmer_idx_table);
+		lmm_free(idx->lmm, idx->kmer_hash_table);
+	}
+	idx->kmer_idx_table = NULL;
+	idx->kmer_hash_table = NULL;
+
+	/* change state */
+	gref->type = GREF_ACV;
+	return((gref_acv_t *)gref);
+}
+
+/**
+ * @fn gref_probe_kmer_hash
+ * @brief probe until the kmer or an empty bucket is found, returns -1 if not found
+ */
+static _force_inline
+int64_t gref_probe_kmer_hash(
+	struct gref_s const *gref,
+	uint64_t h,
+	uint64_t seq)
+{
+	struct gref_kmer_bucket_s const *bucket = gref->kmer_hash_table;
+	while(bucket[h].idx >= 0 && bucket[h].kmer != seq) {
+		h = (h + 1) & gref->kmer_hash_mask;
+	}
+	return(bucket[h].idx);
+}
+
+/**
+ * @fn gref_match_2bitpacked
+ */
+struct gref_match_res_s gref_match_2bitpacked(
+	gref_idx_t const *_gref,
+	uint64_t seq)
+{
+	struct gref_s const *gref = (struct gref_s const *)_gref;
+	seq &= gref->mask;
+
+	if(gref->kmer_hash_table != NULL) {
+		int64_t idx = gref_probe_kmer_hash(gref, _kmer_hash(seq) & gref->kmer_hash_mask, seq);
+		if(idx < 0) {
+			return((struct gref_match_res_s){
+				.gid_pos_arr = gref->kmer_table,
+				.len = 0
+			});
+		}
+		seq = idx;
+	}
+	int64_t base = gref->kmer_idx_table[seq];
+	int64_t tail = gref->kmer_idx_table[seq + 1];
+
+	debug("seq(%llx), mask(%llx), base(%lld), tail(%lld)",
+		seq, gref->mask, base, tail);
+	return((struct gref_match_res_s){
+		.gid_pos_arr = &gref->kmer_table[base],
+		.len = tail - base
+	});
+}
+
+/**
+ * @fn gref_match
+ * @brief seq length must be equal to k.
+ */
+struct gref_match_res_s gref_match(
+	gref_idx_t const *_gref,
+	uint8_t const *seq)
+{
+	struct gref_s const *gref = (struct gref_s const *)_gref;
+	int64_t const seed_len = gref->params.k;
+	int64_t const shift_len = 2 * (seed_len - 1);
+
+	uint64_t packed_seq = 0;
+	for(int64_t i = 0; i < seed_len; i++) {
+		packed_seq = (packed_seq>>2) | ((uint64_t)gref_encode_2bit(seq[i])<<shift_len);
+	}
+	return(gref_match_2bitpacked((gref_t const *)gref, packed_seq));
+}
+
+/**
+ * @fn gref_match_batch
+ * @brief lookups are split into stages (bucket / offset table / position array), and each
+ * stage prefetches the slots of all the kmers in the batch before the next stage touches them.
+ */
+void gref_match_batch(
+	gref_idx_t const *_gref,
+	uint64_t const *kmer,
+	struct gref_match_res_s *res,
+	int64_t cnt)
+{
+	struct gref_s const *gref = (struct gref_s const *)_gref;
+	int64_t idx[GREF_MATCH_BATCH_SIZE];
+
+	for(int64_t b = 0; b < cnt; b += GREF_MATCH_BATCH_SIZE) {
+		int64_t const n = MIN2(cnt - b, GREF_MATCH_BATCH_SIZE);
+		uint64_t const *k = &kmer[b];
+
+		if(gref->kmer_hash_table != NULL) {
+			/* hash buckets */
+			uint64_t h[GREF_MATCH_BATCH_SIZE];
+			for(int64_t i = 0; i < n; i++) {
+				h[i] = _kmer_hash(k[i] & gref->mask) & gref->kmer_hash_mask;
+				_prefetch(&gref->kmer_hash_table[h[i]]);
+			}
+			for(int64_t i = 0; i < n; i++) {
+				idx[i] = gref_probe_kmer_hash(gref, h[i], k[i] & gref->mask);
+				_prefetch(&gref->kmer_idx_table[MAX2(idx[i], 0)]);
+			}
+		} else {
+			for(int64_t i = 0; i < n; i++) {
+				idx[i] = k[i] & gref->mask;
+				_prefetch(&gref->kmer_idx_table[idx[i]]);
+			}
+		}
+
+		/* offsets, then the heads of the position arrays */
+		for(int64_t i = 0; i < n; i++) {
+			int64_t base = (idx[i] < 0) ? 0 : gref->kmer_idx_table[idx[i]];
+			int64_t tail = (idx[i] < 0) ? 0 : gref->kmer_idx_table[idx[i] + 1];
+			_prefetch(&gref->kmer_table[base]);
+
+			res[b + i] = (struct gref_match_res_s){
+				.gid_pos_arr = &gref->kmer_table[base],
+				.len = tail - base
+			};
+		}
+	}
+	return;
+}
+
+/* index dump and load */
+#define GREF_INDEX_MAGIC			( "GREFIDX" )
+#define GREF_INDEX_VERSION			( 2 )
+#define GREF_INDEX_ALIGN_SIZE		( 4096 )
+
+/* out-of-core build: minimum number of kmers in a sorted run, and size of I/O buffers */
+#define GREF_EXT_MIN_CHUNK_CNT		( 1024 )
+#define GREF_EXT_BUF_SIZE			( 4 * 1024 * 1024 )
+
+/**
+ * @enum gref_index_block
+ */
+enum gref_index_block {
+	GREF_INDEX_HMAP_TABLE		= 0,
+	GREF_INDEX_HMAP_KEY			= 1,
+	GREF_INDEX_SECTION			= 2,
+	GREF_INDEX_SEQ				= 3,
+	GREF_INDEX_LINK				= 4,
+	GREF_INDEX_KMER_IDX			= 5,
+	GREF_INDEX_KMER				= 6,
+	GREF_INDEX_KMER_HASH		= 7,
+	GREF_INDEX_BLOCK_CNT		= 8
+};
+
+/**
+ * @struct gref_index_block_s
+ */
+struct gref_index_block_s {
+	uint64_t offset;
+	uint64_t size;
+};
+
+/**
+ * @struct gref_index_header_s
+ * @brief placed at the head of the index file. blocks follow at page-aligned offsets.
+ */
+struct gref_index_header_s {
+	char magic[8];
+	uint32_t version;
+	uint32_t align_size;
+
+	/* params (lmm is cleared) */
+	struct gref_params_s params;
+
+	/* archive info */
+	uint32_t sec_cnt;
+	uint32_t reserved1;
+	uint64_t seq_len;
+	int64_t link_table_size;
+	int64_t kmer_table_size;
+	int64_t kmer_idx_table_size;
+	uint64_t kmer_hash_mask;
+
+	/* hmap info */
+	uint32_t hmap_mask;
+	uint32_t hmap_object_size;
+	uint32_t hmap_next_id;
+	uint32_t reserved2;
+
+	/* array blocks */
+	struct gref_index_block_s block[GREF_INDEX_BLOCK_CNT];
+};
+_static_assert(sizeof(struct gref_index_header_s) <= GREF_INDEX_ALIGN_SIZE);
+
+/**
+ * @fn gref_dump_index_pad
+ */
+static _force_inline
+int gref_dump_index_pad(
+	zf_t *fp,
+	uint64_t size)
+{
+	static uint8_t const zero[GREF_INDEX_ALIGN_SIZE] = { 0 };
+
+	while(size > 0) {
+		uint64_t len = MIN2(size, GREF_INDEX_ALIGN_SIZE);
+		if(zfwrite(fp, (void *)zero, len) != len) { return(-1); }
+		size -= len;
+	}
+	return(0);
+}
+
+/**
+ * @fn gref_dump_index_block
+ * @brief write an array then pad it to the alignment boundary
+ */
+static _force_inline
+int gref_dump_index_block(
+	zf_t *fp,
+	void const *ptr,
+	uint64_t size)
+{
+	if(size != 0 && zfwrite(fp, (void *)ptr, size) != size) {
+		return(-1);
+	}
+	return(gref_dump_index_pad(fp, _roundup(size, GREF_INDEX_ALIGN_SIZE) - size));
+}
+
+/**
+ * @fn gref_dump_index_sections
+ * @brief dump section objects, sequence pointers are converted to offsets from the seq base
+ */
+static _force_inline
+int gref_dump_index_sections(
+	zf_t *fp,
+	struct gref_s const *gref,
+	uint64_t size)
+{
+	struct gref_section_intl_s const *sec =
+		(struct gref_section_intl_s const *)hmap_get_object(gref->hmap, 0);
+	uint8_t const *seq_base = lmm_kv_ptr(gref->seq) + gref->params.seq_head_margin;
+
+	for(int64_t i = 0; i < hmap_get_count(gref->hmap); i++) {
+		struct gref_section_intl_s s = sec[i];
+
+		/* the tail sentinel is left untouched (as gref_*_copy_modify_seq does) */
+		if(i < gref->sec_cnt) {
+			s.fw_sec.base = (uint8_t const *)(s.fw_sec.base - seq_base);
+			s.rv_sec.base = NULL;
+		}
+		if(zfwrite(fp, (void *)&s, sizeof(struct gref_section_intl_s)) != sizeof(struct gref_section_intl_s)) {
+			return(-1);
+		}
+	}
+	return(gref_dump_index_pad(fp, _roundup(size, GREF_INDEX_ALIGN_SIZE) - size));
+}
+
+/**
+ * @fn gref_dump_index_build_header
+ * @brief header of gref, block offsets are not filled
+ */
+static _force_inline
+struct gref_index_header_s gref_dump_index_build_header(
+	struct gref_s const *gref,
+	hmap_raw_t const *raw)
+{
+	uint64_t seq_cnt = (gref->params.seq_direction == GREF_FW_RV) ? 2 : 1;
+	uint64_t head_margin = gref->params.seq_head_margin;
+	uint64_t tail_margin = gref->params.seq_tail_margin;
+
+	struct gref_index_header_s h = {
+		.magic = { 0 },
+		.version = GREF_INDEX_VERSION,
+		.align_size = GREF_INDEX_ALIGN_SIZE,
+		.params = gref->params,
+		.sec_cnt = gref->sec_cnt,
+		.seq_len = gref->seq_len,
+		.link_table_size = gref->link_table_size,
+		.kmer_table_size = gref->kmer_table_size,
+		.kmer_idx_table_size = gref->kmer_idx_table_size,
+		.kmer_hash_mask = gref->kmer_hash_mask,
+		.hmap_mask = raw->mask,
+		.hmap_object_size = raw->object_size,
+		.hmap_next_id = raw->next_id,
+		.block = {
+			[GREF_INDEX_HMAP_TABLE] = { .size = sizeof(uint64_t) * ((uint64_t)raw->mask + 1) },
+			[GREF_INDEX_HMAP_KEY] = { .size = raw->key_arr_size },
+			[GREF_INDEX_SECTION] = { .size = (uint64_t)raw->next_id * raw->object_size },
+			[GREF_INDEX_SEQ] = { .size = head_margin + seq_cnt * gref->seq_len + tail_margin },
+			[GREF_INDEX_LINK] = { .size = sizeof(uint32_t) * gref->link_table_size },
+			[GREF_INDEX_KMER_IDX] = { .size = sizeof(int64_t) * gref->kmer_idx_table_size },
+			[GREF_INDEX_KMER] = { .size = sizeof(struct gref_gid_pos_s) * gref->kmer_table_size },
+			[GREF_INDEX_KMER_HASH] = { .size = (gref->kmer_hash_table == NULL)
+				? 0 : sizeof(struct gref_kmer_bucket_s) * (gref->kmer_hash_mask + 1) }
+		}
+	};
+	strcpy(h.magic, GREF_INDEX_MAGIC);
+	h.params.lmm = NULL;
+	return(h);
+}
+
+/**
+ * @fn gref_dump_index_calc_offsets
+ * @brief place blocks in the order at page-aligned offsets, returns the size of the file
+ */
+static _force_inline
+uint64_t gref_dump_index_calc_offsets(
+	struct gref_index_header_s *h,
+	uint8_t const *order)
+{
+	uint64_t offset = GREF_INDEX_ALIGN_SIZE;
+	for(int64_t i = 0; i < GREF_INDEX_BLOCK_CNT; i++) {
+		h->block[order[i]].offset = offset;
+		offset += _roundup(h->block[order[i]].size, GREF_INDEX_ALIGN_SIZE);
+	}
+	return(offset);
+}
+
+/**
+ * @fn gref_dump_index_archive
+ * @brief write the header and the blocks of the archive (hmap, sections, sequence, and links)
+ */
+static _force_inline
+int gref_dump_index_archive(
+	zf_t *fp,
+	struct gref_s const *gref,
+	hmap_raw_t const *raw,
+	struct gref_index_header_s const *h)
+{
+	uint64_t seq_cnt = (gref->params.seq_direction == GREF_FW_RV) ? 2 : 1;
+	uint64_t head_margin = gref->params.seq_head_margin;
+	uint64_t tail_margin = gref->params.seq_tail_margin;
+	uint8_t const *seq_base = lmm_kv_ptr(gref->seq) + head_margin;
+
+	int ret = 0;
+	ret |= gref_dump_index_block(fp, h, sizeof(struct gref_index_header_s));
+	ret |= gref_dump_index_block(fp, raw->table, h->block[GREF_INDEX_HMAP_TABLE].size);
+	ret |= gref_dump_index_block(fp, raw->key_arr, h->block[GREF_INDEX_HMAP_KEY].size);
+	ret |= gref_dump_index_sections(fp, gref, h->block[GREF_INDEX_SECTION].size);
+
+	/* sequence with (zero-filled) margins */
+	ret |= gref_dump_index_pad(fp, head_margin);
+	ret |= (zfwrite(fp, (void *)seq_base, seq_cnt * gref->seq_len) != seq_cnt * gref->seq_len);
+	ret |= gref_dump_index_pad(fp, tail_margin
+		+ _roundup(h->block[GREF_INDEX_SEQ].size, GREF_INDEX_ALIGN_SIZE) - h->block[GREF_INDEX_SEQ].size);
+
+	ret |= gref_dump_index_block(fp, gref->link_table, h->block[GREF_INDEX_LINK].size);
+	return(ret);
+}
+
+/**
+ * @fn gref_dump_index
+ */
+int gref_dump_index(
+	gref_idx_t const *_gref,
+	char const *path)
+{
+	struct gref_s const *gref = (struct gref_s const *)_gref;
+
+	if(gref == NULL || gref->type != GREF_IDX) {
+		return(GREF_ERROR_INVALID_CONTEXT);
+	}
+	if(gref->params.copy_mode != GREF_COPY) {
+		/* sequence is not owned by the object */
+		return(GREF_ERROR_INVALID_CONTEXT);
+	}
+
+	/* collect arrays */
+	static uint8_t const order[GREF_INDEX_BLOCK_CNT] = {
+		GREF_INDEX_HMAP_TABLE, GREF_INDEX_HMAP_KEY, GREF_INDEX_SECTION, GREF_INDEX_SEQ,
+		GREF_INDEX_LINK, GREF_INDEX_KMER_IDX, GREF_INDEX_KMER, GREF_INDEX_KMER_HASH
+	};
+	hmap_raw_t raw = hmap_get_raw(gref->hmap);
+	struct gref_index_header_s h = gref_dump_index_build_header(gref, &raw);
+	gref_dump_index_calc_offsets(&h, order);
+
+	/* dump */
+	zf_t *fp = zfopen(path, "w");
+	if(fp == NULL) {
+		return(GREF_ERROR_FILE_NOT_FOUND);
+	}
+
+	int ret = gref_dump_index_archive(fp, gref, &raw, &h);
+	ret |= gref_dump_index_block(fp, gref->kmer_idx_table, h.block[GREF_INDEX_KMER_IDX].size);
+	ret |= gref_dump_index_block(fp, gref->kmer_table, h.block[GREF_INDEX_KMER].size);
+	ret |= gref_dump_index_block(fp, gref->kmer_hash_table, h.block[GREF_INDEX_KMER_HASH].size);
+
+	if(zfclose(fp) != 0 || ret != 0) {
+		return(GREF_ERROR);
+	}
+	return(GREF_SUCCESS);
+}
+
+/* out-of-core index build */
+/**
+ * @fn gref_ext_open_tmp
+ * @brief open an anonymous temporary file in $TMPDIR (or /tmp)
+ */
+static _force_inline
+int gref_ext_open_tmp(
+	void)
+{
+	char const *dir = getenv("TMPDIR");
+	dir = (dir == NULL || dir[0] == '\0') ? "/tmp" : dir;
+
+	char *path = (char *)malloc(strlen(dir) + 32);
+	if(path == NULL) { return(-1); }
+	sprintf(path, "%s/gref.XXXXXX", dir);
+
+	int fd = mkstemp(path);
+	if(fd >= 0) { unlink(path); }
+	free(path);
+	return(fd);
+}
+
+/**
+ * @fn gref_ext_pwrite, gref_ext_pread
+ * @brief write or read whole size bytes at offset, returns nonzero on failure
+ */
+static _force_inline
+int gref_ext_pwrite(
+	int fd,
+	void const *ptr,
+	uint64_t size,
+	uint64_t offset)
+{
+	while(size > 0) {
+		ssize_t w = pwrite(fd, ptr, size, offset);
+		if(w <= 0) { return(-1); }
+		ptr = (uint8_t const *)ptr + w; size -= w; offset += w;
+	}
+	return(0);
+}
+static _force_inline
+int gref_ext_pread(
+	int fd,
+	void *ptr,
+	uint64_t size,
+	uint64_t offset)
+{
+	while(size > 0) {
+		ssize_t r = pread(fd, ptr, size, offset);
+		if(r <= 0) { return(-1); }
+		ptr = (uint8_t *)ptr + r; size -= r; offset += r;
+	}
+	return(0);
+}
+
+/**
+ * @struct gref_ext_writer_s
+ * @brief buffered sequential writer from offset
+ */
+struct gref_ext_writer_s {
+	int fd;
+	int err;
+	uint64_t offset;
+	uint64_t size, cnt;
+	uint8_t *buf;
+};
+
+/**
+ * @fn gref_ext_flush
+ */
+static _force_inline
+int gref_ext_flush(
+	struct gref_ext_writer_s *w)
+{
+	w->err |= gref_ext_pwrite(w->fd, w->buf, w->cnt, w->offset);
+	w->offset += w->cnt;
+	w->cnt = 0;
+	return(w->err);
+}
+
+/**
+ * @fn gref_ext_put
+ */
+static _force_inline
+void gref_ext_put(
+	struct gref_ext_writer_s *w,
+	void const *ptr,
+	uint64_t size)
+{
+	if(w->cnt + size > w->size) { gref_ext_flush(w); }
+	memcpy(&w->buf[w->cnt], ptr, size);
+	w->cnt += size;
+	return;
+}
+
+/**
+ * @struct gref_ext_run_s
+ * @brief sorted run of (kmer, pos) pairs in the temporary file, read through buf
+ */
+struct gref_ext_run_s {
+	uint64_t pos, tail;			/* in elements */
+	uint64_t idx, cnt;			/* in buf */
+	struct gref_kmer_tuple_s *buf;
+};
+struct gref_ext_runs_s {
+	lmm_kvec_t(struct gref_ext_run_s) v;
+};
+
+/**
+ * @fn gref_ext_run_fill
+ * @brief returns nonzero if the run is exhausted (or failed to read)
+ */
+static _force_inline
+int gref_ext_run_fill(
+	int fd,
+	struct gref_ext_run_s *r,
+	uint64_t buf_cnt)
+{
+	if(r->idx < r->cnt) { return(0); }
+	r->cnt = MIN2(buf_cnt, r->tail - r->pos);
+	r->idx = 0;
+	if(r->cnt == 0 || gref_ext_pread(fd, r->buf,
+		sizeof(struct gref_kmer_tuple_s) * r->cnt, sizeof(struct gref_kmer_tuple_s) * r->pos) != 0) {
+		r->cnt = 0;
+		return(-1);
+	}
+	r->pos += r->cnt;
+	return(0);
+}
+
+/**
+ * @fn gref_ext_heap_down
+ * @brief min-heap of runs on (kmer, run index), the latter keeps the order of the stable sort
+ */
+static _force_inline
+void gref_ext_heap_down(
+	uint32_t *heap,
+	uint64_t i,
+	uint64_t cnt,
+	struct gref_ext_run_s const *run)
+{
+	#define _key(_i)		( run[heap[(_i)]].buf[run[heap[(_i)]].idx].kmer )
+	#define _less(_i, _j)	( _key(_i) < _key(_j) || (_key(_i) == _key(_j) && heap[(_i)] < heap[(_j)]) )
+	while(2 * i + 1 < cnt) {
+		uint64_t c = 2 * i + 1;
+		if(c + 1 < cnt && _less(c + 1, c)) { c++; }
+		if(!_less(c, i)) { break; }
+		uint32_t t = heap[i]; heap[i] = heap[c]; heap[c] = t;
+		i = c;
+	}
+	#undef _key
+	#undef _less
+	return;
+}
+
+/**
+ * @fn gref_ext_spill_runs
+ * @brief enumerate kmers in chunks of chunk_cnt, sort each and spill to fd. returns the number of kmers.
+ */
+static _force_inline
+int64_t gref_ext_spill_runs(
+	struct gref_s const *acv,
+	int fd,
+	uint64_t chunk_cnt,
+	struct gref_ext_runs_s *runs)
+{
+	static struct gref_iter_params_s const iter_params = {
+		.step_size = 1,
+		.seq_direction = GREF_FW_RV
+	};
+
+	struct gref_kmer_tuple_s *chunk = (struct gref_kmer_tuple_s *)malloc(sizeof(struct gref_kmer_tuple_s) * chunk_cnt);
+	struct gref_iter_s *iter = gref_iter_init_range(acv, &iter_params, 0, _encode_id(acv->sec_cnt, 0));
+	if(chunk == NULL || iter == NULL) {
+		free(chunk);
+		gref_iter_clean(iter);
+		return(-1);
+	}
+
+	int64_t total = 0;
+	int term = 0;
+	while(term == 0) {
+		uint64_t cnt = 0;
+		while(cnt < chunk_cnt) {
+			struct gref_kmer_tuple_s t = gref_iter_next(iter);
+			if(t.gid_pos.gid == (uint32_t)-1) { term = 1; break; }
+			chunk[cnt++] = t;
+		}
+		if(cnt == 0) { break; }
+
+		/* sort (stable) and spill */
+		if(psort_half(chunk, cnt, sizeof(struct gref_kmer_tuple_s), acv->params.num_threads) != 0
+		|| gref_ext_pwrite(fd, chunk, sizeof(struct gref_kmer_tuple_s) * cnt, sizeof(struct gref_kmer_tuple_s) * total) != 0) {
+			total = -1;
+			break;
+		}
+		lmm_kv_push(NULL, runs->v, ((struct gref_ext_run_s){
+			.pos = total,
+			.tail = total + cnt,
+			.idx = 0,
+			.cnt = 0,
+			.buf = NULL
+		}));
+		total += cnt;
+	}
+	gref_iter_clean(iter);
+	free(chunk);
+	return(total);
+}
+
+/**
+ * @fn gref_ext_merge_runs
+ * @brief merge runs into the kmer table (written by kw), and (kmer, head) of distinct kmers (by dw)
+ */
+static _force_inline
+int64_t gref_ext_merge_runs(
+	int fd,
+	struct gref_ext_run_s *run,
+	uint64_t run_cnt,
+	uint64_t buf_cnt,
+	struct gref_ext_writer_s *kw,
+	struct gref_ext_writer_s *dw)
+{
+	struct gref_kmer_tuple_s *buf = (struct gref_kmer_tuple_s *)malloc(
+		sizeof(struct gref_kmer_tuple_s) * buf_cnt * run_cnt);
+	uint32_t *heap = (uint32_t *)malloc(sizeof(uint32_t) * run_cnt);
+	if(buf == NULL || heap == NULL) {
+		free(buf); free(heap);
+		return(-1);
+	}
+
+	/* heapify (runs are not empty) */
+	uint64_t cnt = 0;
+	for(uint64_t i = 0; i < run_cnt; i++) {
+		run[i].buf = &buf[i * buf_cnt];
+		if(gref_ext_run_fill(fd, &run[i], buf_cnt) != 0) { continue; }
+		heap[cnt++] = i;
+	}
+	for(uint64_t i = cnt; i > 0; i--) {
+		gref_ext_heap_down(heap, i - 1, cnt, run);
+	}
+
+	int64_t head = 0, distinct_cnt = 0;
+	uint64_t prev_kmer = (uint64_t)-1;
+	while(cnt > 0) {
+		struct gref_ext_run_s *r = &run[heap[0]];
+		struct gref_kmer_tuple_s t = r->buf[r->idx++];
+
+		if(head == 0 || t.kmer != prev_kmer) {
+			int64_t d[2] = { (int64_t)t.kmer, head };
+			gref_ext_put(dw, d, sizeof(d));
+			prev_kmer = t.kmer;
+			distinct_cnt++;
+		}
+		gref_ext_put(kw, &t.gid_pos, sizeof(struct gref_gid_pos_s));
+		head++;
+
+		if(gref_ext_run_fill(fd, r, buf_cnt) != 0) {
+			heap[0] = heap[--cnt];
+		}
+		gref_ext_heap_down(heap, 0, cnt, run);
 	}
-	return(lmm_kv_ptr(kmer_idx));
+	free(buf);
+	free(heap);
+	return((gref_ext_flush(kw) | gref_ext_flush(dw)) ? -1 : distinct_cnt);
 }
 
 /**
- * @fn gref_shrink_kmer_table
+ * @fn gref_ext_dump_kmer_idx
+ * @brief read (kmer, head) of distinct kmers back and write dense or hashed kmer_idx table
  */
 static _force_inline
-struct gref_gid_pos_s *gref_shrink_kmer_table(
-	struct gref_s *acv,
-	struct gref_kmer_tuple_s *kmer_table,
-	int64_t kmer_table_size)
+int gref_ext_dump_kmer_idx(
+	struct gref_index_header_s *h,
+	int ofd,
+	int dfd,
+	int64_t distinct_cnt,
+	uint64_t buf_size)
 {
-	struct gref_gid_pos_s *packed_pos = (struct gref_gid_pos_s *)kmer_table;
-	
-	for(int64_t i = 0; i < kmer_table_size; i++) {
-		packed_pos[i] = kmer_table[i].gid_pos;
+	int dense = h->params.kmer_idx_mode == GREF_KMER_IDX_DENSE;
+	uint64_t const kmer_idx_size = 0x01ULL << (2 * h->params.k);
+	uint64_t hash_size = gref_calc_kmer_hash_size(distinct_cnt);
+	uint64_t const mask = hash_size - 1;
+
+	int64_t (*d)[2] = (int64_t (*)[2])malloc(buf_size);
+	uint8_t *wbuf = (uint8_t *)malloc(buf_size);
+	struct gref_kmer_bucket_s *bucket = dense ? NULL : (struct gref_kmer_bucket_s *)malloc(
+		sizeof(struct gref_kmer_bucket_s) * hash_size);
+	if(d == NULL || wbuf == NULL || (!dense && bucket == NULL)) {
+		free(d); free(wbuf); free(bucket);
+		return(-1);
+	}
+	if(!dense) {
+		memset(bucket, 0xff, sizeof(struct gref_kmer_bucket_s) * hash_size);
 	}
 
-	return(lmm_realloc(acv->lmm, kmer_table, sizeof(struct gref_gid_pos_s) * kmer_table_size));
+	struct gref_ext_writer_s w = {
+		.fd = ofd,
+		.offset = h->block[GREF_INDEX_KMER_IDX].offset,
+		.size = buf_size,
+		.buf = wbuf
+	};
+
+	/* as gref_build_kmer_idx_table and gref_build_kmer_hash_table do */
+	uint64_t next = 0, d_cnt = buf_size / sizeof(int64_t [2]);
+	for(int64_t i = 0; i < distinct_cnt; i += d_cnt) {
+		uint64_t cnt = MIN2(d_cnt, distinct_cnt - i);
+		if(gref_ext_pread(dfd, d, sizeof(int64_t [2]) * cnt, sizeof(int64_t [2]) * i) != 0) {
+			w.err = 1;
+			break;
+		}
+		for(uint64_t j = 0; j < cnt; j++) {
+			uint64_t kmer = d[j][0];
+			int64_t head = d[j][1];
+			if(dense) {
+				for(; next <= kmer; next++) { gref_ext_put(&w, &head, sizeof(int64_t)); }
+				continue;
+			}
+
+			/* linear probing */
+			uint64_t hv = _kmer_hash(kmer) & mask;
+			while(bucket[hv].idx >= 0) { hv = (hv + 1) & mask; }
+			bucket[hv] = (struct gref_kmer_bucket_s){
+				.kmer = kmer,
+				.idx = i + j
+			};
+			gref_ext_put(&w, &head, sizeof(int64_t));
+		}
+	}
+	int64_t tail = h->kmer_table_size;
+	for(next = dense ? next : kmer_idx_size; next <= kmer_idx_size; next++) {
+		gref_ext_put(&w, &tail, sizeof(int64_t));
+	}
+	gref_ext_flush(&w);
+
+	if(!dense) {
+		w.err |= gref_ext_pwrite(ofd, bucket, sizeof(struct gref_kmer_bucket_s) * hash_size,
+			h->block[GREF_INDEX_KMER_HASH].offset);
+	}
+	free(d); free(wbuf); free(bucket);
+	return(w.err);
 }
 
 /**
- * @fn gref_build_index
+ * @fn gref_dump_index_ext
+ * @brief build kmer index of the archive out of core and dump it to path, which is loaded with
+ * gref_load_index as the one by gref_dump_index. (kmer, pos) pairs are enumerated in chunks
+ * of mem_size / 2 bytes, sorted and spilled to a temporary file in $TMPDIR, then merged into
+ * the kmer table in the file. the arrays are identical to those of gref_build_index.
  */
-gref_idx_t *gref_build_index(
-	gref_acv_t *acv)
+int gref_dump_index_ext(
+	gref_acv_t const *_acv,
+	char const *path,
+	uint64_t mem_size)
 {
-	struct gref_s *gref = (struct gref_s *)acv;
+	struct gref_s const *acv = (struct gref_s const *)_acv;
 
-	if(gref == NULL || gref->type != GREF_ACV) {
-		goto _gref_build_index_error_handler;
+	if(acv == NULL || acv->type != GREF_ACV) {
+		return(GREF_ERROR_INVALID_CONTEXT);
 	}
-
-	/* enumerate kmers and pack into vector */
-	lmm_kvec_t(struct gref_kmer_tuple_s) v;
-	lmm_kv_init(acv->lmm, v);
-
-	static struct gref_iter_params_s const iter_params = {
-		.step_size = 1,
-		.seq_direction = GREF_FW_RV
-	};
-	struct gref_iter_s *iter = gref_iter_init(acv, &iter_params);
-	struct gref_kmer_tuple_s t;
-	int64_t i = 0;
-	while((t = gref_iter_next(iter)).gid_pos.gid != (uint32_t)-1) {
-		i++;
-		lmm_kv_push(acv->lmm, v, t);
+	if(acv->params.copy_mode != GREF_COPY) {
+		return(GREF_ERROR_INVALID_CONTEXT);
 	}
-	gref_iter_clean(iter);
 
-	/* sort kmers */
-	if(psort_half(lmm_kv_ptr(v), lmm_kv_size(v),
-		sizeof(struct gref_kmer_tuple_s), acv->params.num_threads) != 0) {
-		lmm_kv_destroy(acv->lmm, v);
-		debug("sort failed");
-		goto _gref_build_index_error_handler;
+	/* the sort buffer takes the same size as the chunk */
+	uint64_t chunk_cnt = MAX2(GREF_EXT_MIN_CHUNK_CNT, mem_size / (2 * sizeof(struct gref_kmer_tuple_s)));
+	uint64_t buf_size = MIN2(GREF_EXT_BUF_SIZE, mem_size / 4 + 1024);
+
+	int ret = GREF_ERROR;
+	int tfd = gref_ext_open_tmp(), dfd = gref_ext_open_tmp(), ofd = -1;
+	uint8_t *kbuf = (uint8_t *)malloc(buf_size), *dbuf = (uint8_t *)malloc(buf_size);
+	struct gref_ext_runs_s runs;
+	lmm_kv_init(NULL, runs.v);
+	if(tfd < 0 || dfd < 0 || kbuf == NULL || dbuf == NULL) {
+		goto _gref_dump_index_ext_error_handler;
 	}
 
-	/* build index of kmer table */
-	gref->kmer_idx_table = gref_build_kmer_idx_table(acv, lmm_kv_ptr(v), lmm_kv_size(v));
-	if(gref->kmer_idx_table == NULL) {
-		debug("failed to build index table");
-		goto _gref_build_index_error_handler;
+	/* sorted runs */
+	int64_t kmer_table_size = gref_ext_spill_runs(acv, tfd, chunk_cnt, &runs);
+	if(kmer_table_size < 0) {
+		goto _gref_dump_index_ext_error_handler;
 	}
 
-	/* shrink table */
-	gref->kmer_table_size = lmm_kv_size(v);
-	gref->kmer_table = gref_shrink_kmer_table(acv, lmm_kv_ptr(v), lmm_kv_size(v));
-	if(gref->kmer_table == NULL) {
-		debug("failed to shrink");
-		goto _gref_build_index_error_handler;
+	/* kmer table follows the link table; kmer_idx and hash tables are placed after it */
+	static uint8_t const order[GREF_INDEX_BLOCK_CNT] = {
+		GREF_INDEX_HMAP_TABLE, GREF_INDEX_HMAP_KEY, GREF_INDEX_SECTION, GREF_INDEX_SEQ,
+		GREF_INDEX_LINK, GREF_INDEX_KMER, GREF_INDEX_KMER_IDX, GREF_INDEX_KMER_HASH
+	};
+	hmap_raw_t raw = hmap_get_raw(acv->hmap);
+	struct gref_index_header_s h = gref_dump_index_build_header(acv, &raw);
+	h.kmer_table_size = kmer_table_size;
+	h.block[GREF_INDEX_KMER].size = sizeof(struct gref_gid_pos_s) * kmer_table_size;
+	gref_dump_index_calc_offsets(&h, order);
+
+	/* archive part, the header is rewritten at the end */
+	zf_t *fp = zfopen(path, "w");
+	if(fp == NULL) {
+		ret = GREF_ERROR_FILE_NOT_FOUND;
+		goto _gref_dump_index_ext_error_handler;
+	}
+	if((gref_dump_index_archive(fp, acv, &raw, &h) | zfclose(fp)) != 0) {
+		goto _gref_dump_index_ext_error_handler;
+	}
+	if((ofd = open(path, O_WRONLY)) < 0) {
+		goto _gref_dump_index_ext_error_handler;
 	}
 
-	/* store misc constants for kmer matching */
-	gref->mask = (0x01<<(2 * gref->params.k)) - 1;
+	/* merge runs into the kmer table */
+	struct gref_ext_writer_s kw = { .fd = ofd, .offset = h.block[GREF_INDEX_KMER].offset, .size = buf_size, .buf = kbuf };
+	struct gref_ext_writer_s dw = { .fd = dfd, .offset = 0, .size = buf_size, .buf = dbuf };
+	uint64_t run_cnt = lmm_kv_size(runs.v);
+	uint64_t run_buf_cnt = MAX2(1, chunk_cnt / MAX2(1, run_cnt));
+	int64_t distinct_cnt = gref_ext_merge_runs(tfd, lmm_kv_ptr(runs.v), run_cnt, run_buf_cnt, &kw, &dw);
+	if(distinct_cnt < 0) {
+		goto _gref_dump_index_ext_error_handler;
+	}
 
-	/* change state */
-	gref->type = GREF_IDX;
-	return((gref_idx_t *)gref);
+	/* kmer_idx table */
+	if(h.params.kmer_idx_mode == GREF_KMER_IDX_AUTO) {
+		h.params.kmer_idx_mode = gref_select_kmer_idx_mode(h.params.k, distinct_cnt);
+	}
+	if(h.params.kmer_idx_mode == GREF_KMER_IDX_DENSE) {
+		h.kmer_idx_table_size = (0x01ULL << (2 * h.params.k)) + 1;
+	} else {
+		h.kmer_idx_table_size = distinct_cnt + 1;
+		h.kmer_hash_mask = gref_calc_kmer_hash_size(distinct_cnt) - 1;
+		h.block[GREF_INDEX_KMER_HASH].size = sizeof(struct gref_kmer_bucket_s) * (h.kmer_hash_mask + 1);
+	}
+	h.block[GREF_INDEX_KMER_IDX].size = sizeof(int64_t) * h.kmer_idx_table_size;
+	uint64_t file_size = gref_dump_index_calc_offsets(&h, order);
 
-_gref_build_index_error_handler:;
-	gref_clean((gref_t *)gref);
-	return(NULL);
+	if(gref_ext_dump_kmer_idx(&h, ofd, dfd, distinct_cnt, buf_size) != 0
+	|| ftruncate(ofd, file_size) != 0
+	|| gref_ext_pwrite(ofd, &h, sizeof(struct gref_index_header_s), 0) != 0) {
+		goto _gref_dump_index_ext_error_handler;
+	}
+	ret = GREF_SUCCESS;
+
+_gref_dump_index_ext_error_handler:;
+	if(ofd >= 0 && close(ofd) != 0) { ret = GREF_ERROR; }
+	if(tfd >= 0) { close(tfd); }
+	if(dfd >= 0) { close(dfd); }
+	free(kbuf);
+	free(dbuf);
+	lmm_kv_destroy(NULL, runs.v);
+	return(ret);
 }
 
 /**
- * @fn gref_disable_index
+ * @fn gref_load_index_check_header
  */
-gref_acv_t *gref_disable_index(
-	gref_idx_t *idx)
+static _force_inline
+int gref_load_index_check_header(
+	struct gref_index_header_s const *h,
+	uint64_t file_size)
 {
-	struct gref_s *gref = (struct gref_s *)idx;
-
-	if(gref == NULL || gref->type != GREF_IDX) {
-		gref_clean((gref_t *)gref);
-		return(NULL);
+	if(file_size < sizeof(struct gref_index_header_s)) { return(-1); }
+	if(strncmp(h->magic, GREF_INDEX_MAGIC, sizeof(h->magic)) != 0) { return(-1); }
+	if(h->version != GREF_INDEX_VERSION) { return(-1); }
+	if(h->params.k < K_MIN || h->params.k > K_MAX) { return(-1); }
+	if(h->params.seq_direction != GREF_FW_ONLY && h->params.seq_direction != GREF_FW_RV) { return(-1); }
+	if(h->hmap_next_id < h->sec_cnt + 1) { return(-1); }
+	if(h->block[GREF_INDEX_KMER_IDX].size != sizeof(int64_t) * h->kmer_idx_table_size) { return(-1); }
+	if(h->block[GREF_INDEX_KMER_HASH].size != 0
+	&& h->block[GREF_INDEX_KMER_HASH].size != sizeof(struct gref_kmer_bucket_s) * (h->kmer_hash_mask + 1)) {
+		return(-1);
 	}
 
-	/* cleanup kmer_idx_table */
-	lmm_free(idx->lmm, idx->kmer_idx_table); idx->kmer_idx_table = NULL;
-
-	/* change state */
-	gref->type = GREF_ACV;
-	return((gref_acv_t *)gref);
+	for(int64_t i = 0; i < GREF_INDEX_BLOCK_CNT; i++) {
+		if(h->block[i].offset + h->block[i].size > file_size) { return(-1); }
+	}
+	return(0);
 }
 
 /**
- * @fn gref_match_2bitpacked
+ * @fn gref_load_index_rebase_sections
+ * @brief convert offsets in the section objects to pointers into the mapped sequence
  */
-struct gref_match_res_s gref_match_2bitpacked(
-	gref_idx_t const *_gref,
-	uint64_t seq)
+static _force_inline
+void gref_load_index_rebase_sections(
+	struct gref_s *gref,
+	uint8_t const *seq_base)
 {
-	struct gref_s const *gref = (struct gref_s const *)_gref;
-	seq &= gref->mask;
-	int64_t base = gref->kmer_idx_table[seq];
-	int64_t tail = gref->kmer_idx_table[seq + 1];
+	struct gref_section_intl_s *sec =
+		(struct gref_section_intl_s *)hmap_get_object(gref->hmap, 0);
 
-	debug("seq(%llx), mask(%llx), base(%lld), tail(%lld)",
-		seq, gref->mask, base, tail);
-	return((struct gref_match_res_s){
-		.gid_pos_arr = &gref->kmer_table[base],
-		.len = tail - base
-	});
-}
+	if(gref->params.seq_direction == GREF_FW_ONLY) {
+		/* reverse sequence is mapped out of the canonical address (see gref_fw_copy_modify_seq) */
+		gref->seq_lim = GREF_SEQ_LIM;
+		uint8_t const *rv_lim = GREF_SEQ_LIM + (uint64_t)GREF_SEQ_LIM;
 
-/**
- * @fn gref_match
- * @brief seq length must be equal to k.
- */
-struct gref_match_res_s gref_match(
-	gref_idx_t const *_gref,
-	uint8_t const *seq)
-{
-	struct gref_s const *gref = (struct gref_s const *)_gref;
-	int64_t const seed_len = gref->params.k;
-	int64_t const shift_len = 2 * (seed_len - 1);
+		for(int64_t i = 0; i < gref->sec_cnt; i++) {
+			sec[i].fw_sec.base += (uint64_t)seq_base;
+			sec[i].rv_sec.base = rv_lim - (uint64_t)sec[i].fw_sec.base - sec[i].fw_sec.len;
+		}
+	} else {
+		/* reverse sequence follows the forward one (see gref_fr_copy_modify_seq) */
+		uint8_t const *rv_lim = gref->seq_lim = seq_base + 2 * gref->seq_len;
 
-	uint64_t packed_seq = 0;
-	for(int64_t i = 0; i < seed_len; i++) {
-		packed_seq = (packed_seq>>2) | (gref_encode_2bit(seq[i])<<shift_len);
+		for(int64_t i = 0; i < gref->sec_cnt; i++) {
+			sec[i].rv_sec.base = rv_lim - (uint64_t)sec[i].fw_sec.base - sec[i].fw_sec.len;
+			sec[i].fw_sec.base += (uint64_t)seq_base;
+		}
 	}
-	return(gref_match_2bitpacked((gref_t const *)gref, packed_seq));
-}
-
-/* misc */
-#if 0
-/**
- * @fn gref_dump_index
- */
-int gref_dump_index(
-	gref_t const *gref,
-	zf_t *outfp)
-{
-	return(0);
+	return;
 }
 
 /**
  * @fn gref_load_index
+ * @brief map index file dumped with gref_dump_index. large arrays (sequence, link and
+ * kmer tables) are not copied, thus shared among processes via the page cache.
  */
-gref_t *gref_load_index(
-	zf_t *infp)
+gref_idx_t *gref_load_index(
+	char const *path,
+	gref_params_t const *params)
 {
-	return(NULL);
+	struct gref_params_s const default_params = { 0 };
+	params = (params == NULL) ? &default_params : params;
+
+	if(path == NULL) { return(NULL); }
+
+	/* map the whole file */
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) { return(NULL); }
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size < sizeof(struct gref_index_header_s)) {
+		close(fd);
+		return(NULL);
+	}
+	void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED) { return(NULL); }
+
+	/* check header and params */
+	struct gref_index_header_s const *h = (struct gref_index_header_s const *)base;
+	if(gref_load_index_check_header(h, st.st_size) != 0
+	|| (params->k != 0 && params->k != h->params.k)
+	|| (params->seq_direction != 0 && params->seq_direction != h->params.seq_direction)) {
+		debug("broken or incompatible index file");
+		munmap(base, st.st_size);
+		return(NULL);
+	}
+	#define _block(_b)		( (uint8_t *)base + h->block[(_b)].offset )
+
+	/* malloc mem */
+	lmm_t *lmm = (lmm_t *)params->lmm;
+	struct gref_s *gref = (struct gref_s *)lmm_malloc(lmm,
+		sizeof(struct gref_s) + h->params.seq_head_margin + h->params.seq_tail_margin);
+	if(gref == NULL) {
+		munmap(base, st.st_size);
+		return(NULL);
+	}
+	memset(gref, 0, sizeof(struct gref_s));
+	gref->lmm = lmm;
+	gref->map_base = base;
+	gref->map_size = st.st_size;
+
+	/* restore params */
+	gref->params = h->params;
+	gref->params.num_threads = params->num_threads;
+	gref->params.lmm = lmm;
+	gref->iter_init_stack_size = gref_calc_iter_init_stack_size(gref->params.k);
+
+	/* copy name -> section mapping (the only mutable part) */
+	gref->hmap = hmap_init_raw(
+		&((hmap_raw_t const){
+			.mask = h->hmap_mask,
+			.object_size = h->hmap_object_size,
+			.next_id = h->hmap_next_id,
+			.table = _block(GREF_INDEX_HMAP_TABLE),
+			.key_arr = _block(GREF_INDEX_HMAP_KEY),
+			.key_arr_size = h->block[GREF_INDEX_HMAP_KEY].size,
+			.object_arr = _block(GREF_INDEX_SECTION)
+		}),
+		HMAP_PARAMS( .lmm = lmm ));
+	if(gref->hmap == NULL) {
+		gref_clean((gref_t *)gref);
+		return(NULL);
+	}
+	gref->sec_cnt = h->sec_cnt;
+
+	/* sequence */
+	lmm_kv_ptr(gref->seq) = _block(GREF_INDEX_SEQ);
+	lmm_kv_size(gref->seq) = lmm_kv_max(gref->seq) = h->block[GREF_INDEX_SEQ].size;
+	gref->seq_len = h->seq_len;
+	gref_load_index_rebase_sections(gref, _block(GREF_INDEX_SEQ) + gref->params.seq_head_margin);
+
+	/* link table */
+	lmm_kv_ptr(gref->link) = (struct gref_gid_pair_s *)_block(GREF_INDEX_LINK);
+	lmm_kv_size(gref->link) = lmm_kv_max(gref->link) = h->link_table_size / 2;
+	gref->link_table_size = h->link_table_size;
+	gref->link_table = (uint32_t *)_block(GREF_INDEX_LINK);
+
+	/* kmer tables */
+	gref->mask = 0xffffffffffffffff>>(64 - 2 * gref->params.k);
+	gref->kmer_idx_table = (int64_t *)_block(GREF_INDEX_KMER_IDX);
+	gref->kmer_idx_table_size = h->kmer_idx_table_size;
+	gref->kmer_table_size = h->kmer_table_size;
+	gref->kmer_table = (struct gref_gid_pos_s *)_block(GREF_INDEX_KMER);
+	if(h->block[GREF_INDEX_KMER_HASH].size != 0) {
+		gref->kmer_hash_table = (struct gref_kmer_bucket_s *)_block(GREF_INDEX_KMER_HASH);
+		gref->kmer_hash_mask = h->kmer_hash_mask;
+	}
+
+	#undef _block
+
+	/* mapped object is immutable */
+	gref->append_seq = NULL;
+	gref->type = GREF_IDX;
+	return((gref_idx_t *)gref);
 }
-#endif
 
+/* misc */
 /**
  * @fn gref_get_section_count
  */
@@ -1789,6 +3557,22 @@ int64_t gref_get_total_len(
 	return(gref->seq_len);
 }
 
+/**
+ * @fn gref_get_index_size
+ */
+int64_t gref_get_index_size(
+	gref_t const *_gref)
+{
+	struct gref_s const *gref = (struct gref_s const *)_gref;
+	uint64_t seq_cnt = (gref->params.seq_direction == GREF_FW_RV) ? 2 : 1;
+	uint64_t hash_size = (gref->kmer_hash_table == NULL) ? 0 : gref->kmer_hash_mask + 1;
+	return(gref->params.seq_head_margin + seq_cnt * gref->seq_len + gref->params.seq_tail_margin
+		+ sizeof(uint32_t) * gref->link_table_size
+		+ sizeof(struct gref_gid_pos_s) * gref->kmer_table_size
+		+ sizeof(int64_t) * gref->kmer_idx_table_size
+		+ sizeof(struct gref_kmer_bucket_s) * hash_size);
+}
+
 /**
  * @fn gref_get_lim
  * @brief type must be ACV or IDX, otherwise return value is invalid
@@ -1805,7 +3589,7 @@ uint8_t const *gref_get_lim(
  */
 unittest_config(
 	.name = "gref",
-	.depends_on = { "psort", "hmap", "zf" }
+	.depends_on = { "psort", "ptask", "hmap", "zf" }
 );
 
 /**
@@ -1846,7 +3630,7 @@ char *unittest_generate_random_sequence(
 	int64_t _len = strlen(x); \
 	uint8_t _shift_len = 2 * (_len - 1); \
 	for(int64_t i = 0; i < _len; i++) { \
-		_packed_seq = (_packed_seq>>2) | (gref_encode_2bit((x)[i])<<_shift_len); \
+		_packed_seq = (_packed_seq>>2) | ((uint64_t)gref_encode_2bit((x)[i])<<_shift_len); \
 	} \
 	_packed_seq; \
 })
@@ -2667,6 +4451,379 @@ unittest()
 	gref_clean(idx);
 }
 
+/* dump and load */
+unittest()
+{
+	char const *filename = "tmp.gref";
+	gref_pool_t *pool = gref_init_pool(GREF_PARAMS(
+		.k = 4,
+		.seq_head_margin = 32,
+		.seq_tail_margin = 32));
+	gref_append_segment(pool, _str("sec0"), _seq("GGRA"));
+	gref_append_segment(pool, _str("sec1"), _seq("MGGG"));
+	gref_append_link(pool, _str("sec0"), 0, _str("sec1"), 0);
+	gref_append_link(pool, _str("sec1"), 0, _str("sec2"), 0);
+	gref_append_segment(pool, _str("sec2"), _seq("ACVVGTGT"));
+	gref_append_link(pool, _str("sec0"), 0, _str("sec2"), 0);
+	gref_idx_t *idx = gref_build_index(gref_freeze_pool(pool));
+
+	int ret = gref_dump_index(idx, filename);
+	assert(ret == GREF_SUCCESS, "%d", ret);
+
+	/* incompatible params */
+	assert(gref_load_index(filename, GREF_PARAMS( .k = 5 )) == NULL);
+
+	gref_idx_t *ldx = gref_load_index(filename, NULL);
+	assert(ldx != NULL, "%p", ldx);
+	assert(gref_get_section_count(ldx) == gref_get_section_count(idx),
+		"%lld, %lld", gref_get_section_count(ldx), gref_get_section_count(idx));
+	assert(gref_get_total_len(ldx) == gref_get_total_len(idx),
+		"%lld, %lld", gref_get_total_len(ldx), gref_get_total_len(idx));
+
+	for(uint32_t gid = 0; gid < 6; gid++) {
+		/* sections, names, and links */
+		struct gref_section_s const *s = gref_get_section(idx, gid);
+		struct gref_section_s const *l = gref_get_section(ldx, gid);
+		assert(s->gid == l->gid && s->len == l->len, "%u, %u", s->gid, l->gid);
+		assert((gid & 0x01) != 0 || memcmp(s->base, l->base, s->len) == 0);	/* reverse bases are virtual in FW_ONLY mode */
+		assert(strcmp(gref_get_name(idx, gid).ptr, gref_get_name(ldx, gid).ptr) == 0);
+
+		struct gref_link_s sl = gref_get_link(idx, gid), ll = gref_get_link(ldx, gid);
+		assert(sl.len == ll.len, "%lld, %lld", sl.len, ll.len);
+		assert(memcmp(sl.gid_arr, ll.gid_arr, sizeof(uint32_t) * sl.len) == 0);
+	}
+
+	/* kmer matches */
+	char const *q[] = { "GTGT", "CGGG", "GGGA", "TTTT" };
+	for(int64_t i = 0; i < 4; i++) {
+		struct gref_match_res_s r = gref_match(idx, (uint8_t const *)q[i]);
+		struct gref_match_res_s m = gref_match(ldx, (uint8_t const *)q[i]);
+		assert(r.len == m.len, "%lld, %lld", r.len, m.len);
+		assert(r.len == 0 || memcmp(r.gid_pos_arr, m.gid_pos_arr, sizeof(struct gref_gid_pos_s) * r.len) == 0);
+	}
+
+	gref_clean(ldx);
+	gref_clean(idx);
+	remove(filename);
+}
+
+/* hashed kmer index */
+unittest()
+{
+	/* pseudorandom sequence */
+	char seq[1024];
+	uint64_t x = 12345;
+	for(int64_t i = 0; i < 1023; i++) {
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+		seq[i] = "ACGT"[x>>62];
+	}
+	seq[1023] = '\0';
+
+	gref_idx_t *idx[2];
+	for(int64_t j = 0; j < 2; j++) {
+		gref_pool_t *pool = gref_init_pool(GREF_PARAMS(
+			.k = 6,
+			.kmer_idx_mode = (j == 0) ? GREF_KMER_IDX_DENSE : GREF_KMER_IDX_HASH));
+		gref_append_segment(pool, _str("sec0"), (uint8_t const *)seq, 1023);
+		idx[j] = gref_build_index(gref_freeze_pool(pool));
+		assert(idx[j] != NULL, "%p", idx[j]);
+	}
+
+	/* all kmers give the same result */
+	for(uint64_t kmer = 0; kmer < 4096; kmer++) {
+		struct gref_match_res_s d = gref_match_2bitpacked(idx[0], kmer);
+		struct gref_match_res_s h = gref_match_2bitpacked(idx[1], kmer);
+		assert(d.len == h.len, "kmer(%llx), %lld, %lld", kmer, d.len, h.len);
+		assert(d.len == 0 || memcmp(d.gid_pos_arr, h.gid_pos_arr, sizeof(struct gref_gid_pos_s) * d.len) == 0);
+	}
+	gref_clean(idx[0]);
+	gref_clean(idx[1]);
+
+	/* long kmer */
+	gref_pool_t *pool = gref_init_pool(GREF_PARAMS( .k = 32 ));
+	gref_append_segment(pool, _str("sec0"), (uint8_t const *)seq, 1023);
+	gref_idx_t *lidx = gref_build_index(gref_freeze_pool(pool));
+	assert(lidx != NULL, "%p", lidx);
+
+	struct gref_match_res_s r = gref_match(lidx, (uint8_t const *)&seq[100]);
+	assert(r.len == 1, "%lld", r.len);
+	assert(r.gid_pos_arr[0].pos == 100, "%u", r.gid_pos_arr[0].pos);
+	gref_clean(lidx);
+}
+
+/* batch match */
+unittest()
+{
+	char seq[1024];
+	uint64_t x = 54321;
+	for(int64_t i = 0; i < 1023; i++) {
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+		seq[i] = "ACGT"[x>>62];
+	}
+	seq[1023] = '\0';
+
+	for(int64_t j = 0; j < 2; j++) {
+		gref_pool_t *pool = gref_init_pool(GREF_PARAMS(
+			.k = 6,
+			.kmer_idx_mode = (j == 0) ? GREF_KMER_IDX_DENSE : GREF_KMER_IDX_HASH));
+		gref_append_segment(pool, _str("sec0"), (uint8_t const *)seq, 1023);
+		gref_idx_t *idx = gref_build_index(gref_freeze_pool(pool));
+
+		/* crosses the batch boundary */
+		uint64_t kmer[100];
+		struct gref_match_res_s res[100];
+		for(int64_t i = 0; i < 100; i++) {
+			kmer[i] = (i * 0x9e3779b97f4a7c15ULL)>>52;
+		}
+		gref_match_batch(idx, kmer, res, 100);
+
+		for(int64_t i = 0; i < 100; i++) {
+			struct gref_match_res_s m = gref_match_2bitpacked(idx, kmer[i]);
+			assert(m.len == res[i].len, "%lld, %lld", m.len, res[i].len);
+			assert(m.len == 0 || m.gid_pos_arr == res[i].gid_pos_arr, "%p, %p", m.gid_pos_arr, res[i].gid_pos_arr);
+		}
+		gref_clean(idx);
+	}
+}
+
+/* parallel kmer enumeration */
+unittest()
+{
+	char seq[4096];
+	uint64_t x = 11111;
+	for(int64_t i = 0; i < 4095; i++) {
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+		seq[i] = "ACGTN"[(x>>32) % ((i % 97 == 0) ? 5 : 4)];
+	}
+	seq[4095] = '\0';
+
+	struct gref_s *idx[2];
+	for(int64_t j = 0; j < 2; j++) {
+		gref_pool_t *pool = gref_init_pool(GREF_PARAMS(
+			.k = 8,
+			.num_threads = (j == 0) ? 0 : 4));
+		gref_append_segment(pool, _str("sec0"), (uint8_t const *)&seq[0], 1000);
+		gref_append_segment(pool, _str("sec1"), (uint8_t const *)&seq[1000], 5);
+		gref_append_segment(pool, _str("sec2"), (uint8_t const *)&seq[1005], 2000);
+		gref_append_segment(pool, _str("sec3"), (uint8_t const *)&seq[3005], 1090);
+		gref_append_link(pool, _str("sec0"), 0, _str("sec1"), 0);
+		gref_append_link(pool, _str("sec1"), 0, _str("sec2"), 0);
+		gref_append_link(pool, _str("sec1"), 0, _str("sec3"), 1);
+		idx[j] = (struct gref_s *)gref_build_index(gref_freeze_pool(pool));
+		assert(idx[j] != NULL, "%p", idx[j]);
+	}
+
+	/* identical to the single-threaded one */
+	assert(idx[0]->kmer_table_size == idx[1]->kmer_table_size,
+		"%lld, %lld", idx[0]->kmer_table_size, idx[1]->kmer_table_size);
+	assert(memcmp(idx[0]->kmer_table, idx[1]->kmer_table,
+		sizeof(struct gref_gid_pos_s) * idx[0]->kmer_table_size) == 0);
+	gref_clean((gref_t *)idx[0]);
+	gref_clean((gref_t *)idx[1]);
+}
+
+/* counting build */
+unittest()
+{
+	char seq[4096];
+	uint64_t x = 33333;
+	for(int64_t i = 0; i < 4095; i++) {
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+		seq[i] = "ACGTN"[(x>>32) % ((i % 97 == 0) ? 5 : 4)];
+	}
+	seq[4095] = '\0';
+
+	/* dense index at k = 8, hashed one (converted from the dense) at k = 10 */
+	for(int64_t k = 8; k <= 10; k += 2) {
+		struct gref_s *idx[3];
+		for(int64_t j = 0; j < 3; j++) {
+			gref_pool_t *pool = gref_init_pool(GREF_PARAMS(
+				.k = k,
+				.seq_direction = GREF_FW_RV,
+				.kmer_idx_mode = (k == 8) ? GREF_KMER_IDX_DENSE : GREF_KMER_IDX_AUTO,
+				.kmer_build_mode = (j == 0) ? GREF_KMER_BUILD_SORT : GREF_KMER_BUILD_COUNT,
+				.num_threads = (j == 2) ? 4 : 0));
+			gref_append_segment(pool, _str("sec0"), (uint8_t const *)&seq[0], 1000);
+			gref_append_segment(pool, _str("sec1"), (uint8_t const *)&seq[1000], 5);
+			gref_append_segment(pool, _str("sec2"), (uint8_t const *)&seq[1005], 2000);
+			gref_append_segment(pool, _str("sec3"), (uint8_t const *)&seq[3005], 1090);
+			gref_append_segment(pool, _str("sec4"), (uint8_t const *)&seq[0], 1000);
+			gref_append_link(pool, _str("sec0"), 0, _str("sec1"), 0);
+			gref_append_link(pool, _str("sec1"), 0, _str("sec2"), 0);
+			gref_append_link(pool, _str("sec1"), 0, _str("sec3"), 1);
+			gref_append_link(pool, _str("sec4"), 1, _str("sec1"), 0);
+			idx[j] = (struct gref_s *)gref_build_index(gref_freeze_pool(pool));
+			assert(idx[j] != NULL, "%p", idx[j]);
+		}
+
+		/* identical to the sort build */
+		assert(idx[0]->params.kmer_idx_mode == ((k == 8) ? GREF_KMER_IDX_DENSE : GREF_KMER_IDX_HASH),
+			"%u", idx[0]->params.kmer_idx_mode);
+		for(int64_t j = 1; j < 3; j++) {
+			assert(idx[j]->params.kmer_idx_mode == idx[0]->params.kmer_idx_mode, "%u", idx[j]->params.kmer_idx_mode);
+			assert(idx[j]->kmer_table_size == idx[0]->kmer_table_size,
+				"%lld, %lld", idx[j]->kmer_table_size, idx[0]->kmer_table_size);
+			assert(memcmp(idx[j]->kmer_table, idx[0]->kmer_table,
+				sizeof(struct gref_gid_pos_s) * idx[0]->kmer_table_size) == 0, "k(%lld), j(%lld)", k, j);
+			assert(idx[j]->kmer_idx_table_size == idx[0]->kmer_idx_table_size,
+				"%lld, %lld", idx[j]->kmer_idx_table_size, idx[0]->kmer_idx_table_size);
+			assert(memcmp(idx[j]->kmer_idx_table, idx[0]->kmer_idx_table,
+				sizeof(int64_t) * idx[0]->kmer_idx_table_size) == 0, "k(%lld), j(%lld)", k, j);
+			if(idx[0]->params.kmer_idx_mode == GREF_KMER_IDX_HASH) {
+				assert(idx[j]->kmer_hash_mask == idx[0]->kmer_hash_mask, "%llx", idx[j]->kmer_hash_mask);
+				assert(memcmp(idx[j]->kmer_hash_table, idx[0]->kmer_hash_table,
+					sizeof(struct gref_kmer_bucket_s) * (idx[0]->kmer_hash_mask + 1)) == 0, "k(%lld), j(%lld)", k, j);
+			}
+		}
+		for(int64_t j = 0; j < 3; j++) {
+			gref_clean((gref_t *)idx[j]);
+		}
+	}
+}
+
+/* out-of-core build */
+unittest()
+{
+	char const *filename[2] = { "tmp.gref", "tmp.ext.gref" };
+	char seq[4096];
+	uint64_t x = 44444;
+	for(int64_t i = 0; i < 4095; i++) {
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+		seq[i] = "ACGTN"[(x>>32) % ((i % 89 == 0) ? 5 : 4)];
+	}
+	seq[4095] = '\0';
+
+	for(int64_t k = 8; k <= 10; k += 2) {
+		for(int64_t j = 0; j < 2; j++) {
+			gref_pool_t *pool = gref_init_pool(GREF_PARAMS(
+				.k = k,
+				.seq_direction = GREF_FW_RV,
+				.seq_head_margin = 32,
+				.seq_tail_margin = 32,
+				.num_threads = 2 * j));
+			gref_append_segment(pool, _str("sec0"), (uint8_t const *)&seq[0], 1500);
+			gref_append_segment(pool, _str("sec1"), (uint8_t const *)&seq[1500], 7);
+			gref_append_segment(pool, _str("sec2"), (uint8_t const *)&seq[1507], 2588);
+			gref_append_link(pool, _str("sec0"), 0, _str("sec1"), 0);
+			gref_append_link(pool, _str("sec1"), 0, _str("sec2"), 1);
+			gref_append_link(pool, _str("sec0"), 1, _str("sec2"), 0);
+			gref_acv_t *acv = gref_freeze_pool(pool);
+
+			/* spilled in runs of the minimum size */
+			int ret = GREF_ERROR;
+			if(j == 0) {
+				gref_idx_t *idx = gref_build_index(acv);
+				ret = gref_dump_index(idx, filename[j]);
+				gref_clean(idx);
+			} else {
+				ret = gref_dump_index_ext(acv, filename[j], 1024);
+				gref_clean(acv);
+			}
+			assert(ret == GREF_SUCCESS, "%d", ret);
+		}
+
+		struct gref_s *ldx[2] = {
+			(struct gref_s *)gref_load_index(filename[0], NULL),
+			(struct gref_s *)gref_load_index(filename[1], NULL)
+		};
+		assert(ldx[0] != NULL && ldx[1] != NULL, "%p, %p", ldx[0], ldx[1]);
+		assert(ldx[1]->params.kmer_idx_mode == ((k == 8) ? GREF_KMER_IDX_DENSE : GREF_KMER_IDX_HASH),
+			"%u", ldx[1]->params.kmer_idx_mode);
+		assert(ldx[1]->params.kmer_idx_mode == ldx[0]->params.kmer_idx_mode, "%u", ldx[1]->params.kmer_idx_mode);
+
+		/* identical to the in-memory build */
+		#define _cmp_arr(_f, _size) { \
+			assert(memcmp(ldx[0]->_f, ldx[1]->_f, (_size)) == 0, "k(%lld)", k); \
+		}
+		assert(ldx[1]->seq_len == ldx[0]->seq_len, "%llu, %llu", ldx[1]->seq_len, ldx[0]->seq_len);
+		assert(ldx[1]->link_table_size == ldx[0]->link_table_size, "%lld", ldx[1]->link_table_size);
+		assert(ldx[1]->kmer_table_size == ldx[0]->kmer_table_size,
+			"%lld, %lld", ldx[1]->kmer_table_size, ldx[0]->kmer_table_size);
+		assert(ldx[1]->kmer_idx_table_size == ldx[0]->kmer_idx_table_size,
+			"%lld, %lld", ldx[1]->kmer_idx_table_size, ldx[0]->kmer_idx_table_size);
+		_cmp_arr(link_table, sizeof(uint32_t) * ldx[0]->link_table_size);
+		_cmp_arr(kmer_table, sizeof(struct gref_gid_pos_s) * ldx[0]->kmer_table_size);
+		_cmp_arr(kmer_idx_table, sizeof(int64_t) * ldx[0]->kmer_idx_table_size);
+		if(ldx[0]->params.kmer_idx_mode == GREF_KMER_IDX_HASH) {
+			assert(ldx[1]->kmer_hash_mask == ldx[0]->kmer_hash_mask, "%llx", ldx[1]->kmer_hash_mask);
+			_cmp_arr(kmer_hash_table, sizeof(struct gref_kmer_bucket_s) * (ldx[0]->kmer_hash_mask + 1));
+		}
+		for(uint32_t gid = 0; gid < 6; gid++) {
+			struct gref_section_s const *s = gref_get_section((gref_t const *)ldx[0], gid);
+			struct gref_section_s const *l = gref_get_section((gref_t const *)ldx[1], gid);
+			assert(s->len == l->len && memcmp(s->base, l->base, s->len) == 0, "gid(%u)", gid);
+		}
+		#undef _cmp_arr
+
+		gref_clean((gref_t *)ldx[0]);
+		gref_clean((gref_t *)ldx[1]);
+		remove(filename[0]);
+		remove(filename[1]);
+	}
+}
+
+/* parallel freeze and melt */
+unittest()
+{
+	int64_t const sec_cnt = 1000, link_cnt = 300000;
+	char seq[301];
+	uint64_t x = 22222;
+
+	struct gref_s *acv[2];
+	for(int64_t j = 0; j < 2; j++) {
+		gref_pool_t *pool = gref_init_pool(GREF_PARAMS(
+			.k = 8,
+			.seq_direction = GREF_FW_RV,
+			.num_threads = (j == 0) ? 0 : 4));
+
+		x = 22222;
+		for(int64_t i = 0; i < sec_cnt; i++) {
+			char name[32];
+			for(int64_t k = 0; k < 300; k++) {
+				x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+				seq[k] = "ACGT"[(x>>32) & 0x03];
+			}
+			gref_append_segment(pool, name, sprintf(name, "s%lld", (long long)i), (uint8_t const *)seq, 300);
+		}
+		for(int64_t i = 0; i < link_cnt; i++) {
+			char src[32], dst[32];
+			x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+			int src_len = sprintf(src, "s%lld", (long long)((x>>32) % (sec_cnt / 2)));
+			int dst_len = sprintf(dst, "s%lld", (long long)((x>>16) % sec_cnt));
+			gref_append_link(pool, src, src_len, (x>>8) & 0x01, dst, dst_len, (x>>9) & 0x01);
+		}
+		acv[j] = (struct gref_s *)gref_freeze_pool(pool);
+		assert(acv[j] != NULL, "%p", acv[j]);
+	}
+
+	/* identical to the single-threaded one */
+	#define _cmp_acv(_a, _b) { \
+		assert((_a)->link_table_size == (_b)->link_table_size, "%lld, %lld", (_a)->link_table_size, (_b)->link_table_size); \
+		assert(memcmp((_a)->link_table, (_b)->link_table, sizeof(uint32_t) * (_a)->link_table_size / 2) == 0); \
+		for(uint32_t gid = 0; gid < 2 * sec_cnt; gid++) { \
+			struct gref_link_s la = gref_get_link((gref_t const *)(_a), gid); \
+			struct gref_link_s lb = gref_get_link((gref_t const *)(_b), gid); \
+			assert(la.len == lb.len && la.gid_arr - (_a)->link_table == lb.gid_arr - (_b)->link_table, "gid(%u)", gid); \
+		} \
+		assert((_a)->seq_len == (_b)->seq_len, "%llu, %llu", (_a)->seq_len, (_b)->seq_len); \
+		assert(memcmp(lmm_kv_ptr((_a)->seq), lmm_kv_ptr((_b)->seq), 2 * (_a)->seq_len + (_a)->params.seq_head_margin) == 0); \
+	}
+	_cmp_acv(acv[0], acv[1]);
+
+	/* melt and freeze again */
+	for(int64_t j = 0; j < 2; j++) {
+		gref_pool_t *pool = gref_melt_archive((gref_acv_t *)acv[j]);
+		assert(pool != NULL, "%p", pool);
+		acv[j] = (struct gref_s *)gref_freeze_pool(pool);
+		assert(acv[j] != NULL, "%p", acv[j]);
+	}
+	_cmp_acv(acv[0], acv[1]);
+	#undef _cmp_acv
+
+	gref_clean((gref_t *)acv[0]);
+	gref_clean((gref_t *)acv[1]);
+}
+
 /**
  * end of gref.c
  */
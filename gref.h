@@ -63,6 +63,26 @@ enum gref_copy_mode {
 	GREF_NOCOPY					= 2
 };
 
+/**
+ * @enum gref_kmer_idx_mode
+ * @brief kmer -> position table representation
+ */
+enum gref_kmer_idx_mode {
+	GREF_KMER_IDX_AUTO			= 0,	/* smaller of the two (dense if comparable) */
+	GREF_KMER_IDX_DENSE			= 1,	/* 4^k + 1 offsets, O(1) without hashing */
+	GREF_KMER_IDX_HASH			= 2		/* hashed buckets, scales with the number of distinct kmers */
+};
+
+/**
+ * @enum gref_kmer_build_mode
+ * @brief how the kmer table is built; the resulting index is the same
+ */
+enum gref_kmer_build_mode {
+	GREF_KMER_BUILD_AUTO		= 0,	/* count if the dense table is not larger than the kmer table */
+	GREF_KMER_BUILD_SORT		= 1,	/* enumerate all the (kmer, pos) pairs and radix sort them */
+	GREF_KMER_BUILD_COUNT		= 2		/* count kmers, then scatter pos into the final table (dense table needed) */
+};
+
 /**
  * @type gref_t
  */
@@ -100,7 +120,8 @@ struct gref_params_s {
 	uint8_t seq_format;
 	uint8_t copy_mode;
 	uint16_t num_threads;
-	uint16_t reserved;
+	uint8_t kmer_idx_mode;			/* GREF_KMER_IDX_AUTO, DENSE, or HASH */
+	uint8_t kmer_build_mode;		/* GREF_KMER_BUILD_AUTO, SORT, or COUNT */
 	uint32_t hash_size;
 	uint16_t seq_head_margin;
 	uint16_t seq_tail_margin;
@@ -259,6 +280,37 @@ int gref_append_link(
 	int32_t dst_len,
 	int32_t dst_ori);
 
+/**
+ * @fn gref_get_name_id
+ * @brief returns the id of a segment name, assigned in the order of the first appearance
+ * (in gref_append_segment, gref_append_link, or this function)
+ */
+uint32_t gref_get_name_id(
+	gref_pool_t *pool,
+	char const *name,
+	int32_t name_len);
+
+/**
+ * @fn gref_append_segment_id
+ * @brief gref_append_segment with the name resolved by gref_get_name_id
+ */
+int gref_append_segment_id(
+	gref_pool_t *pool,
+	uint32_t id,
+	uint8_t const *seq,
+	int64_t seq_len);
+
+/**
+ * @fn gref_append_link_id
+ * @brief gref_append_link with the names resolved by gref_get_name_id
+ */
+int gref_append_link_id(
+	gref_pool_t *pool,
+	uint32_t src_id,
+	int32_t src_ori,
+	uint32_t dst_id,
+	int32_t dst_ori);
+
 /**
  * @fn gref_append_snp
  * @brief not implemented yet (;_;)
@@ -282,20 +334,32 @@ int gref_split_segment(
 	char const *splitted,
 	int32_t splitted_len);
 
-#if 0
 /**
  * @fn gref_load_index
+ * @brief map an index dumped by gref_dump_index. params->k and params->seq_direction
+ * are checked against the index if nonzero. returns NULL on failure.
  */
 gref_idx_t *gref_load_index(
-	zf_t *fp);
+	char const *path,
+	gref_params_t const *params);
 
 /**
  * @fn gref_dump_index
+ * @brief dump index (built in GREF_COPY mode) to a file.
  */
 int gref_dump_index(
 	gref_idx_t const *gref,
-	zf_t *fp);
-#endif
+	char const *path);
+
+/**
+ * @fn gref_dump_index_ext
+ * @brief build kmer index of the archive out of core (sorted runs of mem_size bytes spilled
+ * to $TMPDIR and merged) and dump it to a file. loaded with gref_load_index. acv is kept.
+ */
+int gref_dump_index_ext(
+	gref_acv_t const *acv,
+	char const *path,
+	uint64_t mem_size);
 
 /**
  * @fn gref_iter_init, gref_iter_next, gref_iter_clean
@@ -306,6 +370,16 @@ gref_iter_t *gref_iter_init(
 	gref_acv_t const *gref,
 	gref_iter_params_t const *params);
 
+/**
+ * @fn gref_iter_init_range
+ * @brief kmer iterator over sections in [base_gid, tail_gid), used to split an archive into work items.
+ */
+gref_iter_t *gref_iter_init_range(
+	gref_acv_t const *gref,
+	gref_iter_params_t const *params,
+	uint32_t base_gid,
+	uint32_t tail_gid);
+
 /**
  * @fn gref_iter_next
  */
@@ -331,6 +405,17 @@ struct gref_match_res_s gref_match_2bitpacked(
 	gref_idx_t const *gref,
 	uint64_t seq);
 
+/**
+ * @fn gref_match_batch
+ * @brief resolves cnt kmers (2bit-packed) into res[0..cnt), hiding index memory latency.
+ */
+#define GREF_MATCH_BATCH_SIZE		( 32 )
+void gref_match_batch(
+	gref_idx_t const *gref,
+	uint64_t const *kmer,
+	struct gref_match_res_s *res,
+	int64_t cnt);
+
 /**
  * @fn gref_get_section_count
  */
@@ -373,6 +458,13 @@ uint8_t const *gref_get_ptr(
 int64_t gref_get_total_len(
 	gref_t const *gref);
 
+/**
+ * @fn gref_get_index_size
+ * @brief bytes of the sequence, link, and kmer tables (mapped or allocated)
+ */
+int64_t gref_get_index_size(
+	gref_t const *gref);
+
 /**
  * @fn gref_get_lim
  */
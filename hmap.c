@@ -233,6 +233,51 @@ _hmap_init_error_handler:;
 	return(NULL);
 }
 
+/**
+ * @fn hmap_init_raw
+ */
+hmap_t *hmap_init_raw(
+	hmap_raw_t const *raw,
+	hmap_params_t const *params)
+{
+	if(raw == NULL || ((raw->mask + 1) & raw->mask) != 0) {
+		return(NULL);
+	}
+
+	/* init with the same table size */
+	uint64_t hmap_size = (uint64_t)raw->mask + 1;
+	struct hmap_s *hmap = (struct hmap_s *)hmap_init(
+		raw->object_size,
+		HMAP_PARAMS(
+			.hmap_size = hmap_size,
+			.lmm = (params == NULL) ? NULL : params->lmm));
+	if(hmap == NULL) {
+		return(NULL);
+	}
+
+	/* object size must be equal to the original one */
+	if(hmap->object_size != raw->object_size) {
+		hmap_clean((hmap_t *)hmap);
+		return(NULL);
+	}
+
+	/* copy arrays */
+	uint64_t object_arr_size = (uint64_t)raw->next_id * raw->object_size;
+	memcpy(hmap->table, raw->table, sizeof(struct hmap_pair_s) * hmap_size);
+	lmm_kv_reserve(hmap->lmm, hmap->key_arr, raw->key_arr_size);
+	lmm_kv_reserve(hmap->lmm, hmap->object_arr, object_arr_size);
+	if(lmm_kv_ptr(hmap->key_arr) == NULL || lmm_kv_ptr(hmap->object_arr) == NULL) {
+		hmap_clean((hmap_t *)hmap);
+		return(NULL);
+	}
+	memcpy(lmm_kv_ptr(hmap->key_arr), raw->key_arr, raw->key_arr_size);
+	memcpy(lmm_kv_ptr(hmap->object_arr), raw->object_arr, object_arr_size);
+	lmm_kv_size(hmap->key_arr) = raw->key_arr_size;
+	lmm_kv_size(hmap->object_arr) = object_arr_size;
+	hmap->next_id = raw->next_id;
+	return((hmap_t *)hmap);
+}
+
 /**
  * @fn hmap_clean
  */
@@ -482,6 +527,24 @@ uint32_t hmap_get_count(
 	return(hmap->next_id);
 }
 
+/**
+ * @fn hmap_get_raw
+ */
+hmap_raw_t hmap_get_raw(
+	hmap_t *_hmap)
+{
+	struct hmap_s *hmap = (struct hmap_s *)_hmap;
+	return((hmap_raw_t){
+		.mask = hmap->mask,
+		.object_size = hmap->object_size,
+		.next_id = hmap->next_id,
+		.table = (void const *)hmap->table,
+		.key_arr = (void const *)lmm_kv_ptr(hmap->key_arr),
+		.key_arr_size = lmm_kv_size(hmap->key_arr),
+		.object_arr = (void const *)lmm_kv_ptr(hmap->object_arr)
+	});
+}
+
 
 /* unittests */
 unittest_config(
@@ -826,6 +889,40 @@ unittest()
 	lmm_clean(lmm);
 }
 
+/* rebuild from raw arrays */
+unittest()
+{
+	struct str_cont_s {
+		hmap_header_t header;
+		char s[128];
+	};
+	hmap_t *hmap = hmap_init(sizeof(struct str_cont_s), NULL);
+	for(int64_t i = 0; i < 1024; i++) {
+		uint32_t id = hmap_get_id(hmap, make_args(i));
+		struct str_cont_s *obj = hmap_get_object(hmap, id);
+		strcpy(obj->s, make_string(i));
+	}
+
+	hmap_raw_t raw = hmap_get_raw(hmap);
+	hmap_t *copy = hmap_init_raw(&raw, NULL);
+	assert(copy != NULL, "copy(%p)", copy);
+	assert(hmap_get_count(copy) == 1024, "%u", hmap_get_count(copy));
+
+	for(int64_t i = 0; i < 1024; i++) {
+		/* ids are kept */
+		assert(hmap_get_id(copy, make_args(i)) == i, "i(%lld)", i);
+
+		struct str_cont_s *obj = hmap_get_object(copy, i);
+		assert(strcmp(obj->s, make_string(i)) == 0, "%s, %s", obj->s, make_string(i));
+	}
+
+	/* new key is appended at the tail */
+	assert(hmap_get_id(copy, make_args(1024)) == 1024, "%u", hmap_get_id(copy, make_args(1024)));
+
+	hmap_clean(copy);
+	hmap_clean(hmap);
+}
+
 
 /**
  * end of hmap.c
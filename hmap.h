@@ -43,6 +43,22 @@ struct hmap_key_s {
 };
 typedef struct hmap_key_s hmap_key_t;
 
+/**
+ * @struct hmap_raw_s
+ * @brief internal arrays, exposed for serialization
+ */
+struct hmap_raw_s {
+	uint32_t mask;
+	uint32_t object_size;
+	uint32_t next_id;
+	uint32_t reserved;
+	void const *table;				/* (mask + 1) * 8 bytes */
+	void const *key_arr;
+	uint64_t key_arr_size;
+	void const *object_arr;			/* next_id * object_size bytes */
+};
+typedef struct hmap_raw_s hmap_raw_t;
+
 /**
  * @fn hmap_init
  */
@@ -50,6 +66,14 @@ hmap_t *hmap_init(
 	uint64_t object_size,
 	hmap_params_t const *params);
 
+/**
+ * @fn hmap_init_raw
+ * @brief rebuild hashmap from arrays taken by hmap_get_raw (arrays are copied)
+ */
+hmap_t *hmap_init_raw(
+	hmap_raw_t const *raw,
+	hmap_params_t const *params);
+
 /**
  * @fn hmap_clean
  */
@@ -91,6 +115,12 @@ void *hmap_get_object(
 uint32_t hmap_get_count(
 	hmap_t *hmap);
 
+/**
+ * @fn hmap_get_raw
+ */
+hmap_raw_t hmap_get_raw(
+	hmap_t *hmap);
+
 #endif /* _HMAP_H_INCLUDED */
 /**
  * end of hmap.h
@@ -300,6 +300,8 @@ void lmm_pool_clean(
 	lmm_pool_t *_pool)
 {
 	struct lmm_pool_s *pool = (struct lmm_pool_s *)_pool;
+	if(pool == NULL) { return; }
+
 	struct lmm_pool_block_s *blk = pool->root->next;
 	lmm_t *lmm = pool->lmm;
 
@@ -4,6 +4,10 @@
  * @brief parallel task manager
  */
 
+#ifdef __linux__
+#  define _GNU_SOURCE		/* sched_getaffinity, CPU_COUNT */
+#endif
+
 /* import unittest */
 #define UNITTEST_UNIQUE_ID			100
 #define UNITTEST 					1
@@ -11,9 +15,13 @@
 #include  "unittest.h"
 
 #include <stdint.h>
+#include <string.h>
 #include <pthread.h>
+#include <unistd.h>
+#ifdef __linux__
+#  include <sched.h>
+#endif
 #include "ptask.h"
-#include "queue.h"
 #include "log.h"
 
 
@@ -25,13 +33,278 @@
 
 /* constants */
 #define PTASK_DISPATCHER_EXIT		( (void *)((int64_t)-1) )
+#define PTASK_STREAM_START			( (void *)((int64_t)-2) )
+#define PTASK_STREAM_BATCH			( 32 )
+
+/**
+ * @macro PTASK_CACHE_LINE_SIZE, PTASK_RING_SPIN_CNT
+ * @brief head and tail counters are placed on separate cache lines; waiters spin
+ * PTASK_RING_SPIN_CNT times before parking on the condition variable.
+ */
+#define PTASK_CACHE_LINE_SIZE		( 64 )
+#define PTASK_RING_SPIN_CNT			( 1024 )
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define ptask_cpu_relax()			__builtin_ia32_pause()
+#else
+#  define ptask_cpu_relax()			__asm__ __volatile__("" ::: "memory")
+#endif
+
+/**
+ * @struct ptask_ring_cell_s
+ * @brief seq == pos: vacant for the put at pos, seq == pos + 1: occupied for the get at pos
+ */
+struct ptask_ring_cell_s {
+	uint64_t seq;
+	void *ptr;
+};
+
+/**
+ * @struct ptask_ring_s
+ * @brief bounded lock-free mpmc ring (Vyukov's algorithm), the capacity is a power of two.
+ */
+struct ptask_ring_s {
+	/* put and get counters on their own cache lines */
+	uint64_t head;
+	uint8_t _pad1[PTASK_CACHE_LINE_SIZE - sizeof(uint64_t)];
+	uint64_t tail;
+	uint8_t _pad2[PTASK_CACHE_LINE_SIZE - sizeof(uint64_t)];
+
+	/* constants */
+	uint64_t mask;
+	struct ptask_ring_cell_s *cell;
+
+	/* parking */
+	uint64_t put_waiters, get_waiters;
+	pthread_mutex_t lock;
+	pthread_cond_t put_cond, get_cond;
+};
+
+/**
+ * @fn ptask_ring_init
+ * @brief capacity is rounded up to a power of two
+ */
+static
+struct ptask_ring_s *ptask_ring_init(
+	int64_t size)
+{
+	uint64_t cap = 2;
+	while(cap < (uint64_t)size) { cap <<= 1; }
+
+	void *p = NULL;
+	if(posix_memalign(&p, PTASK_CACHE_LINE_SIZE,
+		sizeof(struct ptask_ring_s) + cap * sizeof(struct ptask_ring_cell_s)) != 0) {
+		return(NULL);
+	}
+	struct ptask_ring_s *r = (struct ptask_ring_s *)p;
+	memset(r, 0, sizeof(struct ptask_ring_s));
+
+	r->mask = cap - 1;
+	r->cell = (struct ptask_ring_cell_s *)(r + 1);
+	for(uint64_t i = 0; i < cap; i++) {
+		r->cell[i] = (struct ptask_ring_cell_s){ .seq = i, .ptr = NULL };
+	}
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->put_cond, NULL);
+	pthread_cond_init(&r->get_cond, NULL);
+	return(r);
+}
+
+/**
+ * @fn ptask_ring_clean
+ */
+static
+void ptask_ring_clean(
+	struct ptask_ring_s *r)
+{
+	if(r == NULL) { return; }
+	pthread_cond_destroy(&r->put_cond);
+	pthread_cond_destroy(&r->get_cond);
+	pthread_mutex_destroy(&r->lock);
+	free(r);
+	return;
+}
+
+/**
+ * @fn ptask_ring_try_put
+ * @brief returns 0 on success, 1 if full
+ */
+static _force_inline
+int ptask_ring_try_put(
+	struct ptask_ring_s *r,
+	void *ptr)
+{
+	uint64_t pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+	struct ptask_ring_cell_s *c;
+	while(1) {
+		c = &r->cell[pos & r->mask];
+		int64_t dif = (int64_t)(__atomic_load_n(&c->seq, __ATOMIC_ACQUIRE) - pos);
+		if(dif == 0) {
+			if(__atomic_compare_exchange_n(&r->head, &pos, pos + 1, 1,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if(dif < 0) {
+			return(1);
+		} else {
+			pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+		}
+	}
+	c->ptr = ptr;
+	__atomic_store_n(&c->seq, pos + 1, __ATOMIC_RELEASE);
+	return(0);
+}
+
+/**
+ * @fn ptask_ring_try_get
+ * @brief returns 0 on success, 1 if empty
+ */
+static _force_inline
+int ptask_ring_try_get(
+	struct ptask_ring_s *r,
+	void **ptr)
+{
+	uint64_t pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+	struct ptask_ring_cell_s *c;
+	while(1) {
+		c = &r->cell[pos & r->mask];
+		int64_t dif = (int64_t)(__atomic_load_n(&c->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+		if(dif == 0) {
+			if(__atomic_compare_exchange_n(&r->tail, &pos, pos + 1, 1,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if(dif < 0) {
+			return(1);
+		} else {
+			pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+		}
+	}
+	*ptr = c->ptr;
+	__atomic_store_n(&c->seq, pos + r->mask + 1, __ATOMIC_RELEASE);
+	return(0);
+}
+
+/**
+ * @fn ptask_ring_wake
+ * @brief wake up threads parked on cond; the fence pairs with the one in ptask_ring_park
+ */
+static _force_inline
+void ptask_ring_wake(
+	struct ptask_ring_s *r,
+	uint64_t *waiters,
+	pthread_cond_t *cond)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(waiters, __ATOMIC_RELAXED) == 0) {
+		return;
+	}
+	pthread_mutex_lock(&r->lock);
+	pthread_cond_broadcast(cond);
+	pthread_mutex_unlock(&r->lock);
+	return;
+}
+
+/**
+ * @macro ptask_ring_wait
+ * @brief spin on _try, then park on _cond until _try succeeds
+ */
+#define ptask_ring_wait(_r, _try, _waiters, _cond) { \
+	int64_t _spin = 0; \
+	while((_try) != 0) { \
+		if(++_spin < PTASK_RING_SPIN_CNT) { ptask_cpu_relax(); continue; } \
+		pthread_mutex_lock(&(_r)->lock); \
+		__atomic_fetch_add(&(_r)->_waiters, 1, __ATOMIC_SEQ_CST); \
+		__atomic_thread_fence(__ATOMIC_SEQ_CST); \
+		while((_try) != 0) { pthread_cond_wait(&(_r)->_cond, &(_r)->lock); } \
+		__atomic_fetch_sub(&(_r)->_waiters, 1, __ATOMIC_SEQ_CST); \
+		pthread_mutex_unlock(&(_r)->lock); \
+		break; \
+	} \
+}
+
+/**
+ * @fn ptask_ring_put_wait
+ */
+static
+void ptask_ring_put_wait(
+	struct ptask_ring_s *r,
+	void *ptr)
+{
+	ptask_ring_wait(r, ptask_ring_try_put(r, ptr), put_waiters, put_cond);
+	ptask_ring_wake(r, &r->get_waiters, &r->get_cond);
+	return;
+}
+
+/**
+ * @fn ptask_ring_get_wait
+ */
+static
+void *ptask_ring_get_wait(
+	struct ptask_ring_s *r)
+{
+	void *ptr = NULL;
+	ptask_ring_wait(r, ptask_ring_try_get(r, &ptr), get_waiters, get_cond);
+	ptask_ring_wake(r, &r->put_waiters, &r->put_cond);
+	return(ptr);
+}
+
+/**
+ * @fn ptask_ring_put_bulk
+ * @brief put cnt elements, waking up the consumers once per batch of the available room
+ */
+static
+void ptask_ring_put_bulk(
+	struct ptask_ring_s *r,
+	void *const *ptr,
+	int64_t cnt)
+{
+	int64_t i = 0;
+	while(i < cnt) {
+		ptask_ring_wait(r, ptask_ring_try_put(r, ptr[i]), put_waiters, put_cond);
+		for(i++; i < cnt && ptask_ring_try_put(r, ptr[i]) == 0; i++) {}
+		ptask_ring_wake(r, &r->get_waiters, &r->get_cond);
+	}
+	return;
+}
+
+/**
+ * @fn ptask_ring_get_bulk
+ * @brief wait for the first element, then take the available ones up to cnt; returns the count
+ */
+static
+int64_t ptask_ring_get_bulk(
+	struct ptask_ring_s *r,
+	void **ptr,
+	int64_t cnt)
+{
+	if(cnt <= 0) { return(0); }
+	ptask_ring_wait(r, ptask_ring_try_get(r, &ptr[0]), get_waiters, get_cond);
+
+	int64_t i = 1;
+	while(i < cnt && ptask_ring_try_get(r, &ptr[i]) == 0) { i++; }
+	ptask_ring_wake(r, &r->put_waiters, &r->put_cond);
+	return(i);
+}
+
+/**
+ * @struct ptask_stream_slot_s
+ * @brief item container for the stream mode, results are restored in the order of seq
+ */
+struct ptask_stream_slot_s {
+	int64_t seq;
+	int64_t done;
+	void *item;
+	void *result;
+};
 
 /**
  * context container
  */
 struct ptask_container_s {
 	pthread_t th;
-	queue_t *inq, *outq;
+	struct ptask_ring_s *inq, *outq;
+	struct ptask_ring_s *sinq, *soutq;	/* shared queues (stream mode) */
 	void *worker_arg;
 	void *(*worker)(void *worker_arg, void *item);
 };
@@ -39,6 +312,9 @@ struct ptask_context_s {
 	int64_t num_threads;
 	int64_t queue_size;
 
+	/* queues shared by all the threads in the stream mode */
+	struct ptask_ring_s *sinq, *soutq;
+
 	/* worker for the single thread mode */
 	void *worker_arg;
 	void *(*worker)(void *worker_arg, void *item);
@@ -55,25 +331,119 @@ void *ptask_dispatcher(void *s)
 {
 	struct ptask_container_s *c = (struct ptask_container_s *)s;
 	while(1) {
-		void *item;		/* pointer to item */
-		if(queue_get_wait(c->inq, (void **)&item) == 0) {
-			if(item == PTASK_DISPATCHER_EXIT) { break; }
-			debug("worker_arg(%p), item(%p)", c->worker_arg, item);
-			void *result = c->worker(c->worker_arg, item);
-			queue_put_wait(c->outq, result);
+		void *item = ptask_ring_get_wait(c->inq);	/* pointer to item */
+		if(item == PTASK_DISPATCHER_EXIT) { break; }
+		if(item == PTASK_STREAM_START) {
+			/* pull items from the shared queue until the end marker */
+			struct ptask_stream_slot_s *slot;
+			while((void *)(slot = ptask_ring_get_wait(c->sinq)) != PTASK_DISPATCHER_EXIT) {
+				slot->result = c->worker(c->worker_arg, slot->item);
+				ptask_ring_put_wait(c->soutq, (void *)slot);
+			}
+			continue;
 		}
+		debug("worker_arg(%p), item(%p)", c->worker_arg, item);
+		void *result = c->worker(c->worker_arg, item);
+		ptask_ring_put_wait(c->outq, result);
 	}
 	return(NULL);
 }
 
+/**
+ * @fn ptask_read_int_pair
+ * @brief read at most two integers from the first line of path; "max" is read as -1.
+ * returns the number of integers read.
+ */
+static
+int ptask_read_int_pair(
+	char const *path,
+	int64_t *a,
+	int64_t *b)
+{
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL) { return(0); }
+
+	char buf[256] = { 0 };
+	char *line = fgets(buf, 255, fp);
+	fclose(fp);
+	if(line == NULL) { return(0); }
+
+	int cnt = 0;
+	int64_t *dst[2] = { a, b };
+	char *p = buf;
+	while(cnt < 2) {
+		while(*p == ' ' || *p == '\t') { p++; }
+		if(strncmp(p, "max", 3) == 0) {
+			*dst[cnt++] = -1; p += 3; continue;
+		}
+		char *q;
+		int64_t v = strtoll(p, &q, 10);
+		if(q == p) { break; }
+		*dst[cnt++] = v; p = q;
+	}
+	return(cnt);
+}
+
+/**
+ * @fn ptask_get_cgroup_quota
+ * @brief cpu quota of the cgroup in cores (rounded up), 0 if unlimited or unknown
+ */
+static
+int64_t ptask_get_cgroup_quota(
+	void)
+{
+	int64_t quota = -1, period = 0;
+
+	/* cgroup v2: "<quota|max> <period>" */
+	if(ptask_read_int_pair("/sys/fs/cgroup/cpu.max", &quota, &period) == 2) {
+		goto _ptask_get_cgroup_quota_found;
+	}
+
+	/* cgroup v1: cfs_quota_us (-1 if unlimited) and cfs_period_us in separate files */
+	static char const *const v1[][2] = {
+		{ "/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "/sys/fs/cgroup/cpu/cpu.cfs_period_us" },
+		{ "/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_quota_us", "/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_period_us" }
+	};
+	int64_t dummy;
+	for(uint64_t i = 0; i < sizeof(v1) / sizeof(v1[0]); i++) {
+		if(ptask_read_int_pair(v1[i][0], &quota, &dummy) == 1
+		&& ptask_read_int_pair(v1[i][1], &period, &dummy) == 1) {
+			goto _ptask_get_cgroup_quota_found;
+		}
+	}
+	return(0);
+
+_ptask_get_cgroup_quota_found:;
+	if(quota <= 0 || period <= 0) { return(0); }
+	return((quota + period - 1) / period);
+}
+
 /**
  * @fn ptask_get_num_cores
+ * @brief number of cores available to the process: the cpu affinity mask
+ * (or online processors) capped by the cgroup cpu quota. always >= 1.
  */
 int64_t ptask_get_num_cores(
 	void)
 {
-	/** !! fixme !! */
-	return(4);
+	int64_t cores = 0;
+
+	#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if(sched_getaffinity(0, sizeof(cpu_set_t), &set) == 0) {
+			cores = CPU_COUNT(&set);
+		}
+	#endif
+	if(cores <= 0) {
+		cores = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+
+	#ifdef __linux__
+		int64_t quota = ptask_get_cgroup_quota();
+		if(quota > 0 && quota < cores) { cores = quota; }
+	#endif
+	return((cores <= 0) ? 1 : cores);
 }
 
 /**
@@ -109,11 +479,19 @@ ptask_t *ptask_init(
 	ctx->worker_arg = (worker_arg != NULL) ? worker_arg[0] : NULL;
 	ctx->worker = worker;
 
+	/* shared queues */
+	if(num_threads > 0) {
+		ctx->sinq = ptask_ring_init(ctx->queue_size);
+		ctx->soutq = ptask_ring_init(ctx->queue_size);
+	}
+
 	/* create threads */
 	for(int64_t i = 0; i < num_threads; i++) {
 		debug("%lld\n", i);
-		ctx->c[i].inq = queue_create_limited(ctx->queue_size);
-		ctx->c[i].outq = queue_create_limited(ctx->queue_size);
+		ctx->c[i].inq = ptask_ring_init(ctx->queue_size);
+		ctx->c[i].outq = ptask_ring_init(ctx->queue_size);
+		ctx->c[i].sinq = ctx->sinq;
+		ctx->c[i].soutq = ctx->soutq;
 		ctx->c[i].worker_arg = (worker_arg != NULL) ? worker_arg[i] : NULL;
 		ctx->c[i].worker = worker;
 		pthread_create(&ctx->c[i].th, NULL, ptask_dispatcher, (void *)&ctx->c[i]);
@@ -139,18 +517,18 @@ void ptask_clean(
 		debug("%lld\n", i);
 
 		/* send destroy signal */
-		queue_put(ctx->c[i].inq, PTASK_DISPATCHER_EXIT);
+		ptask_ring_put_wait(ctx->c[i].inq, PTASK_DISPATCHER_EXIT);
 
 		/* wait for the thread terminates */
 		void *status;
 		pthread_join(ctx->c[i].th, &status);
 
 		/* cleanup queues */
-		queue_flush(ctx->c[i].inq);
-		queue_flush(ctx->c[i].outq);
-		queue_destroy(ctx->c[i].inq);
-		queue_destroy(ctx->c[i].outq);
+		ptask_ring_clean(ctx->c[i].inq);
+		ptask_ring_clean(ctx->c[i].outq);
 	}
+	ptask_ring_clean(ctx->sinq);
+	ptask_ring_clean(ctx->soutq);
 	free(ctx);
 	return;
 }
@@ -184,13 +562,12 @@ int ptask_parallel(
 	for(int64_t i = 0; i < ctx->num_threads; i++) {
 		void *item = (items != NULL) ? items[i] : NULL;
 		debug("put queue i(%lld), item(%p)", i, item);
-		queue_put_wait(ctx->c[i].inq, item);
+		ptask_ring_put_wait(ctx->c[i].inq, item);
 	}
 
 	/* wait... */
 	for(int64_t i = 0; i < ctx->num_threads; i++) {
-		void *result;
-		queue_get_wait(ctx->c[i].outq, (void **)&result);
+		void *result = ptask_ring_get_wait(ctx->c[i].outq);
 		debug("get queue i(%lld), result(%p)", i, result);
 		
 		/* store the result */
@@ -203,17 +580,7 @@ int ptask_parallel(
 }
 
 /**
- * @struct ptask_stream_status_s
- */
-#define CONT 			( 0 )
-#define TERM 			( 1 )
-struct ptask_stream_status_s {
-	int64_t status;
-	int64_t cnt;
-};
-
-/**
- * @fn ptask_stream
+ * @fn ptask_stream_single
  * @brief get an item from source, throw it to worker, and gather the results into drain.
  */
 static _force_inline
@@ -230,125 +597,69 @@ int ptask_stream_single(
 	}
 	return(PTASK_SUCCESS);
 }
-static _force_inline
-struct ptask_stream_status_s ptask_stream_bulk_source(
-	struct ptask_context_s *ctx,
-	void *(*source)(void *arg), void *source_arg,
-	int64_t bulk_elems_per_thread)
-{
-	int64_t rem_size[ctx->num_threads];
 
-	// log("enter ptask_stream_bulk_source");
-
-	/* get number of elems to be pushed to the queue */
-	int64_t min_rem_size = bulk_elems_per_thread;
-	for(int64_t j = 0; j < ctx->num_threads; j++) {
-		rem_size[j] = ctx->queue_size - queue_elements(ctx->c[j].inq);
-		min_rem_size = (rem_size[j] < min_rem_size) ? rem_size[j] : min_rem_size;
-	}
-
-	int64_t num_items = 0;
-	/* read */ {
-		/* bulk read */
-		int64_t i;
-		for(i = 0; i < min_rem_size; i++) {
-			for(int64_t j = 0; j < ctx->num_threads; j++) {
-				void *item = source(source_arg);
-				if(item == NULL) {
-					/* source reached the end, calc number of items read */
-					num_items += i * ctx->num_threads + j;
-					return((struct ptask_stream_status_s){
-						.status = TERM,
-						.cnt = num_items
-					});
-				}
-				queue_put(ctx->c[j].inq, item);
-			}
-		}
-
-		/* adjust num_items and rem_size */
-		num_items += ctx->num_threads * min_rem_size;
-		for(int64_t j = 0; j < ctx->num_threads; j++) {
-			rem_size[j] -= min_rem_size;
-		}
+/**
+ * @struct ptask_writer_s
+ * @brief context of the writer thread; drain is called on the thread in the order of the results in q
+ */
+struct ptask_writer_s {
+	pthread_t th;
+	struct ptask_ring_s *q;
+	void (*drain)(void *arg, void *result);
+	void *drain_arg;
+
+	/* number of results drain has returned from */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int64_t dcnt;
+};
 
-		/* push remainings */
-		for(; i < bulk_elems_per_thread; i++) {
-			for(int64_t j = 0; j < ctx->num_threads; j++) {
-				/* check queue has the room */
-				if(rem_size[j] <= 0) { continue; }
-				rem_size[j]--;
-
-				void *item = source(source_arg);
-				if(item == NULL) {
-					return((struct ptask_stream_status_s){
-						.status = TERM,
-						.cnt = num_items
-					});
-				}
-				num_items++;
-				queue_put(ctx->c[j].inq, item);
-			}
-		}
+/**
+ * @fn ptask_writer
+ */
+static
+void *ptask_writer(
+	void *s)
+{
+	struct ptask_writer_s *w = (struct ptask_writer_s *)s;
+	void *result;
+	while((result = ptask_ring_get_wait(w->q)) != PTASK_DISPATCHER_EXIT) {
+		w->drain(w->drain_arg, result);
+
+		pthread_mutex_lock(&w->lock);
+		__atomic_store_n(&w->dcnt, w->dcnt + 1, __ATOMIC_RELEASE);
+		pthread_cond_signal(&w->cond);
+		pthread_mutex_unlock(&w->lock);
 	}
-	return((struct ptask_stream_status_s){
-		.status = CONT,
-		.cnt = num_items
-	});
+	return(NULL);
 }
-static _force_inline
-struct ptask_stream_status_s ptask_stream_bulk_drain(
-	struct ptask_context_s *ctx,
-	void (*drain)(void *arg, void *result), void *drain_arg,
-	int64_t bulk_elems_per_thread)
-{
-	int64_t res_cnt[ctx->num_threads];
-
-	// log("enter ptask_stream_bulk_drain");
 
-	/* get number of elems in the result queue */
-	int64_t num_items = 0;
-	int64_t min_res_cnt = bulk_elems_per_thread;
-	for(int64_t j = 0; j < ctx->num_threads; j++) {
-		res_cnt[j] = queue_elements(ctx->c[j].outq);
-		num_items += res_cnt[j];
-		min_res_cnt = (res_cnt[j] < min_res_cnt) ? res_cnt[j] : min_res_cnt;
-		debug("j(%lld), res_cnt(%lld)", j, res_cnt[j]);
-	}
-
-	/** write */ {
-		/* bulk write */
-		int64_t i;
-		for(i = 0; i < min_res_cnt; i++) {
-			for(int64_t j = 0; j < ctx->num_threads; j++) {
-				void *result;
-				queue_get_wait(ctx->c[j].outq, (void **)&result);
-				drain(drain_arg, result);
-			}
-		}
-
-		/* adjust cnt */
-		for(int64_t j = 0; j < ctx->num_threads; j++) {
-			res_cnt[j] -= min_res_cnt;
-			debug("j(%lld), res_cnt(%lld)", j, res_cnt[j]);
-		}
-
-		/* read remainings */
-		for(int64_t j = 0; j < ctx->num_threads; j++) {
-			for(int64_t k = 0; k < res_cnt[j]; k++) {
-				debug("j(%lld), res_cnt(%lld)", j, res_cnt[j]);
-
-				void *result;
-				queue_get_wait(ctx->c[j].outq, (void **)&result);
-				drain(drain_arg, result);
-			}
-		}
+/**
+ * @fn ptask_writer_wait
+ * @brief wait for drain to return from the result of seq, returns the number of drained results
+ */
+static
+int64_t ptask_writer_wait(
+	struct ptask_writer_s *w,
+	int64_t seq)
+{
+	pthread_mutex_lock(&w->lock);
+	while(w->dcnt <= seq) {
+		pthread_cond_wait(&w->cond, &w->lock);
 	}
-	return((struct ptask_stream_status_s){
-		.status = TERM,
-		.cnt = num_items
-	});
+	int64_t dcnt = w->dcnt;
+	pthread_mutex_unlock(&w->lock);
+	return(dcnt);
 }
+
+/**
+ * @fn ptask_stream
+ * @brief get an item from source, throw it to worker, and gather the results into drain.
+ * workers pull items from the shared queue, so that a long item does not stall the others.
+ * items are numbered by the source and results are passed to drain in the source order;
+ * at most queue_size items are alive, from source until drain returns (the size of the
+ * reorder window). drain runs on a dedicated writer thread, concurrently with source.
+ */
 int ptask_stream(
 	ptask_t *_ctx,
 	void *(*source)(void *arg), void *source_arg,
@@ -368,53 +679,109 @@ int ptask_stream(
 			drain, drain_arg));
 	}
 
-	/* multi thread mode */
-	int64_t icnt = 0, ocnt = 0;
-
-	/* restore defaults */
+	/* restore defaults; items issued at once before checking results */
+	int64_t const window = ctx->queue_size;
 	bulk_elems = (bulk_elems <= 0) ? 512 : bulk_elems;
-	int64_t bulk_elems_per_thread = bulk_elems / ctx->num_threads;
 
-	/* scatter and gather */
-	// int64_t blk_icnt = ctx->num_threads * bulk_elems_per_thread;
+	struct ptask_stream_slot_s *slot = (struct ptask_stream_slot_s *)malloc(
+		(sizeof(struct ptask_stream_slot_s) + sizeof(void *)) * window);
+	if(slot == NULL) {
+		return(PTASK_ERROR);
+	}
+	void **buf = (void **)&slot[window];	/* batch buffer for the rings */
+
+	/* start writer */
+	struct ptask_writer_s w = {
+		.q = ptask_ring_init(window),
+		.drain = drain,
+		.drain_arg = drain_arg,
+		.dcnt = 0
+	};
+	pthread_mutex_init(&w.lock, NULL);
+	pthread_cond_init(&w.cond, NULL);
+	if(w.q == NULL || pthread_create(&w.th, NULL, ptask_writer, (void *)&w) != 0) {
+		pthread_cond_destroy(&w.cond);
+		pthread_mutex_destroy(&w.lock);
+		ptask_ring_clean(w.q);
+		free(slot);
+		return(PTASK_ERROR);
+	}
+
+	/* start stream mode */
+	for(int64_t j = 0; j < ctx->num_threads; j++) {
+		ptask_ring_put_wait(ctx->c[j].inq, PTASK_STREAM_START);
+	}
+
+	/* issued, passed to the writer, and returned from drain (an item is retired on the last) */
+	int64_t icnt = 0, ocnt = 0, dcnt = 0, term = 0;
 	while(1) {
-		/* bulk source */
-		struct ptask_stream_status_s s = ptask_stream_bulk_source(ctx,
-			source, source_arg,
-			bulk_elems_per_thread);
-		icnt += s.cnt;
+		/* issue items while the window has room, PTASK_STREAM_BATCH at a time */
+		dcnt = __atomic_load_n(&w.dcnt, __ATOMIC_ACQUIRE);
+		int64_t bcnt = 0;
+		for(int64_t i = 0; i < bulk_elems && term == 0 && icnt - dcnt < window; i++) {
+			void *item = source(source_arg);
+			if(item == NULL) {
+				term = 1; break;
+			}
+
+			struct ptask_stream_slot_s *s = &slot[icnt % window];
+			*s = (struct ptask_stream_slot_s){
+				.seq = icnt++,
+				.done = 0,
+				.item = item,
+				.result = NULL
+			};
+			buf[bcnt++] = (void *)s;
+			if(bcnt == PTASK_STREAM_BATCH) {
+				ptask_ring_put_bulk(ctx->sinq, buf, bcnt);
+				bcnt = 0;
+			}
+		}
+		ptask_ring_put_bulk(ctx->sinq, buf, bcnt);
 		debug("icnt(%lld), ocnt(%lld)", icnt, ocnt);
 
-		/* check source termination */
-		if(s.status != CONT) { break; }
+		/* check termination; otherwise all the items in the window are on the writer */
+		if(ocnt == icnt) {
+			if(term != 0) { break; }
+			dcnt = ptask_writer_wait(&w, icnt - window);
+			continue;
+		}
 
-		/* bulk drain */
-		ocnt += ptask_stream_bulk_drain(ctx,
-			drain, drain_arg,
-			bulk_elems_per_thread).cnt;
-		debug("icnt(%lld), ocnt(%lld)", icnt, ocnt);
+		/* gather results; wait for the first one */
+		int64_t const gcnt = ptask_ring_get_bulk(ctx->soutq, buf, window);
+		for(int64_t i = 0; i < gcnt; i++) {
+			struct ptask_stream_slot_s *s = (struct ptask_stream_slot_s *)buf[i];
+			debug("seq(%lld) done", s->seq);
+			s->done = 1;
+		}
+
+		/* pass the results to the writer in order */
+		int64_t wcnt = 0;
+		while(ocnt < icnt && slot[ocnt % window].done != 0) {
+			buf[wcnt++] = slot[ocnt % window].result;
+			slot[ocnt++ % window].done = 0;
+		}
+		ptask_ring_put_bulk(w.q, buf, wcnt);
 	}
 	debug("icnt(%lld), ocnt(%lld)", icnt, ocnt);
-	while(ocnt < icnt) {
-		// printf("out %lld\n", ocnt);
-		for(int64_t j = 0; j < ctx->num_threads; j++) {
-			if(queue_elements(ctx->c[j].outq) <= 0) { continue; }
-
-			ocnt++;
-			void *result;
-			queue_get_wait(ctx->c[j].outq, (void **)&result);
-			drain(drain_arg, result);
-			debug("icnt(%lld), ocnt(%lld)", icnt, ocnt);
-		}
+
+	/* stop stream mode */
+	for(int64_t j = 0; j < ctx->num_threads; j++) {
+		ptask_ring_put_wait(ctx->sinq, PTASK_DISPATCHER_EXIT);
 	}
 
-	// printf("%d, %d\n", queue_elements(c.inq), queue_elements(c.outq));
+	/* wait for the writer to flush */
+	ptask_ring_put_wait(w.q, PTASK_DISPATCHER_EXIT);
+	pthread_join(w.th, NULL);
+	pthread_cond_destroy(&w.cond);
+	pthread_mutex_destroy(&w.lock);
+	ptask_ring_clean(w.q);
+	free(slot);
 
 	debug("end");
 	return(PTASK_SUCCESS);
 }
 
-
 /* unittests */
 
 /**
@@ -757,6 +1124,179 @@ unittest(with_arr(100))
 	ptask_clean(p);
 }
 
+/**
+ * @fn unittest_worker_skewed
+ * @brief return item itself, taking long time on some of the items
+ */
+static
+void *unittest_worker_skewed(
+	void *arg,
+	void *item)
+{
+	int64_t idx = (int64_t *)item - _src(arg);
+	if((idx % 97) == 0) {
+		volatile int64_t acc = 0;
+		for(int64_t i = 0; i < 100000; i++) { acc += i; }
+	}
+	return(item);
+}
+
+/* results are drained in the source order */
+unittest(with_arr(0))
+{
+	void *args[4] = { gctx, gctx, gctx, gctx };
+	struct ptask_context_s *p = ptask_init(
+		unittest_worker_skewed, args, 4, 64);
+	unittest_init_stream();
+
+	ptask_stream(p,
+		unittest_source, gctx,
+		unittest_drain, gctx,
+		16);
+	assert(unittest_drain_cnt == UNITTEST_WORKING_ARR_LEN, "%lld", unittest_drain_cnt);
+
+	int64_t *src = _src(gctx), *dst = _dst(gctx);
+	int64_t ordered = 1;
+	for(int64_t i = 0; i < UNITTEST_WORKING_ARR_LEN; i++) {
+		ordered &= dst[i] == (int64_t)&src[i];
+	}
+	assert(ordered);
+
+	ptask_clean(p);
+}
+
+/**
+ * @fn unittest_source_alive, unittest_drain_slow
+ * @brief record the max number of items between source and the end of drain
+ */
+static int64_t unittest_alive_max = 0;
+static
+void *unittest_source_alive(
+	void *arg)
+{
+	int64_t alive = unittest_source_cnt - __atomic_load_n(&unittest_drain_cnt, __ATOMIC_ACQUIRE);
+	if(alive + 1 > unittest_alive_max) { unittest_alive_max = alive + 1; }
+	return(unittest_source(arg));
+}
+static
+void unittest_drain_slow(
+	void *arg,
+	void *result)
+{
+	volatile int64_t acc = 0;
+	for(int64_t i = 0; i < 10000; i++) { acc += i; }
+	unittest_drain(arg, result);
+	return;
+}
+
+/* items waiting for the writer are counted in the window */
+unittest(with_arr(0))
+{
+	void *args[4] = { gctx, gctx, gctx, gctx };
+	struct ptask_context_s *p = ptask_init(
+		unittest_worker_skewed, args, 4, 64);
+	unittest_init_stream();
+	unittest_alive_max = 0;
+
+	ptask_stream(p,
+		unittest_source_alive, gctx,
+		unittest_drain_slow, gctx,
+		16);
+	assert(unittest_drain_cnt == UNITTEST_WORKING_ARR_LEN, "%lld", unittest_drain_cnt);
+	assert(unittest_alive_max <= 64, "%lld", unittest_alive_max);
+
+	ptask_clean(p);
+}
+
+/* ptask_get_num_cores */
+unittest()
+{
+	int64_t cores = ptask_get_num_cores();
+	assert(cores >= 1, "%lld", cores);
+	assert(cores <= sysconf(_SC_NPROCESSORS_CONF) || sysconf(_SC_NPROCESSORS_CONF) <= 0, "%lld", cores);
+}
+
+/**
+ * @fn unittest_ring_producer, unittest_ring_consumer
+ */
+#define UNITTEST_RING_CNT		( 100000 )
+static
+void *unittest_ring_producer(
+	void *arg)
+{
+	struct ptask_ring_s *r = (struct ptask_ring_s *)arg;
+	void *buf[8];
+	for(int64_t i = 1; i <= UNITTEST_RING_CNT; i += 8) {
+		for(int64_t j = 0; j < 8; j++) { buf[j] = (void *)(i + j); }
+		ptask_ring_put_bulk(r, buf, 8);
+	}
+	return(NULL);
+}
+static
+void *unittest_ring_consumer(
+	void *arg)
+{
+	struct ptask_ring_s *r = (struct ptask_ring_s *)arg;
+	int64_t sum = 0;
+	void *p;
+	while((p = ptask_ring_get_wait(r)) != PTASK_DISPATCHER_EXIT) {
+		sum += (int64_t)p;
+	}
+	return((void *)sum);
+}
+
+/* ring: fifo in a single thread, full and empty detection */
+unittest()
+{
+	struct ptask_ring_s *r = ptask_ring_init(5);
+	assert(r != NULL);
+	assert(r->mask == 7, "%llu", r->mask);
+
+	void *p = NULL;
+	assert(ptask_ring_try_get(r, &p) != 0);
+	for(int64_t i = 0; i < 8; i++) {
+		assert(ptask_ring_try_put(r, (void *)(i + 1)) == 0);
+	}
+	assert(ptask_ring_try_put(r, (void *)9) != 0);
+
+	void *buf[16];
+	assert(ptask_ring_get_bulk(r, buf, 3) == 3);
+	assert(buf[0] == (void *)1 && buf[2] == (void *)3);
+	assert(ptask_ring_get_bulk(r, buf, 16) == 5);
+	assert(buf[0] == (void *)4 && buf[4] == (void *)8);
+	assert(ptask_ring_try_get(r, &p) != 0);
+
+	ptask_ring_clean(r);
+}
+
+/* ring: multiple producers and consumers */
+unittest()
+{
+	struct ptask_ring_s *r = ptask_ring_init(16);
+	pthread_t pth[4], cth[4];
+	for(int64_t i = 0; i < 4; i++) {
+		pthread_create(&cth[i], NULL, unittest_ring_consumer, (void *)r);
+		pthread_create(&pth[i], NULL, unittest_ring_producer, (void *)r);
+	}
+	for(int64_t i = 0; i < 4; i++) {
+		pthread_join(pth[i], NULL);
+	}
+	for(int64_t i = 0; i < 4; i++) {
+		ptask_ring_put_wait(r, PTASK_DISPATCHER_EXIT);
+	}
+
+	int64_t sum = 0;
+	for(int64_t i = 0; i < 4; i++) {
+		void *s;
+		pthread_join(cth[i], &s);
+		sum += (int64_t)s;
+	}
+	int64_t const n = UNITTEST_RING_CNT;
+	assert(sum == 4 * n * (n + 1) / 2, "%lld", sum);
+
+	ptask_ring_clean(r);
+}
+
 /**
  * end of ptask.c
  */
@@ -27,6 +27,13 @@ enum ptask_status {
  */
 typedef struct ptask_context_s ptask_t;
 
+/**
+ * @fn ptask_get_num_cores
+ * @brief number of cores available to the process (affinity mask and cgroup cpu quota)
+ */
+int64_t ptask_get_num_cores(
+	void);
+
 /**
  * @fn ptask_init
  * @brief initialize threads
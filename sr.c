@@ -10,20 +10,28 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include "lmm.h"
+#include "ptask.h"
 #include "sr.h"
 #include "fna.h"
 #include "gref.h"
+#include "hmap.h"
 #include "log.h"
 #include "sassert.h"
 
 
 /* constants */
 #define SR_SINGLE_READ_MEM_SIZE		( 4 * 1024 * 1024 )
+#define SR_BLOCK_SIZE				( 256 * 1024 )
 
 /* inline directive */
 #define _force_inline				inline
 
+/* max and min */
+#define MAX2(x,y) 					( (x) > (y) ? (x) : (y) )
+#define MIN2(x,y) 					( (x) < (y) ? (x) : (y) )
+
 
 /* assertions */
 _static_assert((int32_t)FNA_UNKNOWN == (int32_t)SR_UNKNOWN);
@@ -36,6 +44,21 @@ _static_assert((int32_t)GREF_FW_ONLY == (int32_t)SR_FW_ONLY);
 _static_assert((int32_t)GREF_FW_RV == (int32_t)SR_FW_RV);
 
 
+/**
+ * @struct sr_block_s
+ * @brief raw text of reads and the parsed grefs (block parsing). at most blk_max reads are
+ * parsed at once, the parser (fna) is kept open while the block has records left.
+ */
+struct sr_block_s {
+	uint8_t *block;
+	uint64_t len;
+	uint32_t file_format;
+	uint32_t reserved;
+	fna_t *fna;
+	uint64_t pos;					/* next read to be handed out */
+	lmm_kvec_t(struct sr_gref_intl_s *) v;
+};
+
 /**
  * @struct sr_s
  */
@@ -47,7 +70,20 @@ struct sr_s {
 	struct sr_gref_s *(*iter_read)(
 		sr_t *sr);
 	lmm_pool_t *pool;
+	pthread_mutex_t pool_lock;		/* reads may be freed on a thread other than the reader */
 	struct sr_params_s params;
+
+	/* graph split */
+	uint32_t part_idx;
+	uint32_t part_cnt;
+	uint32_t *part_gid;				/* boundaries of the pieces (part_cnt + 1) */
+
+	/* block parsing (FASTA and FASTQ on multiple threads) */
+	ptask_t *pt;
+	struct sr_block_s *blk;			/* params.num_threads blocks, in the input order */
+	uint32_t blk_idx;
+	uint32_t blk_cnt;
+	uint64_t blk_max;				/* reads parsed in a block at once */
 };
 
 /**
@@ -64,9 +100,179 @@ struct sr_gref_intl_s {
 	uint8_t gref_need_free;
 	uint8_t seq_need_free;
 	uint8_t reserved2[6];
+	uint32_t part_idx;
+	uint32_t part_cnt;
 };
 _static_assert(sizeof(struct sr_gref_s) == sizeof(struct sr_gref_intl_s));
 
+/**
+ * @fn sr_append_seq
+ * @brief append a segment or a link to the pool
+ */
+static _force_inline
+void sr_append_seq(
+	gref_pool_t *pool,
+	fna_seq_t *seq)
+{
+	if(seq->type == FNA_SEGMENT) {
+		/*
+		for(int64_t i = 0; i < seq->s.segment.seq.len; i++) {
+			fprintf(stderr, "%c", " AC G   T"[seq->s.segment.seq.ptr[i]]);
+		}
+		fprintf(stderr, "\n");
+		*/
+
+		gref_append_segment(pool,
+			seq->s.segment.name.ptr,
+			seq->s.segment.name.len,
+			seq->s.segment.seq.ptr,
+			seq->s.segment.seq.len);
+	} else if(seq->type == FNA_LINK) {
+		/* check cigar starts from '0' (indicating cigar is "0M") */
+		if(seq->s.link.cigar.ptr[0] != '0') {
+			log("overlapping link is not supported (ignored).");
+			return;
+		}
+		gref_append_link(pool,
+			seq->s.link.src.ptr,
+			seq->s.link.src.len,
+			seq->s.link.src_ori,
+			seq->s.link.dst.ptr,
+			seq->s.link.dst.len,
+			seq->s.link.dst_ori);
+	} else {
+		/* unknown type */
+		debug("unknown sequence type appeared.");
+	}
+	return;
+}
+
+/**
+ * @struct sr_seq_rec_s
+ * @brief a record and the block-local ids of its names (UINT32_MAX if not resolved)
+ */
+struct sr_seq_rec_s {
+	fna_seq_t *seq;
+	uint32_t id[2];					/* segment, or source and destination of link */
+};
+
+/**
+ * @struct sr_seq_block_s
+ * @brief a block of the reference, the records parsed from it, and the names in the block
+ */
+struct sr_seq_block_s {
+	uint8_t *block;
+	uint64_t len;
+	uint32_t file_format;
+	uint32_t reserved;
+	hmap_t *names;					/* ids are in the order of the first appearance in the block */
+	lmm_kvec_t(struct sr_seq_rec_s) v;
+};
+
+/**
+ * @fn sr_dump_seq_source
+ * @brief read the next block of the reference
+ */
+static
+void *sr_dump_seq_source(
+	void *arg)
+{
+	sr_t *sr = (sr_t *)arg;
+
+	struct sr_seq_block_s *b = (struct sr_seq_block_s *)malloc(sizeof(struct sr_seq_block_s));
+	if(b == NULL) { return(NULL); }
+
+	b->block = fna_read_block(sr->fna, SR_BLOCK_SIZE, &b->len);
+	if(b->block == NULL) {
+		free(b);
+		return(NULL);
+	}
+	b->file_format = sr->fna->file_format;
+	b->names = NULL;
+	lmm_kv_init(NULL, b->v);
+	return((void *)b);
+}
+
+/**
+ * @fn sr_dump_seq_parse
+ * @brief (worker) parse and encode records in a block, and resolve their names to block-local ids
+ */
+static
+void *sr_dump_seq_parse(
+	void *arg,
+	void *item)
+{
+	struct sr_seq_block_s *b = (struct sr_seq_block_s *)item;
+
+	fna_t *fna = fna_init_mem(b->block, b->len, FNA_PARAMS(
+		.file_format = b->file_format,
+		.seq_encode = FNA_4BIT,
+		.seq_head_margin = 32,
+		.seq_tail_margin = 32));
+	b->names = hmap_init(sizeof(hmap_header_t), HMAP_PARAMS( .hmap_size = 1024 ));
+	if(fna != NULL && b->names != NULL) {
+		fna_seq_t *seq = NULL;
+		while((seq = fna_read(fna)) != NULL) {
+			struct sr_seq_rec_s r = { .seq = seq, .id = { UINT32_MAX, UINT32_MAX } };
+
+			/* the other records are passed to sr_append_seq as is (no name is resolved) */
+			if(seq->type == FNA_SEGMENT) {
+				r.id[0] = hmap_get_id(b->names, seq->s.segment.name.ptr, seq->s.segment.name.len);
+			} else if(seq->type == FNA_LINK && seq->s.link.cigar.ptr[0] == '0') {
+				r.id[0] = hmap_get_id(b->names, seq->s.link.src.ptr, seq->s.link.src.len);
+				r.id[1] = hmap_get_id(b->names, seq->s.link.dst.ptr, seq->s.link.dst.len);
+			}
+			lmm_kv_push(NULL, b->v, r);
+		}
+	}
+	fna_close(fna);
+	free(b->block); b->block = NULL;
+	return((void *)b);
+}
+
+/**
+ * @fn sr_dump_seq_drain
+ * @brief merge the names of a block into the pool, then append the records in the file order
+ */
+static
+void sr_dump_seq_drain(
+	void *arg,
+	void *result)
+{
+	gref_pool_t *pool = (gref_pool_t *)arg;
+	struct sr_seq_block_s *b = (struct sr_seq_block_s *)result;
+
+	/* a lookup for each name in the block; new ones are numbered in the order of the first appearance */
+	uint32_t cnt = (b->names != NULL) ? hmap_get_count(b->names) : 0;
+	uint32_t *map = (uint32_t *)malloc(sizeof(uint32_t) * (cnt + 1));
+	for(uint32_t i = 0; i < cnt; i++) {
+		struct hmap_key_s k = hmap_get_key(b->names, i);
+		map[i] = gref_get_name_id(pool, k.ptr, k.len);
+	}
+
+	for(uint64_t i = 0; i < lmm_kv_size(b->v); i++) {
+		struct sr_seq_rec_s const *r = &lmm_kv_at(b->v, i);
+		fna_seq_t *seq = r->seq;
+		if(r->id[0] == UINT32_MAX) {
+			sr_append_seq(pool, seq);
+		} else if(seq->type == FNA_SEGMENT) {
+			gref_append_segment_id(pool, map[r->id[0]],
+				seq->s.segment.seq.ptr,
+				seq->s.segment.seq.len);
+		} else {
+			gref_append_link_id(pool,
+				map[r->id[0]], seq->s.link.src_ori,
+				map[r->id[1]], seq->s.link.dst_ori);
+		}
+		fna_seq_free(seq);
+	}
+	free(map);
+	hmap_clean(b->names);
+	lmm_kv_destroy(NULL, b->v);
+	free(b);
+	return;
+}
+
 /**
  * @fn sr_dump_seq
  */
@@ -85,43 +291,30 @@ void sr_dump_seq(
 		.num_threads = sr->params.num_threads,
 		.lmm = NULL));
 
-	/* dump sequence */
-	fna_seq_t *seq = NULL;
-	while((seq = fna_read(sr->fna)) != NULL) {
-
-		if(seq->type == FNA_SEGMENT) {
-			/*
-			for(int64_t i = 0; i < seq->s.segment.seq.len; i++) {
-				fprintf(stderr, "%c", " AC G   T"[seq->s.segment.seq.ptr[i]]);
-			}
-			fprintf(stderr, "\n");
-			*/
-
-			gref_append_segment(pool,
-				seq->s.segment.name.ptr,
-				seq->s.segment.name.len,
-				seq->s.segment.seq.ptr,
-				seq->s.segment.seq.len);
-		} else if(seq->type == FNA_LINK) {
-			/* check cigar starts from '0' (indicating cigar is "0M") */
-			if(seq->s.link.cigar.ptr[0] != '0') {
-				log("overlapping link is not supported (ignored).");
-				fna_seq_free(seq);
-				continue;
-			}
-			gref_append_link(pool,
-				seq->s.link.src.ptr,
-				seq->s.link.src.len,
-				seq->s.link.src_ori,
-				seq->s.link.dst.ptr,
-				seq->s.link.dst.len,
-				seq->s.link.dst_ori);
-		} else {
-			/* unknown type */
-			debug("unknown sequence type appeared.");
+	/**
+	 * parse GFA in blocks on the threads. names are hashed into a table for each block on
+	 * the threads; the drain merges the tables in the file order, so that the ids (and the
+	 * index) are the same as the serial parser, with a lookup for each distinct name in a block.
+	 */
+	ptask_t *pt = NULL;
+	if(sr->fna->file_format == FNA_GFA && sr->params.num_threads > 0) {
+		void *worker_arg[sr->params.num_threads];
+		for(int64_t i = 0; i < sr->params.num_threads; i++) {
+			worker_arg[i] = (void *)sr;
 		}
+		pt = ptask_init(sr_dump_seq_parse, worker_arg, sr->params.num_threads, 4 * sr->params.num_threads);
+	}
 
-		fna_seq_free(seq);
+	/* dump sequence */
+	if(pt != NULL) {
+		ptask_stream(pt, sr_dump_seq_source, (void *)sr, sr_dump_seq_drain, (void *)pool, 0);
+		ptask_clean(pt);
+	} else {
+		fna_seq_t *seq = NULL;
+		while((seq = fna_read(sr->fna)) != NULL) {
+			sr_append_seq(pool, seq);
+			fna_seq_free(seq);
+		}
 	}
 	
 	/* freeze */
@@ -163,67 +356,190 @@ struct sr_gref_s *sr_get_index(
 		.path = sr->path,
 		.gref = (gref_t const *)sr->idx,
 		.iter = NULL,
-		.gref_need_free = 0
+		.gref_need_free = 0,
+		.part_idx = 0,
+		.part_cnt = 1
 	};
 	return((struct sr_gref_s *)r);
 }
 
+/**
+ * @fn sr_dump_index
+ * @brief build index and dump it to path. kmers are sorted out of core if the in-memory
+ * build (kmer array and its sort buffer) is estimated to exceed mem_size (0 for unlimited).
+ */
+int sr_dump_index(
+	sr_t *sr,
+	char const *path,
+	uint64_t mem_size)
+{
+	if(sr->idx == NULL && mem_size != 0) {
+		if(sr->acv == NULL) {
+			sr_dump_seq(sr);
+		}
+		if(sr->acv == NULL) {
+			return(-1);
+		}
+
+		/* both strands enumerated */
+		uint64_t build_size = 2 * sizeof(struct gref_kmer_tuple_s)
+			* 2 * gref_get_total_len((gref_t const *)sr->acv);
+		if(build_size > mem_size) {
+			debug("out-of-core build, build_size(%llu), mem_size(%llu)", build_size, mem_size);
+			return((gref_dump_index_ext(sr->acv, path, mem_size) == GREF_SUCCESS) ? 0 : -1);
+		}
+	}
+
+	struct sr_gref_s *r = sr_get_index(sr);
+	if(r == NULL) {
+		return(-1);
+	}
+	int ret = gref_dump_index((gref_idx_t const *)r->gref, path);
+	sr_gref_free(r);
+	return((ret == GREF_SUCCESS) ? 0 : -1);
+}
+
+/**
+ * @fn sr_split_graph
+ * @brief split forward sections into contiguous ranges of approximately the same length.
+ * each cut is placed where the fewest links cross, searched within a half piece around
+ * the balanced position. a piece only limits where seeds are taken: extension runs on the
+ * whole graph, so alignments across a cut are found from either side and the ones
+ * overlapping a better one are removed in ggsea_merge_results.
+ */
+static _force_inline
+int sr_split_graph(
+	sr_t *sr)
+{
+	uint32_t sec_cnt = gref_get_section_count(sr->acv);
+	uint32_t part_cnt = MAX2(1, MIN2(sec_cnt, MAX2(1, sr->params.graph_split_cnt)));
+	int64_t *cross = (int64_t *)malloc(sizeof(int64_t) * (sec_cnt + 1));
+	uint64_t *acc = (uint64_t *)malloc(sizeof(uint64_t) * (sec_cnt + 1));
+	sr->part_gid = (uint32_t *)malloc(sizeof(uint32_t) * (part_cnt + 1));
+	if(cross == NULL || acc == NULL || sr->part_gid == NULL) {
+		free(cross); free(acc);
+		free(sr->part_gid); sr->part_gid = NULL;
+		return(-1);
+	}
+
+	/* cross[c]: number of links across the cut between sections c - 1 and c */
+	memset(cross, 0, sizeof(int64_t) * (sec_cnt + 1));
+	for(uint32_t sid = 0; sid < sec_cnt; sid++) {
+		for(uint32_t d = 0; d < 2; d++) {
+			struct gref_link_s link = gref_get_link(sr->acv, gref_gid(sid, d));
+			for(int64_t k = 0; k < link.len; k++) {
+				uint32_t tid = gref_id(link.gid_arr[k]);
+				if(tid == sid) { continue; }
+				cross[MIN2(sid, tid) + 1]++;
+				cross[MAX2(sid, tid) + 1]--;
+			}
+		}
+	}
+	acc[0] = 0;
+	for(uint32_t sid = 0; sid < sec_cnt; sid++) {
+		cross[sid + 1] += cross[sid];
+		acc[sid + 1] = acc[sid] + gref_get_section(sr->acv, gref_gid(sid, 0))->len;
+	}
+
+	/* cuts in [1, sec_cnt), increasing */
+	int64_t const width = MAX2(1, sec_cnt / (2 * part_cnt));
+	uint32_t prev = 0, j = 0, t = 1;
+	sr->part_gid[j++] = gref_gid(0, 0);
+	for(uint32_t i = 1; i < part_cnt; i++) {
+		/* balanced position: the first cut with the preceding length over the target */
+		uint64_t lim_len = i * acc[sec_cnt] / part_cnt;
+		while(t < sec_cnt && acc[t] < lim_len) { t++; }
+		if(t >= sec_cnt) { break; }
+
+		int64_t cut = -1;
+		for(int64_t c = MAX2(MAX2(1, (int64_t)prev), (int64_t)t - width); c <= MIN2(sec_cnt - 1, t + width); c++) {
+			if(cut < 0 || cross[c] < cross[cut]
+			|| (cross[c] == cross[cut] && llabs(c - (int64_t)t) < llabs(cut - (int64_t)t))) {
+				cut = c;
+			}
+		}
+		if(cut <= prev) { continue; }		/* merged into the previous piece */
+		sr->part_gid[j++] = gref_gid(cut, 0);
+		prev = cut;
+	}
+	sr->part_gid[j] = gref_gid(sec_cnt, 0);
+	sr->part_cnt = j;
+	debug("split into %u pieces", j);
+
+	free(cross);
+	free(acc);
+	return(0);
+}
+
 /**
  * @fn sr_get_iter_graph
+ * @brief returns pieces of the graph (split by params.graph_split_cnt) in order
  */
 static
 struct sr_gref_s *sr_get_iter_graph(
 	sr_t *sr)
 {
-	/* check if archive is already built */
-	if(sr->acv == NULL) {
-		sr_dump_seq(sr);
+	/* check if archive is already built (or loaded) */
+	if(sr->part_gid == NULL) {
 		if(sr->acv == NULL) {
+			sr_dump_seq(sr);
+		}
+		if(sr->acv == NULL || sr_split_graph(sr) != 0) {
 			return(NULL);
 		}
-	} else {
+	}
+
+	/* returns NULL after the last piece */
+	if(sr->part_idx >= sr->part_cnt) {
+		return(NULL);
+	}
+	uint32_t part_idx = sr->part_idx++;
+	gref_iter_t *iter = gref_iter_init_range(sr->acv, NULL, sr->part_gid[part_idx], sr->part_gid[part_idx + 1]);
+	if(iter == NULL) {
 		return(NULL);
 	}
 
 	struct sr_gref_intl_s *r = (struct sr_gref_intl_s *)malloc(
 		sizeof(struct sr_gref_intl_s));
 	*r = (struct sr_gref_intl_s){
-		.lmm = NULL,
+		/* alignments of a piece must outlive the dp context (pieces are merged in drain) */
+		.lmm = lmm_init(NULL, 0),
 		.sr = sr,
 		.path = sr->path,
 		.gref = sr->acv,
-		.iter = gref_iter_init(sr->acv, NULL)
+		.iter = iter,
+		.part_idx = part_idx,
+		.part_cnt = sr->part_cnt
 	};
 	return((struct sr_gref_s *)r);
 }
 
 /**
- * @fn sr_get_iter_read
+ * @fn sr_read_gref
+ * @brief read a sequence from fna and build its gref, returns NULL at the end
  */
 static
-struct sr_gref_s *sr_get_iter_read(
-	sr_t *sr)
+struct sr_gref_intl_s *sr_read_gref(
+	sr_t *sr,
+	fna_t *fna)
 {
-	if(sr->fna == NULL) {
-		return(NULL);
-	}
-
 	/* gref objects */
 	gref_acv_t *acv = NULL;
 
 	/* init local memory */
 	// lmm_t *lmm_read = lmm_init(NULL, SR_SINGLE_READ_MEM_SIZE);
-	lmm_t *lmm_read = lmm_init(
-		lmm_pool_create_object(sr->pool),
-		sr->params.read_mem_size - sizeof(struct lmm_s));
+	pthread_mutex_lock(&sr->pool_lock);
+	void *base = lmm_pool_create_object(sr->pool);
+	pthread_mutex_unlock(&sr->pool_lock);
+	lmm_t *lmm_read = lmm_init(base, sr->params.read_mem_size - sizeof(struct lmm_s));
 	struct sr_gref_intl_s *r = (struct sr_gref_intl_s *)lmm_malloc(
 		lmm_read, sizeof(struct sr_gref_intl_s));
 	debug("sr_gref malloc, ptr(%p)", r);
 
 	/* read a sequence */
-	fna_set_lmm(sr->fna, lmm_read);
+	fna_set_lmm(fna, lmm_read);
 	fna_seq_t *seq = NULL;
-	while((seq = fna_read(sr->fna)) != NULL) {
+	while((seq = fna_read(fna)) != NULL) {
 		if(seq->type == FNA_SEGMENT) {
 			/*
 			debug("name(%s), comment(%s)", seq->s.segment.name.ptr, seq->s.segment.comment.ptr);
@@ -238,7 +554,7 @@ struct sr_gref_s *sr_get_iter_read(
 				.seq_direction = sr->params.seq_direction,
 				.seq_format = GREF_4BIT,
 				.copy_mode = GREF_NOCOPY,
-				.num_threads = sr->params.num_threads,
+				.num_threads = 0,			/* too small to be built on threads */
 				.hash_size = 2,
 				.lmm = lmm_read));
 
@@ -254,9 +570,13 @@ struct sr_gref_s *sr_get_iter_read(
 	}
 
 	if(seq == NULL) {
-		fna_close(sr->fna); sr->fna = NULL;
 		lmm_free(lmm_read, r);
-		lmm_clean(lmm_read);
+		void *base = lmm_clean(lmm_read);
+		if(base != NULL) {
+			pthread_mutex_lock(&sr->pool_lock);
+			lmm_pool_delete_object(sr->pool, base);
+			pthread_mutex_unlock(&sr->pool_lock);
+		}
 		return(NULL);
 	}
 
@@ -268,11 +588,125 @@ struct sr_gref_s *sr_get_iter_read(
 		.iter = gref_iter_init(acv, NULL),
 		.seq = seq,
 		.gref_need_free = 1,
-		.seq_need_free = 1
+		.seq_need_free = 1,
+		.part_idx = 0,
+		.part_cnt = 1
 	};
+	return(r);
+}
+
+/**
+ * @fn sr_get_iter_read
+ */
+static
+struct sr_gref_s *sr_get_iter_read(
+	sr_t *sr)
+{
+	if(sr->fna == NULL) {
+		return(NULL);
+	}
+
+	struct sr_gref_intl_s *r = sr_read_gref(sr, sr->fna);
+	if(r == NULL) {
+		fna_close(sr->fna); sr->fna = NULL;
+	}
 	return((struct sr_gref_s *)r);
 }
 
+/**
+ * @fn sr_parse_block
+ * @brief (worker) parse the next blk_max reads in a block into grefs
+ */
+static
+void *sr_parse_block(
+	void *arg,
+	void *item)
+{
+	struct sr_s *sr = (struct sr_s *)arg;
+	struct sr_block_s *b = (struct sr_block_s *)item;
+
+	/* finished, or the reads parsed in the previous round are not handed out yet */
+	if(b->block == NULL || b->pos < lmm_kv_size(b->v)) {
+		return((void *)b);
+	}
+	lmm_kv_clear(NULL, b->v);
+	b->pos = 0;
+
+	if(b->fna == NULL) {
+		b->fna = fna_init_mem(b->block, b->len, FNA_PARAMS(
+			.file_format = b->file_format,
+			.seq_encode = FNA_4BIT,
+			.seq_head_margin = 32,
+			.seq_tail_margin = 32));
+	}
+	if(b->fna != NULL) {
+		struct sr_gref_intl_s *r = NULL;
+		while(lmm_kv_size(b->v) < sr->blk_max && (r = sr_read_gref(sr, b->fna)) != NULL) {
+			lmm_kv_push(NULL, b->v, r);
+		}
+		if(lmm_kv_size(b->v) == sr->blk_max) {
+			return((void *)b);		/* records left */
+		}
+		fna_close(b->fna); b->fna = NULL;
+	}
+
+	/* sequences are copied into the lmm of each read */
+	free(b->block); b->block = NULL;
+	return((void *)b);
+}
+
+/**
+ * @fn sr_get_iter_block
+ * @brief read blocks of reads, parse them on the threads, and return the reads in order.
+ * reads parsed but not handed out are bounded by num_threads * blk_max.
+ */
+static
+struct sr_gref_s *sr_get_iter_block(
+	sr_t *sr)
+{
+	while(1) {
+		/* reads parsed in the current round, up to the first block with records left */
+		while(sr->blk_idx < sr->blk_cnt) {
+			struct sr_block_s *b = &sr->blk[sr->blk_idx];
+			if(b->pos < lmm_kv_size(b->v)) {
+				return((struct sr_gref_s *)lmm_kv_at(b->v, b->pos++));
+			}
+			if(b->block != NULL) { break; }
+			sr->blk_idx++;
+		}
+
+		/* keep the blocks not finished in order, and read new ones into the rest */
+		uint32_t cnt = 0;
+		for(uint32_t i = sr->blk_idx; i < sr->blk_cnt; i++) {
+			struct sr_block_s t = sr->blk[cnt];
+			sr->blk[cnt++] = sr->blk[i];
+			sr->blk[i] = t;
+		}
+		while(cnt < sr->params.num_threads && sr->fna != NULL) {
+			struct sr_block_s *b = &sr->blk[cnt];
+			lmm_kv_clear(NULL, b->v);
+			b->pos = 0;
+			b->block = fna_read_block(sr->fna, SR_BLOCK_SIZE, &b->len);
+			if(b->block == NULL) {
+				fna_close(sr->fna); sr->fna = NULL;
+				break;
+			}
+			b->file_format = sr->fna->file_format;
+			cnt++;
+		}
+		if(cnt == 0) {
+			return(NULL);
+		}
+
+		void *items[sr->params.num_threads];
+		for(int64_t i = 0; i < sr->params.num_threads; i++) {
+			items[i] = (void *)&sr->blk[i];
+		}
+		ptask_parallel(sr->pt, items, NULL);
+		sr->blk_idx = 0;
+		sr->blk_cnt = cnt;
+	}
+}
 /**
  * @fn sr_get_iter
  */
@@ -302,11 +736,47 @@ void sr_gref_free(
 	lmm_free(lmm, r);
 	void *base = lmm_clean(lmm);
 	if(base != NULL) {
+		pthread_mutex_lock(&sr->pool_lock);
 		lmm_pool_delete_object(sr->pool, base);
+		pthread_mutex_unlock(&sr->pool_lock);
 	}
 	return;
 }
 
+/**
+ * @fn sr_is_index_path
+ */
+int sr_is_index_path(
+	char const *path)
+{
+	uint64_t len = strlen(path);
+	uint64_t suffix_len = strlen(SR_INDEX_SUFFIX);
+	return(len > suffix_len && strcmp(path + len - suffix_len, SR_INDEX_SUFFIX) == 0);
+}
+
+/**
+ * @fn sr_load_index
+ * @brief map prebuilt index, the index is handled as a graph
+ */
+static _force_inline
+int sr_load_index(
+	sr_t *sr,
+	sr_params_t const *params)
+{
+	sr->idx = gref_load_index(sr->path, GREF_PARAMS(
+		.k = params->k,
+		.seq_direction = params->seq_direction,
+		.num_threads = params->num_threads));
+	if(sr->idx == NULL) {
+		return(-1);
+	}
+
+	/* acv and idx share the same object, as built by gref_build_index */
+	sr->acv = (gref_acv_t *)sr->idx;
+	sr->iter_read = sr_get_iter_graph;
+	return(0);
+}
+
 /**
  * @fn sr_init
  */
@@ -325,24 +795,31 @@ sr_t *sr_init(
 	memset(sr, 0, sizeof(struct sr_s));
 	sr->path = strdup(path);
 
-	/* create fna object */
-	sr->fna = fna_init(path, FNA_PARAMS(
-		.file_format = params->format,
-		.seq_encode = FNA_4BIT,
-		.seq_head_margin = 32,
-		.seq_tail_margin = 32));
-	debug("fna(%p)", sr->fna);
-	if(sr->fna == NULL) {
-		goto _sr_init_error_handler;
-	}
+	if(sr_is_index_path(path)) {
+		/* load index built by `comb index' */
+		if(sr_load_index(sr, params) != 0) {
+			goto _sr_init_error_handler;
+		}
+	} else {
+		/* create fna object */
+		sr->fna = fna_init(path, FNA_PARAMS(
+			.file_format = params->format,
+			.seq_encode = FNA_4BIT,
+			.seq_head_margin = 32,
+			.seq_tail_margin = 32));
+		debug("fna(%p)", sr->fna);
+		if(sr->fna == NULL) {
+			goto _sr_init_error_handler;
+		}
 
-	static struct sr_gref_s *(*iter_read_table[])(sr_t *) = {
-		[SR_FASTA] = sr_get_iter_read,
-		[SR_FASTQ] = sr_get_iter_read,
-		[SR_FAST5] = sr_get_iter_read,
-		[SR_GFA] = sr_get_iter_graph
-	};
-	sr->iter_read = iter_read_table[sr->fna->file_format];
+		static struct sr_gref_s *(*iter_read_table[])(sr_t *) = {
+			[SR_FASTA] = sr_get_iter_read,
+			[SR_FASTQ] = sr_get_iter_read,
+			[SR_FAST5] = sr_get_iter_read,
+			[SR_GFA] = sr_get_iter_graph
+		};
+		sr->iter_read = iter_read_table[sr->fna->file_format];
+	}
 
 	/* copy params */
 	sr->params = *params;
@@ -350,9 +827,32 @@ sr_t *sr_init(
 	_restore(sr->params.pool_size, 1024);
 	_restore(sr->params.read_mem_size, SR_SINGLE_READ_MEM_SIZE);
 
-	/* init pool */
-	if(sr->iter_read == sr_get_iter_read) {
-		sr->pool = lmm_pool_init(NULL, sr->params.read_mem_size, sr->params.pool_size);
+	pthread_mutex_init(&sr->pool_lock, NULL);
+	/* parse FASTA and FASTQ in blocks on the threads */
+	if(sr->iter_read == sr_get_iter_read && sr->fna->file_format != FNA_FAST5 && sr->params.num_threads > 0) {
+		void *worker_arg[sr->params.num_threads];
+		for(int64_t i = 0; i < sr->params.num_threads; i++) {
+			worker_arg[i] = (void *)sr;
+		}
+		sr->pt = ptask_init(sr_parse_block, worker_arg, sr->params.num_threads, 1024);
+		sr->blk = (struct sr_block_s *)malloc(sizeof(struct sr_block_s) * sr->params.num_threads);
+		if(sr->pt == NULL || sr->blk == NULL) {
+			goto _sr_init_error_handler;
+		}
+		for(int64_t i = 0; i < sr->params.num_threads; i++) {
+			sr->blk[i].block = NULL;
+			sr->blk[i].fna = NULL;
+			sr->blk[i].pos = 0;
+			lmm_kv_init(NULL, sr->blk[i].v);
+		}
+		sr->blk_max = MAX2(1, SR_READ_AHEAD(sr->params.pool_size) / sr->params.num_threads);
+		sr->iter_read = sr_get_iter_block;
+	}
+
+	/* init pool, reads parsed ahead on the threads are held along with the ones handed out (+1 for the tail of the free list) */
+	if(sr->iter_read == sr_get_iter_read || sr->iter_read == sr_get_iter_block) {
+		uint64_t cnt = sr->params.pool_size + ((sr->blk != NULL) ? sr->params.num_threads * sr->blk_max : 0) + 1;
+		sr->pool = lmm_pool_init(NULL, sr->params.read_mem_size, cnt);
 		if(sr->pool == NULL) {
 			goto _sr_init_error_handler;
 		}
@@ -360,6 +860,8 @@ sr_t *sr_init(
 	return((sr_t *)sr);
 
 _sr_init_error_handler:;
+	ptask_clean(sr->pt); sr->pt = NULL;
+	free(sr->blk); sr->blk = NULL;
 	free(sr->path); sr->path = NULL;
 	fna_close(sr->fna); sr->fna = NULL;
 	lmm_pool_clean(sr->pool); sr->pool = NULL;
@@ -375,10 +877,28 @@ void sr_clean(
 {
 	if(sr == NULL) { return; }
 
+	/* reads parsed but not handed out */
+	if(sr->blk != NULL) {
+		for(uint64_t i = sr->blk_idx; i < sr->blk_cnt; i++) {
+			for(uint64_t j = sr->blk[i].pos; j < lmm_kv_size(sr->blk[i].v); j++) {
+				sr_gref_free((struct sr_gref_s *)lmm_kv_at(sr->blk[i].v, j));
+			}
+		}
+		for(int64_t i = 0; i < sr->params.num_threads; i++) {
+			fna_close(sr->blk[i].fna);
+			free(sr->blk[i].block);
+			lmm_kv_destroy(NULL, sr->blk[i].v);
+		}
+		free(sr->blk); sr->blk = NULL;
+	}
+	ptask_clean(sr->pt); sr->pt = NULL;
+
 	gref_clean(sr->acv); sr->acv = NULL;
+	free(sr->part_gid); sr->part_gid = NULL;
 	free(sr->path); sr->path = NULL;
 	fna_close(sr->fna); sr->fna = NULL;
 	lmm_pool_clean(sr->pool); sr->pool = NULL;
+	pthread_mutex_destroy(&sr->pool_lock);
 	free(sr);
 	return;
 }
@@ -537,6 +1057,308 @@ unittest()
 	remove(fasta_filename);
 }
 
+/* reads parsed on threads are returned in order, and the ones parsed ahead fit in the pool */
+unittest()
+{
+	char const *fasta_filename = "test.fa";
+	int64_t const cnt = 20000, pool_size = 8;
+
+	/* longer than a block, length of the i-th read is 8 + i % 7 */
+	FILE *fp = fopen(fasta_filename, "w");
+	for(int64_t i = 0; i < cnt; i++) {
+		fprintf(fp, ">r%" PRId64 "\n%.*s\n", i, (int)(8 + i % 7), "ACGTACGTACGTACGT");
+	}
+	fclose(fp);
+
+	sr_t *sr = sr_init(fasta_filename, SR_PARAMS(
+		.k = 4,
+		.seq_direction = SR_FW_ONLY,
+		.pool_size = pool_size,
+		.num_threads = 2));
+	assert(sr != NULL);
+
+	/* pool_size reads are held at once, as the caller in comb */
+	struct sr_gref_s *held[pool_size];
+	int64_t i = 0, ordered = 1;
+	struct sr_gref_s *iter = NULL;
+	while((iter = sr_get_iter(sr)) != NULL) {
+		ordered &= gref_get_total_len(iter->gref) == 8 + i % 7;
+		if(i >= pool_size) { sr_gref_free(held[i % pool_size]); }
+		held[i++ % pool_size] = iter;
+	}
+	assert(i == cnt, "%lld", i);
+	assert(ordered);
+	assert(((struct lmm_pool_s *)sr->pool)->root->next == NULL);
+
+	for(int64_t j = MAX2(0, i - pool_size); j < i; j++) {
+		sr_gref_free(held[j % pool_size]);
+	}
+	sr_clean(sr);
+	remove(fasta_filename);
+}
+
+/* multi-line FASTQ parsed on threads gives the same reads as the serial parser */
+unittest()
+{
+	char const *fastq_filename = "test.fq";
+	int64_t const cnt = 20000;
+
+	/* longer than a block, wrapped every 5 characters; the quality lines look like records */
+	FILE *fp = fopen(fastq_filename, "w");
+	char const *qual[3] = { "@IIII", "IIIII", "+IIII" };
+	for(int64_t i = 0; i < cnt; i++) {
+		int64_t len = 11 + i % 17;
+		fprintf(fp, "@r%" PRId64 "\n", i);
+		for(int64_t j = 0; j < len; j += 5) { fprintf(fp, "%.*s\n", (int)MIN2(5, len - j), "ACGTA"); }
+		fprintf(fp, "+\n");
+		for(int64_t j = 0; j < len; j += 5) { fprintf(fp, "%.*s\n", (int)MIN2(5, len - j), qual[(j / 5) % 3]); }
+	}
+	fclose(fp);
+
+	for(uint32_t t = 0; t < 2; t++) {
+		sr_t *sr = sr_init(fastq_filename, SR_PARAMS(
+			.k = 4,
+			.seq_direction = SR_FW_ONLY,
+			.num_threads = 2 * t));
+		assert(sr != NULL);
+
+		int64_t i = 0, ordered = 1;
+		struct sr_gref_s *iter = NULL;
+		while((iter = sr_get_iter(sr)) != NULL) {
+			char name[32];
+			sprintf(name, "r%" PRId64, i);
+			struct gref_str_s n = gref_get_name(iter->gref, 0);
+			ordered &= n.len == (int32_t)strlen(name) && memcmp(n.ptr, name, n.len) == 0;
+			ordered &= gref_get_total_len(iter->gref) == 11 + i % 17;
+			sr_gref_free(iter);
+			i++;
+		}
+		assert(i == cnt, "t(%u), %lld", t, i);
+		assert(ordered, "t(%u)", t);
+		sr_clean(sr);
+	}
+	remove(fastq_filename);
+}
+
+/* load prebuilt index */
+unittest()
+{
+	char const *fasta_filename = "test.fa";
+	char const *index_filename = "test.fa" SR_INDEX_SUFFIX;
+	char const *fasta_content =
+		">test1\n"
+		"ACGTACGT\n"
+		">test2\n"
+		"TTTTGGGG\n"
+		">test3\n"
+		"AAAAAAAA";
+
+	fdump(fasta_filename, fasta_content);
+	sr_t *sr = sr_init(fasta_filename, SR_PARAMS(
+		.k = 4,
+		.seq_direction = SR_FW_ONLY));
+	assert(sr != NULL);
+
+	struct sr_gref_s *idx = sr_get_index(sr);
+	assert(idx != NULL);
+	assert(gref_dump_index((gref_idx_t const *)idx->gref, index_filename) == GREF_SUCCESS);
+	sr_gref_free(idx);
+	sr_clean(sr);
+
+	/* k mismatch */
+	assert(sr_is_index_path(index_filename));
+	sr = sr_init(index_filename, SR_PARAMS( .k = 5 ));
+	assert(sr == NULL);
+
+	sr = sr_init(index_filename, SR_PARAMS(
+		.k = 4,
+		.seq_direction = SR_FW_ONLY));
+	assert(sr != NULL);
+
+	idx = sr_get_index(sr);
+	assert(idx != NULL);
+	assert(gref_get_total_len(idx->gref) == 24, "%lld", gref_get_total_len(idx->gref));
+	sr_gref_free(idx);
+
+	/* index is iterated as a graph */
+	struct sr_gref_s *iter = sr_get_iter(sr);
+	assert(iter != NULL);
+	assert(iter->iter != NULL);
+	sr_gref_free(iter);
+
+	iter = sr_get_iter(sr);
+	assert(iter == NULL);
+
+	sr_clean(sr);
+	remove(fasta_filename);
+	remove(index_filename);
+}
+
+/* GFA parsed in blocks on threads gives the same names, ids, and links as the serial parser */
+unittest()
+{
+	char const *gfa_filename = "test.gfa";
+	int64_t const cnt = 6000;
+
+	/* longer than a block; links refer to segments before they appear, and the overlapping ones are ignored */
+	FILE *fp = fopen(gfa_filename, "w");
+	fprintf(fp, "H\tVN:Z:1.0\n");
+	for(int64_t i = 0; i < cnt; i++) {
+		int64_t j = (i * 7919) % cnt;
+		fprintf(fp, "L\tseg%" PRId64 "\t+\tseg%" PRId64 "\t%c\t0M\n", j, (j + 1) % cnt, "+-"[i & 1]);
+		fprintf(fp, "S\tseg%" PRId64 "\t%.*s\n", i, (int)(32 + i % 29), "ACGTTGCAAGCTTCGAGATCCATGGTACCAGTCGACTGCAGAATTCGGCCGTTAACC");
+		if(i % 1000 == 0) { fprintf(fp, "L\tseg%" PRId64 "\t-\tseg%" PRId64 "\t+\t4M\n", i, j); }
+	}
+	fclose(fp);
+
+	struct sr_gref_s *idx[2];
+	sr_t *sr[2];
+	for(uint32_t t = 0; t < 2; t++) {
+		sr[t] = sr_init(gfa_filename, SR_PARAMS(
+			.k = 4,
+			.seq_direction = SR_FW_ONLY,
+			.num_threads = 4 * t));
+		assert(sr[t] != NULL);
+		idx[t] = sr_get_index(sr[t]);
+		assert(idx[t] != NULL);
+	}
+
+	assert(gref_get_section_count(idx[0]->gref) == cnt, "%lld", (int64_t)gref_get_section_count(idx[0]->gref));
+	assert(gref_get_section_count(idx[1]->gref) == cnt, "%lld", (int64_t)gref_get_section_count(idx[1]->gref));
+	assert(gref_get_total_len(idx[0]->gref) == gref_get_total_len(idx[1]->gref));
+
+	int64_t name_eq = 1, link_eq = 1, link_cnt = 0;
+	for(uint32_t gid = 0; gid < 2 * cnt; gid++) {
+		struct gref_str_s n[2] = { gref_get_name(idx[0]->gref, gid), gref_get_name(idx[1]->gref, gid) };
+		name_eq &= n[0].len == n[1].len && memcmp(n[0].ptr, n[1].ptr, n[0].len) == 0;
+
+		struct gref_link_s l[2] = { gref_get_link(idx[0]->gref, gid), gref_get_link(idx[1]->gref, gid) };
+		link_eq &= l[0].len == l[1].len && memcmp(l[0].gid_arr, l[1].gid_arr, sizeof(uint32_t) * l[0].len) == 0;
+		link_cnt += l[0].len;
+	}
+	assert(name_eq);
+	assert(link_eq);
+	assert(link_cnt == 2 * cnt, "%lld", link_cnt);
+
+	for(uint32_t t = 0; t < 2; t++) {
+		sr_gref_free(idx[t]);
+		sr_clean(sr[t]);
+	}
+	remove(gfa_filename);
+}
+
+/* graph split */
+unittest()
+{
+	char const *gfa_filename = "test.gfa";
+	char const *gfa_content =
+		"H\tVN:Z:1.0\n"
+		"S\t1\tACGTACGTACGT\n"
+		"S\t2\tTTTTGGGGTTTT\n"
+		"S\t3\tAAAAAAAACCCC\n"
+		"S\t4\tGGGGCCCCAAAA\n"
+		"L\t1\t+\t2\t+\t0M\n"
+		"L\t3\t+\t4\t+\t0M\n";
+
+	fdump(gfa_filename, gfa_content);
+
+	/* two connected components are returned as two pieces */
+	sr_t *sr = sr_init(gfa_filename, SR_PARAMS(
+		.k = 4,
+		.seq_direction = SR_FW_ONLY,
+		.graph_split_cnt = 4));
+	assert(sr != NULL);
+
+	for(uint32_t i = 0; i < 2; i++) {
+		struct sr_gref_s *iter = sr_get_iter(sr);
+		assert(iter != NULL);
+		assert(iter->iter != NULL);
+		assert(iter->part_idx == i, "%u, %u", iter->part_idx, i);
+		assert(iter->part_cnt == 2, "%u", iter->part_cnt);
+		sr_gref_free(iter);
+	}
+	assert(sr_get_iter(sr) == NULL);
+	sr_clean(sr);
+
+	/* not split by default */
+	sr = sr_init(gfa_filename, SR_PARAMS(
+		.k = 4,
+		.seq_direction = SR_FW_ONLY));
+	assert(sr != NULL);
+
+	struct sr_gref_s *iter = sr_get_iter(sr);
+	assert(iter != NULL);
+	assert(iter->part_idx == 0, "%u", iter->part_idx);
+	assert(iter->part_cnt == 1, "%u", iter->part_cnt);
+	sr_gref_free(iter);
+	assert(sr_get_iter(sr) == NULL);
+	sr_clean(sr);
+
+	remove(gfa_filename);
+}
+
+/* graph split, a connected graph */
+unittest()
+{
+	char const *gfa_filename = "test.gfa";
+	char const *gfa_content =
+		"H\tVN:Z:1.0\n"
+		"S\t1\tACGTACGTACGT\n"
+		"S\t2\tTTTTGGGGTTTT\n"
+		"S\t3\tAAAAAAAACCCC\n"
+		"S\t4\tGGGGCCCCAAAA\n"
+		"S\t5\tCATGCATGCATG\n"
+		"S\t6\tGTCAGTCAGTCA\n"
+		"S\t7\tTGCATGCATGCA\n"
+		"S\t8\tCCAACCAACCAA\n"
+		"L\t1\t+\t2\t+\t0M\n"
+		"L\t2\t+\t3\t+\t0M\n"
+		"L\t2\t+\t4\t+\t0M\n"
+		"L\t3\t+\t5\t+\t0M\n"
+		"L\t4\t+\t5\t+\t0M\n"
+		"L\t5\t+\t6\t+\t0M\n"
+		"L\t6\t+\t7\t+\t0M\n"
+		"L\t7\t+\t8\t+\t0M\n";
+
+	fdump(gfa_filename, gfa_content);
+
+	/* cut where a single link crosses, not inside the bubble */
+	sr_t *sr = sr_init(gfa_filename, SR_PARAMS(
+		.k = 4,
+		.seq_direction = SR_FW_ONLY,
+		.graph_split_cnt = 2));
+	assert(sr != NULL);
+
+	uint32_t part_cnt = 0, sec_cnt = 0;
+	struct sr_gref_s *iter = NULL;
+	while((iter = sr_get_iter(sr)) != NULL) {
+		assert(iter->part_idx == part_cnt, "%u, %u", iter->part_idx, part_cnt);
+		assert(iter->part_cnt == 2, "%u", iter->part_cnt);
+		part_cnt++;
+		sec_cnt = gref_get_section_count(iter->gref);
+		sr_gref_free(iter);
+	}
+	assert(part_cnt == 2, "%u", part_cnt);
+	assert(sec_cnt == 8, "%u", sec_cnt);
+	assert(sr->part_gid[1] == gref_gid(5, 0), "%u", sr->part_gid[1]);
+	sr_clean(sr);
+
+	/* split into as many pieces as requested */
+	sr = sr_init(gfa_filename, SR_PARAMS(
+		.k = 4,
+		.seq_direction = SR_FW_ONLY,
+		.graph_split_cnt = 4));
+	assert(sr != NULL);
+
+	iter = sr_get_iter(sr);
+	assert(iter != NULL);
+	assert(iter->part_cnt == 4, "%u", iter->part_cnt);
+	sr_gref_free(iter);
+	sr_clean(sr);
+
+	remove(gfa_filename);
+}
+
 
 /**
  * end of sr.c
@@ -45,14 +45,29 @@ struct sr_params_s {
 	uint8_t reserved1;
 	uint16_t num_threads;
 	uint16_t reserved2;
-	uint32_t pool_size;
+	uint32_t pool_size;			/* reads handed out at once (SR_READ_AHEAD more are parsed ahead on threads) */
 	uint32_t read_mem_size;
+	uint32_t graph_split_cnt;	/* number of pieces a graph is split into (iter), 1 if zero */
+	uint32_t reserved3;
 	void *lmm;					/* lmm memory manager */
 };
 typedef struct sr_params_s sr_params_t;
 
 #define SR_PARAMS(...)		( &((struct sr_params_s const){ __VA_ARGS__ }) )
 
+/**
+ * @macro SR_READ_AHEAD
+ * @brief max reads parsed ahead of the ones handed out, when FASTA and FASTQ are parsed on threads
+ * (at least one for each thread)
+ */
+#define SR_READ_AHEAD(_pool_size)	( (_pool_size) / 4 )
+
+/**
+ * @macro SR_INDEX_SUFFIX
+ * @brief files with the suffix are loaded as prebuilt index (see gref_load_index)
+ */
+#define SR_INDEX_SUFFIX		".gref"
+
 /**
  * @struct sr_gref_s
  * @brief gref and iter container
@@ -64,6 +79,8 @@ struct sr_gref_s {
 	gref_iter_t *iter;
 	void *reserved1[2];
 	uint32_t reserved2[2];
+	uint32_t part_idx;			/* index of the piece (graph query is split into part_cnt pieces) */
+	uint32_t part_cnt;
 };
 
 /**
@@ -79,12 +96,28 @@ sr_t *sr_init(
 void sr_clean(
 	sr_t *sr);
 
+/**
+ * @fn sr_is_index_path
+ * @brief returns nonzero if path ends with SR_INDEX_SUFFIX
+ */
+int sr_is_index_path(
+	char const *path);
+
 /**
  * @fn sr_get_index
  */
 struct sr_gref_s *sr_get_index(
 	sr_t *sr);
 
+/**
+ * @fn sr_dump_index
+ * @brief build index and dump it to path, out of core if it does not fit in mem_size
+ */
+int sr_dump_index(
+	sr_t *sr,
+	char const *path,
+	uint64_t mem_size);
+
 /**
  * @fn sr_get_iter
  */
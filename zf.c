@@ -16,7 +16,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "kopen.h"
+#include "ptask.h"
 #include "sassert.h"
 #include "zf.h"
 
@@ -28,10 +33,25 @@
 #include "bzlib.h"
 #endif
 
+#ifdef HAVE_ZSTD
+#include "zstd.h"
+#endif
+
+#ifdef HAVE_LZMA
+#include "lzma.h"
+#endif
+
 
 /* constants */
 #define ZF_BUF_SIZE					( 512 * 1024 )		/* 512KB */
 #define ZF_UNGETC_MARGIN_SIZE		( 32 )
+#define ZF_MT_MAX_THREADS			( 4 )				/* (de)compression threads */
+#define ZF_MAP_READAHEAD_SIZE		( 64 * 1024 * 1024 )
+#define ZF_MAP_RELEASE_SIZE			( 64 * 1024 * 1024 )
+
+/* max and min */
+#define MAX2(x,y) 					( (x) > (y) ? (x) : (y) )
+#define MIN2(x,y) 					( (x) < (y) ? (x) : (y) )
 
 /* function pointer type aliases */
 typedef void *(*zf_dopen_t)(
@@ -98,11 +118,792 @@ size_t fwrite_wrap(
 int zf_init_gzip(
 	void *fp)
 {
-	#if ZLIB_VERNUM >= 0x1240
-		return(gzbuffer((gzFile)fp, ZF_BUF_SIZE));
-	#else
-		return(0);
-	#endif
+	#if ZLIB_VERNUM >= 0x1240
+		return(gzbuffer((gzFile)fp, ZF_BUF_SIZE));
+	#else
+		return(0);
+	#endif
+}
+
+#endif
+
+/**
+ * @fn zf_mode_level
+ * @brief compression level given as a digit in mode (e.g. "w1.zst"), or level if none
+ */
+static
+int zf_mode_level(
+	char const *mode,
+	int level)
+{
+	for(; *mode != '\0' && *mode != '.'; mode++) {
+		if(*mode >= '0' && *mode <= '9') { level = *mode - '0'; }
+	}
+	return(level);
+}
+
+/* zstd-dependent functions */
+#ifdef HAVE_ZSTD
+/**
+ * @struct zf_zstd_s
+ * @brief context of the zstd writer (reader is zf_mt_*)
+ */
+struct zf_zstd_s {
+	FILE *fp;
+	ZSTD_CCtx *c;
+	uint8_t buf[ZF_BUF_SIZE];
+};
+
+/**
+ * @fn zf_zstd_open
+ * @brief open zstd writer, compressed on the threads of libzstd if available
+ */
+void *zf_zstd_open(
+	char const *path,
+	char const *mode)
+{
+	struct zf_zstd_s *z = (struct zf_zstd_s *)malloc(sizeof(struct zf_zstd_s));
+	if(z == NULL) {
+		return(NULL);
+	}
+	z->fp = fopen(path, "wb");
+	z->c = ZSTD_createCCtx();
+	if(z->fp == NULL || z->c == NULL) {
+		if(z->fp != NULL) { fclose(z->fp); }
+		ZSTD_freeCCtx(z->c);
+		free(z);
+		return(NULL);
+	}
+	ZSTD_CCtx_setParameter(z->c, ZSTD_c_compressionLevel, zf_mode_level(mode, ZSTD_CLEVEL_DEFAULT));
+
+	/* fails without ZSTD_MULTITHREAD, compressed on the caller in that case */
+	int64_t cores = ptask_get_num_cores();
+	if(cores > 1) {
+		ZSTD_CCtx_setParameter(z->c, ZSTD_c_nbWorkers, MIN2(cores, ZF_MT_MAX_THREADS));
+	}
+	return((void *)z);
+}
+
+/**
+ * @fn zf_zstd_write
+ */
+size_t zf_zstd_write(
+	void *fp,
+	void *ptr,
+	size_t len)
+{
+	struct zf_zstd_s *z = (struct zf_zstd_s *)fp;
+	ZSTD_inBuffer in = { .src = ptr, .size = len, .pos = 0 };
+	while(in.pos < in.size) {
+		ZSTD_outBuffer out = { .dst = z->buf, .size = ZF_BUF_SIZE, .pos = 0 };
+		if(ZSTD_isError(ZSTD_compressStream2(z->c, &out, &in, ZSTD_e_continue))) {
+			return(0);
+		}
+		fwrite(z->buf, 1, out.pos, z->fp);
+	}
+	return(len);
+}
+
+/**
+ * @fn zf_zstd_close
+ */
+void *zf_zstd_close(
+	void *fp)
+{
+	struct zf_zstd_s *z = (struct zf_zstd_s *)fp;
+	ZSTD_inBuffer in = { .src = NULL, .size = 0, .pos = 0 };
+	size_t rem = 1;
+	while(rem != 0) {
+		ZSTD_outBuffer out = { .dst = z->buf, .size = ZF_BUF_SIZE, .pos = 0 };
+		rem = ZSTD_compressStream2(z->c, &out, &in, ZSTD_e_end);
+		if(ZSTD_isError(rem)) { break; }
+		fwrite(z->buf, 1, out.pos, z->fp);
+	}
+	ZSTD_freeCCtx(z->c);
+	fclose(z->fp);
+	free(z);
+	return(NULL);
+}
+#endif
+
+/* xz-dependent functions */
+#ifdef HAVE_LZMA
+/**
+ * @struct zf_xz_s
+ */
+struct zf_xz_s {
+	FILE *fp;
+	int write;
+	int eof;
+	lzma_stream s;
+	uint8_t buf[ZF_BUF_SIZE];
+};
+
+/**
+ * @fn zf_xz_init
+ */
+static
+struct zf_xz_s *zf_xz_init(
+	FILE *fp,
+	char const *mode)
+{
+	if(fp == NULL) {
+		return(NULL);
+	}
+	struct zf_xz_s *x = (struct zf_xz_s *)malloc(sizeof(struct zf_xz_s));
+	if(x == NULL) {
+		fclose(fp);
+		return(NULL);
+	}
+	*x = (struct zf_xz_s){
+		.fp = fp,
+		.write = (mode[0] != 'r'),
+		.eof = 0,
+		.s = LZMA_STREAM_INIT
+	};
+
+	lzma_ret ret = (x->write != 0)
+		? lzma_easy_encoder(&x->s, zf_mode_level(mode, LZMA_PRESET_DEFAULT), LZMA_CHECK_CRC64)
+		: lzma_stream_decoder(&x->s, UINT64_MAX, LZMA_CONCATENATED);
+	if(ret != LZMA_OK) {
+		fclose(fp);
+		free(x);
+		return(NULL);
+	}
+	return(x);
+}
+
+/**
+ * @fn zf_xz_dopen
+ */
+void *zf_xz_dopen(
+	int fd,
+	char const *mode)
+{
+	return((void *)zf_xz_init(fdopen(fd, "rb"), mode));
+}
+
+/**
+ * @fn zf_xz_open
+ */
+void *zf_xz_open(
+	char const *path,
+	char const *mode)
+{
+	return((void *)zf_xz_init(fopen(path, (mode[0] == 'r') ? "rb" : "wb"), mode));
+}
+
+/**
+ * @fn zf_xz_read
+ */
+size_t zf_xz_read(
+	void *fp,
+	void *ptr,
+	size_t len)
+{
+	struct zf_xz_s *x = (struct zf_xz_s *)fp;
+	x->s.next_out = (uint8_t *)ptr;
+	x->s.avail_out = len;
+	while(x->s.avail_out > 0) {
+		if(x->s.avail_in == 0 && x->eof == 0) {
+			x->s.next_in = x->buf;
+			x->s.avail_in = fread(x->buf, 1, ZF_BUF_SIZE, x->fp);
+			x->eof = (x->s.avail_in < ZF_BUF_SIZE);
+		}
+		if(lzma_code(&x->s, (x->eof != 0) ? LZMA_FINISH : LZMA_RUN) != LZMA_OK) {
+			break;		/* LZMA_STREAM_END or error */
+		}
+	}
+	return(len - x->s.avail_out);
+}
+
+/**
+ * @fn zf_xz_write
+ */
+size_t zf_xz_write(
+	void *fp,
+	void *ptr,
+	size_t len)
+{
+	struct zf_xz_s *x = (struct zf_xz_s *)fp;
+	x->s.next_in = (uint8_t const *)ptr;
+	x->s.avail_in = len;
+	while(x->s.avail_in > 0) {
+		x->s.next_out = x->buf;
+		x->s.avail_out = ZF_BUF_SIZE;
+		if(lzma_code(&x->s, LZMA_RUN) != LZMA_OK) {
+			return(0);
+		}
+		fwrite(x->buf, 1, ZF_BUF_SIZE - x->s.avail_out, x->fp);
+	}
+	return(len);
+}
+
+/**
+ * @fn zf_xz_close
+ */
+void *zf_xz_close(
+	void *fp)
+{
+	struct zf_xz_s *x = (struct zf_xz_s *)fp;
+	lzma_ret ret = LZMA_OK;
+	while(x->write != 0 && ret == LZMA_OK) {
+		x->s.next_out = x->buf;
+		x->s.avail_out = ZF_BUF_SIZE;
+		ret = lzma_code(&x->s, LZMA_FINISH);
+		fwrite(x->buf, 1, ZF_BUF_SIZE - x->s.avail_out, x->fp);
+	}
+	lzma_end(&x->s);
+	fclose(x->fp);
+	free(x);
+	return(NULL);
+}
+#endif
+
+#if defined(HAVE_Z) || defined(HAVE_ZSTD)
+/**
+ * threaded reader for gzip and zstd. BGZF blocks and zstd frames of known size are cut
+ * out by a reader thread and decompressed on worker threads; other streams (including
+ * concatenated gzip members) are decompressed on the reader thread. both run ahead of
+ * the caller into a ring of ZF_MT_SLOT_CNT buffers.
+ */
+#define ZF_MT_SLOT_CNT				( 32 )
+#define ZF_MT_SLOT_SIZE				( 64 * 1024 )		/* max BGZF block size */
+#define ZF_MT_MAX_FRAME_SIZE		( 16 * 1024 * 1024 )	/* zstd frames larger than this are streamed on the reader */
+#define ZF_BGZF_HEADER_SIZE			( 18 )
+
+/**
+ * @enum zf_mt_state
+ */
+enum zf_mt_state {
+	ZF_MT_EMPTY = 0,
+	ZF_MT_PENDING,			/* compressed block is set, waiting for a worker */
+	ZF_MT_DONE				/* decompressed */
+};
+
+/**
+ * @enum zf_mt_format
+ */
+enum zf_mt_format {
+	ZF_MT_RAW = 0,
+	ZF_MT_GZIP,
+	ZF_MT_BGZF,
+	ZF_MT_ZSTD
+};
+
+/**
+ * @struct zf_mt_slot_s
+ */
+struct zf_mt_slot_s {
+	int state;
+	uint64_t seq;
+	uint8_t *in, *out;
+	uint64_t in_size, out_size;		/* capacities */
+	uint64_t in_len;
+	uint64_t out_len, out_pos;
+};
+
+/**
+ * @struct zf_mt_s
+ * @brief context of the threaded reader (fp of the stream)
+ */
+struct zf_mt_s {
+	int fd;
+	int format;
+	int fin;				/* reader issued the last slot */
+	int exit;				/* set on close */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t reader;
+	uint64_t th_cnt;
+	pthread_t th[ZF_MT_MAX_THREADS];
+
+	/* issued by the reader, taken by the workers, and consumed by the caller */
+	uint64_t head, next, tail;
+
+	/* compressed input */
+	uint8_t *ibuf;
+	uint64_t ipos, ilen, isize;
+	struct zf_mt_slot_s slot[ZF_MT_SLOT_CNT];
+};
+
+/**
+ * @fn zf_mt_reserve
+ * @brief expand buffer to hold at least size bytes, returns nonzero if failed
+ */
+static
+int zf_mt_reserve(
+	uint8_t **buf,
+	uint64_t *cap,
+	uint64_t size)
+{
+	if(size <= *cap) {
+		return(0);
+	}
+	uint8_t *b = (uint8_t *)realloc(*buf, MAX2(size, 2 * *cap));
+	if(b == NULL) {
+		return(-1);
+	}
+	*buf = b;
+	*cap = MAX2(size, 2 * *cap);
+	return(0);
+}
+
+/**
+ * @fn zf_mt_fill
+ * @brief move the rest of the input to the head and fill the buffer (expanded to hold at
+ * least size bytes), returns the number of bytes available
+ */
+static
+uint64_t zf_mt_fill(
+	struct zf_mt_s *mt,
+	uint64_t size)
+{
+	memmove(mt->ibuf, &mt->ibuf[mt->ipos], mt->ilen - mt->ipos);
+	mt->ilen -= mt->ipos;
+	mt->ipos = 0;
+	zf_mt_reserve(&mt->ibuf, &mt->isize, size);
+
+	while(mt->ilen < mt->isize) {
+		ssize_t r = read(mt->fd, &mt->ibuf[mt->ilen], mt->isize - mt->ilen);
+		if(r <= 0) { break; }
+		mt->ilen += r;
+	}
+	return(mt->ilen);
+}
+
+/**
+ * @fn zf_mt_bgzf_block_size
+ * @brief returns the size of the BGZF block at p (from BSIZE in the extra field), 0 if p is not a BGZF header
+ */
+static
+uint64_t zf_mt_bgzf_block_size(
+	uint8_t const *p,
+	uint64_t len)
+{
+	if(len < ZF_BGZF_HEADER_SIZE || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || (p[3] & 0x04) == 0) {
+		return(0);
+	}
+	uint64_t xlen = p[10] | (p[11]<<8);
+	for(uint64_t i = 12; i + 4 <= MIN2(12 + xlen, len); i += 4 + (p[i + 2] | (p[i + 3]<<8))) {
+		if(p[i] == 'B' && p[i + 1] == 'C' && (p[i + 2] | (p[i + 3]<<8)) == 2 && i + 6 <= len) {
+			return((p[i + 4] | (p[i + 5]<<8)) + 1);
+		}
+	}
+	return(0);
+}
+
+/**
+ * @fn zf_mt_detect_format
+ */
+static
+int zf_mt_detect_format(
+	uint8_t const *p,
+	uint64_t len)
+{
+	#ifdef HAVE_Z
+		if(zf_mt_bgzf_block_size(p, len) != 0) { return(ZF_MT_BGZF); }
+		if(len >= 2 && p[0] == 0x1f && p[1] == 0x8b) { return(ZF_MT_GZIP); }
+	#endif
+	#ifdef HAVE_ZSTD
+		uint32_t magic = (len >= 4) ? (p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24)) : 0;
+		if(magic == ZSTD_MAGICNUMBER || (magic & ZSTD_MAGIC_SKIPPABLE_MASK) == ZSTD_MAGIC_SKIPPABLE_START) {
+			return(ZF_MT_ZSTD);
+		}
+	#endif
+	return(ZF_MT_RAW);
+}
+
+/**
+ * @fn zf_mt_block_size
+ * @brief size of the block at the head of the input and (the upper bound of) its decompressed
+ * size. returns 0 if the block cannot be decompressed on its own.
+ */
+static
+uint64_t zf_mt_block_size(
+	struct zf_mt_s *mt,
+	uint64_t *out_size)
+{
+	if(mt->format == ZF_MT_BGZF) {
+		*out_size = ZF_MT_SLOT_SIZE;
+		return(zf_mt_bgzf_block_size(&mt->ibuf[mt->ipos], mt->ilen - mt->ipos));
+	}
+
+	#ifdef HAVE_ZSTD
+		unsigned long long size = ZSTD_getFrameContentSize(&mt->ibuf[mt->ipos], mt->ilen - mt->ipos);
+		if(size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR || size > ZF_MT_MAX_FRAME_SIZE) {
+			return(0);
+		}
+
+		/* the whole frame must be in the buffer */
+		size_t frame_size;
+		while(ZSTD_isError(frame_size = ZSTD_findFrameCompressedSize(&mt->ibuf[mt->ipos], mt->ilen - mt->ipos))) {
+			uint64_t len = mt->ilen - mt->ipos;
+			if(len >= ZF_MT_MAX_FRAME_SIZE || zf_mt_fill(mt, 2 * len) == len) {
+				return(0);
+			}
+		}
+		*out_size = size;
+		return(frame_size);
+	#else
+		return(0);
+	#endif
+}
+
+/**
+ * @fn zf_mt_wait_slot
+ * @brief wait for the slot at head to be consumed, returns NULL on close (called with lock held)
+ */
+static
+struct zf_mt_slot_s *zf_mt_wait_slot(
+	struct zf_mt_s *mt)
+{
+	struct zf_mt_slot_s *s = &mt->slot[mt->head % ZF_MT_SLOT_CNT];
+	while(mt->exit == 0 && s->state != ZF_MT_EMPTY) {
+		pthread_cond_wait(&mt->cond, &mt->lock);
+	}
+	return((mt->exit == 0) ? s : NULL);
+}
+
+/**
+ * @fn zf_mt_issue
+ * @brief pass the slot at head to the workers (ZF_MT_PENDING) or to the caller (ZF_MT_DONE)
+ */
+static
+void zf_mt_issue(
+	struct zf_mt_s *mt,
+	struct zf_mt_slot_s *s,
+	int state)
+{
+	pthread_mutex_lock(&mt->lock);
+	s->state = state;
+	s->seq = mt->head++;
+	pthread_cond_broadcast(&mt->cond);
+	pthread_mutex_unlock(&mt->lock);
+	return;
+}
+
+/**
+ * @fn zf_mt_worker
+ * @brief decompress BGZF blocks or zstd frames
+ */
+static
+void *zf_mt_worker(
+	void *arg)
+{
+	struct zf_mt_s *mt = (struct zf_mt_s *)arg;
+	#ifdef HAVE_Z
+		z_stream z = { 0 };
+		if(inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) {
+			return(NULL);
+		}
+	#endif
+	#ifdef HAVE_ZSTD
+		ZSTD_DCtx *d = ZSTD_createDCtx();
+	#endif
+
+	pthread_mutex_lock(&mt->lock);
+	while(1) {
+		/* skip slots done by the reader (they may already be reused for later ones) */
+		struct zf_mt_slot_s *s = &mt->slot[mt->next % ZF_MT_SLOT_CNT];
+		while(mt->next < mt->head && !(s->seq == mt->next && s->state == ZF_MT_PENDING)) {
+			s = &mt->slot[++mt->next % ZF_MT_SLOT_CNT];
+		}
+		if(mt->exit != 0 || (mt->next == mt->head && mt->fin != 0)) { break; }
+		if(mt->next == mt->head) {
+			pthread_cond_wait(&mt->cond, &mt->lock);
+			continue;
+		}
+		mt->next++;
+		pthread_mutex_unlock(&mt->lock);
+
+		/* a broken block is passed as is (truncated), as gzread does */
+		s->out_len = s->out_pos = 0;
+		#ifdef HAVE_Z
+			if(mt->format == ZF_MT_BGZF) {
+				inflateReset(&z);
+				z.next_in = s->in; z.avail_in = s->in_len;
+				z.next_out = s->out; z.avail_out = s->out_size;
+				inflate(&z, Z_FINISH);
+				s->out_len = s->out_size - z.avail_out;
+			}
+		#endif
+		#ifdef HAVE_ZSTD
+			if(mt->format == ZF_MT_ZSTD) {
+				size_t r = ZSTD_decompressDCtx(d, s->out, s->out_size, s->in, s->in_len);
+				s->out_len = ZSTD_isError(r) ? 0 : r;
+			}
+		#endif
+
+		pthread_mutex_lock(&mt->lock);
+		s->state = ZF_MT_DONE;
+		pthread_cond_broadcast(&mt->cond);
+	}
+	pthread_mutex_unlock(&mt->lock);
+
+	#ifdef HAVE_Z
+		inflateEnd(&z);
+	#endif
+	#ifdef HAVE_ZSTD
+		ZSTD_freeDCtx(d);
+	#endif
+	return(NULL);
+}
+
+/**
+ * @fn zf_mt_read_blocks
+ * @brief (reader) cut BGZF blocks or zstd frames out of the input and pass them to the workers.
+ * zstd frames of unknown or large size are decompressed on the reader, slot by slot.
+ */
+static
+void zf_mt_read_blocks(
+	struct zf_mt_s *mt)
+{
+	/* start workers */
+	int64_t th_cnt = MIN2(ZF_MT_MAX_THREADS, ptask_get_num_cores());
+	for(int64_t i = 0; i < th_cnt; i++) {
+		if(pthread_create(&mt->th[mt->th_cnt], NULL, zf_mt_worker, (void *)mt) == 0) {
+			mt->th_cnt++;
+		}
+	}
+	#ifdef HAVE_ZSTD
+		ZSTD_DCtx *d = ZSTD_createDCtx();
+	#endif
+
+	while(mt->th_cnt > 0) {
+		if(mt->ilen - mt->ipos < ZF_BGZF_HEADER_SIZE) { zf_mt_fill(mt, 0); }
+		if(mt->ilen == mt->ipos) { break; }
+
+		pthread_mutex_lock(&mt->lock);
+		struct zf_mt_slot_s *s = zf_mt_wait_slot(mt);
+		pthread_mutex_unlock(&mt->lock);
+		if(s == NULL) { break; }
+
+		uint64_t out_size = 0;
+		uint64_t size = zf_mt_block_size(mt, &out_size);
+		if(size != 0) {
+			/* the whole block is in the buffer */
+			if(mt->ilen - mt->ipos < size && zf_mt_fill(mt, size) < size) { break; }
+			if(zf_mt_reserve(&s->in, &s->in_size, size) != 0 || zf_mt_reserve(&s->out, &s->out_size, out_size) != 0) { break; }
+
+			memcpy(s->in, &mt->ibuf[mt->ipos], size);
+			s->in_len = size;
+			mt->ipos += size;
+			zf_mt_issue(mt, s, ZF_MT_PENDING);
+			continue;
+		}
+
+		/* stop at broken BGZF block */
+		if(mt->format != ZF_MT_ZSTD) { break; }
+
+		#ifdef HAVE_ZSTD
+			/* decompress a frame of unknown or large size here, a slot is issued each time it is full */
+			size_t rem = 1;
+			while(s != NULL && zf_mt_reserve(&s->out, &s->out_size, ZF_MT_SLOT_SIZE) == 0) {
+				s->out_len = s->out_pos = 0;
+				while(rem != 0 && s->out_len < s->out_size) {
+					if(mt->ipos == mt->ilen && zf_mt_fill(mt, 0) == 0) { break; }
+
+					ZSTD_inBuffer in = { .src = mt->ibuf, .size = mt->ilen, .pos = mt->ipos };
+					ZSTD_outBuffer out = { .dst = s->out, .size = s->out_size, .pos = s->out_len };
+					rem = ZSTD_decompressStream(d, &out, &in);
+					mt->ipos = in.pos;
+					s->out_len = out.pos;
+					if(ZSTD_isError(rem)) { break; }
+				}
+				zf_mt_issue(mt, s, ZF_MT_DONE);
+				if(rem == 0 || ZSTD_isError(rem) || s->out_len < s->out_size) { break; }
+
+				/* continue into the next slot */
+				pthread_mutex_lock(&mt->lock);
+				s = zf_mt_wait_slot(mt);
+				pthread_mutex_unlock(&mt->lock);
+			}
+			if(rem != 0) { break; }		/* broken, truncated, or closed */
+		#endif
+	}
+
+	#ifdef HAVE_ZSTD
+		ZSTD_freeDCtx(d);
+	#endif
+	return;
+}
+
+/**
+ * @fn zf_mt_read_stream
+ * @brief (reader) inflate gzip members (or copy uncompressed input) into the slots in order
+ */
+static
+void zf_mt_read_stream(
+	struct zf_mt_s *mt)
+{
+	#ifdef HAVE_Z
+		z_stream z = { 0 };
+		if(mt->format == ZF_MT_GZIP && inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) {
+			return;
+		}
+	#endif
+
+	int end = 0;
+	while(end == 0) {
+		pthread_mutex_lock(&mt->lock);
+		struct zf_mt_slot_s *s = zf_mt_wait_slot(mt);
+		pthread_mutex_unlock(&mt->lock);
+		if(s == NULL || zf_mt_reserve(&s->out, &s->out_size, ZF_MT_SLOT_SIZE) != 0) { break; }
+
+		s->out_len = s->out_pos = 0;
+		while(end == 0 && s->out_len < s->out_size) {
+			if(mt->ipos == mt->ilen && zf_mt_fill(mt, 0) == 0) { end = 1; break; }
+			if(mt->format == ZF_MT_RAW) {
+				uint64_t size = MIN2(mt->ilen - mt->ipos, s->out_size - s->out_len);
+				memcpy(&s->out[s->out_len], &mt->ibuf[mt->ipos], size);
+				mt->ipos += size; s->out_len += size;
+				continue;
+			}
+
+			#ifdef HAVE_Z
+				z.next_in = &mt->ibuf[mt->ipos]; z.avail_in = mt->ilen - mt->ipos;
+				z.next_out = &s->out[s->out_len]; z.avail_out = s->out_size - s->out_len;
+				int ret = inflate(&z, Z_NO_FLUSH);
+				mt->ipos = mt->ilen - z.avail_in;
+				s->out_len = s->out_size - z.avail_out;
+
+				if(ret == Z_STREAM_END) {
+					/* the next member follows if any */
+					inflateReset(&z);
+				} else if(ret != Z_OK && ret != Z_BUF_ERROR) {
+					end = 1;		/* broken stream or trailing garbage */
+				}
+			#endif
+		}
+		zf_mt_issue(mt, s, ZF_MT_DONE);
+	}
+
+	#ifdef HAVE_Z
+		if(mt->format == ZF_MT_GZIP) { inflateEnd(&z); }
+	#endif
+	return;
+}
+
+/**
+ * @fn zf_mt_reader
+ */
+static
+void *zf_mt_reader(
+	void *arg)
+{
+	struct zf_mt_s *mt = (struct zf_mt_s *)arg;
+	zf_mt_fill(mt, ZF_BUF_SIZE);
+	mt->format = zf_mt_detect_format(mt->ibuf, mt->ilen);
+	if(mt->format == ZF_MT_BGZF || mt->format == ZF_MT_ZSTD) {
+		zf_mt_read_blocks(mt);
+	} else {
+		zf_mt_read_stream(mt);
+	}
+
+	pthread_mutex_lock(&mt->lock);
+	mt->fin = 1;
+	pthread_cond_broadcast(&mt->cond);
+	pthread_mutex_unlock(&mt->lock);
+	return(NULL);
+}
+
+/**
+ * @fn zf_mt_close
+ */
+static
+void *zf_mt_close(
+	void *fp)
+{
+	struct zf_mt_s *mt = (struct zf_mt_s *)fp;
+	if(mt == NULL) { return(NULL); }
+
+	pthread_mutex_lock(&mt->lock);
+	mt->exit = 1;
+	pthread_cond_broadcast(&mt->cond);
+	pthread_mutex_unlock(&mt->lock);
+
+	/* workers are started by the reader */
+	pthread_join(mt->reader, NULL);
+	for(uint64_t i = 0; i < mt->th_cnt; i++) {
+		pthread_join(mt->th[i], NULL);
+	}
+	pthread_cond_destroy(&mt->cond);
+	pthread_mutex_destroy(&mt->lock);
+	for(uint64_t i = 0; i < ZF_MT_SLOT_CNT; i++) {
+		free(mt->slot[i].in);
+		free(mt->slot[i].out);
+	}
+	free(mt->ibuf);
+	close(mt->fd);
+	free(mt);
+	return(NULL);
+}
+
+/**
+ * @fn zf_mt_dopen
+ * @brief start the reader thread on fd
+ */
+static
+void *zf_mt_dopen(
+	int fd,
+	char const *mode)
+{
+	struct zf_mt_s *mt = (struct zf_mt_s *)malloc(sizeof(struct zf_mt_s));
+	if(mt == NULL) {
+		return(NULL);
+	}
+	memset(mt, 0, sizeof(struct zf_mt_s));
+	mt->fd = fd;
+	pthread_mutex_init(&mt->lock, NULL);
+	pthread_cond_init(&mt->cond, NULL);
+	if(pthread_create(&mt->reader, NULL, zf_mt_reader, (void *)mt) != 0) {
+		pthread_cond_destroy(&mt->cond);
+		pthread_mutex_destroy(&mt->lock);
+		free(mt);
+		return(NULL);
+	}
+	return((void *)mt);
+}
+
+/**
+ * @fn zf_mt_read
+ * @brief copy decompressed data in order, blocks until len bytes are available or the end of the stream
+ */
+static
+size_t zf_mt_read(
+	void *fp,
+	void *_ptr,
+	size_t len)
+{
+	struct zf_mt_s *mt = (struct zf_mt_s *)fp;
+	uint8_t *ptr = (uint8_t *)_ptr;
+	size_t copied_size = 0;
+
+	pthread_mutex_lock(&mt->lock);
+	while(copied_size < len) {
+		struct zf_mt_slot_s *s = &mt->slot[mt->tail % ZF_MT_SLOT_CNT];
+		while(!(mt->tail < mt->head && s->state == ZF_MT_DONE) && !(mt->tail == mt->head && mt->fin != 0)) {
+			pthread_cond_wait(&mt->cond, &mt->lock);
+		}
+		if(mt->tail == mt->head) { break; }
+		pthread_mutex_unlock(&mt->lock);
+
+		/* the slot is owned by the caller until it is released */
+		uint64_t size = MIN2(len - copied_size, s->out_len - s->out_pos);
+		memcpy(ptr, &s->out[s->out_pos], size);
+		ptr += size; copied_size += size;
+		s->out_pos += size;
+
+		pthread_mutex_lock(&mt->lock);
+		if(s->out_pos == s->out_len) {
+			s->state = ZF_MT_EMPTY;
+			mt->tail++;
+			pthread_cond_broadcast(&mt->cond);
+		}
+	}
+	pthread_mutex_unlock(&mt->lock);
+	return(copied_size);
 }
 #endif
 
@@ -117,7 +918,8 @@ struct zf_functions_s {
 	zf_init_t init;
 	zf_close_t close;
 	zf_read_t read;
-	zf_write_t write;	
+	zf_write_t write;
+	int mt;				/* read with the threaded reader (zf_mt_*) */
 };
 
 /**
@@ -166,7 +968,8 @@ struct zf_functions_s const fn_table[] = {
 		.init = (zf_init_t)zf_init_gzip,
 		.close = (zf_close_t)gzclose,
 		.read = (zf_read_t)gzread,
-		.write = (zf_write_t)gzwrite
+		.write = (zf_write_t)gzwrite,
+		.mt = 1
 		#endif
 	},
 	/* bzip2 */
@@ -181,13 +984,150 @@ struct zf_functions_s const fn_table[] = {
 		.write = (zf_write_t)BZ2_bzwrite
 		#endif
 	},
+	/* zstd */
+	{
+		.ext = ".zst",
+		#ifdef HAVE_ZSTD
+		.open = (zf_open_t)zf_zstd_open,
+		.close = (zf_close_t)zf_zstd_close,
+		.write = (zf_write_t)zf_zstd_write,
+		.mt = 1
+		#endif
+	},
+	/* xz */
+	{
+		.ext = ".xz",
+		#ifdef HAVE_LZMA
+		.dopen = (zf_dopen_t)zf_xz_dopen,
+		.open = (zf_open_t)zf_xz_open,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_xz_close,
+		.read = (zf_read_t)zf_xz_read,
+		.write = (zf_write_t)zf_xz_write
+		#endif
+	},
 	/* other unsupported formats */
 	{ .ext = ".lz" },
 	{ .ext = ".lzma" },
-	{ .ext = ".xz" },
 	{ .ext = ".z" }
 };
 
+/**
+ * @fn zf_read_none
+ * @brief read function of the memory-backed stream, the whole content is already in the buffer
+ */
+static
+size_t zf_read_none(
+	void *fp,
+	void *ptr,
+	size_t len)
+{
+	return(0);
+}
+
+/**
+ * @struct zf_map_s
+ * @brief mapped file (fp of the stream), the mapping is used as the buffer
+ */
+struct zf_map_s {
+	uint8_t *base;			/* the head of the margin for zfungetc */
+	uint8_t *ptr;
+	uint64_t margin;
+	uint64_t size;
+	uint64_t released;		/* pages before this offset are dropped */
+};
+
+/**
+ * @fn zf_map_close
+ */
+static
+void *zf_map_close(
+	void *fp)
+{
+	struct zf_map_s *m = (struct zf_map_s *)fp;
+	munmap((void *)m->base, m->margin + m->size);
+	free(m);
+	return(NULL);
+}
+
+/**
+ * @fn zf_map_open
+ * @brief map uncompressed regular file, returns nonzero if the file cannot be mapped
+ * (falls back to the stdio functions)
+ */
+static
+int zf_map_open(
+	struct zf_intl_s *fio,
+	char const *path)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		return(-1);
+	}
+	if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		close(fd);
+		return(-1);
+	}
+	/**
+	 * private writable mapping preceded by an anonymous page, so that zfungetc can write
+	 * to the buffer (and before its head) as on the stdio stream. the file is not modified.
+	 */
+	uint64_t margin = sysconf(_SC_PAGESIZE);
+	uint8_t *base = (uint8_t *)mmap(NULL, margin + st.st_size,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(base == MAP_FAILED) {
+		close(fd);
+		return(-1);
+	}
+	void *ptr = mmap(&base[margin], st.st_size,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+	close(fd);		/* the mapping is kept */
+	struct zf_map_s *m = (ptr == MAP_FAILED) ? NULL : (struct zf_map_s *)malloc(sizeof(struct zf_map_s));
+	if(m == NULL) {
+		munmap(base, margin + st.st_size);
+		return(-1);
+	}
+	*m = (struct zf_map_s){
+		.base = base,
+		.ptr = (uint8_t *)ptr,
+		.margin = margin,
+		.size = st.st_size,
+		.released = 0
+	};
+
+	/* the file is read once from the head */
+	madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+	madvise(ptr, MIN2(st.st_size, ZF_MAP_READAHEAD_SIZE), MADV_WILLNEED);
+
+	fio->fp = (void *)m;
+	fio->fd = -1;
+	fio->fn = (struct zf_functions_s){ .ext = "", .read = zf_read_none, .close = zf_map_close };
+	fio->buf = m->ptr;
+	fio->size = m->size;
+	fio->eof = 1;			/* the whole content is in the buffer */
+	return(0);
+}
+
+/**
+ * @fn zf_map_release
+ * @brief drop pages of the mapping consumed (before pos) to keep the resident size small
+ */
+static inline
+void zf_map_release(
+	struct zf_map_s *m,
+	uint64_t pos)
+{
+	if(pos < m->released + ZF_MAP_RELEASE_SIZE) {
+		return;
+	}
+	uint64_t lim = pos & ~((uint64_t)sysconf(_SC_PAGESIZE) - 1);
+	madvise((void *)&m->ptr[m->released], lim - m->released, MADV_DONTNEED);
+	m->released = lim;
+	madvise((void *)&m->ptr[lim], MIN2(m->size - lim, ZF_MAP_READAHEAD_SIZE), MADV_WILLNEED);
+	return;
+}
+
 /**
  * @fn zfopen
  * @brief open file, similar to fopen / gzopen,
@@ -266,11 +1206,24 @@ zf_t *zfopen(
 
 	/* open file */
 	if(mode[0] == 'r') {
+		/* uncompressed regular file is mapped */
+		if(fn == &fn_table[0] && strcmp(path, "-") != 0 && zf_map_open(fio, path) == 0) {
+			goto _zfopen_finish;
+		}
+
 		/* read mode, open file with kopen */
 		fio->ko = kopen(path, &fio->fd);
 		if(fio->ko == NULL) {
 			goto _zfopen_finish;
 		}
+		#if defined(HAVE_Z) || defined(HAVE_ZSTD)
+			if(fio->fn.mt != 0) {
+				fio->fn.dopen = (zf_dopen_t)zf_mt_dopen;
+				fio->fn.init = (zf_init_t)NULL;
+				fio->fn.close = (zf_close_t)zf_mt_close;
+				fio->fn.read = (zf_read_t)zf_mt_read;
+			}
+		#endif
 		fio->fp = fio->fn.dopen(fio->fd, mode);
 	} else {
 		/* write mode, check if stdout is specified */
@@ -302,7 +1255,8 @@ _zfopen_finish:;
 	/* everything is going right */
 	fio->path = (path_dup == path) ? strdup(path) : path_dup;
 	fio->mode = (mode_dup == mode) ? strdup(mode) : mode_dup;
-	fio->curr = fio->end = 0;
+	fio->curr = 0;
+	fio->end = (fio->eof != 0) ? fio->size : 0;		/* mapped file is already in the buffer */
 	if(fio->fn.init != NULL) {
 		if(fio->fn.init(fio->fp) != 0) {
 			zfclose((zf_t *)fio);
@@ -313,6 +1267,38 @@ _zfopen_finish:;
 	return((zf_t *)fio);
 }
 
+/**
+ * @fn zfopen_mem
+ * @brief open read-only stream over [ptr, ptr + len) without copying. the memory must be
+ * kept until zfclose and is not modified (zfungetc is not allowed on the stream).
+ */
+zf_t *zfopen_mem(
+	void const *ptr,
+	size_t len)
+{
+	if(ptr == NULL) {
+		return(NULL);
+	}
+
+	struct zf_intl_s *fio = (struct zf_intl_s *)malloc(sizeof(struct zf_intl_s));
+	if(fio == NULL) {
+		return(NULL);
+	}
+	memset(fio, 0, sizeof(struct zf_intl_s));
+	fio->path = strdup("-");
+	fio->mode = strdup("r");
+	fio->fd = -1;
+	fio->fn = (struct zf_functions_s){ .ext = "", .read = zf_read_none };
+
+	/* the whole content is in the buffer; eof == 1 (or 2 if empty) */
+	fio->buf = (uint8_t *)ptr;
+	fio->size = len;
+	fio->curr = 0;
+	fio->end = len;
+	fio->eof = (len == 0) ? 2 : 1;
+	return((zf_t *)fio);
+}
+
 /**
  * @fn zfclose
  * @brief close file, similar to fclose / gzclose
@@ -420,7 +1406,10 @@ size_t zfpeek(
 		copied_size += buf_copy_size;
 	}
 
-	if(len > 0) {
+	if(len > 0 && fio->eof != 0) {
+		/* fp already reached EOF (or the whole content is in the buffer, which must not be modified) */
+		fio->eof += (copied_size == 0);
+	} else if(len > 0) {
 		/* move existing elements to the head of the buffer */
 		if(fio->curr != 0 && fio->curr < fio->end) {
 			memmove((void *)fio->buf, (void *)&fio->buf[fio->curr], fio->end - fio->curr);
@@ -478,6 +1467,44 @@ int zfgetc(
 	return((int)fio->buf[fio->curr++]);
 }
 
+/**
+ * @fn zfbuf
+ */
+uint8_t const *zfbuf(
+	zf_t *fp,
+	size_t *len)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+
+	/* refill the buffer in the same way as zfgetc */
+	if(fio->curr >= fio->end) {
+		fio->curr = 0;
+		fio->end = (fio->eof == 0)
+			? fio->fn.read(fio->fp, fio->buf, fio->size)
+			: 0;
+		fio->eof = (fio->end < fio->size) + (fio->end == 0);
+	}
+	*len = (fio->eof == 2) ? 0 : fio->end - fio->curr;
+
+	/* pages of the mapping are not read again */
+	if(fio->fn.close == (zf_close_t)zf_map_close) {
+		zf_map_release((struct zf_map_s *)fio->fp, fio->curr);
+	}
+	return(&fio->buf[fio->curr]);
+}
+
+/**
+ * @fn zfadvance
+ */
+void zfadvance(
+	zf_t *fp,
+	size_t len)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	fio->curr += len;
+	return;
+}
+
 /**
  * @fn zfungetc
  */
@@ -722,6 +1749,69 @@ unittest(with(TEST_ARR_LEN))
 	remove("tmp.txt");
 }
 
+/* zero-copy read with zfbuf / zfadvance, mixed with zfgetc */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	zfwrite(wfp, arr, TEST_ARR_LEN);
+	zfclose(wfp);
+
+	zf_t *rfp = zfopen("tmp.txt", "r");
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	int64_t pos = 0;
+	while(1) {
+		size_t len;
+		uint8_t const *p = zfbuf(rfp, &len);
+		if(len == 0) { break; }
+
+		/* consume a part of the buffer, then a byte with zfgetc */
+		size_t adv = (len + 1) / 2;
+		memcpy(&rarr[pos], p, adv);
+		zfadvance(rfp, adv);
+		pos += adv;
+
+		int c = zfgetc(rfp);
+		if(c == EOF) { break; }
+		rarr[pos++] = c;
+	}
+	assert(pos == TEST_ARR_LEN, "%lld", pos);
+	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+	zfclose(rfp);
+
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
+	free(rarr);
+	remove("tmp.txt");
+}
+
+/* memory-backed stream */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	zf_t *rfp = zfopen_mem(arr, TEST_ARR_LEN);
+	assert(rfp != NULL, "%p", rfp);
+
+	char buf[16];
+	assert(zfpeek(rfp, buf, 16) == 16);
+	assert(memcmp(arr, buf, 16) == 0);
+
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 100; i++) {
+		rarr[i] = zfgetc(rfp);
+	}
+	size_t read = zfread(rfp, &rarr[100], TEST_ARR_LEN);
+	assert(read == TEST_ARR_LEN - 100, "%llu", read);
+	assert(zfgetc(rfp) == EOF);
+	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+	zfclose(rfp);
+
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+	free(rarr);
+}
+
 /* peek */
 unittest(with(100000))
 {
@@ -912,6 +2002,76 @@ unittest(with(TEST_ARR_LEN))
 	free(rarr);
 	remove("tmp.txt.gz");
 }
+
+/* BGZF and concatenated gzip members (threaded reader) */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* BGZF blocks of 16KB each, followed by the empty EOF block */
+	FILE *fp = fopen("tmp.bgzf.gz", "wb");
+	uint8_t *block = (uint8_t *)malloc(2 * ZF_MT_SLOT_SIZE);
+	for(int64_t i = 0, eof = 0; eof == 0; i += 16 * 1024) {
+		uint64_t len = (i < TEST_ARR_LEN) ? MIN2(16 * 1024, TEST_ARR_LEN - i) : 0;
+		eof = (len == 0);
+		z_stream z = { 0 };
+		deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+		z.next_in = (uint8_t *)&((char *)arr)[i]; z.avail_in = len;
+		z.next_out = &block[ZF_BGZF_HEADER_SIZE]; z.avail_out = ZF_MT_SLOT_SIZE;
+		deflate(&z, Z_FINISH);
+		uint64_t clen = ZF_MT_SLOT_SIZE - z.avail_out;
+		deflateEnd(&z);
+
+		uint64_t bsize = ZF_BGZF_HEADER_SIZE + clen + 8 - 1;
+		uint8_t const header[ZF_BGZF_HEADER_SIZE] = {
+			0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, bsize & 0xff, bsize>>8
+		};
+		uint32_t crc = crc32(0, (uint8_t *)&((char *)arr)[i], len);
+		memcpy(block, header, ZF_BGZF_HEADER_SIZE);
+		for(int64_t j = 0; j < 4; j++) {
+			block[ZF_BGZF_HEADER_SIZE + clen + j] = crc>>(8 * j);
+			block[ZF_BGZF_HEADER_SIZE + clen + 4 + j] = len>>(8 * j);
+		}
+		fwrite(block, 1, bsize + 1, fp);
+	}
+	free(block);
+	fclose(fp);
+
+	zf_t *rfp = zfopen("tmp.bgzf.gz", "r");
+	assert(rfp != NULL, "%p", rfp);
+
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+	assert(read == TEST_ARR_LEN, "%llu", read);
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+	zfclose(rfp);
+	remove("tmp.bgzf.gz");
+
+	/* two members */
+	gzFile gfp = gzopen("tmp.txt.gz", "w");
+	gzwrite(gfp, arr, TEST_ARR_LEN / 2);
+	gzclose(gfp);
+	gfp = gzopen("tmp.txt.gz", "a");
+	gzwrite(gfp, &((char *)arr)[TEST_ARR_LEN / 2], TEST_ARR_LEN - TEST_ARR_LEN / 2);
+	gzclose(gfp);
+
+	rfp = zfopen("tmp.txt.gz", "r");
+	memset(rarr, 0, TEST_ARR_LEN);
+	read = zfread(rfp, rarr, TEST_ARR_LEN);
+	assert(read == TEST_ARR_LEN, "%llu", read);
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+
+	/* close without reading to the end */
+	zfclose(rfp);
+	rfp = zfopen("tmp.txt.gz", "r");
+	assert(zfgetc(rfp) == ((char *)arr)[0], "%d", zfgetc(rfp));
+	zfclose(rfp);
+
+	free(rarr);
+	remove("tmp.txt.gz");
+}
 #endif /* HAVE_Z */
 
 /* bzip2-dependent tests */
@@ -1028,6 +2188,138 @@ unittest(with(TEST_ARR_LEN))
 }
 #endif /* HAVE_BZ2 */
 
+/* zstd-dependent tests */
+#ifdef HAVE_ZSTD
+/* streaming frame written by zf followed by frames of known size (decompressed on workers) */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* write the first half */
+	zf_t *wfp = zfopen("tmpfile", "w1.zst");
+	assert(wfp != NULL, "%p", wfp);
+	size_t written = zfwrite(wfp, arr, TEST_ARR_LEN / 2);
+	assert(written == TEST_ARR_LEN / 2, "%llu", written);
+	zfclose(wfp);
+
+	/* append the rest in frames of 100KB */
+	FILE *fp = fopen("tmpfile", "ab");
+	uint8_t *frame = (uint8_t *)malloc(ZSTD_compressBound(100 * 1024));
+	for(int64_t i = TEST_ARR_LEN / 2; i < TEST_ARR_LEN; i += 100 * 1024) {
+		uint64_t len = MIN2(100 * 1024, TEST_ARR_LEN - i);
+		size_t size = ZSTD_compress(frame, ZSTD_compressBound(len), &((char *)arr)[i], len, 1);
+		fwrite(frame, 1, size, fp);
+	}
+	free(frame);
+	fclose(fp);
+
+	/* read */
+	zf_t *rfp = zfopen("tmpfile", "r.zst");
+	assert(rfp != NULL, "%p", rfp);
+	assert(strcmp(rfp->mode, "r") == 0, "%s", rfp->mode);
+
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+	assert(read == TEST_ARR_LEN, "%llu", read);
+
+	/* EOF */
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+
+	zfclose(rfp);
+
+	/* compare */
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
+	/* cleanup */
+	free(rarr);
+	remove("tmpfile");
+}
+
+/* a frame of unknown size and a frame larger than ZF_MT_MAX_FRAME_SIZE are streamed slot by slot */
+unittest()
+{
+	uint64_t const ulen = 8 * ZF_MT_SLOT_SIZE + 1, llen = ZF_MT_MAX_FRAME_SIZE + 1;
+	char *arr = (char *)make_random_array((void *)(ulen + llen));
+
+	/* the writer does not record the content size */
+	zf_t *wfp = zfopen("tmpfile", "w1.zst");
+	assert(wfp != NULL, "%p", wfp);
+	size_t written = zfwrite(wfp, arr, ulen);
+	assert(written == ulen, "%llu", written);
+	zfclose(wfp);
+
+	FILE *fp = fopen("tmpfile", "ab");
+	uint8_t *frame = (uint8_t *)malloc(ZSTD_compressBound(llen));
+	size_t size = ZSTD_compress(frame, ZSTD_compressBound(llen), &arr[ulen], llen, 1);
+	assert(ZSTD_getFrameContentSize(frame, size) == llen, "%llu", ZSTD_getFrameContentSize(frame, size));
+	fwrite(frame, 1, size, fp);
+	free(frame);
+	fclose(fp);
+
+	/* read */
+	zf_t *rfp = zfopen("tmpfile", "r.zst");
+	assert(rfp != NULL, "%p", rfp);
+
+	char *rarr = (char *)malloc(ulen + llen);
+	size_t read = zfread(rfp, rarr, ulen + llen);
+	assert(read == ulen + llen, "%llu", read);
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+	assert(memcmp(arr, rarr, ulen + llen) == 0);
+
+	/* no slot is expanded to hold a whole frame */
+	struct zf_mt_s *mt = (struct zf_mt_s *)((struct zf_intl_s *)rfp)->fp;
+	for(uint64_t i = 0; i < ZF_MT_SLOT_CNT; i++) {
+		assert(mt->slot[i].out_size <= ZF_MT_SLOT_SIZE, "%llu, %llu", i, mt->slot[i].out_size);
+	}
+	zfclose(rfp);
+
+	/* cleanup */
+	free(rarr);
+	free(arr);
+	remove("tmpfile");
+}
+#endif /* HAVE_ZSTD */
+
+/* xz-dependent tests */
+#ifdef HAVE_LZMA
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* write */
+	zf_t *wfp = zfopen("tmp.txt.xz", "w");
+	assert(wfp != NULL, "%p", wfp);
+
+	size_t written = zfwrite(wfp, arr, TEST_ARR_LEN);
+	assert(written == TEST_ARR_LEN, "%llu", written);
+
+	zfclose(wfp);
+
+	/* read */
+	zf_t *rfp = zfopen("tmp.txt.xz", "r");
+	assert(rfp != NULL, "%p", rfp);
+	assert(strcmp(rfp->path, "tmp.txt") == 0, "%s", rfp->path);
+
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+	assert(read == TEST_ARR_LEN, "%llu", read);
+
+	/* EOF */
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+
+	zfclose(rfp);
+
+	/* compare */
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
+	/* cleanup */
+	free(rarr);
+	remove("tmp.txt.xz");
+}
+#endif /* HAVE_LZMA */
+
 /**
  * end of zf.c
  */
@@ -18,7 +18,7 @@ struct zf_s {
 	char const *path;
 	char const *mode;
 	int reserved1[2];
-	void *reserved2[10];
+	void *reserved2[11];
 	int64_t reserved3[3];
 
 };
@@ -34,6 +34,14 @@ zf_t *zfopen(
 	char const *path,
 	char const *mode);
 
+/**
+ * @fn zfopen_mem
+ * @brief open read-only stream over [ptr, ptr + len) without copying
+ */
+zf_t *zfopen_mem(
+	void const *ptr,
+	size_t len);
+
 /**
  * @fn zfclose
  * @brief close file, similar to fclose / gzclose
@@ -74,6 +82,23 @@ size_t zfwrite(
 int zfgetc(
 	zf_t *zf);
 
+/**
+ * @fn zfbuf
+ * @brief expose the unread bytes in the internal buffer without copying, refilling it if empty.
+ * the number of bytes is stored to *len (0 at EOF). consume them with zfadvance.
+ */
+uint8_t const *zfbuf(
+	zf_t *zf,
+	size_t *len);
+
+/**
+ * @fn zfadvance
+ * @brief advance the read pointer by len (<= the length returned by zfbuf)
+ */
+void zfadvance(
+	zf_t *zf,
+	size_t len);
+
 /**
  * @fn zfungetc
  */